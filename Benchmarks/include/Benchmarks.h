@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdio.h>
+
+namespace hsBench
+{
+
+class Benchmark;
+
+//------------------------------------------------------------------------------
+class BenchmarkCollection
+{
+public:
+    void Add(Benchmark* benchmark);
+
+    //! Runs all benchmarks whose name contains filter, all of them if filter is null
+    void RunBenchmarks(const char* filter);
+
+private:
+    Benchmark* first_{};
+    Benchmark* last_{};
+};
+
+//------------------------------------------------------------------------------
+extern BenchmarkCollection g_BenchmarkCollection;
+
+//------------------------------------------------------------------------------
+class Benchmark
+{
+public:
+    Benchmark(const char* name);
+    virtual void Run() = 0;
+
+    void SetNext(Benchmark* next);
+    Benchmark* GetNext() const;
+
+    const char* GetName() const;
+
+private:
+    Benchmark* next_{};
+    const char* name_{};
+};
+
+//------------------------------------------------------------------------------
+//! Monotonic time in milliseconds
+double GetTimeMs();
+
+//------------------------------------------------------------------------------
+//! Runs func repeatCount times and returns the fastest run in milliseconds
+template<class FuncT>
+double MeasureMs(int repeatCount, const FuncT& func)
+{
+    double best = 0;
+    for (int i = 0; i < repeatCount; ++i)
+    {
+        const double start = GetTimeMs();
+        func();
+        const double time = GetTimeMs() - start;
+        if (i == 0 || time < best)
+            best = time;
+    }
+    return best;
+}
+
+//------------------------------------------------------------------------------
+//! Keeps the compiler from optimizing away results of the measured code
+void DoNotOptimize(const void* value);
+
+}
+
+//------------------------------------------------------------------------------
+#define BENCH_DEF(name) \
+class Bench_##name : public hsBench::Benchmark \
+{ \
+public: \
+    Bench_##name() : Benchmark(#name) {} \
+    void Run() override; \
+} object_Bench_##name ; \
+void Bench_##name::Run()
@@ -0,0 +1,88 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <string.h>
+
+namespace hsBench
+{
+
+//------------------------------------------------------------------------------
+BenchmarkCollection g_BenchmarkCollection;
+
+//------------------------------------------------------------------------------
+const void* volatile g_OptimizationSink;
+
+//------------------------------------------------------------------------------
+void BenchmarkCollection::Add(Benchmark* benchmark)
+{
+    if (!last_)
+    {
+        first_ = benchmark;
+        last_ = first_;
+    }
+    else
+    {
+        last_->SetNext(benchmark);
+        last_ = benchmark;
+    }
+}
+
+//------------------------------------------------------------------------------
+void BenchmarkCollection::RunBenchmarks(const char* filter)
+{
+    printf("Running benchmarks\n");
+
+    Benchmark* benchmark = first_;
+    while (benchmark)
+    {
+        if (!filter || strstr(benchmark->GetName(), filter))
+        {
+            printf("\n------------------------------------------------------------------------------\n");
+            printf("%s\n\n", benchmark->GetName());
+
+            benchmark->Run();
+        }
+
+        benchmark = benchmark->GetNext();
+    }
+}
+
+//------------------------------------------------------------------------------
+Benchmark::Benchmark(const char* name)
+    : name_(name)
+{
+    g_BenchmarkCollection.Add(this);
+}
+
+//------------------------------------------------------------------------------
+void Benchmark::SetNext(Benchmark* next)
+{
+    next_ = next;
+}
+
+//------------------------------------------------------------------------------
+Benchmark* Benchmark::GetNext() const
+{
+    return next_;
+}
+
+//------------------------------------------------------------------------------
+const char* Benchmark::GetName() const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+double GetTimeMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+void DoNotOptimize(const void* value)
+{
+    g_OptimizationSink = value;
+}
+
+}
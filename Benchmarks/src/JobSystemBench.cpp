@@ -0,0 +1,117 @@
+#include "Benchmarks.h"
+
+#include "Threading/JobSystem.h"
+#include "Containers/Array.h"
+#include "Math/Math.h"
+
+#include <thread>
+
+using namespace hsBench;
+using namespace hs;
+
+//------------------------------------------------------------------------------
+static int GetMaxThreads()
+{
+    return Clamp((int)std::thread::hardware_concurrency(), 1, JobSystem::MAX_THREADS);
+}
+
+//------------------------------------------------------------------------------
+static void PrintScalingHeader()
+{
+    printf("%8s %12s %10s %12s\n", "threads", "time [ms]", "speedup", "efficiency");
+}
+
+//------------------------------------------------------------------------------
+static void PrintScalingRow(int threads, double time, double baseTime)
+{
+    const double speedup = baseTime / time;
+    printf("%8d %12.3f %9.2fx %11.1f%%\n", threads, time, speedup, 100.0 * speedup / threads);
+}
+
+//------------------------------------------------------------------------------
+static float HeavyItemWork(float x)
+{
+    for (int i = 0; i < 16; ++i)
+        x = sqrtf(x * x + 1.0f) * 0.5f + sinf(x) * 0.25f;
+    return x;
+}
+
+//------------------------------------------------------------------------------
+static void EmptyJob(void* data)
+{
+    (void)data;
+}
+
+//------------------------------------------------------------------------------
+BENCH_DEF(JobSystem_ParallelFor_Scaling)
+{
+    constexpr int ITEM_COUNT = 1 << 20;
+
+    Array<float> items;
+    items.Reserve(ITEM_COUNT);
+    for (int i = 0; i < ITEM_COUNT; ++i)
+        items.Add((float)i);
+
+    PrintScalingHeader();
+
+    double baseTime = 0;
+    const int maxThreads = GetMaxThreads();
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        JobSystem jobSystem;
+        HS_CHECK(jobSystem.Init(threads));
+
+        const double time = MeasureMs(5, [&]()
+        {
+            jobSystem.ParallelFor(MakeSpan(items.Data(), items.Count()), 1024, [](float& item)
+            {
+                item = HeavyItemWork(item);
+            });
+        });
+        DoNotOptimize(items.Data());
+
+        if (threads == 1)
+            baseTime = time;
+        PrintScalingRow(threads, time, baseTime);
+
+        jobSystem.Free();
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCH_DEF(JobSystem_SmallJobs_Scaling)
+{
+    constexpr int BATCH_SIZE = 2048;
+    constexpr int BATCH_COUNT = 256;
+
+    JobDecl decls[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; ++i)
+        decls[i] = JobDecl{ &EmptyJob, nullptr };
+
+    PrintScalingHeader();
+
+    double baseTime = 0;
+    const int maxThreads = GetMaxThreads();
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        JobSystem jobSystem;
+        HS_CHECK(jobSystem.Init(threads));
+
+        const double time = MeasureMs(3, [&]()
+        {
+            for (int i = 0; i < BATCH_COUNT; ++i)
+            {
+                JobCounter counter;
+                jobSystem.Run(decls, BATCH_SIZE, &counter);
+                jobSystem.Wait(&counter);
+            }
+        });
+
+        if (threads == 1)
+            baseTime = time;
+        PrintScalingRow(threads, time, baseTime);
+        printf("%8s %12.1f ns/job\n", "", time * 1e6 / (BATCH_SIZE * BATCH_COUNT));
+
+        jobSystem.Free();
+    }
+}
@@ -0,0 +1,156 @@
+#include "Benchmarks.h"
+
+#include "Containers/Array.h"
+#include "Math/Math.h"
+#include "Math/MathBatch.h"
+#include "Threading/JobSystem.h"
+
+using namespace hsBench;
+using namespace hs;
+
+namespace
+{
+
+constexpr int MATRIX_COUNT = 1 << 16;
+constexpr int REPEAT_COUNT = 10;
+
+//------------------------------------------------------------------------------
+void MakeMatrices(Array<Mat44>& matrices)
+{
+    matrices.Reserve(MATRIX_COUNT);
+    for (int i = 0; i < MATRIX_COUNT; ++i)
+    {
+        const float f = (float)i;
+        Mat44 m = Mat44::RotationRoll(f * 0.01f) * Mat44::Scale(1.0f + (i % 7));
+        m.SetPosition(Vec3(f, -f, f * 0.5f));
+        matrices.Add(m);
+    }
+}
+
+//------------------------------------------------------------------------------
+void PrintHeader()
+{
+    printf("%12s %12s %12s %10s\n", "", "scalar [ms]", "simd [ms]", "speedup");
+}
+
+//------------------------------------------------------------------------------
+void PrintRow(const char* name, double scalarTime, double simdTime)
+{
+    printf("%12s %12.3f %12.3f %9.2fx\n", name, scalarTime, simdTime, scalarTime / simdTime);
+}
+
+//------------------------------------------------------------------------------
+template<class FuncT>
+double MeasureMatrices(const Array<Mat44>& in, Array<Mat44>& out, FuncT func)
+{
+    const double time = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < in.Count(); ++i)
+            out[i] = func(in[i], in[(i + 1) % in.Count()]);
+    });
+    DoNotOptimize(out.Data());
+    return time;
+}
+
+}
+
+//------------------------------------------------------------------------------
+BENCH_DEF(Math_Mat44_Kernels)
+{
+    Array<Mat44> matrices;
+    MakeMatrices(matrices);
+
+    Array<Mat44> out;
+    for (int i = 0; i < MATRIX_COUNT; ++i)
+        out.Add(Mat44::Identity());
+
+    printf("SSE %d, AVX2 %d, %d matrices\n", HS_SSE, HS_AVX2, MATRIX_COUNT);
+    PrintHeader();
+
+    PrintRow("mul",
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44& b) { return scalar::Mul(a, b); }),
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44& b) { return a * b; })
+    );
+
+    PrintRow("transpose",
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return scalar::Transpose(a); }),
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return Transpose(a); })
+    );
+
+    PrintRow("inverse",
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return scalar::Inverse(a); }),
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return Inverse(a); })
+    );
+
+    PrintRow("affine inv",
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return scalar::InverseAffine(a); }),
+        MeasureMatrices(matrices, out, [](const Mat44& a, const Mat44&) { return InverseAffine(a); })
+    );
+
+    Array<Vec4> vectors;
+    vectors.Reserve(MATRIX_COUNT);
+    for (int i = 0; i < MATRIX_COUNT; ++i)
+        vectors.Add(Vec4((float)i, 1, -(float)i, 1));
+
+    const Mat44 m = matrices[MATRIX_COUNT / 2];
+    const double scalarTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < vectors.Count(); ++i)
+            vectors[i] = scalar::Mul(vectors[i], m);
+    });
+    const double simdTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < vectors.Count(); ++i)
+            vectors[i] = vectors[i] * m;
+    });
+    DoNotOptimize(vectors.Data());
+    PrintRow("transform", scalarTime, simdTime);
+}
+
+//------------------------------------------------------------------------------
+BENCH_DEF(Math_Batch_Transform)
+{
+    constexpr int POINT_COUNT = 1 << 20;
+
+    Array<Vec3> points;
+    Array<Vec4> out;
+    points.Reserve(POINT_COUNT);
+    out.Reserve(POINT_COUNT);
+    for (int i = 0; i < POINT_COUNT; ++i)
+    {
+        points.Add(Vec3((float)i, 1, -(float)i));
+        out.Add(Vec4::ZERO());
+    }
+
+    const Mat44 m = Mat44::RotationRoll(0.3f) * Mat44::Translation(Vec3(1, 2, 3));
+
+    const double perElementTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < points.Count(); ++i)
+            out[i] = points[i].ToVec4Pos() * m;
+    });
+    DoNotOptimize(out.Data());
+
+    const double batchTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        TransformPoints(MakeSpan(points), m, MakeSpan(out));
+    });
+    DoNotOptimize(out.Data());
+
+    JobSystem jobSystem;
+    HS_CHECK(jobSystem.Init());
+
+    const double parallelTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        TransformPointsParallel(&jobSystem, MakeSpan(points), m, MakeSpan(out));
+    });
+    DoNotOptimize(out.Data());
+
+    printf("%d points, %d threads\n", POINT_COUNT, jobSystem.GetThreadCount());
+    jobSystem.Free();
+
+    printf("%12s %12s %10s\n", "", "time [ms]", "speedup");
+    printf("%12s %12.3f %9.2fx\n", "per element", perElementTime, 1.0);
+    printf("%12s %12.3f %9.2fx\n", "batch", batchTime, perElementTime / batchTime);
+    printf("%12s %12.3f %9.2fx\n", "parallel", parallelTime, perElementTime / parallelTime);
+}
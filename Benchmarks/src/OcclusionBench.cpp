@@ -0,0 +1,65 @@
+#include "Benchmarks.h"
+
+#include "Render/OcclusionBuffer.h"
+#include "Containers/Array.h"
+#include "Math/Math.h"
+
+using namespace hsBench;
+using namespace hs;
+
+//------------------------------------------------------------------------------
+BENCH_DEF(OcclusionBuffer_Corridor)
+{
+    constexpr int WALL_COUNT = 64;
+    constexpr int BOX_COUNT = 16 * 1024;
+    constexpr int REPEAT_COUNT = 10;
+
+    OcclusionBuffer buffer;
+    HS_CHECK(buffer.Init());
+
+    const Mat44 view = MakeLookAt(Vec3(0, 0, 0), Vec3(0, 0, 1));
+    const Mat44 viewProj = view * MakePerspectiveProjection(DegToRad(75), 16.0f / 9.0f, 0.1f, 500);
+
+    // Side walls of a corridor plus a few doors which block most of the view
+    const Vec3 wallVerts[] = {
+        Vec3(-1, -1, 0), Vec3(1, -1, 0), Vec3(1, 1, 0), Vec3(-1, 1, 0),
+    };
+    const uint wallIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+    Array<Mat44> walls;
+    for (int i = 0; i < WALL_COUNT; ++i)
+    {
+        const float z = 5.0f + i * 6.0f;
+        const float x = (i % 3 - 1) * 6.0f;
+        walls.Add(Mat44::Scale(4) * Mat44::Translation(Vec3(x, 0, z)));
+    }
+
+    Array<AABB> boxes;
+    Array<uint8> visible;
+    for (int i = 0; i < BOX_COUNT; ++i)
+    {
+        const Vec3 center((float)(i % 41) - 20, (float)(i % 17) - 8, 8.0f + (float)(i % 373));
+        boxes.Add(AABB(center - Vec3(0.5f, 0.5f, 0.5f), center + Vec3(0.5f, 0.5f, 0.5f)));
+        visible.Add(0);
+    }
+
+    const double rasterTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        buffer.BeginFrame(viewProj);
+        for (int i = 0; i < walls.Count(); ++i)
+            buffer.AddOccluder(MakeSpan(wallVerts), MakeSpan(wallIndices), walls[i]);
+        buffer.EndOccluders();
+    });
+
+    uint visibleCount = 0;
+    const double testTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        visibleCount = buffer.TestBoxes(MakeSpan(boxes), MakeSpan(visible));
+    });
+    DoNotOptimize(visible.Data());
+
+    printf("%ux%u buffer, %d occluders, %d boxes\n", buffer.GetWidth(), buffer.GetHeight(), WALL_COUNT, BOX_COUNT);
+    printf("%12s %12.3f ms\n", "rasterize", rasterTime);
+    printf("%12s %12.3f ms, %.1f ns/box\n", "test", testTime, testTime * 1e6 / BOX_COUNT);
+    printf("%12s %12u of %d\n", "visible", visibleCount, BOX_COUNT);
+}
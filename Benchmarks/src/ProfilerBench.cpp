@@ -0,0 +1,38 @@
+#include "Benchmarks.h"
+
+#include "System/Profiler.h"
+
+using namespace hsBench;
+using namespace hs;
+
+//------------------------------------------------------------------------------
+BENCH_DEF(Profiler_ScopeOverhead)
+{
+    constexpr int SCOPE_COUNT = 1000 * 1000;
+    constexpr int REPEAT_COUNT = 5;
+
+    // Without a profiler a scope is only the null check
+    const double disabledTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < SCOPE_COUNT; ++i)
+        {
+            ProfileScope scope("Bench");
+        }
+    });
+
+    HS_CHECK(CreateProfiler());
+    HS_CHECK(g_Profiler->Init());
+
+    const double enabledTime = MeasureMs(REPEAT_COUNT, [&]()
+    {
+        for (int i = 0; i < SCOPE_COUNT; ++i)
+        {
+            ProfileScope scope("Bench");
+        }
+    });
+
+    DestroyProfiler();
+
+    printf("%12s %12.3f ms, %.1f ns/scope\n", "disabled", disabledTime, disabledTime * 1e6 / SCOPE_COUNT);
+    printf("%12s %12.3f ms, %.1f ns/scope\n", "enabled", enabledTime, enabledTime * 1e6 / SCOPE_COUNT);
+}
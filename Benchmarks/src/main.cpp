@@ -0,0 +1,8 @@
+#include "Benchmarks.h"
+
+//------------------------------------------------------------------------------
+// Usage: Benchmarks [name filter]
+int main(int argc, char** argv)
+{
+    hsBench::g_BenchmarkCollection.RunBenchmarks(argc > 1 ? argv[1] : nullptr);
+}
@@ -13,3 +13,8 @@ for %%f in (%shadersSrcDir%\*_vs.hlsl) do (
     echo Compiling %%~nf_vs.hlsl
     dxc -spirv -O3 -T vs_6_0 -E main %%f -Fo %shadersBinDir%\%%~nf.spv -D VS
 )
+
+for %%f in (%shadersSrcDir%\*_cs.hlsl) do (
+    echo Compiling %%~nf_cs.hlsl
+    dxc -spirv -O3 -T cs_6_0 -E main %%f -Fo %shadersBinDir%\%%~nf.spv -D CS
+)
@@ -16,6 +16,8 @@ enum PipelineStage
 {
     PS_VERT,
     PS_FRAG,
+    //! Compute shaders have pipelines of their own, graphics state never sets them
+    PS_COMP,
     PS_COUNT
 };
 
@@ -32,4 +32,34 @@
 #elif defined(_MSC_VER)
     #undef HS_MSVC
     #define HS_MSVC 1
+#elif defined(__GNUC__)
+    #undef HS_GCC
+    #define HS_GCC 1
+#endif
+
+//------------------------------------------------------------------------------
+// SIMD instruction sets the math kernels may use, define HS_NO_SIMD to force scalar code
+#define HS_SSE 0
+#define HS_AVX2 0
+
+#if !defined(HS_NO_SIMD)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #undef HS_SSE
+        #define HS_SSE 1
+    #endif
+
+    // MSVC /arch:AVX2 implies FMA without defining __FMA__
+    #if defined(__AVX2__) && (defined(__FMA__) || HS_MSVC)
+        #undef HS_AVX2
+        #define HS_AVX2 1
+    #endif
+#endif
+
+//------------------------------------------------------------------------------
+// CPU profiling markers, define HS_NO_PROFILE to compile them out
+#define HS_PROFILE 0
+
+#if !defined(HS_NO_PROFILE)
+    #undef HS_PROFILE
+    #define HS_PROFILE 1
 #endif
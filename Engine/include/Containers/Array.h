@@ -452,6 +452,23 @@ public:
         EmplaceBack(std::move(item));
     }
 
+    /*!
+    Adds count items without constructing them and returns the first one, the caller writes them.
+    Only for types which need no construction or destruction.
+    */
+    T* AddCount(Index_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Items added by AddCount are not constructed");
+
+        // Next power of two holding all the items, same as growing by one Add at a time
+        if (Count() + count > Capacity())
+            memory_.Grow(static_cast<Index_t>(NextPow2(static_cast<uint>(Count() + count - 1))));
+
+        T* first = Data() + Count();
+        memory_.CountMut() += count;
+        return first;
+    }
+
     /*!
     If the item is present in the array returs false, if not present adds it and returns true.
     O(n) complexity where n is the number of elements in the array.
@@ -802,6 +819,23 @@ public:
             Add(items[i]);
     }
 
+    /*!
+    Adds count items without constructing them and returns the first one, the caller writes them.
+    Only for types which need no construction or destruction.
+    */
+    T* AddCount(Index_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Items added by AddCount are not constructed");
+
+        // Next power of two holding all the items, same as growing by one Add at a time
+        if (Count() + count > Capacity())
+            Grow(static_cast<Index_t>(NextPow2(static_cast<uint>(Count() + count - 1))));
+
+        T* first = Data() + Count();
+        count_ += count;
+        return first;
+    }
+
     //------------------------------------------------------------------------------
     static constexpr Index_t IndexBad()
     {
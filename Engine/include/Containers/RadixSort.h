@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Config.h"
+#include "Common/Types.h"
+#include "Containers/Span.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+/*!
+Stable LSD radix sort of items by a 64 bit key, one byte per pass. Passes in which all
+keys have the same byte are skipped so short keys cost only the passes they use.
+Scratch must hold at least as many items, the result always ends up in items.
+Items are moved with memcpy so T must be trivially copyable.
+*/
+template<class T, class KeyF>
+void RadixSort(Span<T> items, Span<T> scratch, KeyF key)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    HS_ASSERT(scratch.Count() >= items.Count());
+
+    constexpr uint RADIX = 256;
+    constexpr uint PASSES = sizeof(uint64);
+
+    const uint64 count = items.Count();
+    if (count < 2)
+        return;
+
+    // Histograms of all passes in one go
+    uint64 histograms[PASSES][RADIX]{};
+    for (uint64 i = 0; i < count; ++i)
+    {
+        const uint64 k = key(items[i]);
+        for (uint p = 0; p < PASSES; ++p)
+            ++histograms[p][(k >> (p * 8)) & 0xff];
+    }
+
+    T* src = items.Data();
+    T* dst = scratch.Data();
+    for (uint p = 0; p < PASSES; ++p)
+    {
+        uint64* histogram = histograms[p];
+
+        // Every key has the same byte, order would not change
+        if (histogram[(key(src[0]) >> (p * 8)) & 0xff] == count)
+            continue;
+
+        uint64 offset = 0;
+        for (uint b = 0; b < RADIX; ++b)
+        {
+            const uint64 bucketCount = histogram[b];
+            histogram[b] = offset;
+            offset += bucketCount;
+        }
+
+        for (uint64 i = 0; i < count; ++i)
+        {
+            const uint64 bucket = (key(src[i]) >> (p * 8)) & 0xff;
+            dst[histogram[bucket]++] = src[i];
+        }
+
+        T* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != items.Data())
+        memcpy(items.Data(), src, sizeof(T) * count);
+}
+
+}
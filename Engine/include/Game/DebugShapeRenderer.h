@@ -8,6 +8,8 @@
 
 #include "Containers/Array.h"
 
+#include "System/FrameArena.h"
+
 #include "Common/Enums.h"
 
 namespace hs
@@ -20,6 +22,13 @@ struct DebugShape
     Color color_;
 };
 
+//------------------------------------------------------------------------------
+struct ImmediateDebugShape
+{
+    FrameArray<Vec3> vertices_;
+    Color color_;
+};
+
 //------------------------------------------------------------------------------
 class DebugShapeRenderer
 {
@@ -28,11 +37,20 @@ public:
     void Draw(const RenderPassContext& ctx);
 
     void ClearShapes();
+    //! Shape is drawn every frame until ClearShapes is called
     void AddShape(Span<const Vec3> vertices, Color color);
+    //! Adds the shape with vertices transformed from its local space
+    void AddShape(Span<const Vec3> vertices, Color color, const Mat44& transform);
+    //! Retained shapes in world space
+    Span<const DebugShape> GetShapes() const;
+
+    //! Shape is drawn in the current frame only, its vertices live in g_FrameArena which must exist
+    void AddImmediateShape(Span<const Vec3> vertices, Color color);
 
 private:
     DebugShapeMaterial debugShapeMat_;
     Array<DebugShape> shapes_;
+    Array<ImmediateDebugShape> immediateShapes_;
 };
 
 }
@@ -18,13 +18,6 @@ struct Sprite
     Vec2 pivot_;
 };
 
-//------------------------------------------------------------------------------
-struct SpriteDrawCall
-{
-    Sprite* sprite_;
-    Mat44 world_;
-};
-
 //------------------------------------------------------------------------------
 class SpriteRenderer
 {
@@ -37,7 +30,12 @@ public:
 
 private:
     SpriteMaterial spriteMaterial_;
-    Array<SpriteDrawCall> drawCalls_;
+    Array<SpriteDrawData> drawCalls_;
+
+    //! Depth key in the high bits, index to drawCalls_ in the low ones
+    Array<uint64> sortItems_;
+    Array<uint64> sortScratch_;
+    Array<uint> drawOrder_;
 };
 
 }
@@ -42,6 +42,8 @@ private:
     };
 
     Array<Text> texts_;
+    //! Copies of the texts added while there is no frame arena
+    Array<String> heapTexts_;
 
     const RenderPassContext* ctx_;
 
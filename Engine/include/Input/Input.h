@@ -83,6 +83,7 @@ public:
     #if HS_WINDOWS
         RESULT InitWin32(HWND hwnd);
     #elif HS_LINUX
+        //! Window is null in headless mode, there is no input then
         RESULT InitLinux(GLFWwindow* window);
     #endif
 
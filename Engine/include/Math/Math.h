@@ -6,7 +6,15 @@
 #include "Common/Assert.h"
 
 #include <math.h>
-#include <intrin.h>
+#include <float.h>
+
+#if HS_MSVC
+    #include <intrin.h>
+#endif
+
+#if HS_SSE
+    #include <immintrin.h>
+#endif
 
 namespace hs
 {
@@ -600,6 +608,9 @@ struct Mat44;
 inline Vec4 operator*(const Vec4& v, const Mat44& m);
 inline Mat44 operator*(const Mat44& m, float s);
 inline Mat44 operator*(float s, const Mat44& m);
+inline Mat44 Transpose(const Mat44& m);
+inline Mat44 Inverse(const Mat44& m);
+inline Mat44 InverseAffine(const Mat44& m);
 
 //------------------------------------------------------------------------------
 // Matrix is saved as row major, meaning that the vector at m[0] is the first
@@ -611,17 +622,7 @@ inline Mat44 operator*(float s, const Mat44& m);
 //------------------------------------------------------------------------------
 struct Mat44
 {
-    union
-    {
-        float m[4][4];
-        struct
-        {
-            Vec4 a;
-            Vec4 b;
-            Vec4 c;
-            Vec4 pos;
-        };
-    };
+    float m[4][4];
 
     static Mat44 Identity()
     {
@@ -720,82 +721,26 @@ struct Mat44
     //------------------------------------------------------------------------------
     void SetPosition(const Vec3& position)
     {
-        pos = Vec4{ position.x, position.y, position.z, 1 };
+        m[3][0] = position.x; m[3][1] = position.y; m[3][2] = position.z; m[3][3] = 1;
     }
 
     //------------------------------------------------------------------------------
     Mat44 GetInverse() const
     {
-        const Vec3 a3(XYZ(a));
-        const Vec3 b3(XYZ(b));
-        const Vec3 c3(XYZ(c));
-        const Vec3 d3(XYZ(pos));
-
-        const float x = (*this)(0, 3);
-        const float y = (*this)(1, 3);
-        const float z = (*this)(2, 3);
-        const float w = (*this)(3, 3);
-
-        Vec3 s = a3.Cross(b3);
-        Vec3 t = c3.Cross(d3);
-        Vec3 u = a3 * y - b3 * x;
-        Vec3 v = c3 * w - d3 * z;
-
-        const float det = s.Dot(v) + t.Dot(u);
-        HS_ASSERT(det && "Matrix must be regular");
-
-        const float invDet = 1.0f / det;
-        s *= invDet;
-        t *= invDet;
-        u *= invDet;
-        v *= invDet;
-
-        const Vec3 r0 = b3.Cross(v) + t * y;
-        const Vec3 r1 = v.Cross(a3) - t * x;
-        const Vec3 r2 = d3.Cross(u) + s * w;
-        const Vec3 r3 = u.Cross(c3) - s * z;
-
-        const Mat44 inverse(
-            r0.x, r1.x, r2.x, r3.x,
-            r0.y, r1.y, r2.y, r3.y,
-            r0.z, r1.z, r2.z, r3.z,
-            -b3.Dot(t), a3.Dot(t), -d3.Dot(s), c3.Dot(s)
-        );
-
-        return inverse;
+        return Inverse(*this);
     }
 
     //------------------------------------------------------------------------------
+    //! Inverse of a matrix with the last column (0, 0, 0, 1)
     Mat44 GetInverseTransform() const
     {
-        const Vec3 a3(XYZ(a));
-        const Vec3 b3(XYZ(b));
-        const Vec3 c3(XYZ(c));
-        const Vec3 d3(XYZ(pos));
-
-        Vec3 s = a3.Cross(b3);
-        Vec3 t = c3.Cross(d3);
-
-        const float det = s.Dot(c3);
-        HS_ASSERT(det && "Matrix must be regular");
-
-        const float invDet = 1.0f / det;
-
-        s *= invDet;
-        t *= invDet;
-        const Vec3 v = c3 * invDet;
-
-        const Vec3 r0 = b3.Cross(v);
-        const Vec3 r1 = v.Cross(a3);
-
-        const Mat44 inverse(
-            r0.x, r1.x, s.x,                0,
-            r0.y, r1.y, s.y,                0,
-            r0.z, r1.z, s.z,                0,
-            -b3.Dot(t), a3.Dot(t), -d3.Dot(s), 1
-        );
+        return InverseAffine(*this);
+    }
 
-        return inverse;
+    //------------------------------------------------------------------------------
+    Mat44 GetTransposed() const
+    {
+        return Transpose(*this);
     }
 
     //------------------------------------------------------------------------------
@@ -835,7 +780,15 @@ inline constexpr Vec4::Vec4(const Vec3& v, float w)
 }
 
 //------------------------------------------------------------------------------
-inline Mat44 operator*(const Mat44& a, const Mat44& b)
+// Matrix kernels
+// Scalar versions are always available, SIMD ones when the target supports them.
+// Operators and Mat44 members use the widest one the target allows.
+//------------------------------------------------------------------------------
+namespace scalar
+{
+
+//------------------------------------------------------------------------------
+inline Mat44 Mul(const Mat44& a, const Mat44& b)
 {
     Mat44 out;
 
@@ -863,7 +816,7 @@ inline Mat44 operator*(const Mat44& a, const Mat44& b)
 }
 
 //------------------------------------------------------------------------------
-inline Vec4 operator*(const Vec4& v, const Mat44& m)
+inline Vec4 Mul(const Vec4& v, const Mat44& m)
 {
     Vec4 out;
 
@@ -875,6 +828,358 @@ inline Vec4 operator*(const Vec4& v, const Mat44& m)
     return out;
 }
 
+//------------------------------------------------------------------------------
+inline Mat44 Transpose(const Mat44& m)
+{
+    Mat44 out;
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+            out(i, j) = m(j, i);
+    }
+
+    return out;
+}
+
+//------------------------------------------------------------------------------
+// Lengyel, Foundations of Game Engine Development, Volume 1
+inline Mat44 Inverse(const Mat44& m)
+{
+    const Vec3 a3(m(0, 0), m(0, 1), m(0, 2));
+    const Vec3 b3(m(1, 0), m(1, 1), m(1, 2));
+    const Vec3 c3(m(2, 0), m(2, 1), m(2, 2));
+    const Vec3 d3(m(3, 0), m(3, 1), m(3, 2));
+
+    const float x = m(0, 3);
+    const float y = m(1, 3);
+    const float z = m(2, 3);
+    const float w = m(3, 3);
+
+    Vec3 s = a3.Cross(b3);
+    Vec3 t = c3.Cross(d3);
+    Vec3 u = a3 * y - b3 * x;
+    Vec3 v = c3 * w - d3 * z;
+
+    const float det = s.Dot(v) + t.Dot(u);
+    HS_ASSERT(det && "Matrix must be regular");
+
+    const float invDet = 1.0f / det;
+    s *= invDet;
+    t *= invDet;
+    u *= invDet;
+    v *= invDet;
+
+    const Vec3 r0 = b3.Cross(v) + t * y;
+    const Vec3 r1 = v.Cross(a3) - t * x;
+    const Vec3 r2 = d3.Cross(u) + s * w;
+    const Vec3 r3 = u.Cross(c3) - s * z;
+
+    const Mat44 inverse(
+        r0.x, r1.x, r2.x, r3.x,
+        r0.y, r1.y, r2.y, r3.y,
+        r0.z, r1.z, r2.z, r3.z,
+        -b3.Dot(t), a3.Dot(t), -d3.Dot(s), c3.Dot(s)
+    );
+
+    return inverse;
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 InverseAffine(const Mat44& m)
+{
+    const Vec3 a3(m(0, 0), m(0, 1), m(0, 2));
+    const Vec3 b3(m(1, 0), m(1, 1), m(1, 2));
+    const Vec3 c3(m(2, 0), m(2, 1), m(2, 2));
+    const Vec3 d3(m(3, 0), m(3, 1), m(3, 2));
+
+    Vec3 s = a3.Cross(b3);
+    Vec3 t = c3.Cross(d3);
+
+    const float det = s.Dot(c3);
+    HS_ASSERT(det && "Matrix must be regular");
+
+    const float invDet = 1.0f / det;
+
+    s *= invDet;
+    t *= invDet;
+    const Vec3 v = c3 * invDet;
+
+    const Vec3 r0 = b3.Cross(v);
+    const Vec3 r1 = v.Cross(a3);
+
+    const Mat44 inverse(
+        r0.x, r1.x, s.x,                0,
+        r0.y, r1.y, s.y,                0,
+        r0.z, r1.z, s.z,                0,
+        -b3.Dot(t), a3.Dot(t), -d3.Dot(s), 1
+    );
+
+    return inverse;
+}
+
+}
+
+#if HS_SSE
+//------------------------------------------------------------------------------
+namespace sse
+{
+
+//------------------------------------------------------------------------------
+inline __m128 Splat(__m128 v, int lane)
+{
+    switch (lane)
+    {
+        case 0: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+        case 1: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        case 2: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        default: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+//------------------------------------------------------------------------------
+//! Cross product of xyz, w of the result is 0
+inline __m128 Cross3(__m128 a, __m128 b)
+{
+    const __m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+//------------------------------------------------------------------------------
+//! Dot product of xyz
+inline float Dot3(__m128 a, __m128 b)
+{
+    const __m128 m = _mm_mul_ps(a, b);
+    const __m128 sum = _mm_add_ss(_mm_add_ss(m, Splat(m, 1)), Splat(m, 2));
+    return _mm_cvtss_f32(sum);
+}
+
+//------------------------------------------------------------------------------
+//! Row r of the result is the row vector a[r] times b
+inline __m128 MulRow(__m128 row, const __m128 b[4])
+{
+    __m128 r = _mm_mul_ps(Splat(row, 0), b[0]);
+    r = _mm_add_ps(r, _mm_mul_ps(Splat(row, 1), b[1]));
+    r = _mm_add_ps(r, _mm_mul_ps(Splat(row, 2), b[2]));
+    r = _mm_add_ps(r, _mm_mul_ps(Splat(row, 3), b[3]));
+    return r;
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 Mul(const Mat44& a, const Mat44& b)
+{
+    const __m128 rowsB[4] = {
+        _mm_loadu_ps(b.m[0]),
+        _mm_loadu_ps(b.m[1]),
+        _mm_loadu_ps(b.m[2]),
+        _mm_loadu_ps(b.m[3]),
+    };
+
+    Mat44 out;
+    for (int i = 0; i < 4; ++i)
+        _mm_storeu_ps(out.m[i], MulRow(_mm_loadu_ps(a.m[i]), rowsB));
+
+    return out;
+}
+
+//------------------------------------------------------------------------------
+inline Vec4 Mul(const Vec4& v, const Mat44& m)
+{
+    const __m128 rows[4] = {
+        _mm_loadu_ps(m.m[0]),
+        _mm_loadu_ps(m.m[1]),
+        _mm_loadu_ps(m.m[2]),
+        _mm_loadu_ps(m.m[3]),
+    };
+
+    Vec4 out;
+    _mm_storeu_ps(out.v, MulRow(_mm_loadu_ps(v.v), rows));
+    return out;
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 Transpose(const Mat44& m)
+{
+    __m128 r0 = _mm_loadu_ps(m.m[0]);
+    __m128 r1 = _mm_loadu_ps(m.m[1]);
+    __m128 r2 = _mm_loadu_ps(m.m[2]);
+    __m128 r3 = _mm_loadu_ps(m.m[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    Mat44 out;
+    _mm_storeu_ps(out.m[0], r0);
+    _mm_storeu_ps(out.m[1], r1);
+    _mm_storeu_ps(out.m[2], r2);
+    _mm_storeu_ps(out.m[3], r3);
+    return out;
+}
+
+//------------------------------------------------------------------------------
+// Same algorithm as scalar::Inverse, rows of the 3x3 part are computed as columns and transposed
+inline Mat44 Inverse(const Mat44& m)
+{
+    const __m128 a = _mm_loadu_ps(m.m[0]);
+    const __m128 b = _mm_loadu_ps(m.m[1]);
+    const __m128 c = _mm_loadu_ps(m.m[2]);
+    const __m128 d = _mm_loadu_ps(m.m[3]);
+
+    const __m128 x = Splat(a, 3);
+    const __m128 y = Splat(b, 3);
+    const __m128 z = Splat(c, 3);
+    const __m128 w = Splat(d, 3);
+
+    // W lanes cancel out to 0 in all of these
+    __m128 s = Cross3(a, b);
+    __m128 t = Cross3(c, d);
+    __m128 u = _mm_sub_ps(_mm_mul_ps(a, y), _mm_mul_ps(b, x));
+    __m128 v = _mm_sub_ps(_mm_mul_ps(c, w), _mm_mul_ps(d, z));
+
+    const float det = Dot3(s, v) + Dot3(t, u);
+    HS_ASSERT(det && "Matrix must be regular");
+
+    const __m128 invDet = _mm_set1_ps(1.0f / det);
+    s = _mm_mul_ps(s, invDet);
+    t = _mm_mul_ps(t, invDet);
+    u = _mm_mul_ps(u, invDet);
+    v = _mm_mul_ps(v, invDet);
+
+    __m128 r0 = _mm_add_ps(Cross3(b, v), _mm_mul_ps(t, y));
+    __m128 r1 = _mm_sub_ps(Cross3(v, a), _mm_mul_ps(t, x));
+    __m128 r2 = _mm_add_ps(Cross3(d, u), _mm_mul_ps(s, w));
+    __m128 r3 = _mm_sub_ps(Cross3(u, c), _mm_mul_ps(s, z));
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    Mat44 out;
+    _mm_storeu_ps(out.m[0], r0);
+    _mm_storeu_ps(out.m[1], r1);
+    _mm_storeu_ps(out.m[2], r2);
+    _mm_storeu_ps(out.m[3], _mm_setr_ps(-Dot3(b, t), Dot3(a, t), -Dot3(d, s), Dot3(c, s)));
+    return out;
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 InverseAffine(const Mat44& m)
+{
+    const __m128 a = _mm_loadu_ps(m.m[0]);
+    const __m128 b = _mm_loadu_ps(m.m[1]);
+    const __m128 c = _mm_loadu_ps(m.m[2]);
+    const __m128 d = _mm_loadu_ps(m.m[3]);
+
+    __m128 s = Cross3(a, b);
+    __m128 t = Cross3(c, d);
+
+    const float det = Dot3(s, c);
+    HS_ASSERT(det && "Matrix must be regular");
+
+    const __m128 invDet = _mm_set1_ps(1.0f / det);
+    s = _mm_mul_ps(s, invDet);
+    t = _mm_mul_ps(t, invDet);
+    const __m128 v = _mm_mul_ps(c, invDet);
+
+    __m128 r0 = Cross3(b, v);
+    __m128 r1 = Cross3(v, a);
+    __m128 r2 = s;
+    __m128 r3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    Mat44 out;
+    _mm_storeu_ps(out.m[0], r0);
+    _mm_storeu_ps(out.m[1], r1);
+    _mm_storeu_ps(out.m[2], r2);
+    _mm_storeu_ps(out.m[3], _mm_setr_ps(-Dot3(b, t), Dot3(a, t), -Dot3(d, s), 1));
+    return out;
+}
+
+}
+#endif
+
+#if HS_AVX2
+//------------------------------------------------------------------------------
+namespace avx2
+{
+
+//------------------------------------------------------------------------------
+//! Two rows of a per iteration, each 128 bit lane does one row
+inline Mat44 Mul(const Mat44& a, const Mat44& b)
+{
+    const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[0]));
+    const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[1]));
+    const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[2]));
+    const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[3]));
+
+    Mat44 out;
+    for (int i = 0; i < 4; i += 2)
+    {
+        const __m256 rows = _mm256_loadu_ps(a.m[i]);
+
+        __m256 r = _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        r = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(1, 1, 1, 1)), b1, r);
+        r = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(2, 2, 2, 2)), b2, r);
+        r = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(3, 3, 3, 3)), b3, r);
+
+        _mm256_storeu_ps(out.m[i], r);
+    }
+
+    return out;
+}
+
+}
+#endif
+
+//------------------------------------------------------------------------------
+inline Mat44 operator*(const Mat44& a, const Mat44& b)
+{
+    #if HS_AVX2
+        return avx2::Mul(a, b);
+    #elif HS_SSE
+        return sse::Mul(a, b);
+    #else
+        return scalar::Mul(a, b);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+inline Vec4 operator*(const Vec4& v, const Mat44& m)
+{
+    #if HS_SSE
+        return sse::Mul(v, m);
+    #else
+        return scalar::Mul(v, m);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 Transpose(const Mat44& m)
+{
+    #if HS_SSE
+        return sse::Transpose(m);
+    #else
+        return scalar::Transpose(m);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+inline Mat44 Inverse(const Mat44& m)
+{
+    #if HS_SSE
+        return sse::Inverse(m);
+    #else
+        return scalar::Inverse(m);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+//! Inverse of a matrix with the last column (0, 0, 0, 1)
+inline Mat44 InverseAffine(const Mat44& m)
+{
+    #if HS_SSE
+        return sse::InverseAffine(m);
+    #else
+        return scalar::InverseAffine(m);
+    #endif
+}
+
 //------------------------------------------------------------------------------
 inline Mat44 operator*(const Mat44& m, float s)
 {
@@ -989,19 +1294,19 @@ public:
     };
 
     //------------------------------------------------------------------------------
-    static constexpr Color ToLinear(const Color& srgb)
+    static Color ToLinear(const Color& srgb)
     {
         return Color{ ::hs::ToLinear(srgb.r), ::hs::ToLinear(srgb.g), ::hs::ToLinear(srgb.b), srgb.a };
     }
 
     //------------------------------------------------------------------------------
-    static constexpr Color ToSrgb(const Color& linear)
+    static Color ToSrgb(const Color& linear)
     {
         return Color{ ::hs::ToSrgb(linear.r), ::hs::ToSrgb(linear.g), ::hs::ToSrgb(linear.b), linear.a };
     }
 
     //------------------------------------------------------------------------------
-    static constexpr Color FromSrgb(uint8 r, uint8 g, uint8 b, uint8 a)
+    static Color FromSrgb(uint8 r, uint8 g, uint8 b, uint8 a)
     {
         return ToLinear(Color(r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f));
     }
@@ -1013,7 +1318,7 @@ public:
     {}
 
     //------------------------------------------------------------------------------
-    constexpr uint ToSrgbUint() const
+    uint ToSrgbUint() const
     {
         const Color srgb = ToSrgb(*this);
         const uint col =
@@ -1073,6 +1378,136 @@ struct Circle
     }
 };
 
+//------------------------------------------------------------------------------
+struct AABB
+{
+    Vec3 min_;
+    Vec3 max_;
+
+    AABB() = default;
+    AABB(const Vec3& min, const Vec3& max)
+        : min_(min)
+        , max_(max)
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    //! Box with min above max, used for objects which have no bounds
+    static AABB Invalid()
+    {
+        return AABB(Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsValid() const
+    {
+        return min_.x <= max_.x && min_.y <= max_.y && min_.z <= max_.z;
+    }
+
+    //------------------------------------------------------------------------------
+    Vec3 GetCenter() const
+    {
+        return (min_ + max_) * 0.5f;
+    }
+
+    //------------------------------------------------------------------------------
+    Vec3 GetExtents() const
+    {
+        return (max_ - min_) * 0.5f;
+    }
+};
+
+//------------------------------------------------------------------------------
+//! Box containing the transformed box, Arvo's method
+inline AABB TransformAABB(const AABB& box, const Mat44& m)
+{
+    AABB result;
+    for (int j = 0; j < 3; ++j)
+    {
+        float min = m(3, j);
+        float max = m(3, j);
+        for (int i = 0; i < 3; ++i)
+        {
+            const float a = m(i, j) * box.min_.v[i];
+            const float b = m(i, j) * box.max_.v[i];
+            min += a < b ? a : b;
+            max += a < b ? b : a;
+        }
+        result.min_.v[j] = min;
+        result.max_.v[j] = max;
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+struct Sphere
+{
+    Vec3    center_;
+    float   radius_;
+
+    Sphere() = default;
+    Sphere(const Vec3& center, float radius)
+        : center_(center)
+        , radius_(radius)
+    {
+    }
+};
+
+//------------------------------------------------------------------------------
+enum FrustumPlane
+{
+    FP_LEFT,
+    FP_RIGHT,
+    FP_BOTTOM,
+    FP_TOP,
+    FP_NEAR,
+    FP_FAR,
+    FP_COUNT
+};
+
+//------------------------------------------------------------------------------
+//! Planes as (normal, d) with normals pointing inside, a point p is inside when Dot(normal, p) + d >= 0
+struct Frustum
+{
+    Vec4 planes_[FP_COUNT];
+};
+
+//------------------------------------------------------------------------------
+/*!
+Extracts planes from a view projection matrix (Gribb-Hartmann). Row vectors are
+multiplied from the left and clip depth is 0..1, so planes are combinations of the
+matrix columns.
+*/
+inline Frustum MakeFrustum(const Mat44& viewProj)
+{
+    auto column = [&viewProj](int j)
+    {
+        return Vec4(viewProj(0, j), viewProj(1, j), viewProj(2, j), viewProj(3, j));
+    };
+
+    const Vec4 x = column(0);
+    const Vec4 y = column(1);
+    const Vec4 z = column(2);
+    const Vec4 w = column(3);
+
+    Frustum frustum;
+    frustum.planes_[FP_LEFT]   = Vec4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);
+    frustum.planes_[FP_RIGHT]  = Vec4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);
+    frustum.planes_[FP_BOTTOM] = Vec4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);
+    frustum.planes_[FP_TOP]    = Vec4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);
+    frustum.planes_[FP_NEAR]   = z;
+    frustum.planes_[FP_FAR]    = Vec4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);
+
+    for (int i = 0; i < FP_COUNT; ++i)
+    {
+        Vec4& p = frustum.planes_[i];
+        const float invLen = 1.0f / sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = Vec4(p.x * invLen, p.y * invLen, p.z * invLen, p.w * invLen);
+    }
+
+    return frustum;
+}
+
 //------------------------------------------------------------------------------
 // Intersections
 //------------------------------------------------------------------------------
@@ -1109,6 +1544,36 @@ struct Circle
     return distSq <= Sqr(circle.radius_);
 }
 
+//------------------------------------------------------------------------------
+[[nodiscard]] inline bool IsIntersecting(const Frustum& frustum, const Sphere& sphere)
+{
+    for (int i = 0; i < FP_COUNT; ++i)
+    {
+        const Vec4& p = frustum.planes_[i];
+        const float dist = p.x * sphere.center_.x + p.y * sphere.center_.y + p.z * sphere.center_.z + p.w;
+        if (dist < -sphere.radius_)
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//! Conservative, boxes outside of the frustum near its corners may still pass
+[[nodiscard]] inline bool IsIntersecting(const Frustum& frustum, const AABB& box)
+{
+    const Vec3 c = box.GetCenter();
+    const Vec3 e = box.GetExtents();
+    for (int i = 0; i < FP_COUNT; ++i)
+    {
+        const Vec4& p = frustum.planes_[i];
+        const float dist = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+        const float radius = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+        if (dist < -radius)
+            return false;
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 [[nodiscard]] constexpr inline bool IsIntersecting(const Circle& circle, const Box2D& box)
 {
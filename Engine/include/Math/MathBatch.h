@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Config.h"
+
+#include "Math/Math.h"
+
+#include "Containers/Span.h"
+
+namespace hs
+{
+
+class JobSystem;
+
+//------------------------------------------------------------------------------
+/*!
+Batch versions of the Mat44 operations for hot loops. Points are processed four at a
+time, deinterleaved into xxxx/yyyy/zzzz registers against splatted matrix elements and
+interleaved back on store. Output spans must have the same count as the input.
+
+The Parallel variants split the range into chunks executed on the job system and wait
+for them, small batches are done on the calling thread.
+*/
+
+//------------------------------------------------------------------------------
+//! out[i] = Vec4(points[i], 1) * m
+void TransformPoints(Span<const Vec3> points, const Mat44& m, Span<Vec4> out);
+
+//------------------------------------------------------------------------------
+//! out[i] = xyz of Vec4(points[i], 1) * m, no perspective divide
+void TransformPoints(Span<const Vec3> points, const Mat44& m, Span<Vec3> out);
+
+//------------------------------------------------------------------------------
+//! out[i] = vectors[i] * m
+void TransformVectors(Span<const Vec4> vectors, const Mat44& m, Span<Vec4> out);
+
+//------------------------------------------------------------------------------
+//! out[i] = a[i] * b[i], or a[i] * b[0] when b has a single matrix
+void MultiplyMatrices(Span<const Mat44> a, Span<const Mat44> b, Span<Mat44> out);
+
+//------------------------------------------------------------------------------
+//! visible[i] = IsIntersecting(frustum, boxes[i]), tests four boxes at a time, returns the visible count
+uint CullBoxes(const Frustum& frustum, Span<const AABB> boxes, Span<uint8> visible);
+
+//------------------------------------------------------------------------------
+void TransformPointsParallel(JobSystem* jobSystem, Span<const Vec3> points, const Mat44& m, Span<Vec4> out);
+void TransformVectorsParallel(JobSystem* jobSystem, Span<const Vec4> vectors, const Mat44& m, Span<Vec4> out);
+void MultiplyMatricesParallel(JobSystem* jobSystem, Span<const Mat44> a, Span<const Mat44> b, Span<Mat44> out);
+uint CullBoxesParallel(JobSystem* jobSystem, const Frustum& frustum, Span<const AABB> boxes, Span<uint8> visible);
+
+}
@@ -14,6 +14,10 @@ enum class RenderBufferType
     Uniform,
     Vertex,
     Index,
+    //! Source of copies to device local memory
+    Staging,
+    //! Arguments of indirect draws, may be written by compute passes
+    Indirect,
 };
 
 //------------------------------------------------------------------------------
@@ -34,13 +38,18 @@ public:
     void* Map();
     void Unmap();
 
+    //! HostToDevice and DeviceToHost buffers stay mapped for their whole lifetime, device local ones only on the null backend
+    void* GetMappedData() const;
+
     VkBuffer GetBuffer() const;
+    VmaAllocation GetAllocation() const;
     int GetSize() const;
 
 protected:
     VkBuffer            buffer_{};
     VmaAllocation       allocation_{};
     VkBufferView        view_{};
+    void*               mapped_{};
     int                 size_;
     RenderBufferType    type_;
 };
@@ -48,20 +57,5 @@ protected:
 //------------------------------------------------------------------------------
 void RenderCopyBuffer(VkCommandBuffer cmdBuff, RenderBufferEntry dst, RenderBufferEntry src);
 
-//------------------------------------------------------------------------------
-class TempStagingBuffer
-{
-public:
-    TempStagingBuffer(int size);
-    RESULT Allocate(const void* data);
-
-    VkBuffer GetBuffer() const;
-
-private:
-    VkBuffer        buffer_;
-    VmaAllocation   allocation_;
-    int             size_;
-};
-
 }
 
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Config.h"
+
+#include "Render/Buffer.h"
+#include "Render/RenderBufferEntry.h"
+#include "Render/MeshPool.h"
+#include "Render/VkTypes.h"
+
+#include "Containers/Array.h"
+#include "Containers/Span.h"
+
+#include "Math/Math.h"
+
+#include "Common/Types.h"
+
+namespace hs
+{
+
+class Material;
+class Shader;
+struct VisualObject;
+struct RenderPassContext;
+
+//------------------------------------------------------------------------------
+//! Objects of one material whose meshes share a pool and index type, drawn by one indirect draw
+struct GpuCullBatch
+{
+    Material*           material_{};
+    MeshPool*           pool_{};
+    IndexType           indexType_{};
+    //! Instance stream of all culled objects, commands select the object's instance with firstInstance
+    RenderBufferEntry   instances_;
+    //! maxDraws_ VkDrawIndexedIndirectCommands, one per object of the batch
+    RenderBufferEntry   commands_;
+    //! uint count of the commands written, empty when culled objects keep theirs with zero instances
+    RenderBufferEntry   drawCount_;
+    uint                maxDraws_{};
+};
+
+//------------------------------------------------------------------------------
+//! Counts of the last Cull
+struct GpuCullStats
+{
+    uint    objects_{};
+    uint    batches_{};
+    //! Objects passing the frustum test, only known when the CPU reference ran
+    uint    visible_{};
+    //! Totals of all frames whose output was compared to the CPU reference
+    uint    framesValidated_{};
+    uint    validationFailures_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Frustum culling on the GPU. A compute pass tests the bounds of each object and writes one
+indexed indirect command per visible object, grouped into batches of objects drawn with the
+same material and mesh pool. Each batch is then drawn with one indirect draw whose draw count
+the pass wrote, so the CPU never learns what was visible.
+
+Devices without draw count buffers get the commands of culled objects with zero instances
+instead. Each frame slot has its own output buffers, they are reused once the render waited
+for the slot's previous frame. The null backend runs the CPU reference in place of the pass.
+*/
+class GpuCuller
+{
+public:
+    static constexpr uint THREAD_GROUP_SIZE = 64;
+
+    RESULT Init(uint frameCount);
+    void Free();
+
+    //! Copies the output of each frame back and compares it to the CPU reference when the slot is reused
+    void SetValidation(bool validation);
+
+    /*!
+    Records the culling pass for the objects into the frame's command buffer, must be called
+    outside of render passes. Objects must have a pool mesh and a material supporting GPU culling.
+    */
+    void Cull(VkCommandBuffer cmdBuff, uint frameIdx, Span<VisualObject* const> objects, const Mat44& viewProj);
+    //! Draws the batches of the last Cull
+    void Draw(const RenderPassContext& ctx);
+
+    Span<const GpuCullBatch> GetBatches() const;
+    const GpuCullStats& GetStats() const;
+
+private:
+    static constexpr uint MAX_FRAMES = 4;
+
+    //! Outputs of one frame slot, grown by recreating them when the objects don't fit
+    struct FrameSlot
+    {
+        RenderBuffer    commands_;
+        RenderBuffer    drawCounts_;
+        VkDescriptorSet descSet_{};
+
+        //! Validation, the output copied back and what the CPU reference expects
+        RenderBuffer    commandsReadback_;
+        RenderBuffer    drawCountsReadback_;
+        Array<VkDrawIndexedIndirectCommand> expectedCommands_;
+        Array<uint>     expectedCounts_;
+        //! Per object, its command when visible and the CullVisibility flags the reference gave it
+        Array<VkDrawIndexedIndirectCommand> objectCommands_;
+        Array<uint8>    objectVisibility_;
+        //! First command of each batch and the command count at the end
+        Array<uint>     batchBases_;
+        bool            compact_{};
+        bool            validationPending_{};
+    };
+
+    struct BatchKey
+    {
+        Material*   material_;
+        MeshPool*   pool_;
+        IndexType   indexType_;
+        uint        base_;
+        uint        count_;
+    };
+
+    FrameSlot               slots_[MAX_FRAMES];
+    uint                    frameCount_{};
+    bool                    validation_{};
+    bool                    initialized_{};
+
+    Shader*                 cullShader_{};
+    VkDescriptorSetLayout   setLayout_{};
+    VkPipelineLayout        pipelineLayout_{};
+    VkPipeline              pipeline_{};
+    VkDescriptorPool        descPool_{};
+
+    Array<BatchKey>         batchKeys_;
+    //! Objects reordered so the objects of each batch are next to each other
+    Array<VisualObject*>    sortedObjects_;
+    Array<uint>             objectBatches_;
+    Array<GpuCullBatch>     batches_;
+    //! Objects whose command validation found in the output
+    Array<uint8>            seenScratch_;
+
+    GpuCullStats            stats_;
+
+    RESULT CreatePipeline();
+    //! Fills batchKeys_ and sortedObjects_, returns the batch count
+    uint SortIntoBatches(Span<VisualObject* const> objects);
+    RESULT ReserveSlot(FrameSlot& slot, uint commandCount, uint batchCount);
+    void ValidateSlot(FrameSlot& slot);
+};
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Config.h"
+
+#include "Render/VkTypes.h"
+
+#include "Containers/Array.h"
+
+#include "Common/Types.h"
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+struct GpuScopeStats
+{
+    //! Static string, scopes are matched by name
+    const char* name_{};
+    //! Nesting depth of the scope when it was last recorded
+    uint        depth_{};
+    float       lastMs_{};
+    //! Exponential moving average of lastMs_
+    float       avgMs_{};
+    float       maxMs_{};
+    uint64      sampleCount_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Measures GPU time of named scopes using timestamp queries. Each frame slot has its own
+range of queries, results of a slot are read back when the slot is reused, at that point
+the render has already waited for the GPU to finish it so reading never stalls.
+
+Scopes may nest and must begin and end in the same command buffer. When the queue does
+not support timestamps, e.g. on some software implementations, all calls are no-ops.
+*/
+class GpuProfiler
+{
+public:
+    static constexpr uint MAX_SCOPES = 32;
+    //! Same as RenderConfig::MAX_FRAMES_IN_FLIGHT
+    static constexpr uint MAX_FRAMES = 4;
+    static constexpr const char* CSV_FILE = "GpuProfile.csv";
+
+    RESULT Init(VkDevice device, VkPhysicalDevice physicalDevice, uint queueFamilyIdx, uint frameCount);
+    void Free();
+
+    //! Reads back results of the frame slot's previous frame and resets its queries, must be called outside of a render pass
+    void BeginFrame(VkCommandBuffer cmdBuff, uint frameIdx);
+
+    //! Returns the scope slot to pass to EndScope
+    uint BeginScope(VkCommandBuffer cmdBuff, const char* name);
+    void EndScope(VkCommandBuffer cmdBuff, uint scope);
+
+    bool IsSupported() const;
+    bool IsVisible() const;
+    void SetVisible(bool visible);
+
+    //! Scopes in the order they were first recorded
+    const Array<GpuScopeStats>& GetScopes() const;
+
+    //! Draws the ImGui panel when visible, call between ImGui::NewFrame and ImGui::Render
+    void DrawImGui();
+    RESULT ExportCsv(const char* path) const;
+
+private:
+    //! Weight of the new sample in the moving average
+    static constexpr float SMOOTHING = 0.1f;
+    static constexpr uint INVALID_SCOPE = (uint)-1;
+
+    struct FrameScope
+    {
+        const char* name_;
+        uint        depth_;
+    };
+
+    struct FrameQueries
+    {
+        FrameScope  scopes_[MAX_SCOPES]{};
+        uint        scopeCount_{};
+        bool        written_{};
+    };
+
+    VkDevice            device_{};
+    VkQueryPool         queryPool_{};
+    uint                frameCount_{};
+    //! Nanoseconds per timestamp tick
+    float               timestampPeriod_{};
+    uint64              timestampMask_{};
+    bool                visible_{};
+
+    FrameQueries        frames_[MAX_FRAMES];
+    uint                frameIdx_{};
+    uint                depth_{};
+
+    Array<GpuScopeStats> scopes_;
+    Array<uint64>        results_;
+
+    void ReadResults(uint frameIdx);
+    void AddSample(const char* name, uint depth, float ms);
+};
+
+}
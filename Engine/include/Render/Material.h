@@ -3,6 +3,7 @@
 #include "Config.h"
 
 #include "Render/Types.h"
+#include "Render/RenderBufferEntry.h"
 #include "Containers/Span.h"
 
 #include "Common/Pointers.h"
@@ -10,19 +11,50 @@
 #include "Common/Types.h"
 #include "Math/Math.h"
 
+#include <mutex>
+
 namespace hs
 {
 
 struct RenderPassContext;
 struct DrawData;
+struct GpuCullBatch;
 
 //------------------------------------------------------------------------------
 class Material
 {
 public:
+    Material();
     virtual ~Material() = default;
     virtual RESULT Init() = 0;
     virtual void Draw(const RenderPassContext& ctx, const DrawData& drawData) = 0;
+
+    //! Draws objects sharing this material and mesh, materials supporting instancing do it in one draw call
+    virtual void DrawInstanced(const RenderPassContext& ctx, Span<const DrawData> instances);
+    /*!
+    Draws objects whose meshes share a mesh pool and index type, objects with the same mesh are next
+    to each other. Materials supporting it bind the pool once and draw all meshes with one indirect draw.
+    */
+    virtual void DrawMeshBatch(const RenderPassContext& ctx, Span<const DrawData> instances);
+
+    //! Objects of materials supporting it are culled on the GPU when their mesh has a pool
+    virtual bool SupportsGpuCulling() const;
+    /*!
+    Draws the commands the GPU culling pass wrote for the batch with one indirect draw. Only called
+    for materials returning true from SupportsGpuCulling, which must override it.
+    */
+    virtual void DrawGpuCulled(const RenderPassContext& ctx, const GpuCullBatch& batch);
+
+    //! Unique per material instance, used in the draw sort key
+    uint GetSortId() const;
+    //! Materials with the same pipeline id are sorted next to each other
+    uint GetPipelineSortId() const;
+
+protected:
+    uint pipelineSortId_{};
+
+private:
+    uint sortId_{};
 };
 
 //------------------------------------------------------------------------------
@@ -43,6 +75,8 @@ public:
     RESULT Init() override;
     void Draw(const RenderPassContext& ctx, const DrawData& drawData) override;
     void DrawSprite(const RenderPassContext& ctx, const SpriteDrawData& data);
+    //! Draws the sprites as instanced quads, in the order of the indices when given, otherwise in array order
+    void DrawSprites(const RenderPassContext& ctx, Span<const SpriteDrawData> sprites, Span<const uint> order);
 
 private:
     Shader* vs_{};
@@ -127,6 +161,10 @@ class PBRMaterial : public Material
 public:
     RESULT Init() override;
     void Draw(const RenderPassContext& ctx, const DrawData& drawData) override;
+    void DrawInstanced(const RenderPassContext& ctx, Span<const DrawData> instances) override;
+    void DrawMeshBatch(const RenderPassContext& ctx, Span<const DrawData> instances) override;
+    bool SupportsGpuCulling() const override;
+    void DrawGpuCulled(const RenderPassContext& ctx, const GpuCullBatch& batch) override;
 
     Texture* albedoTex_{};
     Texture* roughnessMetalnessTex_{};
@@ -139,6 +177,15 @@ private:
     Shader*     pbrVert_{};
     Shader*     pbrFrag_{};
     uint        vertexLayout_{};
+
+    //! PBR constants of pbrDataFrame_, written by the first draw of a frame and shared by the rest
+    mutable RenderBufferEntry   pbrData_{};
+    mutable uint64              pbrDataFrame_{ ~0ull };
+    mutable std::mutex          pbrDataLock_;
+
+    RenderBufferEntry WriteInstances(Span<const DrawData> instances) const;
+    RenderBufferEntry GetPbrData() const;
+    void SetDrawState() const;
 };
 
 }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Config.h"
+
+#include "Render/Buffer.h"
+#include "Render/RenderBufferEntry.h"
+
+#include "Containers/Array.h"
+
+#include "Common/Types.h"
+
+namespace hs
+{
+
+class MeshPool;
+
+//------------------------------------------------------------------------------
+enum class IndexType : uint8
+{
+    U16,
+    U32,
+};
+
+//------------------------------------------------------------------------------
+inline uint IndexSize(IndexType type)
+{
+    return type == IndexType::U16 ? 2 : 4;
+}
+
+//------------------------------------------------------------------------------
+//! Geometry suballocated from a MeshPool, offsets are in elements so they go straight to the draw
+struct Mesh
+{
+    MeshPool*   pool_{};
+    uint        firstVertex_{};
+    uint        vertexCount_{};
+    //! In indices of indexType_, meshes with 16-bit and 32-bit indices share the index buffer
+    uint        firstIndex_{};
+    uint        indexCount_{};
+    IndexType   indexType_{ IndexType::U32 };
+
+    bool operator==(const Mesh& other) const
+    {
+        return pool_ == other.pool_
+            && firstVertex_ == other.firstVertex_
+            && firstIndex_ == other.firstIndex_
+            && indexCount_ == other.indexCount_
+            && indexType_ == other.indexType_;
+    }
+
+    bool operator!=(const Mesh& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+//------------------------------------------------------------------------------
+struct MeshPoolStats
+{
+    uint    meshCount_{};
+    uint    verticesUsed_{};
+    uint    indexBytesUsed_{};
+    //! Ranges of removed meshes the GPU may still read
+    uint    pendingFrees_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Device local vertex and index buffers meshes are suballocated from, so draws of all meshes
+in the pool bind the same buffers and differ only in the offsets of the draw. Vertices of
+all meshes have the pool's vertex size, indices may be 16-bit or 32-bit per mesh.
+
+Uploads are copied through the render's staging cache into the frame's command buffer,
+so meshes must be added outside of render passes. Ranges of removed meshes return to the
+pool once the GPU finished the frames which may still draw them.
+*/
+class MeshPool
+{
+public:
+    RESULT Init(uint vertexSize, uint vertexCapacity, uint indexCapacityBytes);
+    //! Buffers are released once the frames in flight finish, call before the render is destroyed
+    void Free();
+
+    //! Vertices and indices are copied, they may be released after the call
+    RESULT Add(const void* vertices, uint vertexCount, const void* indices, uint indexCount, IndexType indexType, Mesh& mesh);
+    void Remove(Mesh& mesh);
+
+    //! Whole buffers, bound once for all meshes of the pool
+    RenderBufferEntry GetVertexBuffer() const;
+    RenderBufferEntry GetIndexBuffer() const;
+    uint GetVertexSize() const;
+
+    const MeshPoolStats& GetStats() const;
+
+private:
+    //! Vertex ranges are in vertices, index ranges in bytes
+    struct Range
+    {
+        uint begin_;
+        uint size_;
+    };
+
+    struct PendingFree
+    {
+        Range   vertices_;
+        Range   indices_;
+        //! Released when GetCompletedFrame() reaches this
+        uint64  frame_;
+    };
+
+    RenderBuffer        vertexBuffer_;
+    RenderBuffer        indexBuffer_;
+    uint                vertexSize_{};
+    bool                initialized_{};
+
+    //! Sorted by begin, neighbours are always merged
+    Array<Range>        freeVertices_;
+    Array<Range>        freeIndices_;
+    Array<PendingFree>  pendingFrees_;
+
+    MeshPoolStats       stats_;
+
+    static bool AllocRange(Array<Range>& freeRanges, uint size, uint align, Range& range);
+    static void FreeRange(Array<Range>& freeRanges, Range range);
+    void ReleaseCompletedFrees();
+    RESULT Upload(const RenderBuffer& dst, uint dstOffset, const void* data, uint size);
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Config.h"
+
+#include "Math/Math.h"
+
+#include "Containers/Array.h"
+#include "Containers/Span.h"
+
+#include "Common/Types.h"
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+struct OcclusionStats
+{
+    uint occluderTriangles_{};
+    //! Occluder triangles dropped because they cross the near plane
+    uint clippedTriangles_{};
+    uint testedBoxes_{};
+    uint occludedBoxes_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Low resolution CPU depth buffer for occlusion culling. Occluder triangles are rasterized
+four pixels at a time, each pixel keeps the nearest occluder depth. Pixels are grouped
+in tiles which keep the farthest depth of their pixels so most box tests are decided
+per tile without touching pixels.
+
+A box is occluded when its nearest depth is behind the occluder depth of every pixel of
+its screen rectangle. Boxes crossing the near plane and triangles crossing it are treated
+conservatively, the former are visible and the latter are not rasterized.
+
+Usage per frame: BeginFrame, AddOccluder for each occluder, EndOccluders, then any number
+of IsVisible/TestBoxes calls. IsVisible is safe to call from multiple threads.
+*/
+class OcclusionBuffer
+{
+public:
+    static constexpr uint TILE_WIDTH = 8;
+    static constexpr uint TILE_HEIGHT = 4;
+    static constexpr uint DEFAULT_WIDTH = 256;
+    static constexpr uint DEFAULT_HEIGHT = 128;
+
+    //! Width must be a multiple of TILE_WIDTH and height of TILE_HEIGHT
+    RESULT Init(uint width = DEFAULT_WIDTH, uint height = DEFAULT_HEIGHT);
+
+    //! Clears depth, viewProj transforms world space to clip space
+    void BeginFrame(const Mat44& viewProj);
+
+    //! Rasterizes an indexed triangle list given in object space
+    void AddOccluder(Span<const Vec3> vertices, Span<const uint> indices, const Mat44& world);
+
+    //! Builds the tile depths, must be called after the last occluder and before testing
+    void EndOccluders();
+
+    bool IsVisible(const AABB& worldBox) const;
+
+    //! visible[i] = IsVisible(boxes[i]), returns the visible count
+    uint TestBoxes(Span<const AABB> boxes, Span<uint8> visible);
+
+    uint GetWidth() const;
+    uint GetHeight() const;
+    //! Depth of the nearest occluder at the pixel, 1 where there is none
+    float GetDepth(uint x, uint y) const;
+
+    //! Stats since the last BeginFrame, box counts are only added by TestBoxes
+    const OcclusionStats& GetStats() const;
+
+private:
+    uint            width_{};
+    uint            height_{};
+    uint            tilesX_{};
+    uint            tilesY_{};
+    Mat44           viewProj_;
+    Array<float>    depth_;
+    //! Farthest depth of each tile
+    Array<float>    tileDepth_;
+    Array<Vec4>     clipVerts_;
+    bool            hasOccluders_{};
+    OcclusionStats  stats_;
+
+    void RasterizeTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2);
+};
+
+}
@@ -6,6 +6,7 @@
 
 #include "Render/RenderPassContext.h"
 #include "Render/RenderBufferEntry.h"
+#include "Render/MeshPool.h"
 #include "Render/VkTypes.h"
 #include "Render/Types.h"
 
@@ -13,6 +14,7 @@
 #include "Containers/Array.h"
 
 #include "Math/Math.h"
+#include "Threading/JobSystem.h"
 
 #include "Common/Pointers.h"
 #include "Common/Enums.h"
@@ -23,6 +25,8 @@
 #endif
 
 #include <unordered_map> // TODO use custom hashmap
+#include <unordered_set>
+#include <mutex>
 
 //------------------------------------------------------------------------------
 bool CheckResult(VkResult result, const char* file, int line, const char* fun);
@@ -44,11 +48,35 @@ static constexpr uint SRV_SLOT_COUNT = 8;
 static constexpr uint IMMUTABLE_SAMPLER_COUNT = 1;
 static constexpr uint DYNAMIC_UBO_COUNT = 3;
 
+//------------------------------------------------------------------------------
+enum class PresentMode
+{
+    Fifo,
+    Mailbox,
+    Immediate,
+};
+
+//------------------------------------------------------------------------------
+struct RenderConfig
+{
+    static constexpr uint MIN_FRAMES_IN_FLIGHT = 2;
+    static constexpr uint MAX_FRAMES_IN_FLIGHT = 4;
+
+    //! Frames the CPU may record ahead of the GPU, more frames trade latency for throughput
+    uint        framesInFlight_{ 2 };
+    //! Fifo is used when the requested mode is not supported by the surface
+    PresentMode presentMode_{ PresentMode::Immediate };
+    //! Main pass objects with pool meshes are frustum culled by a compute pass, CPU culling is used when the device can't
+    bool        gpuCulling_{};
+    //! Reads the GPU culling output back and compares it to the CPU reference, slow, for testing
+    bool        gpuCullingValidation_{};
+};
+
 //------------------------------------------------------------------------------
 extern class Render* g_Render;
 
 //------------------------------------------------------------------------------
-RESULT CreateRender(uint width, uint height);
+RESULT CreateRender(uint width, uint height, const RenderConfig& config = {});
 void DestroyRender();
 
 //------------------------------------------------------------------------------
@@ -66,6 +94,9 @@ class DrawCanvas;
 class SpriteRenderer;
 class DebugShapeRenderer;
 class GuiRenderer;
+class OcclusionBuffer;
+class GpuProfiler;
+class GpuCuller;
 
 class SerializationManager;
 
@@ -89,6 +120,10 @@ struct VisualObject
     Material*       material_;
     VertexBuffer    vertexBuffer_;
     IndexBuffer     indexBuffer_;
+    //! Used instead of vertexBuffer_ and indexBuffer_ when it has a pool
+    Mesh            mesh_{};
+    //! Bounds in object space, objects with invalid bounds are never culled
+    AABB            bounds_{ AABB::Invalid() };
 };
 
 //------------------------------------------------------------------------------
@@ -131,11 +166,20 @@ enum DepthState
     DS_WRITE = 2,
 };
 
+//------------------------------------------------------------------------------
+enum BlendMode
+{
+    BM_ALPHA,
+    BM_OPAQUE,
+    BM_ADDITIVE,
+    BM_COUNT,
+};
+
 //------------------------------------------------------------------------------
 struct RenderState
 {
     static constexpr uint MAX_CONST_BUFF = 1;
-    static constexpr uint MAX_VERT_BUFF = 1;
+    static constexpr uint MAX_VERT_BUFF = 2;
     static constexpr uint MAX_INDEX_BUFF = 1;
     static constexpr uint INVALID_DESC = (uint)-1;
     static constexpr uint INVALID_HANDLE = (uint)-1;
@@ -144,12 +188,11 @@ struct RenderState
     uint                    fsTextures_[SRV_SLOT_COUNT]{};
     RenderBufferEntry       dynamicUBOs_[DYNAMIC_UBO_COUNT]{};
 
-    RenderBufferEntry       bindlessUBO_{};
-
     VkBuffer                vertexBuffers_[MAX_VERT_BUFF];
     VkDeviceSize            vbOffsets_[MAX_VERT_BUFF];
     VkBuffer                indexBuffers_[MAX_INDEX_BUFF];
     VkDeviceSize            indexOffsets_[MAX_INDEX_BUFF];
+    IndexType               indexTypes_[MAX_INDEX_BUFF];
     VkDescriptorSet         uboDescSet_{};
 
     uint                    vertexLayouts_[MAX_VERT_BUFF];
@@ -158,14 +201,52 @@ struct RenderState
     VkrCullMode             cullMode_{};
 
     uint                    depthState_{ DS_TEST | DS_WRITE };
+    BlendMode               blendMode_{ BM_ALPHA };
 
     void Reset();
 };
 
+//------------------------------------------------------------------------------
+struct RenderStats
+{
+    uint drawCount_{};
+    //! Pipelines created because the pipeline cache missed
+    uint pipelineCreates_{};
+    //! Binds issued to the command buffer
+    uint pipelineBinds_{};
+    uint descriptorBinds_{};
+    uint bufferBinds_{};
+    //! Binds skipped because the same state was already bound
+    uint pipelineBindsSkipped_{};
+    uint descriptorBindsSkipped_{};
+    uint bufferBindsSkipped_{};
+    //! Main pass objects after frustum culling
+    uint objectsVisible_{};
+    uint objectsCulled_{};
+    //! Objects inside the frustum hidden behind occluders
+    uint objectsOccluded_{};
+    //! Main pass objects handed to the GPU culling pass, the CPU does not know which are visible
+    uint objectsGpuCulled_{};
+    //! Draws skipped because their pipeline was still compiling
+    uint drawsSkipped_{};
+    //! Draws using the pass fallback pipeline while theirs was compiling
+    uint fallbackDraws_{};
+    //! Draws issued by indirect commands, drawCount_ counts each indirect draw call once. GPU counted draws add their maximum.
+    uint indirectCommands_{};
+    //! Pipeline compiles not finished at the end of the frame
+    uint pipelinesCompiling_{};
+    //! CPU time blocked until the GPU finished the frame which used the next frame slot
+    float gpuWaitMs_{};
+    //! CPU time blocked in vkAcquireNextImageKHR
+    float acquireMs_{};
+    //! Bytes allocated from the UBO, vertex, index and indirect caches
+    uint64 bytesAllocated_{};
+};
+
 //------------------------------------------------------------------------------
 class Render
 {
-    friend RESULT CreateRender(uint width, uint height);
+    friend RESULT CreateRender(uint width, uint height, const RenderConfig& config);
     friend void DestroyRender();
 
 public:
@@ -176,37 +257,112 @@ public:
     #elif HS_LINUX
         RESULT InitLinux(GLFWwindow* window);
     #endif
+    /*!
+    Renders to offscreen images instead of a swapchain, no window or surface is needed so it
+    runs on machines without a display, e.g. with a software implementation such as lavapipe.
+    */
+    RESULT InitHeadless();
+    /*!
+    Null backend, never calls Vulkan. State and draws go through the same paths and are counted
+    in the stats, buffer caches live in host memory and shaders are not loaded. Used to measure
+    and test the CPU side of rendering on machines without a GPU.
+    */
+    RESULT InitNull();
     RESULT Init();
     RESULT InitImgui();
 
     void ClearPipelineCache();
 
+    /*!
+    Pipelines missing in the cache are compiled on worker threads. Until they are done draws
+    needing them use the pass fallback pipeline or are skipped.
+    Prewarm queues the pipeline of the current state, materials call it from Init after
+    setting the state they draw with so the pipeline is ready by the first draw.
+    */
+    void PrewarmPipeline(RenderPassType passType);
+    /*!
+    Shaders drawing instead of ones whose pipeline is still compiling, the rest of the state is
+    kept so the vertex shader must only read attributes all vertex layouts of the pass have.
+    */
+    void SetPipelineFallback(RenderPassType passType, Shader* vert, Shader* frag);
+    void WaitForPipelineCompiles();
+
+    static constexpr uint MAX_SHADER_NAME = 64;
+    static constexpr uint MAX_VERT_ATTRIBUTES = 16;
+
+    //! Pipeline state of a PipelineKey with ids replaced by shader names and vertex layout contents
+    struct PipelineManifestEntry
+    {
+        char                                shaders_[PS_COUNT][MAX_SHADER_NAME];
+        VkVertexInputBindingDescription     bindings_[RenderState::MAX_VERT_BUFF];
+        VkVertexInputAttributeDescription   attributes_[MAX_VERT_ATTRIBUTES];
+        uint                                bindingCount_;
+        uint                                attributeCount_;
+        uint                                primitiveTopology_;
+        uint                                passType_;
+        uint                                depthState_;
+        uint                                cullMode_;
+        uint                                blendMode_;
+    };
+
+    /*!
+    Pipelines created this run, saved with the pipeline cache and pre-created in the next run.
+    Entries of a saved manifest may be stale, their shaders renamed or the vertex layout or pass
+    state out of range, PrecreatePipelines skips those and returns how many it created.
+    */
+    Span<const PipelineManifestEntry> GetPipelineManifest() const;
+    uint PrecreatePipelines(Span<const PipelineManifestEntry> entries);
+
     // Setting state
     template<PipelineStage stage>
     void SetShader(Shader* shader)
     {
-        state_.shaders_[stage] = shader;
+        GetRecorder().state_.shaders_[stage] = shader;
     }
     void SetTexture(uint slot, Texture* texture);
     void SetVertexBuffer(uint slot, const RenderBufferEntry& entry);
     void SetVertexLayout(uint slot, uint layoutHandle);
-    void SetIndexBuffer(uint slot, const RenderBufferEntry& entry);
+    void SetIndexBuffer(uint slot, const RenderBufferEntry& entry, IndexType indexType = IndexType::U32);
     void SetPrimitiveTopology(VkrPrimitiveTopology primitiveTopology);
     void SetDynamicUbo(uint slot, const RenderBufferEntry& entry);
     void SetDepthState(uint state);
+    void SetCullMode(VkrCullMode cullMode);
+    void SetBlendMode(BlendMode blendMode);
 
     // Drawing
-    void Draw(const RenderPassContext& ctx, uint vertexCount, uint firstVertex);
-    void DrawIndexed(const RenderPassContext& ctx, uint indexCount, uint firstIndex, uint vertexOffset);
+    void Draw(const RenderPassContext& ctx, uint vertexCount, uint firstVertex, uint instanceCount = 1);
+    void DrawIndexed(const RenderPassContext& ctx, uint indexCount, uint firstIndex, uint vertexOffset, uint instanceCount = 1);
+    /*!
+    Draws drawCount VkDrawIndexedIndirectCommands read from the buffer. One multi-draw when the device
+    supports it, otherwise one indirect draw per command.
+    */
+    void DrawIndexedIndirect(const RenderPassContext& ctx, const RenderBufferEntry& commands, uint drawCount);
+    /*!
+    Draws at most maxDraws commands, how many is read from the uint in countBuffer when the GPU executes
+    the draw. Without a count buffer all maxDraws commands are drawn.
+    */
+    void DrawIndexedIndirectCount(const RenderPassContext& ctx, const RenderBufferEntry& commands, const RenderBufferEntry& countBuffer, uint maxDraws);
+    //! Indirect commands may have a non-zero firstInstance, without it instanced runs must be drawn directly
+    bool HasIndirectFirstInstance() const;
+    //! Draw counts may come from a buffer, without it draws generated on the GPU keep culled commands with zero instances
+    bool HasDrawIndirectCount() const;
 
     void Update(float dTime);
 
+    bool IsHeadless() const;
+    bool IsNull() const;
+    //! Saves the current frame to PNG once the GPU finishes it, headless mode only
+    void CaptureFrame(const char* path);
+
     VkDevice GetDevice() const;
     VmaAllocator GetAllocator() const;
     ShaderManager* GetShaderManager() const;
     VkCommandBuffer CmdBuff() const;
     uint64 GetCurrentFrame() const;
+    //! Resources used by the current frame may be reused once this frame starts
     uint64 GetSafeFrame() const;
+    //! Frames older than the returned one have finished executing on the GPU
+    uint64 GetCompletedFrame() const;
 
     void DestroyLater(VkBuffer buffer, VmaAllocation allocation);
 
@@ -224,6 +380,9 @@ public:
     RenderBufferCache* GetUBOCache() const;
     RenderBufferCache* GetVertexCache() const;
     RenderBufferCache* GetIndexCache() const;
+    //! Host memory copied to device local buffers and images by the frame's command buffer
+    RenderBufferCache* GetStagingCache() const;
+    RenderBufferCache* GetIndirectCache() const;
 
     uint GetWidth() const;
     uint GetHeight() const;
@@ -232,6 +391,9 @@ public:
 
     void ResetState();
 
+    //! Draw and bind counts of the last finished frame
+    const RenderStats& GetStats() const;
+
     //----------------------
     // Vertex layout manager
     uint GetOrCreateVertexLayout(VkPipelineVertexInputStateCreateInfo info);
@@ -240,21 +402,36 @@ public:
     // Camera
     const Camera* GetCamera() const;
     Camera* GetCamera();
+    //! sh::SceneData of the camera, uploaded once per frame and shared by all draws so their UBO binds are skipped
+    const RenderBufferEntry& GetSceneData() const;
 
     SpriteRenderer* GetSpriteRenderer() const;
     DebugShapeRenderer* GetDebugShapeRenderer() const;
     GuiRenderer* GetGuiRenderer() const;
+    GpuProfiler* GetGpuProfiler() const;
+    //! Null unless enabled in the config and supported by the device
+    GpuCuller* GetGpuCuller() const;
 
     void RenderObject(VisualObject* object);
     void RenderObjects(Span<VisualObject> objects);
     void RenderObjects(Span<VisualObject*> objects);
+    /*!
+    Occluders hide main pass objects behind them, they are used for the current frame only.
+    Vertices and indices are not copied and must stay valid until the frame is rendered.
+    */
+    void AddOccluder(Span<const Vec3> vertices, Span<const uint> indices, const Mat44& transform);
 
 private:
     // Vulkan 1.2 should be widely supported if drivers are up to date
     static constexpr auto VK_VERSION = VK_API_VERSION_1_2;
     static constexpr uint VKR_INVALID = -1;
 
-    static constexpr uint BB_IMG_COUNT = 2;
+    static constexpr uint MAX_FRAMES = RenderConfig::MAX_FRAMES_IN_FLIGHT;
+    static constexpr uint MAX_SWAPCHAIN_IMAGES = 8;
+    //! Main pass chunks recorded in parallel into secondary command buffers
+    static constexpr uint MAX_RECORD_CHUNKS = 16;
+    //! Fewer draws per chunk cost more in recorder setup than they save
+    static constexpr int MIN_CHUNK_DRAWS = 256;
 
     #if HS_WINDOWS
         // Win32
@@ -275,50 +452,105 @@ private:
     VkDevice            vkDevice_{};
 
     VkPhysicalDeviceProperties vkPhysicalDeviceProperties_{};
+    //! Optional features, enabled when the device supports them
+    bool                multiDrawIndirect_{};
+    bool                drawIndirectFirstInstance_{};
+    bool                drawIndirectCount_{};
 
     // Debug
     #if HS_DEBUG
         VkDebugReportCallbackEXT debugReportCallback_{};
     #endif
 
-    // Swapchain
+    RenderConfig        config_;
+
+    // Swapchain, indexed by the acquired image
     VkSurfaceKHR        vkSurface_{};
     VkSwapchainKHR      vkSwapchain_{};
+    PresentMode         presentMode_{};
+    uint                swapchainImageCount_{};
     uint                currentBBIdx_{};
-    VkImage             bbImages_[BB_IMG_COUNT]{};
-    VkImageView         bbViews_[BB_IMG_COUNT]{};
+    VkImage             bbImages_[MAX_SWAPCHAIN_IMAGES]{};
+    VkImageView         bbViews_[MAX_SWAPCHAIN_IMAGES]{};
     VkFormat            swapChainFormat_{};
 
-    VkImage             depthImages_[BB_IMG_COUNT]{};
-    VmaAllocation       depthMemory_[BB_IMG_COUNT]{};
-    VkImageView         depthViews_[BB_IMG_COUNT]{};
+    VkImage             depthImages_[MAX_SWAPCHAIN_IMAGES]{};
+    VmaAllocation       depthMemory_[MAX_SWAPCHAIN_IMAGES]{};
+    VkImageView         depthViews_[MAX_SWAPCHAIN_IMAGES]{};
+
+    // Headless, offscreen images replace the swapchain and each frame slot renders to its own image
+    bool                headless_{};
+    VmaAllocation       bbMemory_[MAX_SWAPCHAIN_IMAGES]{};
+
+    static constexpr uint MAX_CAPTURE_PATH = 256;
+
+    //! Readback of a frame, written to PNG when the GPU is done with the frame slot
+    struct FrameCapture
+    {
+        VkBuffer        buffer_{};
+        VmaAllocation   allocation_{};
+        VkDeviceSize    size_{};
+        uint            width_{};
+        uint            height_{};
+        bool            pending_{};
+        char            path_[MAX_CAPTURE_PATH]{};
+    };
+    FrameCapture        captures_[MAX_FRAMES];
+    //! Path of the capture requested for the current frame, empty when none
+    char                captureRequest_[MAX_CAPTURE_PATH]{};
+
+    // Null backend, Vulkan objects are replaced by unique non-null handles
+    bool                nullBackend_{};
+    uint64              nullHandleCount_{};
+
+    template<class HandleT>
+    HandleT MakeNullHandle()
+    {
+        return (HandleT)(uintptr)++nullHandleCount_;
+    }
+
+    //! Signaled by the last submit of a frame, waited by the present of the image
+    VkSemaphore         submitSemaphores_[MAX_SWAPCHAIN_IMAGES]{};
 
+    // Frames in flight, indexed by frameIdx_
     uint64              frame_{};
+    uint                frameIdx_{};
+    //! Frame + 1 last submitted from each frame slot, 0 when not used yet
+    uint64              submittedFrames_[MAX_FRAMES]{};
+    uint64              completedFrame_{};
+
+    //! Signaled when the acquired image is ready to be rendered to
+    VkSemaphore         acquireSemaphores_[MAX_FRAMES]{};
+    //! The next submit has to wait for the acquire semaphore of the frame
+    bool                acquirePending_{};
 
     // Synchronization
     #if defined(VKR_USE_TIMELINE_SEMAPHORES)
         VkSemaphore         directQueueSemaphore_{};
-        uint64              semaphoreValues[BB_IMG_COUNT]{ 1, 1 };
+        uint64              lastSemaphoreValue_{};
+        //! Value signaled by the last submit of each frame slot
+        uint64              semaphoreValues_[MAX_FRAMES]{};
+    #else
+        VkFence             directQueueFences_[MAX_FRAMES]{};
     #endif
 
-    VkFence             directQueueFences_[BB_IMG_COUNT]{};
-    VkFence             nextImageFence_;
-
-    VkSemaphore         submitSemaphores_[BB_IMG_COUNT]{};
-
     // Queues
     uint                directQueueFamilyIdx_{ VKR_INVALID };
     VkQueue             vkDirectQueue_{};
 
     // Command buffers
     VkCommandPool       directCmdPool_{};
-    VkCommandBuffer     directCmdBuffers_[BB_IMG_COUNT]{};
+    VkCommandBuffer     directCmdBuffers_[MAX_FRAMES]{};
+
+    //! Secondary buffers of main pass chunks, each chunk has its own pool so they can record in parallel
+    VkCommandPool       chunkCmdPools_[MAX_FRAMES][MAX_RECORD_CHUNKS]{};
+    VkCommandBuffer     chunkCmdBuffers_[MAX_FRAMES][MAX_RECORD_CHUNKS]{};
 
     VkRenderPass        mainRenderPass_{};
-    VkFramebuffer       mainFrameBuffer_[BB_IMG_COUNT]{};
+    VkFramebuffer       mainFrameBuffer_[MAX_SWAPCHAIN_IMAGES]{};
 
     VkRenderPass        overlayRenderPass_{};
-    VkFramebuffer       overlayFrameBuffer_[BB_IMG_COUNT]{};
+    VkFramebuffer       overlayFrameBuffer_[MAX_SWAPCHAIN_IMAGES]{};
 
     // Descriptors
     VkDescriptorPool    bindlessPool_{};
@@ -328,7 +560,22 @@ private:
     VkDescriptorPool    immutableSamplerPool_{};
     VkDescriptorSet     immutableSamplerSet_{};
 
-    VkDescriptorPool    dynamicUBODPool_[BB_IMG_COUNT]{};
+    VkDescriptorPool    dynamicUBODPool_[MAX_FRAMES]{};
+    //! Pools are externally synchronized, recorders allocate sets from the same one
+    std::mutex          dynamicUBODPoolLock_;
+
+    //! UBO descriptor sets only depend on the bound buffers, offsets are dynamic
+    struct UboSetKey
+    {
+        VkBuffer    buffers_[DYNAMIC_UBO_COUNT]{};
+        int         ranges_[DYNAMIC_UBO_COUNT]{};
+
+        bool operator==(const UboSetKey& other) const;
+    };
+    struct UboSetKeyHash
+    {
+        Hash_t operator()(const UboSetKey& key) const;
+    };
 
     // Imgui
     // TODO(pavel): Rework this, how big descriptor pool does Imgui need? Can we use one of ours?
@@ -341,11 +588,95 @@ private:
     };*/
     using PipelineKey = uint64;
     std::unordered_map<PipelineKey, VkPipeline, FibonacciHash<PipelineKey>> pipelineCache_;
+    //! Pipelines whose creation failed, draws needing them are skipped until the cache is cleared, e.g. by a shader reload
+    std::unordered_set<PipelineKey, FibonacciHash<PipelineKey>> failedPipelines_;
+    //! Changes when the pipeline cache is cleared so recorders drop their last pipeline
+    int pipelineCacheGen_{};
+
+    //----------------------
+    // Pipeline cache persistence
+    static constexpr const char* PIPELINE_CACHE_FILE = "PipelineCache.bin";
+    static constexpr uint PIPELINE_CACHE_MAGIC = 0x43505348; // HSPC
+    static constexpr uint PIPELINE_CACHE_VERSION = 3;
+
+    //! Validates the file against the device, cache data of a different device or driver is dropped
+    struct PipelineCacheHeader
+    {
+        uint    magic_;
+        uint    version_;
+        uint    vendorId_;
+        uint    deviceId_;
+        uint    driverVersion_;
+        uint8   pipelineCacheUuid_[VK_UUID_SIZE];
+        uint    cacheDataSize_;
+        uint    manifestCount_;
+    };
+
+    //! Vertex layouts created from the manifest point to these
+    struct VertexLayoutStorage
+    {
+        VkVertexInputBindingDescription     bindings_[RenderState::MAX_VERT_BUFF];
+        VkVertexInputAttributeDescription   attributes_[MAX_VERT_ATTRIBUTES];
+    };
+
+    VkPipelineCache                 vkPipelineCache_{};
+    Array<PipelineManifestEntry>    pipelineManifest_;
+    Array<VertexLayoutStorage*>     vertexLayoutStorage_;
+
+    RESULT LoadPipelineCache();
+    void SavePipelineCache();
+    bool IsManifestEntryValid(const PipelineManifestEntry& entry) const;
+    void AddToPipelineManifest(const RenderPassContext& ctx, const RenderState& state);
+
+    //----------------------
+    // Async pipeline compilation
+    //! Everything pipeline creation reads, copied so it can run off the render thread. Viewport and scissor are dynamic.
+    struct PipelineDesc
+    {
+        VkShaderModule                          shaders_[PS_COUNT]{};
+        VkPipelineVertexInputStateCreateInfo    vertexLayout_{};
+        VkPrimitiveTopology                     primitiveTopology_{};
+        uint                                    depthState_{};
+        VkrCullMode                             cullMode_{};
+        BlendMode                               blendMode_{};
+        VkRenderPass                            renderPass_{};
+    };
+
+    //! Workers only write the pipeline and done flag, the cache maps are touched by the render thread only
+    struct PipelineCompile
+    {
+        const Render*   render_{};
+        PipelineDesc    desc_;
+        VkPipeline      pipeline_{};
+        int             done_{};
+    };
+
+    std::unordered_map<PipelineKey, PipelineCompile*, FibonacciHash<PipelineKey>> pendingPipelines_;
+    //! Guards the pipeline maps and manifest, draws of chunks look pipelines up in parallel
+    std::mutex  pipelineLock_;
+    JobCounter  pipelineCompiles_;
+    Shader*     fallbackShaders_[RPT_COUNT][PS_COUNT]{};
+
+    PipelineDesc MakePipelineDesc(const RenderPassContext& ctx, const RenderState& state) const;
+    VkPipeline CreatePipeline(const PipelineDesc& desc) const;
+    static void CompilePipelineJob(void* data);
+    //! Returns the cached pipeline, on a miss queues its compilation and returns null. Thread safe.
+    VkPipeline FindOrCompilePipeline(const RenderPassContext& ctx, const RenderState& state);
+    //! Caches a created pipeline or remembers that its creation failed, under pipelineLock_ or on the render thread
+    void AddCompiledPipeline(PipelineKey key, VkPipeline pipeline);
+    //! Moves finished compiles to the pipeline cache
+    void CollectCompiledPipelines();
+    VkRenderPass GetRenderPass(RenderPassType passType) const;
 
     // Caches
     UniquePtr<RenderBufferCache>    uboCache_;
     UniquePtr<RenderBufferCache>    vbCache_;
     UniquePtr<RenderBufferCache>    indexCache_;
+    UniquePtr<RenderBufferCache>    stagingCache_;
+    UniquePtr<RenderBufferCache>    indirectCache_;
+
+    //! Uploads of whole textures fit in a block
+    static constexpr uint STAGING_BLOCK_SIZE = 4 * 1024 * 1024;
 
     // Allocator
     VmaAllocator        allocator_;
@@ -356,8 +687,8 @@ private:
         VkBuffer        buffer_;
         VmaAllocation   allocation_;
     };
-    Array<VkPipeline>       destroyPipelines_[BB_IMG_COUNT];
-    Array<BufferToRelease>  destroyBuffers_[BB_IMG_COUNT];
+    Array<VkPipeline>       destroyPipelines_[MAX_FRAMES];
+    Array<BufferToRelease>  destroyBuffers_[MAX_FRAMES];
 
     // Shaders
     UniquePtr<ShaderManager>    shaderManager_{};
@@ -366,7 +697,52 @@ private:
     VkDescriptorSetLayout       dynamicUBOLayout_{};
     VkPipelineLayout            pipelineLayout_{};
 
-    RenderState state_;
+    //! What is actually bound on the current command buffer, draws only issue binds that differ
+    struct BoundState
+    {
+        VkPipeline      pipeline_{};
+        bool            staticSetsBound_{};
+        VkDescriptorSet uboDescSet_{};
+        uint            dynOffsets_[DYNAMIC_UBO_COUNT]{};
+        VkBuffer        vertexBuffers_[RenderState::MAX_VERT_BUFF]{};
+        VkDeviceSize    vbOffsets_[RenderState::MAX_VERT_BUFF]{};
+        VkBuffer        indexBuffer_{};
+        VkDeviceSize    indexOffset_{};
+        IndexType       indexType_{};
+        //! Bindless texture indices in the push constants, undefined until the first push
+        bool            texturesPushed_{};
+        uint            fsTextures_[SRV_SLOT_COUNT]{};
+    };
+
+    /*!
+    State of one command buffer being recorded. The main thread records the primary buffer,
+    main pass chunks record their secondary buffers on worker threads. Set* and Draw* use the
+    recorder of the calling thread so materials draw the same way in both.
+    */
+    struct CommandRecorder
+    {
+        //! Null for the main recorder, it records into the frame's primary buffer
+        VkCommandBuffer cmdBuff_{};
+        RenderState     state_;
+        BoundState      bound_;
+        //! Draw and bind counts, added to the frame stats at the end of the frame
+        RenderStats     stats_;
+        //! Pipeline of the last lookup, runs of draws with the same state skip pipelineLock_
+        PipelineKey     lastPipelineKey_{};
+        VkPipeline      lastPipeline_{};
+        int             lastPipelineGen_{ -1 };
+        //! Sets allocated from dynamicUBODPool_ of the same index, cleared when the pool is reset
+        std::unordered_map<UboSetKey, VkDescriptorSet, UboSetKeyHash> uboSetCache_[MAX_FRAMES];
+    };
+    CommandRecorder             mainRecorder_;
+    CommandRecorder             chunkRecorders_[MAX_RECORD_CHUNKS];
+    //! Set while a chunk records on the thread, null means the main recorder
+    static thread_local CommandRecorder* s_Recorder;
+
+    CommandRecorder& GetRecorder();
+
+    RenderStats frameStats_;
+    RenderStats stats_;
 
     UniquePtr<DrawCanvas>       drawCanvas_;
 
@@ -374,13 +750,79 @@ private:
     UniquePtr<DebugShapeRenderer>   debugShapeRenderer_;
     UniquePtr<GuiRenderer>          guiRenderer_;
 
+    UniquePtr<GpuProfiler>          gpuProfiler_;
+
     Array<VisualObject*>            renderObjects_[RPT_COUNT];
 
+    //----------------------
+    // Draw list
+    struct DrawItem
+    {
+        //! Pass | pipeline | material | mesh | depth, from the most significant bits
+        uint64          key_;
+        VisualObject*   object_;
+    };
+    Array<DrawItem>                 drawItems_;
+    Array<DrawItem>                 drawItemsScratch_;
+    Array<DrawData>                 drawInstances_;
+
+    //! Contiguous part of the sorted draw items, recorded by a job into its own secondary buffer
+    struct RecordChunk
+    {
+        Render*             render_{};
+        RenderPassContext   ctx_{};
+        VkFramebuffer       frameBuffer_{};
+        CommandRecorder*    recorder_{};
+        Span<const DrawItem> items_;
+        Array<DrawData>     instances_;
+        //! The last chunk draws the GPU culled batches after its items
+        bool                drawGpuCulled_{};
+    };
+    RecordChunk                     recordChunks_[MAX_RECORD_CHUNKS];
+    JobCounter                      chunkRecords_;
+
+    static uint64 MakeDrawSortKey(RenderPassType pass, const VisualObject* object, const Vec3& cameraPos);
+    //! Fills drawItems_ with the objects in draw order
+    void SortDrawItems(const RenderPassContext& ctx, Span<VisualObject* const> objects);
+    //! Splits drawItems_ into recordChunks_ without breaking instanced runs, returns 0 when recording on this thread is cheaper
+    uint SplitDrawChunks();
+    //! Records the chunks in parallel and executes them from the primary buffer, the pass must have begun with secondary contents
+    void RecordDrawChunks(const RenderPassContext& ctx, uint chunkCount);
+    static void RecordChunkJob(void* data);
+    void DrawItems(const RenderPassContext& ctx, Span<const DrawItem> items, Array<DrawData>& instances);
+
+    //----------------------
+    // Culling
+    Array<AABB>                     cullBoxes_;
+    Array<uint8>                    cullVisible_;
+    Array<VisualObject*>            visibleObjects_;
+
+    struct Occluder
+    {
+        Span<const Vec3>    vertices_;
+        Span<const uint>    indices_;
+        Mat44               transform_;
+    };
+    Array<Occluder>                 occluders_;
+    UniquePtr<OcclusionBuffer>      occlusionBuffer_;
+
+    UniquePtr<GpuCuller>            gpuCuller_;
+    Array<VisualObject*>            gpuCulledObjects_;
+    Array<VisualObject*>            cpuCulledObjects_;
+
+    //! Fills visibleObjects_ with objects inside the camera frustum which are not occluded
+    void CullObjects(Span<VisualObject* const> objects);
+    //! Records the GPU culling pass for the objects it supports, returns the rest
+    Span<VisualObject* const> CullObjectsOnGpu(Span<VisualObject* const> objects);
+
     RESULT CreateInstance();
     RESULT CreateSurface();
     RESULT FindPhysicalDevice();
     RESULT CreateDevice();
     RESULT CreateSwapchain();
+    RESULT CreateOffscreenImages();
+    //! Views and depth buffers of the back buffer images
+    RESULT CreateBackBufferViews();
 
     RESULT CreateMainRenderPass();
     RESULT CreateMainFrameBuffer();
@@ -388,12 +830,20 @@ private:
     RESULT CreateOverlayRenderPass();
     RESULT CreateOverlayFrameBuffer();
 
+    //! Everything on top of the device, shared by the Vulkan and the null backend
+    RESULT InitResources();
+
     void DestroySurface();
     void DestroySwapchain();
 
     void DestroyRenderPass(VkRenderPass& renderPass);
     void DestroyFrameBuffer(VkFramebuffer* frameBufferArr);
 
+    //! Copies the back buffer to the frame slot's capture buffer, called after the last pass
+    RESULT RecordCapture();
+    void WriteCapture(uint frameIdx);
+    void FreeCaptures();
+
     //----------------------
     // Vertex layout manager
     Array<VkPipelineVertexInputStateCreateInfo> vertexLayouts_;
@@ -401,14 +851,28 @@ private:
     static PipelineKey StateToPipelineKey(const RenderPassContext& ctx, const RenderState& state);
 
     RESULT PrepareForDraw(const RenderPassContext& ctx);
+    //! Pipelines have dynamic viewport and scissor, set at the start of each pass
+    void SetViewportAndScissor();
     void AfterDraw();
+    //! Forget what is bound, needed when the command buffer restarts or someone else binds to it
+    void InvalidateBoundState();
 
     RESULT WaitForFence(VkFence fence);
-
+    //! Blocks until the GPU is done with the last submit from the frame slot
+    RESULT WaitForFrame(uint frameIdx);
+    //! Acquires the next swapchain image without waiting for the GPU, returns false when the swapchain is out of date
+    bool AcquireNextImage();
+    RESULT AllocateCommandBuffers();
     void Free();
 
     template<bool present, bool wait>
     void FlushGpu();
+    //! FlushGpu of the null backend, the frame is complete as soon as it is recorded
+    void EndNullFrame();
+    //! The descriptor pool of the frame slot was reset, sets cached by all recorders are gone
+    void ClearUboSetCaches(uint frameIdx);
+    //! Moves the draw and bind counts of the recorder to the frame stats
+    void AddRecorderStats(CommandRecorder& recorder);
 
     //----------------------
     // Serialization
@@ -417,6 +881,9 @@ private:
     //----------------------
     // Camera
     Camera camera_;
+    RenderBufferEntry sceneData_{};
+
+    void UploadSceneData();
 };
 
 
@@ -9,14 +9,48 @@
 
 #include "Common/Types.h"
 
+#include <mutex>
+
 namespace hs
 {
 
 //------------------------------------------------------------------------------
+struct RenderBufferCacheStats
+{
+    //! Bytes handed out during the frame, excluding alignment padding
+    uint64  bytesAllocated_{};
+    uint    allocCount_{};
+    //! Blocks the GPU may still be reading from
+    uint    buffersInFlight_{};
+    //! Ring blocks, the oversize ones are not included
+    uint    bufferCount_{};
+    //! A full block was replaced by the next retired block of the ring
+    uint    wrapCount_{};
+    //! A full block was replaced by a newly created one
+    uint    growCount_{};
+    //! Allocations larger than a block which got a dedicated buffer
+    uint    oversizeCount_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Transient GPU buffer memory for data written once per frame. Blocks are HostToDevice
+buffers mapped for their whole lifetime, allocation is an atomic bump in the current
+block so it is safe to allocate from multiple threads. Only switching to a new block
+when the current one fills up takes a lock.
+
+Blocks form a ring ordered by last use, the block after the current one is always the
+oldest. It is reused once the GPU finished the last frame that wrote to it, otherwise
+a new block is inserted in front of it. The ring so grows only up to the amount of
+memory the frames in flight need. Allocations larger than a block get a dedicated buffer
+which is recycled the same way and released when unused for a while.
+*/
 class RenderBufferCache
 {
 public:
-    RenderBufferCache(RenderBufferType cacheType);
+    static constexpr uint DEFAULT_BLOCK_SIZE = 512 * 1024;
+
+    RenderBufferCache(RenderBufferType cacheType, uint blockSize = DEFAULT_BLOCK_SIZE);
     ~RenderBufferCache();
 
     RESULT Init();
@@ -26,25 +60,55 @@ public:
     template<class ItemT>
     RenderBufferEntry BeginAlloc(int count, ItemT** data);
 
+    //! Memory is persistently mapped and coherent, kept so callers mark where writing ends
     void EndAlloc();
+
+    //! Called by the render after the frame was submitted, finishes per-frame stats
+    void EndFrame();
+
     uint GetMaxSize() const;
     int GetRemainingBufferSize(uint align) const;
 
+    //! Stats of the last finished frame
+    const RenderBufferCacheStats& GetStats() const;
+
 private:
-    constexpr static uint BUFFER_SIZE = 512 * 1024;
+    //! Unused oversize buffers are freed after this many frames
+    static constexpr uint64 OVERSIZE_KEEP_FRAMES = 60;
 
     struct CacheEntry
     {
         RenderBuffer* buffer_{};
-        uint64 safeToUseFrame_{};
-        uint begin_{};
+        uint8* mapped_{};
+        //! GPU may read the block until GetCompletedFrame() reaches this
+        uint64 busyUntilFrame_{};
+        int size_{};
+        int begin_{};
     };
 
     RenderBufferType cacheType_;
-    Array<CacheEntry> entries_;
+    int blockSize_{};
     int minAlignment_{};
 
-    RESULT MakeEntry(CacheEntry& entry);
+    //! Block allocations currently bump into, changes only under switchLock_
+    CacheEntry* current_{};
+    Array<CacheEntry*> ring_;
+    int head_{};
+    Array<CacheEntry*> oversize_;
+    std::mutex switchLock_;
+
+    int frameBytes_{};
+    int frameAllocs_{};
+    int frameWraps_{};
+    int frameGrows_{};
+    int frameOversize_{};
+    RenderBufferCacheStats stats_;
+
+    RESULT MakeEntry(int size, CacheEntry*& entry);
+    void FreeEntry(CacheEntry* entry);
+    bool IsRetired(const CacheEntry* entry) const;
+    void SwitchEntry();
+    RenderBufferEntry AllocOversize(int size, void** data);
 };
 
 //------------------------------------------------------------------------------
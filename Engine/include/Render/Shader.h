@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Render/VkTypes.h"
+#include "String/String.h"
 #include "Common/Types.h"
 
 namespace hs
@@ -13,6 +14,8 @@ public:
     VkShaderModule vkShader_;
     PipelineStage type_;
     uint16 id_;
+    //! Name the shader was created with, also the key of the shader manager cache
+    String name_;
 };
 
 }
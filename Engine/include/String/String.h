@@ -36,6 +36,7 @@ public:
     StringView() = default;
     explicit StringView(const String& string);
     explicit StringView(const char* cstr);
+    StringView(const char* data, uint size);
 
     //template<uint N>
     //explicit constexpr StringView(const char (&stringLiteral)[N]);
@@ -214,6 +215,13 @@ inline StringView::StringView(const char* cstr)
     , size_(strlen(cstr))
 {
 }
+
+//------------------------------------------------------------------------------
+inline StringView::StringView(const char* data, uint size)
+    : string_(data)
+    , size_(size)
+{
+}
 //template<uint N>
 //constexpr StringView::StringView(const char (&stringLiteral)[N])
 //{
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "Config.h"
+#include "Common/Types.h"
+#include "Containers/Array.h"
+
+#include <mutex>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+extern class FrameArena* g_FrameArena;
+
+//------------------------------------------------------------------------------
+RESULT CreateFrameArena();
+
+//------------------------------------------------------------------------------
+void DestroyFrameArena();
+
+//------------------------------------------------------------------------------
+struct FrameArenaStats
+{
+    //! Bytes bump-allocated in the last finished frame
+    uint64  bytesAllocated_{};
+    //! Number of allocations in the last finished frame
+    uint    allocCount_{};
+    //! Allocations that did not fit the frame block and had to go to the heap
+    uint    overflowCount_{};
+    //! Heap allocations done through Alloc/AllocAligned/Realloc during the last finished frame
+    uint    heapAllocCount_{};
+    //! Size of a single frame block
+    uint64  capacity_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Linear allocator for transient per-frame data. There is one block per frame in flight,
+memory allocated during frame N stays valid until frame N + GetFrameCount() starts which
+must not be before the frame Render::GetSafeFrame() returns during frame N.
+
+Allocation is a single atomic bump so it can be used from jobs. When a block runs out
+the allocation falls back to the heap and the block is grown on the next reset so the
+steady state does no heap allocations.
+*/
+class FrameArena
+{
+public:
+    static constexpr uint FRAME_COUNT = 2;
+    static constexpr uint MAX_FRAME_COUNT = 4;
+    static constexpr uint64 DEFAULT_CAPACITY = 1024 * 1024;
+
+    //! frameCount should match the render's frames in flight
+    RESULT Init(uint64 capacity = DEFAULT_CAPACITY, uint frameCount = FRAME_COUNT);
+    void Free();
+
+    //! Releases everything allocated GetFrameCount() frames ago and makes frame's block current
+    void BeginFrame(uint64 frame);
+
+    void* Alloc(uint64 size, uint64 alignment);
+
+    template<class T>
+    T* Alloc(uint64 count)
+    {
+        return static_cast<T*>(Alloc(sizeof(T) * count, alignof(T)));
+    }
+
+    //! Grows the allocation in place if it was the last one in the block, returns false otherwise
+    bool TryGrow(void* memory, uint64 oldSize, uint64 newSize);
+
+    //! True if memory points to the current frame block
+    bool Owns(const void* memory) const;
+
+    uint64 GetCurrentFrame() const;
+    uint GetFrameCount() const;
+    const FrameArenaStats& GetStats() const;
+
+private:
+    struct Block
+    {
+        uint8*  memory_{};
+        int     capacity_{};
+        int     top_{};
+        int     allocCount_{};
+        uint64  frame_{};
+        //! Heap fallback allocations, freed when the block is reset
+        Array<void*> overflow_;
+        uint64  overflowBytes_{};
+    };
+
+    Block           blocks_[MAX_FRAME_COUNT];
+    uint            frameCount_{ FRAME_COUNT };
+    uint            currentBlock_{};
+    uint64          frame_{};
+    int             frameStartHeapAllocs_{};
+    FrameArenaStats stats_;
+    std::mutex      overflowLock_;
+
+    void* AllocOverflow(Block& block, uint64 size, uint64 alignment);
+};
+
+//------------------------------------------------------------------------------
+/*!
+Memory policy placing TemplArray items into g_FrameArena. Freeing is a no-op, the memory
+is reclaimed in bulk, so such arrays must not outlive the frame they were filled in.
+*/
+template<class T>
+class ArenaMemoryPolicy
+{
+public:
+    static constexpr bool IS_MOVABLE = true;
+
+    //------------------------------------------------------------------------------
+    void CopyConstruct(const ArenaMemoryPolicy<T>& other)
+    {
+        HS_ASSERT(!items_);
+
+        capacity_ = other.capacity_;
+        count_ = other.count_;
+        items_ = capacity_ ? g_FrameArena->Alloc<T>(capacity_) : nullptr;
+    }
+
+    //------------------------------------------------------------------------------
+    void Assign(const ArenaMemoryPolicy<T>& other)
+    {
+        if (capacity_ < other.capacity_)
+        {
+            capacity_ = other.capacity_;
+            items_ = g_FrameArena->Alloc<T>(capacity_);
+        }
+
+        count_ = other.count_;
+    }
+
+    //------------------------------------------------------------------------------
+    void MoveConstruct(ArenaMemoryPolicy<T>&& other)
+    {
+        capacity_ = other.capacity_;
+        count_ = other.count_;
+        items_ = other.items_;
+
+        other.items_ = nullptr;
+        other.capacity_ = 0;
+        other.count_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void MoveAssign(ArenaMemoryPolicy<T>&& other)
+    {
+        MoveConstruct(std::move(other));
+    }
+
+    //------------------------------------------------------------------------------
+    void Free()
+    {
+        count_ = 0;
+        capacity_ = 0;
+        items_ = nullptr;
+    }
+
+    //------------------------------------------------------------------------------
+    void EnsureEmplaceBack()
+    {
+        Grow(GetNextCapacity());
+    }
+
+    //------------------------------------------------------------------------------
+    void EnsureEmplace(Index_t index)
+    {
+        const Index_t capacity = GetNextCapacity();
+
+        auto newItems = g_FrameArena->Alloc<T>(capacity);
+        if constexpr (std::is_trivial_v<T>)
+        {
+            memcpy(newItems, items_, sizeof(T) * index);
+            memcpy(&newItems[index + 1], &items_[index], (count_ - index) * sizeof(T));
+        }
+        else
+        {
+            for (Index_t i = 0; i < index; ++i)
+            {
+                new(newItems + i) T(std::move(items_[i]));
+                items_[i].~T();
+            }
+            for (Index_t i = index; i < count_; ++i)
+            {
+                new(newItems + i + 1) T(std::move(items_[i]));
+                items_[i].~T();
+            }
+        }
+
+        capacity_ = capacity;
+        items_ = newItems;
+    }
+
+    //------------------------------------------------------------------------------
+    void Grow(Index_t capacity)
+    {
+        capacity = Max(capacity, MIN_CAPACITY);
+
+        // Most of the time the array is the last thing allocated so it can just extend
+        if (items_ && g_FrameArena->TryGrow(items_, sizeof(T) * capacity_, sizeof(T) * capacity))
+        {
+            capacity_ = capacity;
+            return;
+        }
+
+        auto newItems = g_FrameArena->Alloc<T>(capacity);
+        if constexpr (std::is_trivial_v<T>)
+        {
+            if (count_)
+                memcpy(newItems, items_, sizeof(T) * count_);
+        }
+        else
+        {
+            for (Index_t i = 0; i < count_; ++i)
+            {
+                new(newItems + i) T(std::move(items_[i]));
+                items_[i].~T();
+            }
+        }
+
+        capacity_ = capacity;
+        items_ = newItems;
+    }
+
+    //------------------------------------------------------------------------------
+    Index_t& CountMut()
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    Index_t Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    T* Items()
+    {
+        return items_;
+    }
+
+    //------------------------------------------------------------------------------
+    const T* Items() const
+    {
+        return items_;
+    }
+
+    //------------------------------------------------------------------------------
+    Index_t Capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    static constexpr Index_t MIN_CAPACITY = 8;
+
+    Index_t capacity_{};
+    Index_t count_{};
+    T* items_{};
+
+    //------------------------------------------------------------------------------
+    Index_t GetNextCapacity() const
+    {
+        Index_t newCapacity = Max(NextPow2(static_cast<uint>(capacity_)), static_cast<uint>(MIN_CAPACITY));
+        HS_ASSERT(newCapacity > 0);
+        return newCapacity;
+    }
+};
+
+//------------------------------------------------------------------------------
+template<class T>
+using FrameArray = TemplArray<T, ArenaMemoryPolicy<T>>;
+
+}
@@ -18,4 +18,8 @@ void* ReallocAligned(void* memory, uint64 oldSize, uint64 newSize, uint64 alignm
 void Free(void* memory);
 void FreeAligned(void* memory);
 
+//------------------------------------------------------------------------------
+//! Number of allocations done through Alloc, AllocAligned, Realloc and ReallocAligned so far
+int GetHeapAllocCount();
+
 }
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "Config.h"
+#include "Common/Types.h"
+#include "Containers/Array.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+extern class Profiler* g_Profiler;
+
+//------------------------------------------------------------------------------
+RESULT CreateProfiler();
+
+//------------------------------------------------------------------------------
+void DestroyProfiler();
+
+//------------------------------------------------------------------------------
+struct ProfileEvent
+{
+    //! Static string, only the pointer is stored
+    const char* name_;
+    uint64      startNs_;
+    uint64      endNs_;
+    uint        depth_;
+};
+
+//------------------------------------------------------------------------------
+struct ProfileThreadEvents
+{
+    const char*         threadName_;
+    uint                threadIdx_;
+    Array<ProfileEvent> events_;
+};
+
+//------------------------------------------------------------------------------
+/*!
+CPU profiler recording nested named scopes. Every thread writes finished scopes to its
+own ring buffer, the owning thread is the only writer so recording is a few stores and
+an atomic publish of the write count. Readers copy the rings and drop events the writer
+may have overwritten meanwhile, so reading never blocks the recording threads.
+
+Threads register themselves on their first event which takes a lock once. Rings keep
+only the latest THREAD_EVENT_COUNT events of each thread.
+
+Use HS_PROFILE_SCOPE("name") to record a scope, the macros compile to nothing when
+HS_PROFILE is 0.
+*/
+class Profiler
+{
+public:
+    static constexpr uint MAX_THREADS = 64;
+    //! Power of two
+    static constexpr uint THREAD_EVENT_COUNT = 16 * 1024;
+    static constexpr uint FRAME_HISTORY = 64;
+    static constexpr const char* TRACE_FILE = "CpuTrace.json";
+
+    struct ThreadBuffer
+    {
+        ProfileEvent    events_[THREAD_EVENT_COUNT];
+        //! Events written so far, published after the event is stored
+        uint64          writeCount_{};
+        uint            depth_{};
+        uint            threadIdx_{};
+        char            name_[32]{};
+    };
+
+    RESULT Init();
+    void Free();
+
+    //! Marks the start of a frame, call from the main thread
+    void BeginFrame();
+
+    //! Names the calling thread in the views and the exported trace
+    void SetThreadName(const char* name);
+
+    //! Returns the buffer of the calling thread with the depth of the new scope reserved
+    ThreadBuffer* BeginEvent();
+    void EndEvent(ThreadBuffer* buffer, const char* name, uint64 startNs);
+
+    //! Copies events of all threads which overlap [fromNs, toNs)
+    void CollectEvents(uint64 fromNs, uint64 toNs, Array<ProfileThreadEvents>& threads) const;
+
+    //! Start and end of a finished frame, frameAgo 0 is the last finished one
+    bool GetFrameRange(uint frameAgo, uint64& startNs, uint64& endNs) const;
+
+    //! Writes all events still in the rings in Chrome trace_event format
+    RESULT ExportChromeTrace(const char* path) const;
+
+    bool IsVisible() const;
+    void SetVisible(bool visible);
+    //! Draws the flame view of the last frame when visible, call between ImGui::NewFrame and ImGui::Render
+    void DrawImGui();
+
+    static uint64 GetTimeNs();
+
+private:
+    //! Bumped for each Init so threads notice their cached buffer belongs to an old profiler
+    static uint             s_Generation;
+
+    ThreadBuffer*           threads_[MAX_THREADS]{};
+    int                     threadCount_{};
+    std::mutex              registerLock_;
+    uint                    generation_{};
+
+    uint64                  frameStarts_[FRAME_HISTORY]{};
+    uint64                  frameCount_{};
+    uint64                  startNs_{};
+
+    bool                    visible_{};
+    bool                    paused_{};
+    Array<ProfileThreadEvents> flameThreads_;
+    uint64                  flameStartNs_{};
+    uint64                  flameEndNs_{};
+
+    ThreadBuffer* RegisterThread();
+};
+
+//------------------------------------------------------------------------------
+//! Records the enclosing scope, use through HS_PROFILE_SCOPE
+class ProfileScope
+{
+public:
+    //------------------------------------------------------------------------------
+    explicit ProfileScope(const char* name)
+        : name_(name)
+    {
+        if (g_Profiler)
+        {
+            buffer_ = g_Profiler->BeginEvent();
+            startNs_ = Profiler::GetTimeNs();
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    ~ProfileScope()
+    {
+        if (buffer_)
+            g_Profiler->EndEvent(buffer_, name_, startNs_);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char*                 name_;
+    Profiler::ThreadBuffer*     buffer_{};
+    uint64                      startNs_{};
+};
+
+//------------------------------------------------------------------------------
+inline uint64 Profiler::GetTimeNs()
+{
+    return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+//------------------------------------------------------------------------------
+#define HS_PROFILE_CONCAT_INNER(a, b) a##b
+#define HS_PROFILE_CONCAT(a, b) HS_PROFILE_CONCAT_INNER(a, b)
+
+#if HS_PROFILE
+    #define HS_PROFILE_SCOPE(name) ::hs::ProfileScope HS_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+    #define HS_PROFILE_THREAD(name) do { if (::hs::g_Profiler) ::hs::g_Profiler->SetThreadName(name); } while (false)
+    #define HS_PROFILE_FRAME() do { if (::hs::g_Profiler) ::hs::g_Profiler->BeginFrame(); } while (false)
+#else
+    #define HS_PROFILE_SCOPE(name)
+    #define HS_PROFILE_THREAD(name) do {} while (false)
+    #define HS_PROFILE_FRAME() do {} while (false)
+#endif
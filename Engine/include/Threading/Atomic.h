@@ -142,6 +142,36 @@ inline int AtomicCompareExchange(int* dst, int desired, int expected)
     #endif
 }
 
+//------------------------------------------------------------------------------
+//! Atomically loads pointer with acquire semantics
+template<class T>
+inline T* AtomicLoadPtr(T* const* value)
+{
+    #if HS_MSVC
+        T* tmp = *value;
+        _ReadWriteBarrier();
+        return tmp;
+    #elif HS_CLANG || HS_GCC
+        return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+    #else
+        HS_NOT_IMPLEMENTED
+    #endif
+}
+
+//------------------------------------------------------------------------------
+//! Atomically stores pointer x to value
+template<class T>
+inline void AtomicStorePtr(T** value, T* x)
+{
+    #if HS_MSVC
+        _InterlockedExchangePointer(reinterpret_cast<void* volatile*>(value), x);
+    #elif HS_CLANG || HS_GCC
+        __atomic_store_n(value, x, __ATOMIC_SEQ_CST);
+    #else
+        HS_NOT_IMPLEMENTED
+    #endif
+}
+
 //------------------------------------------------------------------------------
 class AtomicInt
 {
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Config.h"
+#include "Common/Types.h"
+#include "Containers/Span.h"
+#include "Math/Math.h"
+#include "Threading/Atomic.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+extern class JobSystem* g_JobSystem;
+
+//------------------------------------------------------------------------------
+RESULT CreateJobSystem();
+
+//------------------------------------------------------------------------------
+void DestroyJobSystem();
+
+//------------------------------------------------------------------------------
+using JobFunc = void(*)(void* data);
+
+//------------------------------------------------------------------------------
+struct JobDecl
+{
+    JobFunc func_{};
+    void*   data_{};
+};
+
+//------------------------------------------------------------------------------
+struct Job;
+
+//------------------------------------------------------------------------------
+/*!
+Counts unfinished jobs of a batch. Jobs dispatched with a counter increment it and
+decrement it when done, other jobs can be made dependent on it and will only be
+queued once it reaches zero.
+*/
+class JobCounter
+{
+public:
+    bool IsDone() const
+    {
+        return AtomicLoad(&value_) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    int     value_{};
+    int     lock_{};
+    Job*    waitList_{};
+};
+
+//------------------------------------------------------------------------------
+/*!
+Chase-Lev work stealing deque of fixed size. The owner thread pushes and pops at the
+bottom, any other thread may steal from the top.
+*/
+class JobDeque
+{
+public:
+    static constexpr int CAPACITY = 4096;
+    static constexpr int MASK = CAPACITY - 1;
+    static_assert((CAPACITY & MASK) == 0, "Capacity must be power of 2");
+
+    //! Returns false when the deque is full
+    bool Push(Job* job);
+    Job* Pop();
+    Job* Steal();
+
+    int Count() const;
+
+private:
+    alignas(64) int top_{};
+    alignas(64) int bottom_{};
+    alignas(64) Job* jobs_[CAPACITY]{};
+};
+
+//------------------------------------------------------------------------------
+class JobSystem
+{
+public:
+    //! Pooled jobs per thread, jobs dispatched while all of them are alive are allocated on the heap
+    static constexpr int MAX_THREAD_JOBS = JobDeque::CAPACITY;
+    static constexpr int MAX_THREADS = 64;
+
+    /*!
+    Starts threadCount - 1 worker threads, the thread calling Init is thread 0 and
+    executes jobs only while waiting. Zero means one thread per hardware core.
+    */
+    RESULT Init(int threadCount = 0);
+    void Free();
+
+    //! Number of threads executing jobs including the main thread
+    int GetThreadCount() const;
+
+    //! Index of the calling thread, 0 is the main thread, -1 for threads not owned by the system
+    int GetThreadIdx() const;
+
+    /*!
+    Queues count jobs, counter (optional) is incremented by count and decremented as each job finishes.
+    If dependency is not null the jobs are held back until the dependency counter reaches zero.
+    */
+    void Run(const JobDecl* jobs, int count, JobCounter* counter, JobCounter* dependency = nullptr);
+    void Run(const JobDecl& job, JobCounter* counter, JobCounter* dependency = nullptr);
+
+    //! Executes queued jobs on the calling thread until the counter reaches zero
+    void Wait(JobCounter* counter);
+
+    /*!
+    Calls func(Span<T> chunk) for consecutive chunks of at most batchSize items and waits for
+    all of them to finish. Chunks are grabbed dynamically so uneven work still balances.
+    */
+    template<class T, class FuncT>
+    void ParallelForChunked(Span<T> items, uint batchSize, const FuncT& func);
+
+    //! Calls func(T& item) for each item in parallel and waits for all of them to finish
+    template<class T, class FuncT>
+    void ParallelFor(Span<T> items, uint batchSize, const FuncT& func);
+
+    template<class T, class FuncT>
+    void ParallelFor(Span<T> items, const FuncT& func);
+
+private:
+    struct alignas(64) ThreadData
+    {
+        JobDeque    deque_;
+        Job*        jobPool_{};
+        uint        jobPoolIdx_{};
+        std::thread thread_;
+    };
+
+    ThreadData*             threads_{};
+    int                     threadCount_{};
+
+    int                     quit_{};
+    int                     queuedJobs_{};
+    int                     sleepingThreads_{};
+    std::mutex              sleepMutex_;
+    std::condition_variable sleepCv_;
+
+    static void WorkerMain(JobSystem* system, int threadIdx);
+
+    Job* AllocJob(int threadIdx);
+    void FreeJob(Job* job);
+    void Enqueue(int threadIdx, Job* job);
+    Job* GetJob(int threadIdx);
+    void EnqueueList(int threadIdx, Job* job);
+    void Execute(int threadIdx, Job* job);
+    void WakeWorkers();
+};
+
+//------------------------------------------------------------------------------
+namespace internal
+{
+
+//------------------------------------------------------------------------------
+template<class T, class FuncT>
+struct ParallelForData
+{
+    Span<T>         items_;
+    const FuncT*    func_;
+    uint            batchSize_;
+    int             nextItem_;
+};
+
+//------------------------------------------------------------------------------
+template<class T, class FuncT>
+void ParallelForJob(void* data)
+{
+    auto pfData = static_cast<ParallelForData<T, FuncT>*>(data);
+    const int count = static_cast<int>(pfData->items_.Count());
+    const int batchSize = static_cast<int>(pfData->batchSize_);
+
+    for (;;)
+    {
+        const int begin = AtomicAdd(&pfData->nextItem_, batchSize) - batchSize;
+        if (begin >= count)
+            return;
+
+        const int end = Min(begin + batchSize, count);
+        (*pfData->func_)(Span<T>(pfData->items_.Data() + begin, end - begin));
+    }
+}
+
+}
+
+//------------------------------------------------------------------------------
+template<class T, class FuncT>
+void JobSystem::ParallelForChunked(Span<T> items, uint batchSize, const FuncT& func)
+{
+    HS_ASSERT(batchSize > 0);
+    HS_ASSERT(items.Count() < (1ull << 30));
+
+    if (items.IsEmpty())
+        return;
+
+    const int batchCount = static_cast<int>((items.Count() + batchSize - 1) / batchSize);
+    if (batchCount == 1 || threadCount_ <= 1)
+    {
+        func(items);
+        return;
+    }
+
+    internal::ParallelForData<T, FuncT> data{ items, &func, batchSize, 0 };
+
+    // One job per thread, each grabs batches until the range is exhausted
+    const int jobCount = Min(batchCount, threadCount_);
+    JobDecl decls[MAX_THREADS];
+    for (int i = 0; i < jobCount; ++i)
+        decls[i] = JobDecl{ &internal::ParallelForJob<T, FuncT>, &data };
+
+    JobCounter counter;
+    Run(decls, jobCount, &counter);
+    Wait(&counter);
+}
+
+//------------------------------------------------------------------------------
+template<class T, class FuncT>
+void JobSystem::ParallelFor(Span<T> items, uint batchSize, const FuncT& func)
+{
+    ParallelForChunked(items, batchSize, [&func](Span<T> chunk)
+    {
+        for (uint64 i = 0; i < chunk.Count(); ++i)
+            func(chunk[i]);
+    });
+}
+
+//------------------------------------------------------------------------------
+template<class T, class FuncT>
+void JobSystem::ParallelFor(Span<T> items, const FuncT& func)
+{
+    // Aim for a few batches per thread so stealing has something to balance
+    const uint batchesPerThread = 4;
+    const uint64 batchCount = (uint64)Max(threadCount_, 1) * batchesPerThread;
+    const uint batchSize = (uint)((items.Count() + batchCount - 1) / batchCount);
+
+    ParallelFor(items, batchSize > 0 ? batchSize : 1, func);
+}
+
+}
@@ -48,7 +48,8 @@ bool Engine::IsWindowActive() const
     #if HS_WINDOWS
         return isWindowActive_;
     #elif HS_LINUX
-        return glfwGetWindowAttrib(window_, GLFW_FOCUSED) != 0;
+        // No window in headless mode
+        return window_ && glfwGetWindowAttrib(window_, GLFW_FOCUSED) != 0;
     #endif
 }
 
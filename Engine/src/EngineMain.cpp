@@ -1,8 +1,12 @@
 
 #include "Game/GameBase.h"
 #include "Render/Render.h"
+#include "Render/GpuProfiler.h"
 #include "Input/Input.h"
 #include "Resources/ResourceManager.h"
+#include "Threading/JobSystem.h"
+#include "System/FrameArena.h"
+#include "System/Profiler.h"
 #include "Engine.h"
 
 #include "Common/Logging.h"
@@ -48,6 +52,20 @@ static uint g_WindowWidth = 1280;
 static uint g_WindowHeight = 720;
 static bool g_DisableSizeChange = false;
 
+//------------------------------------------------------------------------------
+//! Renders a fixed number of frames offscreen with a fixed timestep so runs are repeatable
+struct HeadlessOptions
+{
+    bool    enabled_{};
+    uint    frameCount_{ 1000 };
+    float   timeStep_{ 1.0f / 60 };
+    //! Every N-th frame is saved to PNG, 0 saves none
+    uint    captureInterval_{};
+    //! Null render backend, measures the CPU side only and needs no GPU
+    bool    nullRender_{};
+};
+static HeadlessOptions g_Headless;
+
 #if HS_WINDOWS
     HWND g_hwnd{};
 #elif HS_LINUX
@@ -78,8 +96,9 @@ void ParseCmdLine(char** commandLineArr, uint cmdLineCount, uint& width, uint& h
             }
         }
 
+        // Headless has no monitor to fill, the size is given by -window
         const char* fullscreenStart = strstr(commandLine, FULLSCREEN_STR);
-        if (!windowStart && fullscreenStart)
+        if (!windowStart && fullscreenStart && !g_Headless.enabled_)
         {
             windowStyle = WindowState::BorderlessFs;
             #if HS_WINDOWS
@@ -95,6 +114,46 @@ void ParseCmdLine(char** commandLineArr, uint cmdLineCount, uint& width, uint& h
     }
 }
 
+//------------------------------------------------------------------------------
+//! Parsed before the rest of the command line, headless runs must not touch GLFW
+void ParseHeadlessCmdLine(char** commandLineArr, uint cmdLineCount, HeadlessOptions& headless)
+{
+    constexpr const char* HEADLESS_STR = "-headless";
+    constexpr const char* FRAMES_STR = "-frames";
+    constexpr const char* TIMESTEP_STR = "-timestep";
+    constexpr const char* CAPTURE_STR = "-capture";
+    constexpr const char* NULL_RENDER_STR = "-nullrender";
+
+    for (uint i = 0; i < cmdLineCount; ++i)
+    {
+        const char* commandLine = commandLineArr[i];
+        if (strstr(commandLine, HEADLESS_STR))
+            headless.enabled_ = true;
+
+        if (strstr(commandLine, NULL_RENDER_STR))
+        {
+            headless.enabled_ = true;
+            headless.nullRender_ = true;
+        }
+
+        const char* framesStart = strstr(commandLine, FRAMES_STR);
+        if (framesStart)
+            sscanf(framesStart + strlen(FRAMES_STR), "=%u", &headless.frameCount_);
+
+        const char* timeStepStart = strstr(commandLine, TIMESTEP_STR);
+        if (timeStepStart)
+        {
+            float timeStep;
+            if (sscanf(timeStepStart + strlen(TIMESTEP_STR), "=%f", &timeStep) == 1 && timeStep > 0)
+                headless.timeStep_ = timeStep;
+        }
+
+        const char* captureStart = strstr(commandLine, CAPTURE_STR);
+        if (captureStart)
+            sscanf(captureStart + strlen(CAPTURE_STR), "=%u", &headless.captureInterval_);
+    }
+}
+
 //------------------------------------------------------------------------------
 static RESULT HsInitImgui()
 {
@@ -106,6 +165,14 @@ static RESULT HsInitImgui()
     // Setup Dear ImGui style
     ImGui::StyleColorsDark();
 
+    if (g_Headless.enabled_)
+    {
+        // No platform backend, display size and time step stay fixed for the whole run
+        io.DisplaySize = ImVec2((float)g_WindowWidth, (float)g_WindowHeight);
+        io.DeltaTime = g_Headless.timeStep_;
+        return R_OK;
+    }
+
     #if HS_WINDOWS
         // Setup Platform/Renderer backends
         ImGui_ImplWin32_Init(g_hwnd);
@@ -119,11 +186,14 @@ static RESULT HsInitImgui()
 //------------------------------------------------------------------------------
 static void HsDestroyImgui()
 {
+    if (!g_Headless.enabled_)
+    {
     #if HS_WINDOWS
         ImGui_ImplWin32_Shutdown();
     #elif HS_LINUX
         ImGui_ImplGlfw_Shutdown();
     #endif
+    }
     ImGui::DestroyContext();
 }
 
@@ -134,6 +204,9 @@ static void Cleanup()
     DestroyInput();
     DestroyRender();
     DestroyResourceManager();
+    DestroyJobSystem();
+    DestroyFrameArena();
+    DestroyProfiler();
     DestroyEngine();
     SDL_Quit();
     glfwTerminate();
@@ -340,6 +413,51 @@ static void Cleanup()
             return -1;
         }
 
+        // Profiler, created before the job system so the workers get their names
+        if (HS_FAILED(CreateProfiler()))
+        {
+            Log(LogLevel::Error, "Failed to create profiler");
+            return -1;
+        }
+        HS_ASSERT(g_Profiler);
+
+        if (HS_FAILED(g_Profiler->Init()))
+        {
+            Log(LogLevel::Error, "Failed to init profiler");
+            return -1;
+        }
+        HS_PROFILE_THREAD("Main");
+
+        // Job system
+        if (HS_FAILED(CreateJobSystem()))
+        {
+            Log(LogLevel::Error, "Failed to create job system");
+            return -1;
+        }
+        HS_ASSERT(g_JobSystem);
+
+        if (HS_FAILED(g_JobSystem->Init()))
+        {
+            Log(LogLevel::Error, "Failed to init job system");
+            return -1;
+        }
+
+        // Frame arena keeps memory alive for as many frames as the render has in flight
+        const RenderConfig renderConfig;
+
+        if (HS_FAILED(CreateFrameArena()))
+        {
+            Log(LogLevel::Error, "Failed to create frame arena");
+            return -1;
+        }
+        HS_ASSERT(g_FrameArena);
+
+        if (HS_FAILED(g_FrameArena->Init(FrameArena::DEFAULT_CAPACITY, renderConfig.framesInFlight_)))
+        {
+            Log(LogLevel::Error, "Failed to init frame arena");
+            return -1;
+        }
+
         // Resource manager
         if (HS_FAILED(CreateResourceManager()))
         {
@@ -355,7 +473,7 @@ static void Cleanup()
         }
 
         // Render
-        if (HS_FAILED(CreateRender(width, height)))
+        if (HS_FAILED(CreateRender(width, height, renderConfig)))
         {
             Log(LogLevel::Error, "Failed to create render");
             return -1;
@@ -451,6 +569,10 @@ static void Cleanup()
                     {
                         if (msg.wParam == VK_F5)
                             (void)g_Render->CompileShaders();
+                        else if (msg.wParam == VK_F6)
+                            g_Render->GetGpuProfiler()->SetVisible(!g_Render->GetGpuProfiler()->IsVisible());
+                        else if (msg.wParam == VK_F7)
+                            g_Profiler->SetVisible(!g_Profiler->IsVisible());
                         g_Input->KeyUp(msg.wParam);
                         break;
                     }
@@ -488,15 +610,30 @@ static void Cleanup()
                 float dTime = elapsed.count() / (1000.0f * 1000 * 1000);
                 dTime = Min(dTime, 0.5f);
 
+                HS_PROFILE_FRAME();
+                HS_PROFILE_SCOPE("Frame");
+
                 g_Engine->SetWindowActive(g_isWindowActive);
 
                 ImGui_ImplWin32_NewFrame();
                 ImGui::NewFrame();
 
-                g_Input->Update();
-                g_Engine->Update(dTime);
-                g_GameBase->Update();
-                g_Render->Update(dTime);
+                {
+                    HS_PROFILE_SCOPE("Input");
+                    g_Input->Update();
+                }
+                {
+                    HS_PROFILE_SCOPE("EngineUpdate");
+                    g_Engine->Update(dTime);
+                }
+                {
+                    HS_PROFILE_SCOPE("GameUpdate");
+                    g_GameBase->Update();
+                }
+                {
+                    HS_PROFILE_SCOPE("RenderUpdate");
+                    g_Render->Update(dTime);
+                }
 
                 g_Input->EndFrame();
             }
@@ -538,6 +675,70 @@ static void Cleanup()
         return R_OK;
     }
 
+    //------------------------------------------------------------------------------
+    static void RunHeadless()
+    {
+        const float dTime = g_Headless.timeStep_;
+        Log(LogLevel::Info, "Headless run of %u frames, timestep %.4f s%s", g_Headless.frameCount_, dTime, g_Headless.nullRender_ ? ", null render" : "");
+
+        uint64 draws{};
+        uint64 pipelineBinds{};
+        uint64 descriptorBinds{};
+        uint64 bufferBinds{};
+        uint64 bytes{};
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (uint frame = 0; frame < g_Headless.frameCount_; ++frame)
+        {
+            HS_PROFILE_FRAME();
+            HS_PROFILE_SCOPE("Frame");
+
+            ImGui::NewFrame();
+
+            {
+                HS_PROFILE_SCOPE("Input");
+                g_Input->Update();
+            }
+            {
+                HS_PROFILE_SCOPE("EngineUpdate");
+                g_Engine->Update(dTime);
+            }
+            {
+                HS_PROFILE_SCOPE("GameUpdate");
+                g_GameBase->Update();
+            }
+
+            if (g_Headless.captureInterval_ && (frame + 1) % g_Headless.captureInterval_ == 0)
+            {
+                char path[64];
+                snprintf(path, sizeof(path), "Frame_%05u.png", frame);
+                g_Render->CaptureFrame(path);
+            }
+
+            {
+                HS_PROFILE_SCOPE("RenderUpdate");
+                g_Render->Update(dTime);
+            }
+
+            const RenderStats& stats = g_Render->GetStats();
+            draws += stats.drawCount_;
+            pipelineBinds += stats.pipelineBinds_;
+            descriptorBinds += stats.descriptorBinds_;
+            bufferBinds += stats.bufferBinds_;
+            bytes += stats.bytesAllocated_;
+
+            g_Input->EndFrame();
+        }
+
+        const float totalMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        Log(LogLevel::Info, "Headless run finished in %.2f ms, %.3f ms per frame",
+            totalMs, g_Headless.frameCount_ ? totalMs / g_Headless.frameCount_ : 0.0f);
+
+        const double frames = Max(g_Headless.frameCount_, 1u);
+        Log(LogLevel::Info, "Per frame: %.1f draws, %.1f pipeline binds, %.1f descriptor binds, %.1f buffer binds, %.0f bytes allocated",
+            draws / frames, pipelineBinds / frames, descriptorBinds / frames, bufferBinds / frames, bytes / frames);
+    }
+
     //------------------------------------------------------------------------------
     int EngineMainLinux(int argc, char** argv, const char* gameName)
     {
@@ -546,7 +747,10 @@ static void Cleanup()
         uint width = g_WindowWidth;
         uint height = g_WindowHeight;
 
-        if (!glfwInit())
+        // Headless may run without a display where GLFW fails to init
+        ParseHeadlessCmdLine(argv, argc, g_Headless);
+
+        if (!g_Headless.enabled_ && !glfwInit())
         {
             LOG_ERR("Failed to init GLFW");
             return -1;
@@ -555,7 +759,7 @@ static void Cleanup()
         ParseCmdLine(argv, argc, width, height, g_WindowState);
 
         // Window
-        if (HS_FAILED(InitWindow(width, height, gameName)))
+        if (!g_Headless.enabled_ && HS_FAILED(InitWindow(width, height, gameName)))
             return -1;
 
         // Engine
@@ -572,6 +776,51 @@ static void Cleanup()
             return -1;
         }
 
+        // Profiler, created before the job system so the workers get their names
+        if (HS_FAILED(CreateProfiler()))
+        {
+            Log(LogLevel::Error, "Failed to create profiler");
+            return -1;
+        }
+        HS_ASSERT(g_Profiler);
+
+        if (HS_FAILED(g_Profiler->Init()))
+        {
+            Log(LogLevel::Error, "Failed to init profiler");
+            return -1;
+        }
+        HS_PROFILE_THREAD("Main");
+
+        // Job system
+        if (HS_FAILED(CreateJobSystem()))
+        {
+            Log(LogLevel::Error, "Failed to create job system");
+            return -1;
+        }
+        HS_ASSERT(g_JobSystem);
+
+        if (HS_FAILED(g_JobSystem->Init()))
+        {
+            Log(LogLevel::Error, "Failed to init job system");
+            return -1;
+        }
+
+        // Frame arena keeps memory alive for as many frames as the render has in flight
+        const RenderConfig renderConfig;
+
+        if (HS_FAILED(CreateFrameArena()))
+        {
+            Log(LogLevel::Error, "Failed to create frame arena");
+            return -1;
+        }
+        HS_ASSERT(g_FrameArena);
+
+        if (HS_FAILED(g_FrameArena->Init(FrameArena::DEFAULT_CAPACITY, renderConfig.framesInFlight_)))
+        {
+            Log(LogLevel::Error, "Failed to init frame arena");
+            return -1;
+        }
+
         // Resource manager
         if (HS_FAILED(CreateResourceManager()))
         {
@@ -587,14 +836,22 @@ static void Cleanup()
         }
 
         // Render
-        if (HS_FAILED(CreateRender(width, height)))
+        if (HS_FAILED(CreateRender(width, height, renderConfig)))
         {
             Log(LogLevel::Error, "Failed to create render");
             return -1;
         }
         HS_ASSERT(g_Render);
 
-        if (HS_FAILED(g_Render->InitLinux(g_wnd)))
+        RESULT renderInit;
+        if (g_Headless.nullRender_)
+            renderInit = g_Render->InitNull();
+        else if (g_Headless.enabled_)
+            renderInit = g_Render->InitHeadless();
+        else
+            renderInit = g_Render->InitLinux(g_wnd);
+
+        if (HS_FAILED(renderInit))
         {
             Log(LogLevel::Error, "Failed to init render");
             return -1;
@@ -641,6 +898,13 @@ static void Cleanup()
             return -1;
         }
 
+        if (g_Headless.enabled_)
+        {
+            RunHeadless();
+            Cleanup();
+            return 0;
+        }
+
         auto start = std::chrono::high_resolution_clock::now();
         while (!glfwWindowShouldClose(g_wnd))
         {
@@ -652,15 +916,30 @@ static void Cleanup()
             float dTime = elapsed.count() / (1000.0f * 1000 * 1000);
             dTime = Min(dTime, 0.5f);
 
+            HS_PROFILE_FRAME();
+            HS_PROFILE_SCOPE("Frame");
+
             g_Engine->SetWindowActive(g_isWindowActive);
 
             ImGui_ImplGlfw_NewFrame();
             ImGui::NewFrame();
 
-            g_Input->Update();
-            g_Engine->Update(dTime);
-            g_GameBase->Update();
-            g_Render->Update(dTime);
+            {
+                HS_PROFILE_SCOPE("Input");
+                g_Input->Update();
+            }
+            {
+                HS_PROFILE_SCOPE("EngineUpdate");
+                g_Engine->Update(dTime);
+            }
+            {
+                HS_PROFILE_SCOPE("GameUpdate");
+                g_GameBase->Update();
+            }
+            {
+                HS_PROFILE_SCOPE("RenderUpdate");
+                g_Render->Update(dTime);
+            }
 
             g_Input->EndFrame();
         }
@@ -1,5 +1,8 @@
 #include "Game/DebugShapeRenderer.h"
 
+#include "Math/MathBatch.h"
+
+#include <cstring>
 #include <utility>
 
 namespace hs
@@ -21,6 +24,14 @@ void DebugShapeRenderer::Draw(const RenderPassContext& ctx)
     {
         debugShapeMat_.DrawShape(ctx, MakeSpan(shapes_[i].vertices_), shapes_[i].color_);
     }
+
+    for (int i = 0; i < immediateShapes_.Count(); ++i)
+    {
+        debugShapeMat_.DrawShape(ctx, MakeSpan(immediateShapes_[i].vertices_), immediateShapes_[i].color_);
+    }
+
+    // Vertices are in the frame arena and would not survive to the next frame
+    immediateShapes_.Clear();
 }
 
 //------------------------------------------------------------------------------
@@ -33,11 +44,38 @@ void DebugShapeRenderer::ClearShapes()
 void DebugShapeRenderer::AddShape(Span<const Vec3> vertices, Color color)
 {
     Array<Vec3> verts;
-    verts.Reserve(vertices.Count());
+    memcpy(verts.AddCount((int)vertices.Count()), vertices.Data(), vertices.Count() * sizeof(Vec3));
+    shapes_.Add(DebugShape{ std::move(verts), color });
+}
 
-    for (uint i = 0; i < vertices.Count(); ++i)
-        verts.Add(vertices[i]);
+//------------------------------------------------------------------------------
+void DebugShapeRenderer::AddShape(Span<const Vec3> vertices, Color color, const Mat44& transform)
+{
+    // Retained shapes are transformed once here instead of every frame they are drawn
+    Array<Vec3> verts;
+    Vec3* transformed = verts.AddCount((int)vertices.Count());
+    TransformPoints(vertices, transform, Span<Vec3>(transformed, vertices.Count()));
     shapes_.Add(DebugShape{ std::move(verts), color });
 }
 
+//------------------------------------------------------------------------------
+Span<const DebugShape> DebugShapeRenderer::GetShapes() const
+{
+    return MakeSpan<const DebugShape>(shapes_.Data(), shapes_.Count());
+}
+
+//------------------------------------------------------------------------------
+void DebugShapeRenderer::AddImmediateShape(Span<const Vec3> vertices, Color color)
+{
+    if (!g_FrameArena)
+    {
+        HS_ASSERT(!"Immediate shapes need the frame arena");
+        return;
+    }
+
+    FrameArray<Vec3> verts;
+    memcpy(verts.AddCount((int)vertices.Count()), vertices.Data(), vertices.Count() * sizeof(Vec3));
+    immediateShapes_.Add(ImmediateDebugShape{ std::move(verts), color });
+}
+
 }
@@ -2,6 +2,8 @@
 
 #include "Render/Render.h"
 
+#include "Containers/RadixSort.h"
+
 #include "Common/Logging.h"
 
 namespace hs
@@ -36,20 +38,17 @@ void SpriteRenderer::AddSprite(Sprite* sprite, const Mat44& world)
     if (!IsIntersecting(tileBoundBox, frustum))
         return;
 
-    drawCalls_.Add(SpriteDrawCall{ sprite, world });
+    drawCalls_.Add(SpriteDrawData{ sprite->texture_, sprite->uvBox_, sprite->size_, world });
 }
 
 //------------------------------------------------------------------------------
-static int SpriteDrawCallCmp(const void *a, const void *b)
+//! Maps float to uint so that larger floats give smaller keys
+static uint FarToNearKey(float z)
 {
-    auto posA = ((SpriteDrawCall*)a)->world_.GetPosition();
-    auto posB = ((SpriteDrawCall*)b)->world_.GetPosition();
-
-    if (posA.z > posB.z)
-        return -1;
-    if (posA.z < posB.z)
-        return 1;
-    return 0;
+    uint bits;
+    memcpy(&bits, &z, sizeof(bits));
+    const uint ascending = (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+    return ~ascending;
 }
 
 //------------------------------------------------------------------------------
@@ -57,19 +56,31 @@ void SpriteRenderer::Draw(const RenderPassContext& ctx)
 {
     g_Render->ResetState();
 
-    // TODO improve drawing and add batching
-    qsort(drawCalls_.Data(), drawCalls_.Count(), sizeof(SpriteDrawCall), &SpriteDrawCallCmp);
+    const int count = drawCalls_.Count();
 
-    //Log(LogLevel::Info, "Sprite draw calls: %d", drawCalls_.Count());
-    for (int i = 0, count = drawCalls_.Count(); i < count; ++i)
-    {
-        spriteMaterial_.DrawSprite(ctx, SpriteDrawData{
-            drawCalls_[i].sprite_->texture_,
-            drawCalls_[i].sprite_->uvBox_,
-            drawCalls_[i].sprite_->size_,
-            drawCalls_[i].world_
-        });
-    }
+    // Back to front, the sort is stable so sprites with the same depth keep the order they were added in
+    sortItems_.Clear();
+    for (int i = 0; i < count; ++i)
+        sortItems_.Add(((uint64)FarToNearKey(drawCalls_[i].world_.GetPosition().z) << 32) | (uint)i);
+
+    while (sortScratch_.Count() < count)
+        sortScratch_.Add(0);
+
+    RadixSort(
+        MakeSpan(sortItems_.Data(), sortItems_.Count()),
+        MakeSpan(sortScratch_.Data(), sortScratch_.Count()),
+        [](uint64 item) { return item >> 32; }
+    );
+
+    drawOrder_.Clear();
+    for (int i = 0; i < count; ++i)
+        drawOrder_.Add((uint)sortItems_[i]);
+
+    spriteMaterial_.DrawSprites(
+        ctx,
+        MakeSpan<const SpriteDrawData>(drawCalls_.Data(), drawCalls_.Count()),
+        MakeSpan<const uint>(drawOrder_.Data(), drawOrder_.Count())
+    );
 }
 
 }
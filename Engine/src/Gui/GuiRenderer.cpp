@@ -7,6 +7,8 @@
 #include "Render/Texture.h"
 #include "Render/Render.h"
 
+#include "System/FrameArena.h"
+
 #include "Common/Logging.h"
 
 #include "Common.h"
@@ -83,7 +85,19 @@ RESULT GuiRenderer::Init()
 //------------------------------------------------------------------------------
 void GuiRenderer::AddText(Font* font, StringView text, Vec2 pos)
 {
-    texts_.Add(Text{ font, text, pos });
+    // Copy the text, it is drawn at the end of this frame and the caller's buffer may be gone by then
+    if (!g_FrameArena)
+    {
+        // Without the frame arena keep a heap copy alive until Draw
+        heapTexts_.Add(String(text));
+        texts_.Add(Text{ font, StringView(heapTexts_.Back()), pos });
+        return;
+    }
+
+    char* textCopy = g_FrameArena->Alloc<char>(text.Size());
+    memcpy(textCopy, text.Data(), text.Size());
+
+    texts_.Add(Text{ font, StringView(textCopy, text.Size()), pos });
 }
 
 //------------------------------------------------------------------------------
@@ -94,6 +108,7 @@ void GuiRenderer::Draw(const RenderPassContext& ctx)
         DrawText(text.font_, StringView(text.text_), text.pos_);
 
     texts_.Clear();
+    heapTexts_.Clear();
 }
 
 //------------------------------------------------------------------------------
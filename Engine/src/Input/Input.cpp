@@ -66,6 +66,12 @@ static void JoysticCallback(int joysticId, int event)
 //------------------------------------------------------------------------------
 RESULT Input::Init()
 {
+    #if HS_LINUX
+        // Headless, there is no input and GLFW is not initialized
+        if (!window_)
+            return R_OK;
+    #endif
+
     glfwSetJoystickCallback(&JoysticCallback);
 
     for (int gamepadI = 0; gamepadI < GLFW_JOYSTICK_LAST; ++gamepadI)
@@ -96,7 +102,8 @@ RESULT Input::Init()
     {
         window_ = window;
 
-        glfwSetKeyCallback(window_, &KeyCallback);
+        if (window_)
+            glfwSetKeyCallback(window_, &KeyCallback);
 
         auto res = Init();
 
@@ -109,6 +116,9 @@ void Input::Update()
 {
     #if HS_WINDOWS
         //glfwPollEvents();
+    #elif HS_LINUX
+        if (!window_)
+            return;
     #endif
 
     for (int gamepadI = 0; gamepadI < GLFW_JOYSTICK_LAST; ++gamepadI)
@@ -161,6 +171,9 @@ Vec2 Input::GetMousePos() const
             }
         }
     #elif HS_LINUX
+        if (!window_)
+            return Vec2{};
+
         double xpos, ypos;
         glfwGetCursorPos(window_, &xpos, &ypos);
         return Vec2(static_cast<float>(xpos), static_cast<float>(ypos));
@@ -0,0 +1,330 @@
+#include "Math/MathBatch.h"
+
+#include "Threading/JobSystem.h"
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+// Items per job of the parallel variants, smaller ranges run on the calling thread
+static constexpr uint POINT_BATCH_SIZE = 16 * 1024;
+static constexpr uint MATRIX_BATCH_SIZE = 4 * 1024;
+static constexpr uint CULL_BATCH_SIZE = 4 * 1024;
+
+#if HS_SSE
+//------------------------------------------------------------------------------
+//! Matrix elements splatted to all lanes, ms[4 * i + j] holds m(i, j)
+struct SplatMat44
+{
+    __m128 ms[16];
+
+    explicit SplatMat44(const Mat44& m)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+                ms[4 * i + j] = _mm_set1_ps(m.m[i][j]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    //! Column j of the product for four vectors in SoA form, w is implicitly 1 when not given
+    __m128 Column(int j, __m128 x, __m128 y, __m128 z) const
+    {
+        __m128 r = _mm_add_ps(_mm_mul_ps(x, ms[j]), ms[12 + j]);
+        r = _mm_add_ps(r, _mm_mul_ps(y, ms[4 + j]));
+        return _mm_add_ps(r, _mm_mul_ps(z, ms[8 + j]));
+    }
+
+    //------------------------------------------------------------------------------
+    __m128 Column(int j, __m128 x, __m128 y, __m128 z, __m128 w) const
+    {
+        __m128 r = _mm_mul_ps(x, ms[j]);
+        r = _mm_add_ps(r, _mm_mul_ps(y, ms[4 + j]));
+        r = _mm_add_ps(r, _mm_mul_ps(z, ms[8 + j]));
+        return _mm_add_ps(r, _mm_mul_ps(w, ms[12 + j]));
+    }
+};
+
+//------------------------------------------------------------------------------
+//! Deinterleaves four consecutive Vec3 into xxxx, yyyy, zzzz
+static void LoadPoints4(const Vec3* points, __m128& x, __m128& y, __m128& z)
+{
+    const float* p = points[0].v;
+    const __m128 p0 = _mm_loadu_ps(p);     // x0 y0 z0 x1
+    const __m128 p1 = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+    const __m128 p2 = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+
+    const __m128 xy23 = _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+    const __m128 yz01 = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+
+    x = _mm_shuffle_ps(p0, xy23, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(yz01, p2, _MM_SHUFFLE(3, 0, 3, 1));
+}
+#endif
+
+//------------------------------------------------------------------------------
+void TransformPoints(Span<const Vec3> points, const Mat44& m, Span<Vec4> out)
+{
+    HS_ASSERT(points.Count() == out.Count());
+
+    uint64 i = 0;
+#if HS_SSE
+    const SplatMat44 sm(m);
+    for (; i + 4 <= points.Count(); i += 4)
+    {
+        __m128 x, y, z;
+        LoadPoints4(&points[i], x, y, z);
+
+        __m128 r0 = sm.Column(0, x, y, z);
+        __m128 r1 = sm.Column(1, x, y, z);
+        __m128 r2 = sm.Column(2, x, y, z);
+        __m128 r3 = sm.Column(3, x, y, z);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_storeu_ps(out[i].v, r0);
+        _mm_storeu_ps(out[i + 1].v, r1);
+        _mm_storeu_ps(out[i + 2].v, r2);
+        _mm_storeu_ps(out[i + 3].v, r3);
+    }
+#endif
+
+    for (; i < points.Count(); ++i)
+        out[i] = points[i].ToVec4Pos() * m;
+}
+
+//------------------------------------------------------------------------------
+void TransformPoints(Span<const Vec3> points, const Mat44& m, Span<Vec3> out)
+{
+    HS_ASSERT(points.Count() == out.Count());
+
+    uint64 i = 0;
+#if HS_SSE
+    const SplatMat44 sm(m);
+    for (; i + 4 <= points.Count(); i += 4)
+    {
+        __m128 x, y, z;
+        LoadPoints4(&points[i], x, y, z);
+
+        __m128 r0 = sm.Column(0, x, y, z);
+        __m128 r1 = sm.Column(1, x, y, z);
+        __m128 r2 = sm.Column(2, x, y, z);
+        __m128 r3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        // Each full store spills w into the next point which the following store overwrites,
+        // the last one must not write past the group
+        _mm_storeu_ps(out[i].v, r0);
+        _mm_storeu_ps(out[i + 1].v, r1);
+        _mm_storeu_ps(out[i + 2].v, r2);
+        _mm_storel_pi(reinterpret_cast<__m64*>(out[i + 3].v), r3);
+        _mm_store_ss(&out[i + 3].z, _mm_movehl_ps(r3, r3));
+    }
+#endif
+
+    for (; i < points.Count(); ++i)
+        out[i] = m.TransformPos(points[i]);
+}
+
+//------------------------------------------------------------------------------
+void TransformVectors(Span<const Vec4> vectors, const Mat44& m, Span<Vec4> out)
+{
+    HS_ASSERT(vectors.Count() == out.Count());
+
+    uint64 i = 0;
+#if HS_SSE
+    const SplatMat44 sm(m);
+    for (; i + 4 <= vectors.Count(); i += 4)
+    {
+        __m128 x = _mm_loadu_ps(vectors[i].v);
+        __m128 y = _mm_loadu_ps(vectors[i + 1].v);
+        __m128 z = _mm_loadu_ps(vectors[i + 2].v);
+        __m128 w = _mm_loadu_ps(vectors[i + 3].v);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 r0 = sm.Column(0, x, y, z, w);
+        __m128 r1 = sm.Column(1, x, y, z, w);
+        __m128 r2 = sm.Column(2, x, y, z, w);
+        __m128 r3 = sm.Column(3, x, y, z, w);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_storeu_ps(out[i].v, r0);
+        _mm_storeu_ps(out[i + 1].v, r1);
+        _mm_storeu_ps(out[i + 2].v, r2);
+        _mm_storeu_ps(out[i + 3].v, r3);
+    }
+#endif
+
+    for (; i < vectors.Count(); ++i)
+        out[i] = vectors[i] * m;
+}
+
+//------------------------------------------------------------------------------
+void MultiplyMatrices(Span<const Mat44> a, Span<const Mat44> b, Span<Mat44> out)
+{
+    HS_ASSERT(a.Count() == out.Count());
+    HS_ASSERT(b.Count() == a.Count() || b.Count() == 1);
+
+    // The per matrix kernels are already SIMD, rows of a single b stay in registers
+    if (b.Count() == 1)
+    {
+        const Mat44 bm = b[0];
+        for (uint64 i = 0; i < a.Count(); ++i)
+            out[i] = a[i] * bm;
+    }
+    else
+    {
+        for (uint64 i = 0; i < a.Count(); ++i)
+            out[i] = a[i] * b[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+uint CullBoxes(const Frustum& frustum, Span<const AABB> boxes, Span<uint8> visible)
+{
+    HS_ASSERT(boxes.Count() == visible.Count());
+
+    uint visibleCount = 0;
+    uint64 i = 0;
+#if HS_SSE
+    __m128 planes[FP_COUNT][4];
+    __m128 absPlanes[FP_COUNT][3];
+    for (int p = 0; p < FP_COUNT; ++p)
+    {
+        for (int j = 0; j < 4; ++j)
+            planes[p][j] = _mm_set1_ps(frustum.planes_[p].v[j]);
+        for (int j = 0; j < 3; ++j)
+            absPlanes[p][j] = _mm_set1_ps(fabsf(frustum.planes_[p].v[j]));
+    }
+
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= boxes.Count(); i += 4)
+    {
+        const AABB* b = &boxes[i];
+
+        // Center and extents of four boxes in SoA form
+        const __m128 minX = _mm_setr_ps(b[0].min_.x, b[1].min_.x, b[2].min_.x, b[3].min_.x);
+        const __m128 minY = _mm_setr_ps(b[0].min_.y, b[1].min_.y, b[2].min_.y, b[3].min_.y);
+        const __m128 minZ = _mm_setr_ps(b[0].min_.z, b[1].min_.z, b[2].min_.z, b[3].min_.z);
+        const __m128 maxX = _mm_setr_ps(b[0].max_.x, b[1].max_.x, b[2].max_.x, b[3].max_.x);
+        const __m128 maxY = _mm_setr_ps(b[0].max_.y, b[1].max_.y, b[2].max_.y, b[3].max_.y);
+        const __m128 maxZ = _mm_setr_ps(b[0].max_.z, b[1].max_.z, b[2].max_.z, b[3].max_.z);
+
+        const __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        const __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        const __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        const __m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        const __m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        const __m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        // A box is out when it is completely behind any plane, dist + radius < 0
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < FP_COUNT; ++p)
+        {
+            __m128 dist = _mm_add_ps(_mm_mul_ps(cx, planes[p][0]), planes[p][3]);
+            dist = _mm_add_ps(dist, _mm_mul_ps(cy, planes[p][1]));
+            dist = _mm_add_ps(dist, _mm_mul_ps(cz, planes[p][2]));
+
+            __m128 radius = _mm_mul_ps(ex, absPlanes[p][0]);
+            radius = _mm_add_ps(radius, _mm_mul_ps(ey, absPlanes[p][1]));
+            radius = _mm_add_ps(radius, _mm_mul_ps(ez, absPlanes[p][2]));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+
+        const int outMask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k)
+        {
+            const uint8 isVisible = (outMask & (1 << k)) ? 0 : 1;
+            visible[i + k] = isVisible;
+            visibleCount += isVisible;
+        }
+    }
+#endif
+
+    for (; i < boxes.Count(); ++i)
+    {
+        const uint8 isVisible = IsIntersecting(frustum, boxes[i]) ? 1 : 0;
+        visible[i] = isVisible;
+        visibleCount += isVisible;
+    }
+
+    return visibleCount;
+}
+
+//------------------------------------------------------------------------------
+void TransformPointsParallel(JobSystem* jobSystem, Span<const Vec3> points, const Mat44& m, Span<Vec4> out)
+{
+    HS_ASSERT(points.Count() == out.Count());
+
+    if (!jobSystem)
+    {
+        TransformPoints(points, m, out);
+        return;
+    }
+
+    jobSystem->ParallelForChunked(out, POINT_BATCH_SIZE, [&](Span<Vec4> chunk)
+    {
+        const uint64 begin = chunk.Data() - out.Data();
+        TransformPoints(MakeSpan(points.Data() + begin, chunk.Count()), m, chunk);
+    });
+}
+
+//------------------------------------------------------------------------------
+void TransformVectorsParallel(JobSystem* jobSystem, Span<const Vec4> vectors, const Mat44& m, Span<Vec4> out)
+{
+    HS_ASSERT(vectors.Count() == out.Count());
+
+    if (!jobSystem)
+    {
+        TransformVectors(vectors, m, out);
+        return;
+    }
+
+    jobSystem->ParallelForChunked(out, POINT_BATCH_SIZE, [&](Span<Vec4> chunk)
+    {
+        const uint64 begin = chunk.Data() - out.Data();
+        TransformVectors(MakeSpan(vectors.Data() + begin, chunk.Count()), m, chunk);
+    });
+}
+
+//------------------------------------------------------------------------------
+void MultiplyMatricesParallel(JobSystem* jobSystem, Span<const Mat44> a, Span<const Mat44> b, Span<Mat44> out)
+{
+    HS_ASSERT(a.Count() == out.Count());
+
+    if (!jobSystem)
+    {
+        MultiplyMatrices(a, b, out);
+        return;
+    }
+
+    jobSystem->ParallelForChunked(out, MATRIX_BATCH_SIZE, [&](Span<Mat44> chunk)
+    {
+        const uint64 begin = chunk.Data() - out.Data();
+        const Span<const Mat44> bChunk = b.Count() == 1 ? b : MakeSpan(b.Data() + begin, chunk.Count());
+        MultiplyMatrices(MakeSpan(a.Data() + begin, chunk.Count()), bChunk, chunk);
+    });
+}
+
+//------------------------------------------------------------------------------
+uint CullBoxesParallel(JobSystem* jobSystem, const Frustum& frustum, Span<const AABB> boxes, Span<uint8> visible)
+{
+    HS_ASSERT(boxes.Count() == visible.Count());
+
+    if (!jobSystem)
+        return CullBoxes(frustum, boxes, visible);
+
+    int visibleCount = 0;
+    jobSystem->ParallelForChunked(visible, CULL_BATCH_SIZE, [&](Span<uint8> chunk)
+    {
+        const uint64 begin = chunk.Data() - visible.Data();
+        const uint chunkVisible = CullBoxes(frustum, MakeSpan(boxes.Data() + begin, chunk.Count()), chunk);
+        AtomicAdd(&visibleCount, (int)chunkVisible);
+    });
+
+    return (uint)visibleCount;
+}
+
+}
@@ -4,6 +4,8 @@
 #include "Render/Allocator.h"
 #include "Render/Vulkan.h"
 
+#include <cstdlib>
+
 namespace hs
 {
 
@@ -15,6 +17,17 @@ RESULT RenderBuffer::Init(RenderBufferType type, RenderBufferMemory memory, int
     size_ = size;
     type_ = type;
 
+    // Plain host memory, the address doubles as the buffer handle so binds still compare
+    if (g_Render->IsNull())
+    {
+        mapped_ = malloc(size_);
+        if (!mapped_)
+            return R_FAIL;
+
+        buffer_ = (VkBuffer)(uintptr)mapped_;
+        return R_OK;
+    }
+
     VkBufferCreateInfo bufferInfo{};
     switch (type_)
     {
@@ -22,11 +35,19 @@ RESULT RenderBuffer::Init(RenderBufferType type, RenderBufferMemory memory, int
             bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
             break;
         case RenderBufferType::Vertex:
-            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+            // Compute passes read instance streams as storage buffers
+            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
             break;
         case RenderBufferType::Index:
             bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
             break;
+        case RenderBufferType::Staging:
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            break;
+        case RenderBufferType::Indirect:
+            // Compute passes may write the commands, copied back when validating them
+            bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            break;
         default:
             HS_NOT_IMPLEMENTED;
             break;
@@ -47,29 +68,49 @@ RESULT RenderBuffer::Init(RenderBufferType type, RenderBufferMemory memory, int
             break;
         case RenderBufferMemory::HostToDevice:
             allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+            // Mapped once for the lifetime, coherent so writes don't need explicit flushes
+            allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
             break;
+        case RenderBufferMemory::DeviceToHost:
+            // Readbacks, memory may not be coherent so reads need vmaInvalidateAllocation
+            allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+            allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            break;
         default:
             HS_NOT_IMPLEMENTED;
             break;
     }
 
-    if (VKR_FAILED(vmaCreateBuffer(g_Render->GetAllocator(), &bufferInfo, &allocInfo, &buffer_, &allocation_, nullptr)))
+    VmaAllocationInfo allocationInfo{};
+    if (VKR_FAILED(vmaCreateBuffer(g_Render->GetAllocator(), &bufferInfo, &allocInfo, &buffer_, &allocation_, &allocationInfo)))
         return R_FAIL;
 
+    mapped_ = allocationInfo.pMappedData;
+
     return R_OK;
 }
 
 //------------------------------------------------------------------------------
 void RenderBuffer::Free()
 {
-    if (buffer_ && allocation_)
+    if (g_Render->IsNull())
+        free(mapped_);
+    else if (buffer_ && allocation_)
         vmaDestroyBuffer(g_Render->GetAllocator(), buffer_, allocation_);
+
+    buffer_ = VK_NULL_HANDLE;
+    mapped_ = nullptr;
 }
 
 //------------------------------------------------------------------------------
 void* RenderBuffer::Map()
 {
+    if (mapped_)
+        return mapped_;
+
     void* mapped{};
     if (VKR_FAILED(vmaMapMemory(g_Render->GetAllocator(), allocation_, &mapped)))
         return nullptr;
@@ -80,15 +121,30 @@ void* RenderBuffer::Map()
 //------------------------------------------------------------------------------
 void RenderBuffer::Unmap()
 {
+    if (mapped_)
+        return;
+
     vmaUnmapMemory(g_Render->GetAllocator(), allocation_);
 }
 
+//------------------------------------------------------------------------------
+void* RenderBuffer::GetMappedData() const
+{
+    return mapped_;
+}
+
 //------------------------------------------------------------------------------
 VkBuffer RenderBuffer::GetBuffer() const
 {
     return buffer_;
 }
 
+//------------------------------------------------------------------------------
+VmaAllocation RenderBuffer::GetAllocation() const
+{
+    return allocation_;
+}
+
 //------------------------------------------------------------------------------
 int RenderBuffer::GetSize() const
 {
@@ -108,51 +164,5 @@ void RenderCopyBuffer(VkCommandBuffer cmdBuff, RenderBufferEntry dst, RenderBuff
     vkCmdCopyBuffer(cmdBuff, src.buffer_, dst.buffer_, 1, &region);
 }
 
-//------------------------------------------------------------------------------
-// TempStagingBuffer
-//------------------------------------------------------------------------------
-TempStagingBuffer::TempStagingBuffer(int size)
-    : size_(size)
-{
-}
-
-//------------------------------------------------------------------------------
-RESULT TempStagingBuffer::Allocate(const void* data)
-{
-    // Create the buffer
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size         = size_;
-    bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-    if (VKR_FAILED(vmaCreateBuffer(g_Render->GetAllocator(), &bufferInfo, &allocInfo, &buffer_, &allocation_, nullptr)))
-        return R_FAIL;
-
-    g_Render->DestroyLater(buffer_, allocation_);
-
-    if (data)
-    {
-        void* mapped;
-        if (VKR_FAILED(vmaMapMemory(g_Render->GetAllocator(), allocation_, &mapped)))
-            return R_FAIL;
-
-        memcpy(mapped, data, size_);
-
-        vmaUnmapMemory(g_Render->GetAllocator(), allocation_);
-    }
-
-    return R_OK;
-}
-
-//------------------------------------------------------------------------------
-VkBuffer TempStagingBuffer::GetBuffer() const
-{
-    return buffer_;
-}
-
 }
 
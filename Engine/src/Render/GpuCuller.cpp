@@ -0,0 +1,667 @@
+#include "Render/GpuCuller.h"
+
+#include "Render/Render.h"
+#include "Render/Material.h"
+#include "Render/RenderBufferCache.h"
+#include "Render/ShaderManager.h"
+#include "Render/Shader.h"
+#include "Render/Allocator.h"
+
+#include "System/Profiler.h"
+
+#include "Common/Logging.h"
+
+#include "Common.h"
+
+#include <cstring>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+//! Objects, instances, commands and draw counts
+static constexpr uint CULL_BINDING_COUNT = 4;
+
+//------------------------------------------------------------------------------
+//! Visibility the reference gives each object
+enum CullVisibility : uint8
+{
+    CV_HIDDEN = 0,
+    CV_VISIBLE = 1,
+    //! Within the tolerance of a plane, the GPU rounding differently may decide either way
+    CV_NEAR_PLANE = 2,
+};
+
+//------------------------------------------------------------------------------
+//! Distance to a plane relative to the magnitudes it is computed from, under which visibility is ambiguous
+static constexpr float NEAR_PLANE_TOLERANCE = 1e-4f;
+
+//------------------------------------------------------------------------------
+//! Same test as IsIntersecting(Frustum, AABB), also flags boxes touching a plane within the tolerance
+static uint8 ClassifyBox(const Frustum& frustum, const AABB& box)
+{
+    const Vec3 c = box.GetCenter();
+    const Vec3 e = box.GetExtents();
+
+    bool visible = true;
+    bool nearPlane = false;
+    for (int i = 0; i < FP_COUNT; ++i)
+    {
+        const Vec4& p = frustum.planes_[i];
+        const float dist = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+        const float radius = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+        const float tolerance = NEAR_PLANE_TOLERANCE * (1 + fabsf(p.w) + fabsf(dist - p.w) + radius);
+
+        // Clearly outside of one plane is hidden whatever the others say
+        if (dist + radius < -tolerance)
+            return CV_HIDDEN;
+
+        visible &= dist >= -radius;
+        nearPlane |= fabsf(dist + radius) <= tolerance;
+    }
+
+    return (visible ? CV_VISIBLE : CV_HIDDEN) | (nearPlane ? CV_NEAR_PLANE : 0);
+}
+
+//------------------------------------------------------------------------------
+/*!
+Writes what the cull shader writes, in object order where the order of the shader is undefined. Also
+writes each object's command and CullVisibility for validation. Returns the visible count.
+*/
+static uint CullReference(
+    const sh::CullObject* objects, const sh::InstanceData* instances, const sh::CullConstants& constants,
+    VkDrawIndexedIndirectCommand* commands, uint* drawCounts,
+    VkDrawIndexedIndirectCommand* objectCommands, uint8* objectVisibility)
+{
+    Frustum frustum;
+    for (int i = 0; i < FP_COUNT; ++i)
+        frustum.planes_[i] = constants.FrustumPlanes[i];
+
+    uint visibleCount = 0;
+    for (uint i = 0; i < constants.ObjectCount; ++i)
+    {
+        const sh::CullObject& object = objects[i];
+        const AABB bounds(
+            Vec3(object.BoundsMin.x, object.BoundsMin.y, object.BoundsMin.z),
+            Vec3(object.BoundsMax.x, object.BoundsMax.y, object.BoundsMax.z)
+        );
+        const uint8 visibility = bounds.IsValid() ? ClassifyBox(frustum, TransformAABB(bounds, instances[i].World)) : CV_VISIBLE;
+        const bool visible = (visibility & CV_VISIBLE) != 0;
+        visibleCount += visible ? 1 : 0;
+
+        VkDrawIndexedIndirectCommand command;
+        command.indexCount      = object.IndexCount;
+        command.instanceCount   = 1;
+        command.firstIndex      = object.FirstIndex;
+        command.vertexOffset    = object.VertexOffset;
+        command.firstInstance   = i;
+
+        objectCommands[i] = command;
+        objectVisibility[i] = visibility;
+
+        if (constants.Compact)
+        {
+            if (visible)
+                commands[object.CommandBase + drawCounts[object.Batch]++] = command;
+        }
+        else
+        {
+            command.instanceCount = visible ? 1 : 0;
+            commands[i] = command;
+        }
+    }
+
+    return visibleCount;
+}
+
+//------------------------------------------------------------------------------
+static RESULT GrowBuffer(RenderBuffer& buffer, RenderBufferType type, RenderBufferMemory memory, uint size)
+{
+    if (buffer.GetBuffer() && (uint)buffer.GetSize() >= size)
+        return R_OK;
+
+    const uint newSize = buffer.GetBuffer() ? Max(size, 2 * (uint)buffer.GetSize()) : size;
+
+    // The render waited for the frame slot's previous frame, nothing reads the old buffer anymore
+    buffer.Free();
+    return buffer.Init(type, memory, (int)newSize);
+}
+
+//------------------------------------------------------------------------------
+RESULT GpuCuller::Init(uint frameCount)
+{
+    HS_ASSERT(!initialized_);
+    HS_ASSERT(frameCount > 0 && frameCount <= MAX_FRAMES);
+
+    // Commands of all objects read the one instance stream
+    if (!g_Render->HasIndirectFirstInstance())
+    {
+        LOG_WARN("GPU culling needs drawIndirectFirstInstance");
+        return R_FAIL;
+    }
+
+    cullShader_ = g_Render->GetShaderManager()->GetOrCreateShader("Cull_cs");
+    if (!cullShader_)
+        return R_FAIL;
+
+    frameCount_ = frameCount;
+    initialized_ = true;
+
+    if (!g_Render->IsNull() && HS_FAILED(CreatePipeline()))
+    {
+        Free();
+        return R_FAIL;
+    }
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+RESULT GpuCuller::CreatePipeline()
+{
+    VkDevice device = g_Render->GetDevice();
+
+    VkDescriptorSetLayoutBinding bindings[CULL_BINDING_COUNT]{};
+    for (uint i = 0; i < CULL_BINDING_COUNT; ++i)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount  = HS_ARR_LEN(bindings);
+    setLayoutInfo.pBindings     = bindings;
+
+    if (VKR_FAILED(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout_)))
+        return R_FAIL;
+
+    VkPushConstantRange cullConstants{};
+    cullConstants.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullConstants.offset        = 0;
+    cullConstants.size          = sizeof(sh::CullConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount           = 1;
+    layoutInfo.pSetLayouts              = &setLayout_;
+    layoutInfo.pushConstantRangeCount   = 1;
+    layoutInfo.pPushConstantRanges      = &cullConstants;
+
+    if (VKR_FAILED(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout_)))
+        return R_FAIL;
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module   = cullShader_->vkShader_;
+    pipelineInfo.stage.pName    = "main";
+    pipelineInfo.layout         = pipelineLayout_;
+
+    if (VKR_FAILED(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_)))
+        return R_FAIL;
+
+    VkDescriptorPoolSize poolSizes[1]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount    = frameCount_ * CULL_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = frameCount_;
+    poolInfo.poolSizeCount  = HS_ARR_LEN(poolSizes);
+    poolInfo.pPoolSizes     = poolSizes;
+
+    if (VKR_FAILED(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descPool_)))
+        return R_FAIL;
+
+    for (uint i = 0; i < frameCount_; ++i)
+    {
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool      = descPool_;
+        setInfo.descriptorSetCount  = 1;
+        setInfo.pSetLayouts         = &setLayout_;
+
+        if (VKR_FAILED(vkAllocateDescriptorSets(device, &setInfo, &slots_[i].descSet_)))
+            return R_FAIL;
+    }
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void GpuCuller::Free()
+{
+    if (!initialized_)
+        return;
+
+    for (uint i = 0; i < MAX_FRAMES; ++i)
+    {
+        slots_[i].commands_.Free();
+        slots_[i].drawCounts_.Free();
+        slots_[i].commandsReadback_.Free();
+        slots_[i].drawCountsReadback_.Free();
+        slots_[i].descSet_ = VK_NULL_HANDLE;
+        slots_[i].validationPending_ = false;
+    }
+
+    if (!g_Render->IsNull())
+    {
+        VkDevice device = g_Render->GetDevice();
+        vkDestroyPipeline(device, pipeline_, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout_, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout_, nullptr);
+        vkDestroyDescriptorPool(device, descPool_, nullptr);
+    }
+
+    pipeline_ = VK_NULL_HANDLE;
+    pipelineLayout_ = VK_NULL_HANDLE;
+    setLayout_ = VK_NULL_HANDLE;
+    descPool_ = VK_NULL_HANDLE;
+    batches_.Clear();
+    initialized_ = false;
+}
+
+//------------------------------------------------------------------------------
+void GpuCuller::SetValidation(bool validation)
+{
+    validation_ = validation;
+}
+
+//------------------------------------------------------------------------------
+uint GpuCuller::SortIntoBatches(Span<VisualObject* const> objects)
+{
+    batchKeys_.Clear();
+    objectBatches_.Clear();
+
+    // Few batches per frame, a linear search is cheaper than hashing
+    for (uint64 i = 0; i < objects.Count(); ++i)
+    {
+        const VisualObject* object = objects[i];
+        HS_ASSERT(object->mesh_.pool_);
+        HS_ASSERT(object->material_->SupportsGpuCulling());
+
+        int batch = 0;
+        while (batch < batchKeys_.Count()
+            && !(batchKeys_[batch].material_ == object->material_
+                && batchKeys_[batch].pool_ == object->mesh_.pool_
+                && batchKeys_[batch].indexType_ == object->mesh_.indexType_))
+        {
+            ++batch;
+        }
+
+        if (batch == batchKeys_.Count())
+            batchKeys_.Add(BatchKey{ object->material_, object->mesh_.pool_, object->mesh_.indexType_, 0, 0 });
+
+        ++batchKeys_[batch].count_;
+        objectBatches_.Add((uint)batch);
+    }
+
+    // Counting sort, objects keep their order within the batch
+    uint base = 0;
+    for (int i = 0; i < batchKeys_.Count(); ++i)
+    {
+        batchKeys_[i].base_ = base;
+        base += batchKeys_[i].count_;
+        batchKeys_[i].count_ = 0;
+    }
+
+    sortedObjects_.Clear();
+    while (sortedObjects_.Count() < (int)objects.Count())
+        sortedObjects_.Add(nullptr);
+
+    for (uint64 i = 0; i < objects.Count(); ++i)
+    {
+        BatchKey& key = batchKeys_[objectBatches_[(int)i]];
+        sortedObjects_[key.base_ + key.count_++] = objects[i];
+    }
+
+    return (uint)batchKeys_.Count();
+}
+
+//------------------------------------------------------------------------------
+RESULT GpuCuller::ReserveSlot(FrameSlot& slot, uint commandCount, uint batchCount)
+{
+    const uint commandsSize = commandCount * sizeof(VkDrawIndexedIndirectCommand);
+    const uint countsSize = batchCount * sizeof(uint);
+
+    if (HS_FAILED(GrowBuffer(slot.commands_, RenderBufferType::Indirect, RenderBufferMemory::DeviceLocal, commandsSize))
+        || HS_FAILED(GrowBuffer(slot.drawCounts_, RenderBufferType::Indirect, RenderBufferMemory::DeviceLocal, countsSize)))
+    {
+        return R_FAIL;
+    }
+
+    // Null outputs are host memory already
+    if (validation_ && !g_Render->IsNull())
+    {
+        if (HS_FAILED(GrowBuffer(slot.commandsReadback_, RenderBufferType::Staging, RenderBufferMemory::DeviceToHost, commandsSize))
+            || HS_FAILED(GrowBuffer(slot.drawCountsReadback_, RenderBufferType::Staging, RenderBufferMemory::DeviceToHost, countsSize)))
+        {
+            return R_FAIL;
+        }
+    }
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void GpuCuller::Cull(VkCommandBuffer cmdBuff, uint frameIdx, Span<VisualObject* const> objects, const Mat44& viewProj)
+{
+    HS_PROFILE_SCOPE("GpuCull");
+    HS_ASSERT(initialized_ && frameIdx < frameCount_);
+
+    FrameSlot& slot = slots_[frameIdx];
+
+    // The render waited for the slot's previous frame, its output is complete
+    if (slot.validationPending_)
+        ValidateSlot(slot);
+
+    batches_.Clear();
+    stats_.objects_ = (uint)objects.Count();
+    stats_.batches_ = 0;
+    stats_.visible_ = 0;
+
+    if (objects.IsEmpty())
+        return;
+
+    const uint objectCount = (uint)objects.Count();
+    const uint batchCount = SortIntoBatches(objects);
+
+    if (HS_FAILED(ReserveSlot(slot, objectCount, batchCount)))
+    {
+        LOG_ERR("Failed to allocate GPU culling output for %u objects", objectCount);
+        return;
+    }
+
+    const bool nullBackend = g_Render->IsNull();
+    const bool compact = g_Render->HasDrawIndirectCount();
+
+    //-----------------------
+    // Inputs, read by the pass as storage buffers and by the draws as the instance stream
+    RenderBufferCache* vbCache = g_Render->GetVertexCache();
+    const int storageAlign = (int)Max<VkDeviceSize>(g_Render->GetPhysDevProps().limits.minStorageBufferOffsetAlignment, 16);
+
+    sh::CullObject* cullObjects{};
+    const RenderBufferEntry objectBuffer = vbCache->BeginAlloc((int)(objectCount * sizeof(sh::CullObject)), storageAlign, (void**)&cullObjects);
+    if (!objectBuffer.buffer_)
+        return;
+
+    for (uint b = 0; b < batchCount; ++b)
+    {
+        const BatchKey& key = batchKeys_[b];
+        for (uint i = key.base_; i < key.base_ + key.count_; ++i)
+        {
+            const VisualObject* object = sortedObjects_[i];
+            const Mesh& mesh = object->mesh_;
+
+            sh::CullObject& cullObject = cullObjects[i];
+            cullObject.BoundsMin    = Vec4(object->bounds_.min_, 0);
+            cullObject.BoundsMax    = Vec4(object->bounds_.max_, 0);
+            cullObject.FirstIndex   = mesh.firstIndex_;
+            cullObject.IndexCount   = mesh.indexCount_;
+            cullObject.VertexOffset = (int)mesh.firstVertex_;
+            cullObject.CommandBase  = key.base_;
+            cullObject.Batch        = b;
+        }
+    }
+
+    vbCache->EndAlloc();
+
+    sh::InstanceData* instances{};
+    const RenderBufferEntry instanceBuffer = vbCache->BeginAlloc((int)(objectCount * sizeof(sh::InstanceData)), storageAlign, (void**)&instances);
+    if (!instanceBuffer.buffer_)
+        return;
+
+    for (uint i = 0; i < objectCount; ++i)
+        instances[i].World = sortedObjects_[i]->transform_;
+
+    vbCache->EndAlloc();
+
+    const Frustum frustum = MakeFrustum(viewProj);
+
+    sh::CullConstants constants{};
+    for (int i = 0; i < FP_COUNT; ++i)
+        constants.FrustumPlanes[i] = frustum.planes_[i];
+    constants.ObjectCount = objectCount;
+    constants.Compact = compact ? 1 : 0;
+
+    //-----------------------
+    // CPU reference, stands in for the pass on the null backend
+    slot.compact_ = compact;
+    slot.batchBases_.Clear();
+    for (uint b = 0; b < batchCount; ++b)
+        slot.batchBases_.Add(batchKeys_[b].base_);
+    slot.batchBases_.Add(objectCount);
+
+    const uint commandsSize = objectCount * sizeof(VkDrawIndexedIndirectCommand);
+    const uint countsSize = batchCount * sizeof(uint);
+
+    if (nullBackend || validation_)
+    {
+        slot.expectedCommands_.Clear();
+        while (slot.expectedCommands_.Count() < (int)objectCount)
+            slot.expectedCommands_.Add({});
+
+        slot.expectedCounts_.Clear();
+        while (slot.expectedCounts_.Count() < (int)batchCount)
+            slot.expectedCounts_.Add(0);
+
+        slot.objectCommands_.Clear();
+        slot.objectCommands_.AddCount((int)objectCount);
+        slot.objectVisibility_.Clear();
+        slot.objectVisibility_.AddCount((int)objectCount);
+
+        stats_.visible_ = CullReference(
+            cullObjects, instances, constants, slot.expectedCommands_.Data(), slot.expectedCounts_.Data(),
+            slot.objectCommands_.Data(), slot.objectVisibility_.Data()
+        );
+    }
+
+    if (nullBackend)
+    {
+        memcpy(slot.commands_.GetMappedData(), slot.expectedCommands_.Data(), commandsSize);
+        memcpy(slot.drawCounts_.GetMappedData(), slot.expectedCounts_.Data(), countsSize);
+    }
+    else
+    {
+        // Inputs move within the vertex cache every frame
+        VkDescriptorBufferInfo bufferInfos[CULL_BINDING_COUNT]{};
+        bufferInfos[0] = VkDescriptorBufferInfo{ objectBuffer.buffer_, (VkDeviceSize)objectBuffer.offset_, (VkDeviceSize)objectBuffer.size_ };
+        bufferInfos[1] = VkDescriptorBufferInfo{ instanceBuffer.buffer_, (VkDeviceSize)instanceBuffer.offset_, (VkDeviceSize)instanceBuffer.size_ };
+        bufferInfos[2] = VkDescriptorBufferInfo{ slot.commands_.GetBuffer(), 0, commandsSize };
+        bufferInfos[3] = VkDescriptorBufferInfo{ slot.drawCounts_.GetBuffer(), 0, countsSize };
+
+        VkWriteDescriptorSet writes[CULL_BINDING_COUNT]{};
+        for (uint i = 0; i < CULL_BINDING_COUNT; ++i)
+        {
+            writes[i].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet            = slot.descSet_;
+            writes[i].dstBinding        = i;
+            writes[i].descriptorCount   = 1;
+            writes[i].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo       = &bufferInfos[i];
+        }
+
+        vkUpdateDescriptorSets(g_Render->GetDevice(), HS_ARR_LEN(writes), writes, 0, nullptr);
+
+        // Visible objects count themselves in
+        vkCmdFillBuffer(cmdBuff, slot.drawCounts_.GetBuffer(), 0, countsSize, 0);
+
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType          = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask  = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(
+            cmdBuff,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &clearBarrier, 0, nullptr, 0, nullptr
+        );
+
+        vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+        vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1, &slot.descSet_, 0, nullptr);
+        vkCmdPushConstants(cmdBuff, pipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(cmdBuff, (objectCount + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE, 1, 1);
+
+        VkMemoryBarrier cullBarrier{};
+        cullBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cullBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask   = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            cmdBuff,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &cullBarrier, 0, nullptr, 0, nullptr
+        );
+
+        if (validation_)
+        {
+            RenderCopyBuffer(cmdBuff, RenderBufferEntry{ slot.commandsReadback_.GetBuffer(), 0, (int)commandsSize }, RenderBufferEntry{ slot.commands_.GetBuffer(), 0, (int)commandsSize });
+            RenderCopyBuffer(cmdBuff, RenderBufferEntry{ slot.drawCountsReadback_.GetBuffer(), 0, (int)countsSize }, RenderBufferEntry{ slot.drawCounts_.GetBuffer(), 0, (int)countsSize });
+
+            VkMemoryBarrier readbackBarrier{};
+            readbackBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            readbackBarrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+            readbackBarrier.dstAccessMask   = VK_ACCESS_HOST_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                cmdBuff,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                0, 1, &readbackBarrier, 0, nullptr, 0, nullptr
+            );
+        }
+    }
+
+    slot.validationPending_ = validation_;
+
+    //-----------------------
+    // Draws
+    for (uint b = 0; b < batchCount; ++b)
+    {
+        const BatchKey& key = batchKeys_[b];
+
+        GpuCullBatch batch;
+        batch.material_     = key.material_;
+        batch.pool_         = key.pool_;
+        batch.indexType_    = key.indexType_;
+        batch.instances_    = instanceBuffer;
+        batch.commands_     = RenderBufferEntry{ slot.commands_.GetBuffer(), (int)(key.base_ * sizeof(VkDrawIndexedIndirectCommand)), (int)(key.count_ * sizeof(VkDrawIndexedIndirectCommand)) };
+        if (compact)
+            batch.drawCount_ = RenderBufferEntry{ slot.drawCounts_.GetBuffer(), (int)(b * sizeof(uint)), (int)sizeof(uint) };
+        batch.maxDraws_     = key.count_;
+
+        batches_.Add(batch);
+    }
+
+    stats_.batches_ = batchCount;
+}
+
+//------------------------------------------------------------------------------
+void GpuCuller::ValidateSlot(FrameSlot& slot)
+{
+    slot.validationPending_ = false;
+
+    const bool nullBackend = g_Render->IsNull();
+    const RenderBuffer& commandsBuffer = nullBackend ? slot.commands_ : slot.commandsReadback_;
+    const RenderBuffer& countsBuffer = nullBackend ? slot.drawCounts_ : slot.drawCountsReadback_;
+
+    if (!nullBackend)
+    {
+        vmaInvalidateAllocation(g_Render->GetAllocator(), commandsBuffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+        vmaInvalidateAllocation(g_Render->GetAllocator(), countsBuffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+    }
+
+    const VkDrawIndexedIndirectCommand* commands = static_cast<const VkDrawIndexedIndirectCommand*>(commandsBuffer.GetMappedData());
+    const uint* drawCounts = static_cast<const uint*>(countsBuffer.GetMappedData());
+
+    // Objects touching a plane may be culled either way, the rest must match the reference exactly
+    const VkDrawIndexedIndirectCommand* objectCommands = slot.objectCommands_.Data();
+    const uint8* visibility = slot.objectVisibility_.Data();
+
+    bool valid = true;
+    for (int b = 0; b + 1 < slot.batchBases_.Count() && valid; ++b)
+    {
+        const uint base = slot.batchBases_[b];
+        const uint end = slot.batchBases_[b + 1];
+
+        if (slot.compact_)
+        {
+            // Visible objects race for their slots, each must be there once whatever the order
+            const uint count = drawCounts[b];
+            if (count > end - base)
+            {
+                valid = false;
+                break;
+            }
+
+            seenScratch_.Clear();
+            while (seenScratch_.Count() < (int)(end - base))
+                seenScratch_.Add(0);
+
+            for (uint i = 0; i < count && valid; ++i)
+            {
+                const VkDrawIndexedIndirectCommand& command = commands[base + i];
+                const uint object = command.firstInstance;
+
+                valid = object >= base && object < end
+                    && !seenScratch_[object - base]
+                    && visibility[object] != CV_HIDDEN
+                    && memcmp(&command, &objectCommands[object], sizeof(command)) == 0;
+
+                if (valid)
+                    seenScratch_[object - base] = 1;
+            }
+
+            for (uint object = base; object < end && valid; ++object)
+            {
+                if (visibility[object] == CV_VISIBLE)
+                    valid = seenScratch_[object - base] != 0;
+            }
+        }
+        else
+        {
+            // Culled objects keep their command with zero instances
+            for (uint object = base; object < end && valid; ++object)
+            {
+                VkDrawIndexedIndirectCommand command = commands[object];
+                const bool instanceValid = (visibility[object] & CV_NEAR_PLANE)
+                    ? command.instanceCount <= 1
+                    : command.instanceCount == (visibility[object] == CV_VISIBLE ? 1u : 0u);
+
+                command.instanceCount = 1;
+                valid = instanceValid && memcmp(&command, &objectCommands[object], sizeof(command)) == 0;
+            }
+        }
+    }
+
+    ++stats_.framesValidated_;
+    if (!valid)
+    {
+        ++stats_.validationFailures_;
+        LOG_WARN("GPU culling output differs from the CPU reference");
+    }
+}
+
+//------------------------------------------------------------------------------
+void GpuCuller::Draw(const RenderPassContext& ctx)
+{
+    for (int i = 0; i < batches_.Count(); ++i)
+        batches_[i].material_->DrawGpuCulled(ctx, batches_[i]);
+}
+
+//------------------------------------------------------------------------------
+Span<const GpuCullBatch> GpuCuller::GetBatches() const
+{
+    return MakeSpan<const GpuCullBatch>(batches_.Data(), batches_.Count());
+}
+
+//------------------------------------------------------------------------------
+const GpuCullStats& GpuCuller::GetStats() const
+{
+    return stats_;
+}
+
+}
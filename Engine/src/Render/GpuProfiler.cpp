@@ -0,0 +1,273 @@
+#include "Render/GpuProfiler.h"
+
+#include "Render/Render.h"
+#include "Render/Vulkan.h"
+
+#include "Common/Logging.h"
+#include "Common/Util.h"
+
+#include "imgui/imgui.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+RESULT GpuProfiler::Init(VkDevice device, VkPhysicalDevice physicalDevice, uint queueFamilyIdx, uint frameCount)
+{
+    HS_ASSERT(frameCount > 0 && frameCount <= MAX_FRAMES);
+
+    device_ = device;
+    frameCount_ = frameCount;
+
+    uint familyCount{};
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    auto families = HS_ALLOCA(VkQueueFamilyProperties, familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+    HS_ASSERT(queueFamilyIdx < familyCount);
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+    const uint validBits = families[queueFamilyIdx].timestampValidBits;
+    if (!validBits || props.limits.timestampPeriod <= 0)
+    {
+        LOG_WARN("GPU timestamps not supported, GPU profiler is disabled");
+        return R_OK;
+    }
+
+    timestampPeriod_ = props.limits.timestampPeriod;
+    timestampMask_ = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = frameCount_ * MAX_SCOPES * 2;
+
+    if (VKR_FAILED(vkCreateQueryPool(device_, &poolInfo, nullptr, &queryPool_)))
+        return R_FAIL;
+
+    results_.Reserve(MAX_SCOPES * 2);
+    for (uint i = 0; i < MAX_SCOPES * 2; ++i)
+        results_.Add(0);
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::Free()
+{
+    if (queryPool_)
+        vkDestroyQueryPool(device_, queryPool_, nullptr);
+    queryPool_ = VK_NULL_HANDLE;
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::BeginFrame(VkCommandBuffer cmdBuff, uint frameIdx)
+{
+    if (!queryPool_)
+        return;
+
+    HS_ASSERT(frameIdx < frameCount_);
+    HS_ASSERT(depth_ == 0 && "Scope left open in the previous frame");
+
+    if (frames_[frameIdx].written_)
+        ReadResults(frameIdx);
+
+    frameIdx_ = frameIdx;
+    frames_[frameIdx] = {};
+    frames_[frameIdx].written_ = true;
+
+    vkCmdResetQueryPool(cmdBuff, queryPool_, frameIdx * MAX_SCOPES * 2, MAX_SCOPES * 2);
+}
+
+//------------------------------------------------------------------------------
+uint GpuProfiler::BeginScope(VkCommandBuffer cmdBuff, const char* name)
+{
+    FrameQueries& frame = frames_[frameIdx_];
+    if (!queryPool_ || frame.scopeCount_ >= MAX_SCOPES)
+        return INVALID_SCOPE;
+
+    const uint scope = frame.scopeCount_++;
+    frame.scopes_[scope] = FrameScope{ name, depth_ };
+    ++depth_;
+
+    vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, (frameIdx_ * MAX_SCOPES + scope) * 2);
+
+    return scope;
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::EndScope(VkCommandBuffer cmdBuff, uint scope)
+{
+    if (scope == INVALID_SCOPE)
+        return;
+
+    HS_ASSERT(depth_ > 0);
+    --depth_;
+
+    vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool_, (frameIdx_ * MAX_SCOPES + scope) * 2 + 1);
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::ReadResults(uint frameIdx)
+{
+    const FrameQueries& frame = frames_[frameIdx];
+    if (!frame.scopeCount_)
+        return;
+
+    // The render waited for the frame slot so the results are available, if not the frame is skipped
+    const uint queryCount = frame.scopeCount_ * 2;
+    const VkResult result = vkGetQueryPoolResults(
+        device_,
+        queryPool_,
+        frameIdx * MAX_SCOPES * 2,
+        queryCount,
+        queryCount * sizeof(uint64),
+        results_.Data(),
+        sizeof(uint64),
+        VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS)
+        return;
+
+    for (uint i = 0; i < frame.scopeCount_; ++i)
+    {
+        const uint64 ticks = (results_[i * 2 + 1] - results_[i * 2]) & timestampMask_;
+        AddSample(frame.scopes_[i].name_, frame.scopes_[i].depth_, (float)(ticks * (double)timestampPeriod_ * 1e-6));
+    }
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::AddSample(const char* name, uint depth, float ms)
+{
+    GpuScopeStats* stats = nullptr;
+    for (int i = 0; i < scopes_.Count(); ++i)
+    {
+        if (scopes_[i].name_ == name || strcmp(scopes_[i].name_, name) == 0)
+        {
+            stats = &scopes_[i];
+            break;
+        }
+    }
+
+    if (!stats)
+    {
+        scopes_.Add(GpuScopeStats{ name });
+        stats = &scopes_.Back();
+    }
+
+    stats->depth_ = depth;
+    stats->lastMs_ = ms;
+    stats->avgMs_ = stats->sampleCount_ ? stats->avgMs_ + (ms - stats->avgMs_) * SMOOTHING : ms;
+    stats->maxMs_ = Max(stats->maxMs_, ms);
+    ++stats->sampleCount_;
+}
+
+//------------------------------------------------------------------------------
+bool GpuProfiler::IsSupported() const
+{
+    return queryPool_ != VK_NULL_HANDLE;
+}
+
+//------------------------------------------------------------------------------
+bool GpuProfiler::IsVisible() const
+{
+    return visible_;
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::SetVisible(bool visible)
+{
+    visible_ = visible;
+}
+
+//------------------------------------------------------------------------------
+const Array<GpuScopeStats>& GpuProfiler::GetScopes() const
+{
+    return scopes_;
+}
+
+//------------------------------------------------------------------------------
+void GpuProfiler::DrawImGui()
+{
+    if (!visible_)
+        return;
+
+    if (!ImGui::Begin("GPU Profiler", &visible_))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (!IsSupported())
+    {
+        ImGui::TextUnformatted("GPU timestamps are not supported by the device");
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Export CSV"))
+    {
+        if (HS_SUCCEEDED(ExportCsv(CSV_FILE)))
+            LOG_DBG("GPU profile exported to %s", CSV_FILE);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        scopes_.Clear();
+
+    if (ImGui::BeginTable("GpuScopes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < scopes_.Count(); ++i)
+        {
+            const GpuScopeStats& stats = scopes_[i];
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", stats.depth_ * 2, "", stats.name_);
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.avgMs_);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.lastMs_);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.maxMs_);
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+//------------------------------------------------------------------------------
+RESULT GpuProfiler::ExportCsv(const char* path) const
+{
+    FILE* f = fopen(path, "w");
+    if (!f)
+    {
+        LOG_WARN("Failed to open %s for writing", path);
+        return R_FAIL;
+    }
+
+    fprintf(f, "scope,depth,avg_ms,last_ms,max_ms,samples\n");
+    for (int i = 0; i < scopes_.Count(); ++i)
+    {
+        const GpuScopeStats& stats = scopes_[i];
+        fprintf(f, "%s,%u,%.4f,%.4f,%.4f,%llu\n",
+            stats.name_, stats.depth_, stats.avgMs_, stats.lastMs_, stats.maxMs_, (unsigned long long)stats.sampleCount_);
+    }
+
+    fclose(f);
+
+    return R_OK;
+}
+
+}
@@ -5,6 +5,7 @@
 #include "Render/ShaderManager.h"
 #include "Render/Buffer.h"
 #include "Render/RenderBufferCache.h"
+#include "Render/GpuCuller.h"
 #include "Render/VertexTypes.h"
 #include "Input/Input.h"
 
@@ -17,6 +18,64 @@
 namespace hs
 {
 
+//------------------------------------------------------------------------------
+// Material
+//------------------------------------------------------------------------------
+static uint s_NextMaterialSortId{};
+
+//------------------------------------------------------------------------------
+Material::Material()
+    : sortId_(s_NextMaterialSortId++)
+{
+}
+
+//------------------------------------------------------------------------------
+void Material::DrawInstanced(const RenderPassContext& ctx, Span<const DrawData> instances)
+{
+    for (uint64 i = 0; i < instances.Count(); ++i)
+        Draw(ctx, instances[i]);
+}
+
+//------------------------------------------------------------------------------
+void Material::DrawMeshBatch(const RenderPassContext& ctx, Span<const DrawData> instances)
+{
+    uint64 runStart = 0;
+    while (runStart < instances.Count())
+    {
+        uint64 runEnd = runStart + 1;
+        while (runEnd < instances.Count() && instances[runEnd].object_->mesh_ == instances[runStart].object_->mesh_)
+            ++runEnd;
+
+        DrawInstanced(ctx, MakeSpan(instances.Data() + runStart, runEnd - runStart));
+        runStart = runEnd;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool Material::SupportsGpuCulling() const
+{
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void Material::DrawGpuCulled(const RenderPassContext&, const GpuCullBatch&)
+{
+    // The culler only takes objects of materials supporting it, those override this
+    HS_ASSERT(!"Material without GPU culling support got a GPU culled batch");
+}
+
+//------------------------------------------------------------------------------
+uint Material::GetSortId() const
+{
+    return sortId_;
+}
+
+//------------------------------------------------------------------------------
+uint Material::GetPipelineSortId() const
+{
+    return pipelineSortId_;
+}
+
 //------------------------------------------------------------------------------
 struct SpriteVertex
 {
@@ -27,28 +86,52 @@ struct SpriteVertex
 };
 
 //------------------------------------------------------------------------------
-uint SpriteVertexLayout()
+//! Per sprite data, the quad itself is generated in the vertex shader
+struct SpriteInstance
 {
-    static VkVertexInputAttributeDescription attributeDescriptions[3]{};
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    attributeDescriptions[0].offset = 0;
+    Mat44   world_;
+    Vec4    uvBox_;
+    Vec2    size_;
+    uint    texIdx_;
+    uint    color_;
+};
 
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[1].offset = 16;
+//------------------------------------------------------------------------------
+uint SpriteInstanceLayout()
+{
+    static VkVertexInputAttributeDescription attributeDescriptions[8]{};
+    for (uint i = 0; i < 4; ++i)
+    {
+        attributeDescriptions[i].binding = 0;
+        attributeDescriptions[i].location = i;
+        attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[i].offset = i * sizeof(Vec4);
+    }
 
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_B8G8R8A8_UNORM;
-    attributeDescriptions[2].offset = 24;
+    attributeDescriptions[4].binding = 0;
+    attributeDescriptions[4].location = 4;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[4].offset = offsetof(SpriteInstance, uvBox_);
+
+    attributeDescriptions[5].binding = 0;
+    attributeDescriptions[5].location = 5;
+    attributeDescriptions[5].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[5].offset = offsetof(SpriteInstance, size_);
+
+    attributeDescriptions[6].binding = 0;
+    attributeDescriptions[6].location = 6;
+    attributeDescriptions[6].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[6].offset = offsetof(SpriteInstance, texIdx_);
+
+    attributeDescriptions[7].binding = 0;
+    attributeDescriptions[7].location = 7;
+    attributeDescriptions[7].format = VK_FORMAT_B8G8R8A8_UNORM;
+    attributeDescriptions[7].offset = offsetof(SpriteInstance, color_);
 
     static VkVertexInputBindingDescription bindingDescription{};
     bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(SpriteVertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescription.stride = sizeof(SpriteInstance);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -92,7 +175,7 @@ uint PosColVertLayout()
 //------------------------------------------------------------------------------
 uint PbrVertexLayout()
 {
-    static VkVertexInputAttributeDescription attributeDescriptions[3]{};
+    static VkVertexInputAttributeDescription attributeDescriptions[7]{};
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
     attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -108,36 +191,34 @@ uint PbrVertexLayout()
     attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
     attributeDescriptions[2].offset = 24;
 
-    static VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(ObjectVertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    // Instance world matrix, one row per attribute
+    for (uint i = 0; i < 4; ++i)
+    {
+        attributeDescriptions[3 + i].binding = 1;
+        attributeDescriptions[3 + i].location = 3 + i;
+        attributeDescriptions[3 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[3 + i].offset = i * sizeof(Vec4);
+    }
+
+    static VkVertexInputBindingDescription bindingDescriptions[2]{};
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(ObjectVertex);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(sh::InstanceData);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = HS_ARR_LEN(bindingDescriptions);
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
     vertexInputInfo.vertexAttributeDescriptionCount = HS_ARR_LEN(attributeDescriptions);
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
 
     return g_Render->GetOrCreateVertexLayout(vertexInputInfo);
 }
 
-//------------------------------------------------------------------------------
-void SetSceneData()
-{
-    void* mapped;
-    RenderBufferEntry constBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::SceneData), sizeof(sh::SceneData), &mapped);
-    auto ubo = (sh::SceneData*)mapped;
-
-    Mat44 camMat = g_Render->GetCamera()->toCamera_;
-    Mat44 projMat = camMat * g_Render->GetCamera()->toProjection_;
-    ubo->VP = projMat;
-
-    g_Render->GetUBOCache()->EndAlloc();
-    g_Render->SetDynamicUbo(0, constBuffer);
-}
-
 //------------------------------------------------------------------------------
 // Sprite Material
 //------------------------------------------------------------------------------
@@ -154,7 +235,15 @@ RESULT SpriteMaterial::Init()
         return R_FAIL;
 
     //
-    vertexLayout_ = SpriteVertexLayout();
+    vertexLayout_ = SpriteInstanceLayout();
+
+    // Compile the pipeline in the background so the first sprite draw doesn't wait for it
+    g_Render->ResetState();
+    g_Render->SetVertexLayout(0, vertexLayout_);
+    g_Render->SetShader<PS_VERT>(vs_);
+    g_Render->SetShader<PS_FRAG>(fs_);
+    g_Render->PrewarmPipeline(RPT_OVERLAY);
+    g_Render->ResetState();
 
     return R_OK;
 }
@@ -168,95 +257,58 @@ void SpriteMaterial::Draw(const RenderPassContext& ctx, const DrawData& drawData
 //------------------------------------------------------------------------------
 void SpriteMaterial::DrawSprite(const RenderPassContext& ctx, const SpriteDrawData& data)
 {
-    {
-        SpriteVertex* mapped{};
-        RenderBufferEntry vbEntry = g_Render->GetVertexCache()->BeginAlloc(6 * sizeof(SpriteVertex), sizeof(SpriteVertex), (void**)&mapped);
-
-        Vec3 vertPos = Vec3::ZERO();
-
-        mapped[0].position_ = Vec4{
-            vertPos.x,
-            vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[0].uv_ = Vec2{ data.uvBox_.x, data.uvBox_.y + data.uvBox_.w };
-        mapped[0].color_ = 0xffffffff;
-
-        mapped[1].position_ = Vec4{
-            data.size_.x + vertPos.x,
-            vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[1].uv_ = Vec2{ data.uvBox_.x + data.uvBox_.z, data.uvBox_.y + data.uvBox_.w };
-        mapped[1].color_ = 0xffffffff;
-
-        mapped[2].position_ = Vec4{
-            data.size_.x + vertPos.x,
-            data.size_.y + vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[2].uv_ = Vec2{ data.uvBox_.x + data.uvBox_.z, data.uvBox_.y };
-        mapped[2].color_ = 0xffffffff;
-
-        mapped[3].position_ = Vec4{
-            vertPos.x,
-            vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[3].uv_ = Vec2{ data.uvBox_.x, data.uvBox_.y + data.uvBox_.w };
-        mapped[3].color_ = 0xffffffff;
-
-        mapped[4].position_ = Vec4{
-            data.size_.x + vertPos.x,
-            data.size_.y + vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[4].uv_ = Vec2{ data.uvBox_.x + data.uvBox_.z, data.uvBox_.y };
-        mapped[4].color_ = 0xffffffff;
-
-        mapped[5].position_ = Vec4{
-            vertPos.x,
-            data.size_.y + vertPos.y,
-            vertPos.z,
-            1
-        };
-        mapped[5].uv_ = Vec2{ data.uvBox_.x, data.uvBox_.y };
-        mapped[5].color_ = 0xffffffff;
+    DrawSprites(ctx, Span<const SpriteDrawData>(&data, 1), {});
+}
 
-        g_Render->GetVertexCache()->EndAlloc();
+//------------------------------------------------------------------------------
+void SpriteMaterial::DrawSprites(const RenderPassContext& ctx, Span<const SpriteDrawData> sprites, Span<const uint> order)
+{
+    HS_ASSERT(order.IsEmpty() || order.Count() == sprites.Count());
 
-        g_Render->SetVertexBuffer(0, vbEntry);
-    }
+    if (sprites.IsEmpty())
+        return;
 
+    // One instanced draw per vertex cache block
+    const uint maxBatch = g_Render->GetVertexCache()->GetMaxSize() / sizeof(SpriteInstance);
+
+    uint64 batchStart = 0;
+    while (batchStart < sprites.Count())
     {
-        void* mapped;
-        RenderBufferEntry uniformBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::SpriteData), sizeof(sh::SpriteData), &mapped);
+        const uint batchCount = (uint)Min<uint64>(sprites.Count() - batchStart, maxBatch);
 
-        auto ubo = (sh::SpriteData*)mapped;
-            ubo->World = data.world_;
-        g_Render->GetUBOCache()->EndAlloc();
+        SpriteInstance* instances{};
+        RenderBufferEntry instEntry = g_Render->GetVertexCache()->BeginAlloc((int)batchCount, &instances);
 
-        g_Render->SetDynamicUbo(1, uniformBuffer);
-    }
+        for (uint i = 0; i < batchCount; ++i)
+        {
+            const uint64 spriteIdx = order.IsEmpty() ? batchStart + i : order[batchStart + i];
+            const SpriteDrawData& sprite = sprites[spriteIdx];
+
+            SpriteInstance& inst = instances[i];
+            inst.world_     = sprite.world_;
+            inst.uvBox_     = sprite.uvBox_;
+            inst.size_      = sprite.size_;
+            inst.texIdx_    = sprite.texture_ ? sprite.texture_->GetBindlessIndex() : 0;
+            inst.color_     = 0xffffffff;
+        }
 
-    SetSceneData();
+        g_Render->GetVertexCache()->EndAlloc();
 
-    g_Render->SetVertexLayout(0, vertexLayout_);
+        // State is reset after each draw so the scene data is set again for each batch
+        g_Render->SetDynamicUbo(0, g_Render->GetSceneData());
+        g_Render->SetVertexBuffer(0, instEntry);
+        g_Render->SetVertexLayout(0, vertexLayout_);
 
-    g_Render->SetTexture(0, data.texture_);
+        g_Render->SetShader<PS_VERT>(vs_);
+        g_Render->SetShader<PS_FRAG>(fs_);
 
-    g_Render->SetShader<PS_VERT>(vs_);
-    g_Render->SetShader<PS_FRAG>(fs_);
+        // Quad corners come from the vertex index
+        g_Render->Draw(ctx, 6, 0, batchCount);
 
-    g_Render->Draw(ctx, 6, 0);
+        batchStart += batchCount;
+    }
 }
 
-
 //------------------------------------------------------------------------------
 // Debug shape Material
 //------------------------------------------------------------------------------
@@ -307,7 +359,7 @@ void DebugShapeMaterial::DrawShape(const RenderPassContext& ctx, Span<const Vec3
         g_Render->SetVertexBuffer(0, vbEntry);
     }
 
-    SetSceneData();
+    g_Render->SetDynamicUbo(0, g_Render->GetSceneData());
 
     g_Render->SetVertexLayout(0, shapeVertexLayout_);
 
@@ -403,23 +455,7 @@ RESULT PhongMaterial::Init()
 //------------------------------------------------------------------------------
 void PhongMaterial::Draw(const RenderPassContext& ctx, const DrawData& drawData)
 {
-    // TODO move scene CB elsewhere
-    struct SceneData
-    {
-        Mat44   Projection;
-        Vec4    ViewPos;
-    };
-
-    SceneData* ubo{};
-    RenderBufferEntry constBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(SceneData), sizeof(SceneData), (void**)&ubo);
-
-    ubo->Projection = g_Render->GetCamera()->toCamera_ * g_Render->GetCamera()->toProjection_;
-    ubo->ViewPos    = g_Render->GetCamera()->pos_.ToVec4Pos();
-
-    g_Render->GetUBOCache()->EndAlloc();
-
-    g_Render->SetDynamicUbo(0, constBuffer);
-
+    g_Render->SetDynamicUbo(0, g_Render->GetSceneData());
 
     // This material setup
     g_Render->SetShader<PS_VERT>(phongVert_);
@@ -478,27 +514,8 @@ RESULT SkyboxMaterial::Init()
 //------------------------------------------------------------------------------
 void SkyboxMaterial::Draw(const RenderPassContext& ctx, const DrawData& drawData)
 {
-    // TODO move scene CB elsewhere
-    struct SceneData
-    {
-        Mat44   Projection;
-        Vec4    ViewPos;
-    };
-
-    void* mapped;
-    RenderBufferEntry constBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(SceneData), sizeof(SceneData), &mapped);
-    auto ubo = (SceneData*)mapped;
-
-    Mat44 camMat = g_Render->GetCamera()->toCamera_;
-    camMat.SetPosition(Vec3{});
-
-    Mat44 projMat = camMat * g_Render->GetCamera()->toProjection_;
-    ubo->Projection = projMat;
-
-    g_Render->GetUBOCache()->EndAlloc();
-
-    g_Render->SetDynamicUbo(0, constBuffer);
-
+    // Shared scene data, the shader moves the cube to the camera instead of removing the view translation
+    g_Render->SetDynamicUbo(0, g_Render->GetSceneData());
 
     // This material setup
     g_Render->SetShader<PS_VERT>(skyboxVert_);
@@ -525,6 +542,14 @@ RESULT PBRMaterial::Init()
         return R_FAIL;
 
     vertexLayout_ = PbrVertexLayout();
+    pipelineSortId_ = pbrVert_->id_;
+
+    g_Render->ResetState();
+    g_Render->SetVertexLayout(0, vertexLayout_);
+    g_Render->SetShader<PS_VERT>(pbrVert_);
+    g_Render->SetShader<PS_FRAG>(pbrFrag_);
+    g_Render->PrewarmPipeline(RPT_MAIN);
+    g_Render->ResetState();
 
     return R_OK;
 }
@@ -532,33 +557,137 @@ RESULT PBRMaterial::Init()
 //------------------------------------------------------------------------------
 void PBRMaterial::Draw(const RenderPassContext& ctx, const DrawData& drawData)
 {
-    // Scene data
+    DrawInstanced(ctx, Span<const DrawData>(&drawData, 1));
+}
+
+//------------------------------------------------------------------------------
+void PBRMaterial::DrawInstanced(const RenderPassContext& ctx, Span<const DrawData> instances)
+{
+    if (instances.IsEmpty())
+        return;
+
+    // All instances share the mesh, only the transform differs
+    const VisualObject* object = instances[0].object_;
+    const RenderBufferEntry instBuffer = WriteInstances(instances);
+
+    const Mesh& mesh = object->mesh_;
+    if (mesh.pool_)
+    {
+        g_Render->SetVertexBuffer(0, mesh.pool_->GetVertexBuffer());
+        g_Render->SetIndexBuffer(0, mesh.pool_->GetIndexBuffer(), mesh.indexType_);
+    }
+    else
     {
-        sh::SceneData* scene{};
-        RenderBufferEntry constBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::SceneData), sizeof(sh::SceneData), (void**)&scene);
+        g_Render->SetVertexBuffer(0, object->vertexBuffer_.buffer_);
+        g_Render->SetIndexBuffer(0, object->indexBuffer_.buffer_);
+    }
+    g_Render->SetVertexBuffer(1, instBuffer);
+    SetDrawState();
+
+    // Objects without a mesh draw their whole index buffer, which always has 32-bit indices
+    if (mesh.pool_)
+        g_Render->DrawIndexed(ctx, mesh.indexCount_, mesh.firstIndex_, mesh.firstVertex_, (uint)instances.Count());
+    else
+        g_Render->DrawIndexed(ctx, (uint)(object->indexBuffer_.buffer_.size_ / sizeof(uint)), 0, 0, (uint)instances.Count());
+}
 
-        scene->VP       = g_Render->GetCamera()->toCamera_ * g_Render->GetCamera()->toProjection_;
-        scene->ViewPos  = g_Render->GetCamera()->pos_.ToVec4Pos();
+//------------------------------------------------------------------------------
+void PBRMaterial::DrawMeshBatch(const RenderPassContext& ctx, Span<const DrawData> instances)
+{
+    // Runs are told apart by firstInstance which indirect draws can't set without the feature
+    if (instances.IsEmpty() || !g_Render->HasIndirectFirstInstance())
+    {
+        Material::DrawMeshBatch(ctx, instances);
+        return;
+    }
 
-        g_Render->GetUBOCache()->EndAlloc();
-        g_Render->SetDynamicUbo(0, constBuffer);
+    const Mesh& firstMesh = instances[0].object_->mesh_;
+
+    uint runCount = 1;
+    for (uint64 i = 1; i < instances.Count(); ++i)
+    {
+        if (instances[i].object_->mesh_ != instances[i - 1].object_->mesh_)
+            ++runCount;
     }
 
-    // Instance data
+    // One command per run of the same mesh, all runs read the one instance stream
+    const RenderBufferEntry instBuffer = WriteInstances(instances);
+
+    VkDrawIndexedIndirectCommand* commands{};
+    const RenderBufferEntry commandBuffer = g_Render->GetIndirectCache()->BeginAlloc((int)runCount, &commands);
+
+    uint64 runStart = 0;
+    for (uint run = 0; run < runCount; ++run)
     {
-        sh::InstanceData* inst{};
-        RenderBufferEntry instCBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::InstanceData), sizeof(sh::InstanceData), (void**)&inst);
+        const Mesh& mesh = instances[runStart].object_->mesh_;
 
-        inst->World = drawData.transform_;
+        uint64 runEnd = runStart + 1;
+        while (runEnd < instances.Count() && instances[runEnd].object_->mesh_ == mesh)
+            ++runEnd;
 
-        g_Render->GetUBOCache()->EndAlloc();
-        g_Render->SetDynamicUbo(1, instCBuffer);
+        commands[run].indexCount    = mesh.indexCount_;
+        commands[run].instanceCount = (uint)(runEnd - runStart);
+        commands[run].firstIndex    = mesh.firstIndex_;
+        commands[run].vertexOffset  = (int)mesh.firstVertex_;
+        commands[run].firstInstance = (uint)runStart;
+
+        runStart = runEnd;
     }
 
-    // PBR data
+    g_Render->GetIndirectCache()->EndAlloc();
+
+    g_Render->SetVertexBuffer(0, firstMesh.pool_->GetVertexBuffer());
+    g_Render->SetVertexBuffer(1, instBuffer);
+    g_Render->SetIndexBuffer(0, firstMesh.pool_->GetIndexBuffer(), firstMesh.indexType_);
+    SetDrawState();
+
+    g_Render->DrawIndexedIndirect(ctx, commandBuffer, runCount);
+}
+
+//------------------------------------------------------------------------------
+bool PBRMaterial::SupportsGpuCulling() const
+{
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void PBRMaterial::DrawGpuCulled(const RenderPassContext& ctx, const GpuCullBatch& batch)
+{
+    g_Render->SetVertexBuffer(0, batch.pool_->GetVertexBuffer());
+    g_Render->SetVertexBuffer(1, batch.instances_);
+    g_Render->SetIndexBuffer(0, batch.pool_->GetIndexBuffer(), batch.indexType_);
+    SetDrawState();
+
+    g_Render->DrawIndexedIndirectCount(ctx, batch.commands_, batch.drawCount_, batch.maxDraws_);
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry PBRMaterial::WriteInstances(Span<const DrawData> instances) const
+{
+    // Instance data, read as a per instance vertex stream
+    sh::InstanceData* inst{};
+    const RenderBufferEntry instBuffer = g_Render->GetVertexCache()->BeginAlloc((int)instances.Count(), &inst);
+
+    for (uint64 i = 0; i < instances.Count(); ++i)
+        inst[i].World = instances[i].transform_;
+
+    g_Render->GetVertexCache()->EndAlloc();
+
+    return instBuffer;
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry PBRMaterial::GetPbrData() const
+{
+    // Chunks recorded in parallel draw with the same material, the first one writes the constants.
+    // Changes of the parameters take effect in the next frame.
+    const uint64 frame = g_Render->GetCurrentFrame();
+
+    std::lock_guard<std::mutex> lock(pbrDataLock_);
+    if (pbrDataFrame_ != frame)
     {
         sh::PBRData* pbr{};
-        RenderBufferEntry pbrConstBuffer = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::PBRData), sizeof(sh::PBRData), (void**)&pbr);
+        pbrData_ = g_Render->GetUBOCache()->BeginAlloc(sizeof(sh::PBRData), sizeof(sh::PBRData), (void**)&pbr);
 
         pbr->Albedo = albedo_;
         pbr->Roughness = roughness_;
@@ -566,22 +695,27 @@ void PBRMaterial::Draw(const RenderPassContext& ctx, const DrawData& drawData)
         pbr->AO = ao_;
 
         g_Render->GetUBOCache()->EndAlloc();
-        g_Render->SetDynamicUbo(2, pbrConstBuffer);
+        pbrDataFrame_ = frame;
     }
 
+    return pbrData_;
+}
+
+//------------------------------------------------------------------------------
+void PBRMaterial::SetDrawState() const
+{
+    g_Render->SetDynamicUbo(0, g_Render->GetSceneData());
+
+    g_Render->SetDynamicUbo(2, GetPbrData());
+
     // Material setup
-    g_Render->SetVertexBuffer(0, drawData.object_->vertexBuffer_.buffer_);
     g_Render->SetVertexLayout(0, vertexLayout_);
-    g_Render->SetIndexBuffer(0, drawData.object_->indexBuffer_.buffer_);
 
     g_Render->SetShader<PS_VERT>(pbrVert_);
     g_Render->SetShader<PS_FRAG>(pbrFrag_);
 
     g_Render->SetTexture(0, albedoTex_);
     g_Render->SetTexture(1, roughnessMetalnessTex_);
-
-    // TODO get the data better
-    g_Render->DrawIndexed(ctx, drawData.object_->indexBuffer_.buffer_.size_ / 4, 0, 0);
 }
 
 }
@@ -0,0 +1,283 @@
+#include "Render/MeshPool.h"
+
+#include "Render/Render.h"
+#include "Render/RenderBufferCache.h"
+#include "Render/Vulkan.h"
+
+#include "Math/Math.h"
+
+#include "Common/Logging.h"
+
+#include <cstring>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+//! Index ranges start at multiples of both index sizes so firstIndex is exact for either type
+static constexpr uint INDEX_RANGE_ALIGN = 4;
+
+//------------------------------------------------------------------------------
+RESULT MeshPool::Init(uint vertexSize, uint vertexCapacity, uint indexCapacityBytes)
+{
+    HS_ASSERT(!initialized_);
+    HS_ASSERT(vertexSize > 0 && vertexCapacity > 0 && indexCapacityBytes > 0);
+    HS_ASSERT((uint64)vertexSize * vertexCapacity < (1u << 31) && indexCapacityBytes < (1u << 31));
+
+    vertexSize_ = vertexSize;
+
+    if (HS_FAILED(vertexBuffer_.Init(RenderBufferType::Vertex, RenderBufferMemory::DeviceLocal, (int)(vertexSize * vertexCapacity))))
+        return R_FAIL;
+
+    if (HS_FAILED(indexBuffer_.Init(RenderBufferType::Index, RenderBufferMemory::DeviceLocal, (int)indexCapacityBytes)))
+    {
+        vertexBuffer_.Free();
+        return R_FAIL;
+    }
+
+    freeVertices_.Add(Range{ 0, vertexCapacity });
+    freeIndices_.Add(Range{ 0, indexCapacityBytes });
+    initialized_ = true;
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void MeshPool::Free()
+{
+    if (!initialized_)
+        return;
+
+    // Meshes of the pool may still be drawn by frames in flight
+    if (!g_Render->IsNull())
+    {
+        g_Render->DestroyLater(vertexBuffer_.GetBuffer(), vertexBuffer_.GetAllocation());
+        g_Render->DestroyLater(indexBuffer_.GetBuffer(), indexBuffer_.GetAllocation());
+    }
+    else
+    {
+        vertexBuffer_.Free();
+        indexBuffer_.Free();
+    }
+
+    freeVertices_.Clear();
+    freeIndices_.Clear();
+    pendingFrees_.Clear();
+    stats_ = {};
+    initialized_ = false;
+}
+
+//------------------------------------------------------------------------------
+RESULT MeshPool::Add(const void* vertices, uint vertexCount, const void* indices, uint indexCount, IndexType indexType, Mesh& mesh)
+{
+    HS_ASSERT(initialized_);
+    HS_ASSERT(vertices && vertexCount > 0 && indices && indexCount > 0);
+
+    ReleaseCompletedFrees();
+
+    const uint indexSize = IndexSize(indexType);
+
+    Range vertexRange;
+    if (!AllocRange(freeVertices_, vertexCount, 1, vertexRange))
+    {
+        LOG_WARN("Mesh pool has no space for %u vertices", vertexCount);
+        return R_FAIL;
+    }
+
+    Range indexRange;
+    if (!AllocRange(freeIndices_, indexCount * indexSize, INDEX_RANGE_ALIGN, indexRange))
+    {
+        FreeRange(freeVertices_, vertexRange);
+        LOG_WARN("Mesh pool has no space for %u indices", indexCount);
+        return R_FAIL;
+    }
+
+    if (HS_FAILED(Upload(vertexBuffer_, vertexRange.begin_ * vertexSize_, vertices, vertexCount * vertexSize_))
+        || HS_FAILED(Upload(indexBuffer_, indexRange.begin_, indices, indexRange.size_)))
+    {
+        FreeRange(freeVertices_, vertexRange);
+        FreeRange(freeIndices_, indexRange);
+        return R_FAIL;
+    }
+
+    if (!g_Render->IsNull())
+    {
+        VkMemoryBarrier barrier{};
+        barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            g_Render->CmdBuff(),
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    mesh.pool_          = this;
+    mesh.firstVertex_   = vertexRange.begin_;
+    mesh.vertexCount_   = vertexCount;
+    mesh.firstIndex_    = indexRange.begin_ / indexSize;
+    mesh.indexCount_    = indexCount;
+    mesh.indexType_     = indexType;
+
+    ++stats_.meshCount_;
+    stats_.verticesUsed_ += vertexRange.size_;
+    stats_.indexBytesUsed_ += indexRange.size_;
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void MeshPool::Remove(Mesh& mesh)
+{
+    HS_ASSERT(mesh.pool_ == this);
+
+    PendingFree pending;
+    pending.vertices_ = Range{ mesh.firstVertex_, mesh.vertexCount_ };
+    pending.indices_ = Range{ mesh.firstIndex_ * IndexSize(mesh.indexType_), mesh.indexCount_ * IndexSize(mesh.indexType_) };
+    pending.frame_ = g_Render->GetCurrentFrame() + 1;
+    pendingFrees_.Add(pending);
+
+    --stats_.meshCount_;
+    stats_.verticesUsed_ -= pending.vertices_.size_;
+    stats_.indexBytesUsed_ -= pending.indices_.size_;
+    stats_.pendingFrees_ = pendingFrees_.Count();
+
+    mesh = {};
+}
+
+//------------------------------------------------------------------------------
+void MeshPool::ReleaseCompletedFrees()
+{
+    const uint64 completedFrame = g_Render->GetCompletedFrame();
+
+    int kept = 0;
+    for (int i = 0; i < pendingFrees_.Count(); ++i)
+    {
+        const PendingFree& pending = pendingFrees_[i];
+        if (pending.frame_ <= completedFrame)
+        {
+            FreeRange(freeVertices_, pending.vertices_);
+            FreeRange(freeIndices_, pending.indices_);
+        }
+        else
+        {
+            pendingFrees_[kept++] = pending;
+        }
+    }
+
+    while (pendingFrees_.Count() > kept)
+        pendingFrees_.RemoveBack();
+
+    stats_.pendingFrees_ = pendingFrees_.Count();
+}
+
+//------------------------------------------------------------------------------
+bool MeshPool::AllocRange(Array<Range>& freeRanges, uint size, uint align, Range& range)
+{
+    // First fit, the padding in front of an aligned begin stays free
+    for (int i = 0; i < freeRanges.Count(); ++i)
+    {
+        Range& freeRange = freeRanges[i];
+        const uint begin = Align(freeRange.begin_, align);
+        const uint end = freeRange.begin_ + freeRange.size_;
+        if (begin > end || end - begin < size)
+            continue;
+
+        range = Range{ begin, size };
+
+        const Range tail{ begin + size, end - begin - size };
+        if (begin > freeRange.begin_)
+        {
+            freeRange.size_ = begin - freeRange.begin_;
+            if (tail.size_)
+                freeRanges.Insert(i + 1, tail);
+        }
+        else if (tail.size_)
+        {
+            freeRange = tail;
+        }
+        else
+        {
+            freeRanges.Remove(i);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void MeshPool::FreeRange(Array<Range>& freeRanges, Range range)
+{
+    int i = 0;
+    while (i < freeRanges.Count() && freeRanges[i].begin_ < range.begin_)
+        ++i;
+
+    if (i < freeRanges.Count() && range.begin_ + range.size_ == freeRanges[i].begin_)
+    {
+        range.size_ += freeRanges[i].size_;
+        freeRanges.Remove(i);
+    }
+
+    if (i > 0 && freeRanges[i - 1].begin_ + freeRanges[i - 1].size_ == range.begin_)
+    {
+        freeRanges[i - 1].size_ += range.size_;
+        return;
+    }
+
+    freeRanges.Insert(i, range);
+}
+
+//------------------------------------------------------------------------------
+RESULT MeshPool::Upload(const RenderBuffer& dst, uint dstOffset, const void* data, uint size)
+{
+    // Host memory stands in for the device local buffer
+    if (g_Render->IsNull())
+    {
+        memcpy(static_cast<uint8*>(dst.GetMappedData()) + dstOffset, data, size);
+        return R_OK;
+    }
+
+    RenderBufferCache* stagingCache = g_Render->GetStagingCache();
+
+    void* mapped{};
+    const RenderBufferEntry src = stagingCache->BeginAlloc((int)size, 16, &mapped);
+    if (!src.buffer_)
+        return R_FAIL;
+
+    memcpy(mapped, data, size);
+    stagingCache->EndAlloc();
+
+    RenderCopyBuffer(g_Render->CmdBuff(), RenderBufferEntry{ dst.GetBuffer(), (int)dstOffset, (int)size }, src);
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry MeshPool::GetVertexBuffer() const
+{
+    return RenderBufferEntry{ vertexBuffer_.GetBuffer(), 0, vertexBuffer_.GetSize() };
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry MeshPool::GetIndexBuffer() const
+{
+    return RenderBufferEntry{ indexBuffer_.GetBuffer(), 0, indexBuffer_.GetSize() };
+}
+
+//------------------------------------------------------------------------------
+uint MeshPool::GetVertexSize() const
+{
+    return vertexSize_;
+}
+
+//------------------------------------------------------------------------------
+const MeshPoolStats& MeshPool::GetStats() const
+{
+    return stats_;
+}
+
+}
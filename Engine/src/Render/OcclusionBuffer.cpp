@@ -0,0 +1,345 @@
+#include "Render/OcclusionBuffer.h"
+
+#include "Math/MathBatch.h"
+
+#include <utility>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+RESULT OcclusionBuffer::Init(uint width, uint height)
+{
+    if (width == 0 || height == 0 || width % TILE_WIDTH || height % TILE_HEIGHT)
+        return R_FAIL;
+
+    width_ = width;
+    height_ = height;
+    tilesX_ = width / TILE_WIDTH;
+    tilesY_ = height / TILE_HEIGHT;
+
+    depth_.Clear();
+    depth_.Reserve(width_ * height_);
+    for (uint i = 0; i < width_ * height_; ++i)
+        depth_.Add(1.0f);
+
+    tileDepth_.Clear();
+    tileDepth_.Reserve(tilesX_ * tilesY_);
+    for (uint i = 0; i < tilesX_ * tilesY_; ++i)
+        tileDepth_.Add(1.0f);
+
+    viewProj_ = Mat44::Identity();
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void OcclusionBuffer::BeginFrame(const Mat44& viewProj)
+{
+    viewProj_ = viewProj;
+    hasOccluders_ = false;
+    stats_ = {};
+
+    for (int i = 0; i < depth_.Count(); ++i)
+        depth_[i] = 1.0f;
+    for (int i = 0; i < tileDepth_.Count(); ++i)
+        tileDepth_[i] = 1.0f;
+}
+
+//------------------------------------------------------------------------------
+void OcclusionBuffer::AddOccluder(Span<const Vec3> vertices, Span<const uint> indices, const Mat44& world)
+{
+    HS_ASSERT(indices.Count() % 3 == 0);
+
+    clipVerts_.Clear();
+    for (uint64 i = 0; i < vertices.Count(); ++i)
+        clipVerts_.Add(Vec4::ZERO());
+
+    TransformPoints(vertices, world * viewProj_, MakeSpan(clipVerts_));
+
+    const float halfWidth = 0.5f * width_;
+    const float halfHeight = 0.5f * height_;
+
+    for (uint64 i = 0; i + 2 < indices.Count(); i += 3)
+    {
+        Vec4 screen[3];
+        bool clipped = false;
+        for (int v = 0; v < 3; ++v)
+        {
+            HS_ASSERT(indices[i + v] < vertices.Count());
+            const Vec4& clip = clipVerts_[indices[i + v]];
+
+            // In front of the near plane z and w are both positive
+            if (clip.z < 0 || clip.w <= 0)
+            {
+                clipped = true;
+                break;
+            }
+
+            const float invW = 1.0f / clip.w;
+            screen[v] = Vec4(
+                (clip.x * invW + 1.0f) * halfWidth,
+                (clip.y * invW + 1.0f) * halfHeight,
+                clip.z * invW,
+                1.0f
+            );
+        }
+
+        ++stats_.occluderTriangles_;
+        if (clipped)
+        {
+            ++stats_.clippedTriangles_;
+            continue;
+        }
+
+        RasterizeTriangle(screen[0], screen[1], screen[2]);
+    }
+
+    hasOccluders_ = true;
+}
+
+//------------------------------------------------------------------------------
+void OcclusionBuffer::RasterizeTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2)
+{
+    const Vec4* a = &v0;
+    const Vec4* b = &v1;
+    const Vec4* c = &v2;
+
+    // Make the winding counter-clockwise so the edge functions are positive inside
+    float area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+    if (area < 0)
+    {
+        std::swap(b, c);
+        area = -area;
+    }
+    if (area < 1e-6f)
+        return;
+
+    int minX = Max((int)floorf(Min(a->x, Min(b->x, c->x))), 0);
+    int maxX = Min((int)ceilf(Max(a->x, Max(b->x, c->x))), (int)width_);
+    const int minY = Max((int)floorf(Min(a->y, Min(b->y, c->y))), 0);
+    const int maxY = Min((int)ceilf(Max(a->y, Max(b->y, c->y))), (int)height_);
+    if (minX >= maxX || minY >= maxY)
+        return;
+
+    // Rows are processed in groups of four pixels
+    minX &= ~3;
+
+    // Edge function of p -> q is A * x + B * y + C
+    struct Edge
+    {
+        float a_, b_, c_;
+    };
+    auto makeEdge = [](const Vec4* p, const Vec4* q)
+    {
+        Edge e;
+        e.a_ = p->y - q->y;
+        e.b_ = q->x - p->x;
+        e.c_ = -(e.a_ * p->x + e.b_ * p->y);
+        return e;
+    };
+
+    // Edge opposite to each vertex, its value divided by area is the vertex weight
+    const Edge ea = makeEdge(b, c);
+    const Edge eb = makeEdge(c, a);
+    const Edge ec = makeEdge(a, b);
+
+    const float invArea = 1.0f / area;
+    const float dzdx = (ea.a_ * a->z + eb.a_ * b->z + ec.a_ * c->z) * invArea;
+    const float dzdy = (ea.b_ * a->z + eb.b_ * b->z + ec.b_ * c->z) * invArea;
+    const float z0 = (ea.c_ * a->z + eb.c_ * b->z + ec.c_ * c->z) * invArea;
+
+#if HS_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 eaA = _mm_set1_ps(ea.a_);
+    const __m128 ebA = _mm_set1_ps(eb.a_);
+    const __m128 ecA = _mm_set1_ps(ec.a_);
+    const __m128 dzdxs = _mm_set1_ps(dzdx);
+
+    for (int y = minY; y < maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        const __m128 eaRow = _mm_set1_ps(ea.b_ * py + ea.c_);
+        const __m128 ebRow = _mm_set1_ps(eb.b_ * py + eb.c_);
+        const __m128 ecRow = _mm_set1_ps(ec.b_ * py + ec.c_);
+        const __m128 zRow = _mm_set1_ps(dzdy * py + z0);
+
+        float* row = &depth_[y * width_];
+        for (int x = minX; x < maxX; x += 4)
+        {
+            const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+
+            const __m128 wa = _mm_add_ps(_mm_mul_ps(eaA, px), eaRow);
+            const __m128 wb = _mm_add_ps(_mm_mul_ps(ebA, px), ebRow);
+            const __m128 wc = _mm_add_ps(_mm_mul_ps(ecA, px), ecRow);
+            const __m128 inside = _mm_and_ps(_mm_cmpge_ps(wa, zero), _mm_and_ps(_mm_cmpge_ps(wb, zero), _mm_cmpge_ps(wc, zero)));
+            if (!_mm_movemask_ps(inside))
+                continue;
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(dzdxs, px), zRow);
+            const __m128 old = _mm_loadu_ps(row + x);
+            const __m128 nearest = _mm_min_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = minY; y < maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        float* row = &depth_[y * width_];
+        for (int x = minX; x < maxX; ++x)
+        {
+            const float px = x + 0.5f;
+            const float wa = ea.a_ * px + ea.b_ * py + ea.c_;
+            const float wb = eb.a_ * px + eb.b_ * py + eb.c_;
+            const float wc = ec.a_ * px + ec.b_ * py + ec.c_;
+            if (wa < 0 || wb < 0 || wc < 0)
+                continue;
+
+            row[x] = Min(row[x], dzdx * px + dzdy * py + z0);
+        }
+    }
+#endif
+}
+
+//------------------------------------------------------------------------------
+void OcclusionBuffer::EndOccluders()
+{
+    for (uint ty = 0; ty < tilesY_; ++ty)
+    {
+        for (uint tx = 0; tx < tilesX_; ++tx)
+        {
+            float farthest = 0;
+            for (uint y = ty * TILE_HEIGHT; y < (ty + 1) * TILE_HEIGHT; ++y)
+            {
+                const float* row = &depth_[y * width_ + tx * TILE_WIDTH];
+                for (uint x = 0; x < TILE_WIDTH; ++x)
+                    farthest = Max(farthest, row[x]);
+            }
+            tileDepth_[ty * tilesX_ + tx] = farthest;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool OcclusionBuffer::IsVisible(const AABB& worldBox) const
+{
+    if (!hasOccluders_)
+        return true;
+
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minDepth = FLT_MAX;
+    for (int i = 0; i < 8; ++i)
+    {
+        const Vec4 corner(
+            (i & 1) ? worldBox.max_.x : worldBox.min_.x,
+            (i & 2) ? worldBox.max_.y : worldBox.min_.y,
+            (i & 4) ? worldBox.max_.z : worldBox.min_.z,
+            1
+        );
+        const Vec4 clip = corner * viewProj_;
+
+        // Crossing the near plane, we can't tell the nearest depth
+        if (clip.z < 0 || clip.w <= 0)
+            return true;
+
+        const float invW = 1.0f / clip.w;
+        const float x = clip.x * invW;
+        const float y = clip.y * invW;
+        minX = Min(minX, x);
+        maxX = Max(maxX, x);
+        minY = Min(minY, y);
+        maxY = Max(maxY, y);
+        minDepth = Min(minDepth, clip.z * invW);
+    }
+
+    const int px0 = Max((int)floorf((minX + 1.0f) * 0.5f * width_), 0);
+    const int px1 = Min((int)ceilf((maxX + 1.0f) * 0.5f * width_), (int)width_);
+    const int py0 = Max((int)floorf((minY + 1.0f) * 0.5f * height_), 0);
+    const int py1 = Min((int)ceilf((maxY + 1.0f) * 0.5f * height_), (int)height_);
+
+    // Off screen, frustum culling decides about these
+    if (px0 >= px1 || py0 >= py1)
+        return true;
+
+    const int tx0 = px0 / TILE_WIDTH;
+    const int tx1 = (px1 - 1) / TILE_WIDTH;
+    const int ty0 = py0 / TILE_HEIGHT;
+    const int ty1 = (py1 - 1) / TILE_HEIGHT;
+
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        for (int tx = tx0; tx <= tx1; ++tx)
+        {
+            // All occluders in the tile are in front of the box
+            if (tileDepth_[ty * tilesX_ + tx] < minDepth)
+                continue;
+
+            const int x0 = Max(px0, tx * (int)TILE_WIDTH);
+            const int x1 = Min(px1, (tx + 1) * (int)TILE_WIDTH);
+            const int y0 = Max(py0, ty * (int)TILE_HEIGHT);
+            const int y1 = Min(py1, (ty + 1) * (int)TILE_HEIGHT);
+            for (int y = y0; y < y1; ++y)
+            {
+                const float* row = &depth_[y * width_];
+                for (int x = x0; x < x1; ++x)
+                {
+                    if (row[x] >= minDepth)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+uint OcclusionBuffer::TestBoxes(Span<const AABB> boxes, Span<uint8> visible)
+{
+    HS_ASSERT(boxes.Count() == visible.Count());
+
+    uint visibleCount = 0;
+    for (uint64 i = 0; i < boxes.Count(); ++i)
+    {
+        const uint8 isVisible = IsVisible(boxes[i]) ? 1 : 0;
+        visible[i] = isVisible;
+        visibleCount += isVisible;
+    }
+
+    stats_.testedBoxes_ += (uint)boxes.Count();
+    stats_.occludedBoxes_ += (uint)boxes.Count() - visibleCount;
+
+    return visibleCount;
+}
+
+//------------------------------------------------------------------------------
+uint OcclusionBuffer::GetWidth() const
+{
+    return width_;
+}
+
+//------------------------------------------------------------------------------
+uint OcclusionBuffer::GetHeight() const
+{
+    return height_;
+}
+
+//------------------------------------------------------------------------------
+float OcclusionBuffer::GetDepth(uint x, uint y) const
+{
+    HS_ASSERT(x < width_ && y < height_);
+    return depth_[y * width_ + x];
+}
+
+//------------------------------------------------------------------------------
+const OcclusionStats& OcclusionBuffer::GetStats() const
+{
+    return stats_;
+}
+
+}
@@ -14,15 +14,27 @@
 #include "Render/Buffer.h"
 #include "Render/RenderBufferCache.h"
 #include "Render/RenderPassContext.h"
+#include "Render/OcclusionBuffer.h"
+#include "Render/GpuProfiler.h"
+#include "Render/GpuCuller.h"
 #include "Render/Vulkan.h"
 
+#include "Containers/RadixSort.h"
+#include "Math/MathBatch.h"
+#include "Threading/JobSystem.h"
+
 #include "Resources/Serialization.h"
 #include "Input/Input.h"
 
+#include "System/FrameArena.h"
+#include "System/Profiler.h"
+
 #include "Common/Logging.h"
 #include "Common/Assert.h"
 #include "Common/Util.h"
 
+#include "Common.h"
+
 #if HS_WINDOWS
     #include "vulkan/vulkan_win32.h"
 #elif HS_LINUX
@@ -31,9 +43,13 @@
 
 #include "imgui/imgui_impl_vulkan.h"
 
+#include "tinygltf/stb_image_write.h"
+
 #include <malloc.h>
 #include <cstdio>
+#include <cstring>
 #include <cfloat>
+#include <chrono>
 
 #if HS_RENDER_DEBUG
     #define HS_RENDER_VALIDATION 1
@@ -137,11 +153,15 @@ namespace hs
 {
 
 //------------------------------------------------------------------------------
-struct BindingUBO
+//! Push constants of all pipelines, matches BindingConstants in the shaders
+struct BindingConstants
 {
     uint SRV[SRV_SLOT_COUNT]{};
 };
 
+//------------------------------------------------------------------------------
+static constexpr VkShaderStageFlags BINDING_CONSTANTS_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
 #if HS_DEBUG
     //------------------------------------------------------------------------------
     void QueueFamiliesToString(uint bits, char* str)
@@ -176,12 +196,19 @@ VkPhysicalDeviceFeatures CreateRequiredFeatures()
 Render* g_Render;
 
 //------------------------------------------------------------------------------
-RESULT CreateRender(uint width, uint height)
+RESULT CreateRender(uint width, uint height, const RenderConfig& config)
 {
+    if (config.framesInFlight_ < RenderConfig::MIN_FRAMES_IN_FLIGHT || config.framesInFlight_ > RenderConfig::MAX_FRAMES_IN_FLIGHT)
+    {
+        LOG_ERR("Frames in flight must be between %u and %u", RenderConfig::MIN_FRAMES_IN_FLIGHT, RenderConfig::MAX_FRAMES_IN_FLIGHT);
+        return R_FAIL;
+    }
+
     g_Render = new Render();
 
     g_Render->width_ = width;
     g_Render->height_ = height;
+    g_Render->config_ = config;
 
     return R_OK;
 }
@@ -191,6 +218,7 @@ void DestroyRender()
 {
     g_Render->Free();
     delete g_Render;
+    g_Render = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -235,9 +263,9 @@ RESULT Render::OnWindowResized(uint width, uint height)
 {
     FlushGpu<false, true>();
 
-    ClearPipelineCache();
-
-    pipelineCache_.clear();
+    // Viewport is dynamic so pipelines survive the resize, compiles in flight use the render passes though
+    WaitForPipelineCompiles();
+    const VkFormat oldFormat = swapChainFormat_;
 
     DestroySwapchain();
     DestroySurface();
@@ -245,18 +273,15 @@ RESULT Render::OnWindowResized(uint width, uint height)
     width_ = width;
     height_ = height;
 
-    if (HS_FAILED(CreateSurface()))
+    if (!headless_ && HS_FAILED(CreateSurface()))
         return R_FAIL;
 
-    auto oldBBIdx = currentBBIdx_;
-    if (HS_FAILED(CreateSwapchain()))
+    if (HS_FAILED(headless_ ? CreateOffscreenImages() : CreateSwapchain()))
         return R_FAIL;
 
-    // TODO(pavel): This is not nice, we should not use currentBBIdx_ given from vkAcquireNextImageKHR,
-    if (oldBBIdx != currentBBIdx_)
-    {
-        std::swap(directQueueFences_[currentBBIdx_], directQueueFences_[oldBBIdx]);
-    }
+    // Pipelines are compatible with the new render passes unless the format changed
+    if (swapChainFormat_ != oldFormat)
+        ClearPipelineCache();
 
     // TODO(pavel): Is this necessary here? Swapchain format could change so it may be a good idea to do it.
     DestroyRenderPass(mainRenderPass_);
@@ -275,22 +300,13 @@ RESULT Render::OnWindowResized(uint width, uint height)
     if (HS_FAILED(CreateOverlayFrameBuffer()))
         return R_FAIL;
 
-    vkFreeCommandBuffers(vkDevice_, directCmdPool_, BB_IMG_COUNT, directCmdBuffers_);
-
-    VkCommandBufferAllocateInfo cmdBufferInfo{};
-    cmdBufferInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufferInfo.commandPool           = directCmdPool_;
-    cmdBufferInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufferInfo.commandBufferCount    = BB_IMG_COUNT;
-
-    if (VKR_FAILED(vkAllocateCommandBuffers(vkDevice_, &cmdBufferInfo, directCmdBuffers_)))
+    vkFreeCommandBuffers(vkDevice_, directCmdPool_, config_.framesInFlight_, directCmdBuffers_);
+    if (HS_FAILED(AllocateCommandBuffers()))
         return R_FAIL;
 
-    for (int i = 0; i < BB_IMG_COUNT; ++i)
-    {
-        if (VKR_FAILED(SetDiagName(vkDevice_, (uint64)directCmdBuffers_[i], VK_OBJECT_TYPE_COMMAND_BUFFER, "DirectCmdBuffer")))
-            return R_FAIL;
-    }
+    // The old image was given up with the old swapchain
+    if (!AcquireNextImage())
+        return R_FAIL;
 
     //-----------------------
     // Init command buffer
@@ -298,7 +314,7 @@ RESULT Render::OnWindowResized(uint width, uint height)
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[currentBBIdx_], &beginInfo));
+    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[frameIdx_], &beginInfo));
 
     return R_OK;
 }
@@ -353,6 +369,20 @@ RESULT Render::CreateInstance()
         VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
     };
 
+    // No surface in headless mode, GLFW is not even initialized
+    const char* headlessInstanceExt[] =
+    {
+        VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    };
+
+    if (headless_)
+    {
+        instInfo.enabledExtensionCount      = HS_ARR_LEN(headlessInstanceExt);
+        instInfo.ppEnabledExtensionNames    = headlessInstanceExt;
+    }
+    else
+    {
     #if HS_WINDOWS
         instInfo.enabledExtensionCount      = HS_ARR_LEN(instanceExt);
         instInfo.ppEnabledExtensionNames    = instanceExt;
@@ -366,6 +396,7 @@ RESULT Render::CreateInstance()
         instInfo.enabledExtensionCount      = HS_ARR_LEN(instanceExt) + glfwInstanceExtCount;
         instInfo.ppEnabledExtensionNames    = allExtensions;
     #endif
+    }
 
     if (VKR_FAILED(vkCreateInstance(&instInfo, nullptr, &vkInstance_)))
         return R_FAIL;
@@ -437,9 +468,11 @@ RESULT Render::CreateDevice()
 
     for (uint i = 0; i < queueCount; ++i)
     {
-        VkBool32 presentSupport{};
+        // Nothing is presented in headless mode
+        VkBool32 presentSupport = headless_;
         //presentSupport = vkGetPhysicalDeviceWin32PresentationSupportKHR(vkPhysicalDevice_, i);
-        VKR_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(vkPhysicalDevice_, i, vkSurface_, &presentSupport));
+        if (!headless_)
+            VKR_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(vkPhysicalDevice_, i, vkSurface_, &presentSupport));
 
         #if HS_DEBUG
             static char buff[512];
@@ -466,30 +499,51 @@ RESULT Render::CreateDevice()
     queues[0].pQueuePriorities  = prioritites;
 
     // Device
-    VkPhysicalDeviceFeatures features{};
-    vkGetPhysicalDeviceFeatures(vkPhysicalDevice_, &features);
+    VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(vkPhysicalDevice_, &supportedFeatures);
+    const VkPhysicalDeviceFeatures& features = supportedFeatures.features;
     // TODO check if the device has all required featues
 
     VkPhysicalDeviceFeatures deviceFeatures = CreateRequiredFeatures();
 
+    // Indirect draws work without them, just with more commands
+    multiDrawIndirect_ = features.multiDrawIndirect;
+    drawIndirectFirstInstance_ = features.drawIndirectFirstInstance;
+    deviceFeatures.multiDrawIndirect = features.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+
     const char* deviceExt[] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
-    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
-    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
-    descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind      = VK_TRUE;
-    descriptorIndexingFeatures.descriptorBindingPartiallyBound                   = VK_TRUE;
-    descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount          = VK_TRUE;
-    descriptorIndexingFeatures.runtimeDescriptorArray                            = VK_TRUE;
-    descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing         = VK_TRUE;
+    // Vulkan 1.2 features must all go through this struct, the per-feature structs may not be chained with it
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.descriptorBindingSampledImageUpdateAfterBind     = VK_TRUE;
+    features12.descriptorBindingPartiallyBound                  = VK_TRUE;
+    features12.descriptorBindingVariableDescriptorCount         = VK_TRUE;
+    features12.runtimeDescriptorArray                           = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing        = VK_TRUE;
+
+    #if defined(VKR_USE_TIMELINE_SEMAPHORES)
+        features12.timelineSemaphore = VK_TRUE;
+    #endif
+
+    // GPU culled draws keep the commands of culled objects without it
+    drawIndirectCount_ = supportedFeatures12.drawIndirectCount;
+    features12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
 
     VkDeviceCreateInfo deviceInfo{};
     deviceInfo.sType                    = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceInfo.pNext                    = &descriptorIndexingFeatures;
+    deviceInfo.pNext                    = &features12;
     deviceInfo.queueCreateInfoCount     = 1;
     deviceInfo.pQueueCreateInfos        = queues;
-    deviceInfo.enabledExtensionCount    = HS_ARR_LEN(deviceExt);
+    deviceInfo.enabledExtensionCount    = headless_ ? 0 : HS_ARR_LEN(deviceExt);
     deviceInfo.ppEnabledExtensionNames  = deviceExt;
     deviceInfo.pEnabledFeatures         = &deviceFeatures;
 
@@ -543,26 +597,42 @@ RESULT Render::CreateSwapchain()
     if (VKR_FAILED(vkGetPhysicalDeviceSurfacePresentModesKHR(vkPhysicalDevice_, vkSurface_, &presentModeCount, presentModes)))
         return R_FAIL;
 
+    VkPresentModeKHR vkPresentMode{};
+    switch (config_.presentMode_)
+    {
+        case PresentMode::Fifo:         vkPresentMode = VK_PRESENT_MODE_FIFO_KHR; break;
+        case PresentMode::Mailbox:      vkPresentMode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case PresentMode::Immediate:    vkPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+    }
+
     bool modeFound = false;
     for (uint i = 0; !modeFound && i < presentModeCount; ++i)
     {
-        if (presentModes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        if (presentModes[i] == vkPresentMode)
             modeFound = true;
     }
 
+    presentMode_ = config_.presentMode_;
     if (!modeFound)
     {
-        Log(LogLevel::Error, "VK_PRESENT_MODE_IMMEDIATE_KHR not supported");
-        return R_FAIL;
+        // FIFO support is required by the spec
+        LOG_WARN("Requested present mode %d not supported, using FIFO", (int)config_.presentMode_);
+        vkPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        presentMode_ = PresentMode::Fifo;
     }
 
     vkSurfaceCapabilities_ = {};
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vkPhysicalDevice_, vkSurface_, &vkSurfaceCapabilities_);
 
+    // Mailbox needs a third image to always have one to render to
+    uint minImageCount = Max(vkSurfaceCapabilities_.minImageCount, presentMode_ == PresentMode::Mailbox ? 3u : 2u);
+    if (vkSurfaceCapabilities_.maxImageCount)
+        minImageCount = Min(minImageCount, vkSurfaceCapabilities_.maxImageCount);
+
     VkSwapchainCreateInfoKHR swapchainInfo{};
     swapchainInfo.sType             = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     swapchainInfo.surface           = vkSurface_;
-    swapchainInfo.minImageCount     = 2;
+    swapchainInfo.minImageCount     = minImageCount;
     swapchainInfo.imageFormat       = swapChainFormat_ = VK_FORMAT_B8G8R8A8_SRGB;
     swapchainInfo.imageColorSpace   = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
     swapchainInfo.imageExtent       = VkExtent2D{ width_, height_ };
@@ -571,7 +641,7 @@ RESULT Render::CreateSwapchain()
     swapchainInfo.imageSharingMode  = VK_SHARING_MODE_EXCLUSIVE; // We assume the same queue will draw and present
     swapchainInfo.preTransform      = vkSurfaceCapabilities_.currentTransform;
     swapchainInfo.compositeAlpha    = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchainInfo.presentMode       = VK_PRESENT_MODE_IMMEDIATE_KHR; //VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    swapchainInfo.presentMode       = vkPresentMode;
     swapchainInfo.clipped           = VK_FALSE; // Just to be safe VK_TRUE if we know we will never read the buffers back
 
     if (VKR_FAILED(vkCreateSwapchainKHR(vkDevice_, &swapchainInfo, nullptr, &vkSwapchain_)))
@@ -583,20 +653,55 @@ RESULT Render::CreateSwapchain()
     if (VKR_FAILED(vkGetSwapchainImagesKHR(vkDevice_, vkSwapchain_, &swapchainImageCount, nullptr)))
         return R_FAIL;
 
-    HS_ASSERT(swapchainImageCount == 2 && "We kind of assume 2 is the number");
+    if (swapchainImageCount > MAX_SWAPCHAIN_IMAGES)
+    {
+        LOG_ERR("Swapchain has %u images, at most %u are supported", swapchainImageCount, MAX_SWAPCHAIN_IMAGES);
+        return R_FAIL;
+    }
 
     if (VKR_FAILED(vkGetSwapchainImagesKHR(vkDevice_, vkSwapchain_, &swapchainImageCount, bbImages_)))
         return R_FAIL;
+    swapchainImageCount_ = swapchainImageCount;
 
-    if (VKR_FAILED(vkAcquireNextImageKHR(vkDevice_, vkSwapchain_, (uint64)-1, VK_NULL_HANDLE, nextImageFence_, &currentBBIdx_)))
-        return R_FAIL;
+    return CreateBackBufferViews();
+}
 
-    if (HS_FAILED(WaitForFence(nextImageFence_)))
-        return R_FAIL;
+//------------------------------------------------------------------------------
+RESULT Render::CreateOffscreenImages()
+{
+    // Frame slot i always renders to image i, waiting for the slot makes its image free to reuse
+    swapchainImageCount_ = config_.framesInFlight_;
+    // RGBA so captures can be written as they are read back
+    swapChainFormat_ = VK_FORMAT_R8G8B8A8_SRGB;
 
-    //-----------------------
-    // Create swapchain views
-    for (int i = 0; i < BB_IMG_COUNT; ++i)
+    for (uint i = 0; i < swapchainImageCount_; ++i)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+        imageInfo.format        = swapChainFormat_;
+        imageInfo.extent        = VkExtent3D{ width_, height_, 1 };
+        imageInfo.mipLevels     = 1;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage         = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        if (VKR_FAILED(vmaCreateImage(allocator_, &imageInfo, &allocInfo, &bbImages_[i], &bbMemory_[i], nullptr)))
+            return R_FAIL;
+    }
+
+    return CreateBackBufferViews();
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::CreateBackBufferViews()
+{
+    for (uint i = 0; i < swapchainImageCount_; ++i)
     {
         VkImageSubresourceRange subresource{};
         subresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -693,13 +798,14 @@ RESULT Render::CreateMainRenderPass()
     subpass.pColorAttachments       = &colorAttachmentRef;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    /*VkSubpassDependency dependency{};
+    // The layout transition has to wait for the acquire semaphore which is waited on at color output
+    VkSubpassDependency dependency{};
     dependency.srcSubpass       = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass       = 0;
     dependency.srcStageMask     = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependency.srcAccessMask    = 0;
     dependency.dstStageMask     = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;*/
+    dependency.dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
     VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
     VkRenderPassCreateInfo renderPassInfo{};
@@ -708,8 +814,8 @@ RESULT Render::CreateMainRenderPass()
     renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    //renderPassInfo.dependencyCount = 1;
-    //renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
 
     HS_ASSERT(!mainRenderPass_);
 
@@ -722,7 +828,7 @@ RESULT Render::CreateMainRenderPass()
 //------------------------------------------------------------------------------
 RESULT Render::CreateMainFrameBuffer()
 {
-    for (int bbIdx = 0; bbIdx < BB_IMG_COUNT; ++bbIdx)
+    for (uint bbIdx = 0; bbIdx < swapchainImageCount_; ++bbIdx)
     {
         VkImageView viewAttachments[] = { bbViews_[bbIdx], depthViews_[bbIdx] };
 
@@ -754,7 +860,7 @@ RESULT Render::CreateOverlayRenderPass()
     colorAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout     = headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment   = 0;
@@ -769,6 +875,15 @@ RESULT Render::CreateOverlayRenderPass()
     subpass.colorAttachmentCount    = 1;
     subpass.pColorAttachments       = &colorAttachmentRef;
 
+    // Headless frames may be copied out for a capture right after the pass
+    VkSubpassDependency captureDependency{};
+    captureDependency.srcSubpass    = 0;
+    captureDependency.dstSubpass    = VK_SUBPASS_EXTERNAL;
+    captureDependency.srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    captureDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    captureDependency.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    captureDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
     VkAttachmentDescription attachments[] = { colorAttachment };
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -776,6 +891,8 @@ RESULT Render::CreateOverlayRenderPass()
     renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = headless_ ? 1 : 0;
+    renderPassInfo.pDependencies = &captureDependency;
 
     HS_ASSERT(!overlayRenderPass_);
 
@@ -788,7 +905,7 @@ RESULT Render::CreateOverlayRenderPass()
 //------------------------------------------------------------------------------
 RESULT Render::CreateOverlayFrameBuffer()
 {
-    for (int bbIdx = 0; bbIdx < BB_IMG_COUNT; ++bbIdx)
+    for (uint bbIdx = 0; bbIdx < swapchainImageCount_; ++bbIdx)
     {
         VkImageView viewAttachments[] = { bbViews_[bbIdx] };
 
@@ -825,7 +942,7 @@ void Render::DestroySwapchain()
     vkDestroySwapchainKHR(vkDevice_, vkSwapchain_, nullptr);
     vkSwapchain_ = VK_NULL_HANDLE;
 
-    for (int bbIdx = 0; bbIdx < BB_IMG_COUNT; ++bbIdx)
+    for (uint bbIdx = 0; bbIdx < swapchainImageCount_; ++bbIdx)
     {
         vkDestroyImageView(vkDevice_, bbViews_[bbIdx], nullptr);
         bbViews_[bbIdx] = VK_NULL_HANDLE;
@@ -834,6 +951,15 @@ void Render::DestroySwapchain()
         depthViews_[bbIdx] = VK_NULL_HANDLE;
 
         vmaDestroyImage(allocator_, depthImages_[bbIdx], depthMemory_[bbIdx]);
+        depthImages_[bbIdx] = VK_NULL_HANDLE;
+
+        // Swapchain images are owned by the swapchain
+        if (bbMemory_[bbIdx])
+        {
+            vmaDestroyImage(allocator_, bbImages_[bbIdx], bbMemory_[bbIdx]);
+            bbMemory_[bbIdx] = VK_NULL_HANDLE;
+        }
+        bbImages_[bbIdx] = VK_NULL_HANDLE;
     }
 }
 
@@ -850,7 +976,8 @@ void Render::DestroyRenderPass(VkRenderPass& renderPass)
 //------------------------------------------------------------------------------
 void Render::DestroyFrameBuffer(VkFramebuffer* frameBufferArr)
 {
-    for (int bbIdx = 0; bbIdx < BB_IMG_COUNT; ++bbIdx)
+    // The image count may have changed with the new swapchain
+    for (uint bbIdx = 0; bbIdx < MAX_SWAPCHAIN_IMAGES; ++bbIdx)
     {
         if (frameBufferArr[bbIdx])
         {
@@ -873,10 +1000,429 @@ RESULT Render::CompileShaders()
 //------------------------------------------------------------------------------
 void Render::ClearPipelineCache()
 {
+    // Compiles in flight use the old shaders or dimensions
+    WaitForPipelineCompiles();
+    CollectCompiledPipelines();
+
     for (auto pl : pipelineCache_)
-        destroyPipelines_[currentBBIdx_].Add(pl.second);
+        destroyPipelines_[frameIdx_].Add(pl.second);
 
     pipelineCache_.clear();
+    // Failed pipelines are tried again, the reload may have fixed their shaders
+    failedPipelines_.clear();
+    AtomicIncrement(&pipelineCacheGen_);
+}
+
+//------------------------------------------------------------------------------
+void Render::PrewarmPipeline(RenderPassType passType)
+{
+    RenderPassContext ctx{};
+    ctx.passType_ = passType;
+    ctx.renderPass_ = GetRenderPass(passType);
+
+    FindOrCompilePipeline(ctx, GetRecorder().state_);
+}
+
+//------------------------------------------------------------------------------
+void Render::SetPipelineFallback(RenderPassType passType, Shader* vert, Shader* frag)
+{
+    fallbackShaders_[passType][PS_VERT] = vert;
+    fallbackShaders_[passType][PS_FRAG] = frag;
+
+    PrewarmPipeline(passType);
+}
+
+//------------------------------------------------------------------------------
+void Render::WaitForPipelineCompiles()
+{
+    if (g_JobSystem)
+        g_JobSystem->Wait(&pipelineCompiles_);
+}
+
+//------------------------------------------------------------------------------
+VkRenderPass Render::GetRenderPass(RenderPassType passType) const
+{
+    return passType == RPT_OVERLAY ? overlayRenderPass_ : mainRenderPass_;
+}
+
+//------------------------------------------------------------------------------
+void Render::CompilePipelineJob(void* data)
+{
+    HS_PROFILE_SCOPE("CompilePipeline");
+
+    auto compile = static_cast<PipelineCompile*>(data);
+    compile->pipeline_ = compile->render_->CreatePipeline(compile->desc_);
+    AtomicStore(&compile->done_, 1);
+}
+
+//------------------------------------------------------------------------------
+VkPipeline Render::FindOrCompilePipeline(const RenderPassContext& ctx, const RenderState& state)
+{
+    const PipelineKey plKey = StateToPipelineKey(ctx, state);
+
+    // Draws are sorted by pipeline so most of them use the pipeline of the previous draw
+    CommandRecorder& rec = GetRecorder();
+    const int cacheGen = AtomicLoad(&pipelineCacheGen_);
+    if (rec.lastPipeline_ && rec.lastPipelineKey_ == plKey && rec.lastPipelineGen_ == cacheGen)
+        return rec.lastPipeline_;
+
+    std::lock_guard<std::mutex> lock(pipelineLock_);
+
+    auto cachedPl = pipelineCache_.find(plKey);
+    if (cachedPl != pipelineCache_.end())
+    {
+        rec.lastPipelineKey_ = plKey;
+        rec.lastPipeline_ = cachedPl->second;
+        rec.lastPipelineGen_ = cacheGen;
+        return cachedPl->second;
+    }
+
+    if (failedPipelines_.count(plKey))
+        return VK_NULL_HANDLE;
+
+    auto pending = pendingPipelines_.find(plKey);
+    if (pending != pendingPipelines_.end())
+    {
+        PipelineCompile* compile = pending->second;
+        if (!AtomicLoad(&compile->done_))
+            return VK_NULL_HANDLE;
+
+        const VkPipeline pipeline = compile->pipeline_;
+        AddCompiledPipeline(plKey, pipeline);
+        pendingPipelines_.erase(pending);
+        delete compile;
+        return pipeline;
+    }
+
+    ++rec.stats_.pipelineCreates_;
+    AddToPipelineManifest(ctx, state);
+
+    if (nullBackend_)
+    {
+        const VkPipeline pipeline = MakeNullHandle<VkPipeline>();
+        AddCompiledPipeline(plKey, pipeline);
+        return pipeline;
+    }
+
+    // Without workers nobody would pick the job up until the next wait
+    if (!g_JobSystem || g_JobSystem->GetThreadCount() <= 1)
+    {
+        const VkPipeline pipeline = CreatePipeline(MakePipelineDesc(ctx, state));
+        AddCompiledPipeline(plKey, pipeline);
+        return pipeline;
+    }
+
+    PipelineCompile* compile = new PipelineCompile();
+    compile->render_ = this;
+    compile->desc_ = MakePipelineDesc(ctx, state);
+    pendingPipelines_.emplace(plKey, compile);
+
+    g_JobSystem->Run(JobDecl{ &CompilePipelineJob, compile }, &pipelineCompiles_);
+
+    return VK_NULL_HANDLE;
+}
+
+//------------------------------------------------------------------------------
+void Render::AddCompiledPipeline(PipelineKey key, VkPipeline pipeline)
+{
+    if (pipeline)
+    {
+        pipelineCache_.emplace(key, pipeline);
+        return;
+    }
+
+    // Logged once, the draws are skipped without trying to create it again
+    if (failedPipelines_.insert(key).second)
+        LOG_ERR("Failed to create pipeline %llx, draws using it are skipped until the pipeline cache is cleared", (unsigned long long)key);
+}
+
+//------------------------------------------------------------------------------
+void Render::CollectCompiledPipelines()
+{
+    for (auto it = pendingPipelines_.begin(); it != pendingPipelines_.end();)
+    {
+        PipelineCompile* compile = it->second;
+        if (!AtomicLoad(&compile->done_))
+        {
+            ++it;
+            continue;
+        }
+
+        AddCompiledPipeline(it->first, compile->pipeline_);
+        delete compile;
+        it = pendingPipelines_.erase(it);
+    }
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::LoadPipelineCache()
+{
+    Array<uint8> cacheData;
+    Array<PipelineManifestEntry> manifest;
+
+    FILE* f = fopen(PIPELINE_CACHE_FILE, "rb");
+    if (f)
+    {
+        PipelineCacheHeader header{};
+        bool valid = fread(&header, sizeof(header), 1, f) == 1
+            && header.magic_ == PIPELINE_CACHE_MAGIC
+            && header.version_ == PIPELINE_CACHE_VERSION;
+
+        if (valid)
+        {
+            cacheData.Reserve(header.cacheDataSize_);
+            for (uint i = 0; i < header.cacheDataSize_; ++i)
+                cacheData.Add(0);
+            manifest.Reserve(header.manifestCount_);
+            for (uint i = 0; i < header.manifestCount_; ++i)
+                manifest.Add(PipelineManifestEntry{});
+
+            valid = fread(cacheData.Data(), 1, cacheData.Count(), f) == (size_t)cacheData.Count()
+                && fread(manifest.Data(), sizeof(PipelineManifestEntry), manifest.Count(), f) == (size_t)manifest.Count();
+        }
+        fclose(f);
+
+        if (!valid)
+        {
+            LOG_WARN("Pipeline cache %s is corrupted or outdated, ignoring it", PIPELINE_CACHE_FILE);
+            cacheData.Clear();
+            manifest.Clear();
+        }
+        else if (header.vendorId_ != vkPhysicalDeviceProperties_.vendorID
+            || header.deviceId_ != vkPhysicalDeviceProperties_.deviceID
+            || header.driverVersion_ != vkPhysicalDeviceProperties_.driverVersion
+            || memcmp(header.pipelineCacheUuid_, vkPhysicalDeviceProperties_.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            // The driver would reject the data anyway, the manifest is still good for pre-creating
+            LOG_DBG("Pipeline cache was created by a different device or driver, dropping its data");
+            cacheData.Clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType             = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize   = cacheData.Count();
+    cacheInfo.pInitialData      = cacheData.IsEmpty() ? nullptr : cacheData.Data();
+
+    if (VKR_FAILED(vkCreatePipelineCache(vkDevice_, &cacheInfo, nullptr, &vkPipelineCache_)))
+    {
+        // Data passed the header checks but the driver still refused it, start empty
+        cacheInfo.initialDataSize   = 0;
+        cacheInfo.pInitialData      = nullptr;
+        if (VKR_FAILED(vkCreatePipelineCache(vkDevice_, &cacheInfo, nullptr, &vkPipelineCache_)))
+            return R_FAIL;
+    }
+
+    PrecreatePipelines(MakeSpan(manifest));
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+bool Render::IsManifestEntryValid(const PipelineManifestEntry& entry) const
+{
+    if (entry.bindingCount_ > RenderState::MAX_VERT_BUFF
+        || entry.attributeCount_ > MAX_VERT_ATTRIBUTES
+        || entry.primitiveTopology_ > (uint)VkrPrimitiveTopology::PATCH_LIST
+        || (entry.depthState_ & ~(uint)(DS_TEST | DS_WRITE))
+        || entry.cullMode_ > (uint)VkrCullMode::None
+        || entry.blendMode_ >= BM_COUNT)
+    {
+        return false;
+    }
+
+    // The null backend creates no render passes
+    if (entry.passType_ >= RPT_COUNT || (!nullBackend_ && !GetRenderPass((RenderPassType)entry.passType_)))
+        return false;
+
+    for (int s = 0; s < PS_COUNT; ++s)
+    {
+        if (!memchr(entry.shaders_[s], 0, MAX_SHADER_NAME))
+            return false;
+    }
+
+    for (uint b = 0; b < entry.bindingCount_; ++b)
+    {
+        if (entry.bindings_[b].binding >= RenderState::MAX_VERT_BUFF || entry.bindings_[b].inputRate > VK_VERTEX_INPUT_RATE_INSTANCE)
+            return false;
+    }
+
+    // Each attribute must read one of the entry's bindings
+    for (uint a = 0; a < entry.attributeCount_; ++a)
+    {
+        const VkVertexInputAttributeDescription& attribute = entry.attributes_[a];
+        if (attribute.format == VK_FORMAT_UNDEFINED)
+            return false;
+
+        bool hasBinding = false;
+        for (uint b = 0; b < entry.bindingCount_; ++b)
+            hasBinding |= entry.bindings_[b].binding == attribute.binding;
+        if (!hasBinding)
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+uint Render::PrecreatePipelines(Span<const PipelineManifestEntry> entries)
+{
+    uint created = 0;
+    for (uint64 i = 0; i < entries.Count(); ++i)
+    {
+        const PipelineManifestEntry& entry = entries[i];
+        if (!IsManifestEntryValid(entry))
+            continue;
+
+        mainRecorder_.state_.Reset();
+
+        bool shadersValid = true;
+        for (int s = 0; s < PS_COUNT; ++s)
+        {
+            if (!entry.shaders_[s][0])
+                continue;
+
+            // The shader could have been renamed or removed since the manifest was saved, or
+            // its name now belongs to a shader of another stage
+            Shader* shader = shaderManager_->GetOrCreateShader(entry.shaders_[s]);
+            shadersValid &= shader && shader->type_ == (PipelineStage)s;
+            mainRecorder_.state_.shaders_[s] = shader;
+        }
+        if (!shadersValid)
+            continue;
+
+        if (entry.bindingCount_ || entry.attributeCount_)
+        {
+            VertexLayoutStorage* storage = new VertexLayoutStorage{};
+            memcpy(storage->bindings_, entry.bindings_, sizeof(storage->bindings_));
+            memcpy(storage->attributes_, entry.attributes_, sizeof(storage->attributes_));
+
+            VkPipelineVertexInputStateCreateInfo layout{};
+            layout.sType                            = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            layout.vertexBindingDescriptionCount    = entry.bindingCount_;
+            layout.pVertexBindingDescriptions       = storage->bindings_;
+            layout.vertexAttributeDescriptionCount  = entry.attributeCount_;
+            layout.pVertexAttributeDescriptions     = storage->attributes_;
+
+            const int layoutCount = vertexLayouts_.Count();
+            mainRecorder_.state_.vertexLayouts_[0] = GetOrCreateVertexLayout(layout);
+            if (vertexLayouts_.Count() != layoutCount)
+                vertexLayoutStorage_.Add(storage);
+            else
+                delete storage;
+        }
+
+        mainRecorder_.state_.primitiveTopology_ = (VkrPrimitiveTopology)entry.primitiveTopology_;
+        mainRecorder_.state_.depthState_ = entry.depthState_;
+        mainRecorder_.state_.cullMode_ = (VkrCullMode)entry.cullMode_;
+        mainRecorder_.state_.blendMode_ = (BlendMode)entry.blendMode_;
+
+        // Entries still valid are added back to the manifest
+        PrewarmPipeline((RenderPassType)entry.passType_);
+        ++created;
+    }
+
+    mainRecorder_.state_.Reset();
+
+    if (created != entries.Count())
+        LOG_DBG("Skipped %llu stale pipeline manifest entries", (unsigned long long)(entries.Count() - created));
+
+    return created;
+}
+
+//------------------------------------------------------------------------------
+Span<const Render::PipelineManifestEntry> Render::GetPipelineManifest() const
+{
+    return MakeSpan<const PipelineManifestEntry>(pipelineManifest_.Data(), pipelineManifest_.Count());
+}
+
+//------------------------------------------------------------------------------
+void Render::AddToPipelineManifest(const RenderPassContext& ctx, const RenderState& state)
+{
+    PipelineManifestEntry entry{};
+
+    for (int s = 0; s < PS_COUNT; ++s)
+    {
+        if (!state.shaders_[s])
+            continue;
+
+        const char* name = state.shaders_[s]->name_.Data();
+        // Shaders with names not fitting the entry are not persisted
+        if (strlen(name) >= MAX_SHADER_NAME)
+            return;
+        strcpy(entry.shaders_[s], name);
+    }
+
+    if (state.vertexLayouts_[0] != RenderState::INVALID_HANDLE)
+    {
+        const VkPipelineVertexInputStateCreateInfo& layout = vertexLayouts_[state.vertexLayouts_[0]];
+        if (layout.vertexBindingDescriptionCount > RenderState::MAX_VERT_BUFF
+            || layout.vertexAttributeDescriptionCount > MAX_VERT_ATTRIBUTES)
+        {
+            return;
+        }
+
+        entry.bindingCount_ = layout.vertexBindingDescriptionCount;
+        entry.attributeCount_ = layout.vertexAttributeDescriptionCount;
+        memcpy(entry.bindings_, layout.pVertexBindingDescriptions, entry.bindingCount_ * sizeof(VkVertexInputBindingDescription));
+        memcpy(entry.attributes_, layout.pVertexAttributeDescriptions, entry.attributeCount_ * sizeof(VkVertexInputAttributeDescription));
+    }
+
+    entry.primitiveTopology_ = (uint)state.primitiveTopology_;
+    entry.passType_ = ctx.passType_;
+    entry.depthState_ = state.depthState_;
+    entry.cullMode_ = (uint)state.cullMode_;
+    entry.blendMode_ = state.blendMode_;
+
+    // Same state can miss again after the cache is cleared by a resize or shader reload
+    for (int i = 0; i < pipelineManifest_.Count(); ++i)
+    {
+        if (memcmp(&pipelineManifest_[i], &entry, sizeof(entry)) == 0)
+            return;
+    }
+
+    pipelineManifest_.Add(entry);
+}
+
+//------------------------------------------------------------------------------
+void Render::SavePipelineCache()
+{
+    if (!vkPipelineCache_)
+        return;
+
+    size_t dataSize = 0;
+    Array<uint8> cacheData;
+    if (vkGetPipelineCacheData(vkDevice_, vkPipelineCache_, &dataSize, nullptr) == VK_SUCCESS)
+    {
+        cacheData.Reserve((int)dataSize);
+        for (size_t i = 0; i < dataSize; ++i)
+            cacheData.Add(0);
+
+        if (vkGetPipelineCacheData(vkDevice_, vkPipelineCache_, &dataSize, cacheData.Data()) != VK_SUCCESS)
+            cacheData.Clear();
+    }
+
+    PipelineCacheHeader header{};
+    header.magic_           = PIPELINE_CACHE_MAGIC;
+    header.version_         = PIPELINE_CACHE_VERSION;
+    header.vendorId_        = vkPhysicalDeviceProperties_.vendorID;
+    header.deviceId_        = vkPhysicalDeviceProperties_.deviceID;
+    header.driverVersion_   = vkPhysicalDeviceProperties_.driverVersion;
+    memcpy(header.pipelineCacheUuid_, vkPhysicalDeviceProperties_.pipelineCacheUUID, VK_UUID_SIZE);
+    header.cacheDataSize_   = cacheData.Count();
+    header.manifestCount_   = pipelineManifest_.Count();
+
+    FILE* f = fopen(PIPELINE_CACHE_FILE, "wb");
+    if (!f)
+    {
+        LOG_WARN("Failed to open pipeline cache %s for writing", PIPELINE_CACHE_FILE);
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(cacheData.Data(), 1, cacheData.Count(), f);
+    fwrite(pipelineManifest_.Data(), sizeof(PipelineManifestEntry), pipelineManifest_.Count(), f);
+    fclose(f);
 }
 
 //------------------------------------------------------------------------------
@@ -919,6 +1465,9 @@ void Render::TransitionBarrier(
     VkImageLayout layoutBefore, VkImageLayout layoutAfter,
     VkPipelineStageFlags stageBefore, VkPipelineStageFlags stageAfter)
 {
+    if (nullBackend_)
+        return;
+
     VkImageMemoryBarrier barrier{};
     barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.srcAccessMask       = accessBefore;
@@ -959,6 +1508,15 @@ RESULT Render::InitWin32(HWND hwnd, HINSTANCE hinst)
     }
 #endif
 
+//------------------------------------------------------------------------------
+RESULT Render::InitHeadless()
+{
+    headless_ = true;
+
+    RESULT res = Init();
+    return res;
+}
+
 //------------------------------------------------------------------------------
 RESULT Render::Init()
 {
@@ -966,7 +1524,7 @@ RESULT Render::Init()
     if (HS_FAILED(CreateInstance()))
         return R_FAIL;
 
-    if (HS_FAILED(CreateSurface()))
+    if (!headless_ && HS_FAILED(CreateSurface()))
         return R_FAIL;
 
     if (HS_FAILED(FindPhysicalDevice()))
@@ -989,37 +1547,57 @@ RESULT Render::Init()
 
     //-----------------------
     // Create fences
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    #if defined(VKR_USE_TIMELINE_SEMAPHORES)
+        VkSemaphoreTypeCreateInfo timelineInfo{};
+        timelineInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType  = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue   = 0;
 
-    for (int i = 0; i < BB_IMG_COUNT; ++i)
-    {
-        if (VKR_FAILED(vkCreateFence(vkDevice_, &fenceInfo, nullptr, &directQueueFences_[i])))
+        VkSemaphoreCreateInfo timelineCreate{};
+        timelineCreate.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        timelineCreate.pNext = &timelineInfo;
+
+        if (VKR_FAILED(vkCreateSemaphore(vkDevice_, &timelineCreate, nullptr, &directQueueSemaphore_)))
             return R_FAIL;
-    }
+    #else
+        // Frame slots not used yet have nothing to wait for
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    fenceInfo.flags = 0;
-    if (VKR_FAILED(vkCreateFence(vkDevice_, &fenceInfo, nullptr, &nextImageFence_)))
-        return R_FAIL;
+        for (uint i = 0; i < config_.framesInFlight_; ++i)
+        {
+            if (VKR_FAILED(vkCreateFence(vkDevice_, &fenceInfo, nullptr, &directQueueFences_[i])))
+                return R_FAIL;
+        }
+
+        // The first frame is recorded right away
+        if (VKR_FAILED(vkResetFences(vkDevice_, 1, &directQueueFences_[frameIdx_])))
+            return R_FAIL;
+    #endif
 
     //-----------------------
     // Create semaphores
     VkSemaphoreCreateInfo semaphoreCreate{};
     semaphoreCreate.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    for (int i = 0; i < BB_IMG_COUNT; ++i)
+    for (uint i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i)
     {
         if (VKR_FAILED(vkCreateSemaphore(vkDevice_, &semaphoreCreate, nullptr, &submitSemaphores_[i])))
             return R_FAIL;
     }
 
+    for (uint i = 0; i < config_.framesInFlight_; ++i)
+    {
+        if (VKR_FAILED(vkCreateSemaphore(vkDevice_, &semaphoreCreate, nullptr, &acquireSemaphores_[i])))
+            return R_FAIL;
+    }
+
     //-----------------------
-    if (HS_FAILED(CreateSwapchain()))
+    if (HS_FAILED(headless_ ? CreateOffscreenImages() : CreateSwapchain()))
         return R_FAIL;
 
-    // All backbuffers are ready except for the current one we will use right away
-    if (VKR_FAILED(vkResetFences(vkDevice_, 1, &directQueueFences_[currentBBIdx_])))
+    if (!AcquireNextImage())
         return R_FAIL;
 
     //-----------------------
@@ -1032,19 +1610,29 @@ RESULT Render::Init()
     if (VKR_FAILED(vkCreateCommandPool(vkDevice_, &directPoolInfo, nullptr, &directCmdPool_)))
         return R_FAIL;
 
-    VkCommandBufferAllocateInfo cmdBufferInfo{};
-    cmdBufferInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufferInfo.commandPool           = directCmdPool_;
-    cmdBufferInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufferInfo.commandBufferCount    = BB_IMG_COUNT;
-
-    if (VKR_FAILED(vkAllocateCommandBuffers(vkDevice_, &cmdBufferInfo, directCmdBuffers_)))
+    if (HS_FAILED(AllocateCommandBuffers()))
         return R_FAIL;
 
-    for (int i = 0; i < BB_IMG_COUNT; ++i)
+    // One pool per chunk and frame, pools may not be used from several threads at once
+    VkCommandPoolCreateInfo chunkPoolInfo = directPoolInfo;
+    chunkPoolInfo.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (uint f = 0; f < config_.framesInFlight_; ++f)
     {
-        if (VKR_FAILED(SetDiagName(vkDevice_, (uint64)directCmdBuffers_[i], VK_OBJECT_TYPE_COMMAND_BUFFER, "DirectCmdBuffer")))
-            return R_FAIL;
+        for (uint i = 0; i < MAX_RECORD_CHUNKS; ++i)
+        {
+            if (VKR_FAILED(vkCreateCommandPool(vkDevice_, &chunkPoolInfo, nullptr, &chunkCmdPools_[f][i])))
+                return R_FAIL;
+
+            VkCommandBufferAllocateInfo chunkBufferInfo{};
+            chunkBufferInfo.sType               = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            chunkBufferInfo.commandPool         = chunkCmdPools_[f][i];
+            chunkBufferInfo.level               = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            chunkBufferInfo.commandBufferCount  = 1;
+
+            if (VKR_FAILED(vkAllocateCommandBuffers(vkDevice_, &chunkBufferInfo, &chunkCmdBuffers_[f][i])))
+                return R_FAIL;
+        }
     }
 
     //-----------------------
@@ -1053,7 +1641,7 @@ RESULT Render::Init()
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[currentBBIdx_], &beginInfo));
+    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[frameIdx_], &beginInfo));
 
     //-----------------------
     // Pipeline layout
@@ -1158,21 +1746,15 @@ RESULT Render::Init()
     if (VKR_FAILED(vkCreateDescriptorSetLayout(vkDevice_, &bindlessSrv, nullptr, &bindlessTexturesLayout_)))
         return R_FAIL;
 
-    // UBO
-    VkDescriptorSetLayoutBinding uboBindings[DYNAMIC_UBO_COUNT + 1]{};
-    uboBindings[0].binding             = 0;
-    uboBindings[0].descriptorType      = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    uboBindings[0].descriptorCount     = 1;
-    uboBindings[0].stageFlags          = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
-
-    uboBindings[1] = uboBindings[0];
-    uboBindings[1].binding             = 1;
-
-    uboBindings[2] = uboBindings[0];
-    uboBindings[2].binding             = 2;
-
-    uboBindings[3] = uboBindings[0];
-    uboBindings[3].binding             = 3;
+    // UBO, binding 0 used to hold the bindless indices which are push constants now
+    VkDescriptorSetLayoutBinding uboBindings[DYNAMIC_UBO_COUNT]{};
+    for (uint i = 0; i < DYNAMIC_UBO_COUNT; ++i)
+    {
+        uboBindings[i].binding             = i + 1;
+        uboBindings[i].descriptorType      = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        uboBindings[i].descriptorCount     = 1;
+        uboBindings[i].stageFlags          = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    }
 
     VkDescriptorSetLayoutCreateInfo dynamicUbo{};
     dynamicUbo.sType           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1188,9 +1770,16 @@ RESULT Render::Init()
         dynamicUBOLayout_,
     };
 
+    VkPushConstantRange bindingConstants{};
+    bindingConstants.stageFlags = BINDING_CONSTANTS_STAGES;
+    bindingConstants.offset     = 0;
+    bindingConstants.size       = sizeof(BindingConstants);
+
     VkPipelineLayoutCreateInfo plLayoutInfo{};
-    plLayoutInfo.setLayoutCount = HS_ARR_LEN(descLayouts);
-    plLayoutInfo.pSetLayouts    = descLayouts;
+    plLayoutInfo.setLayoutCount         = HS_ARR_LEN(descLayouts);
+    plLayoutInfo.pSetLayouts            = descLayouts;
+    plLayoutInfo.pushConstantRangeCount = 1;
+    plLayoutInfo.pPushConstantRanges    = &bindingConstants;
 
     plLayoutInfo.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     if (VKR_FAILED(vkCreatePipelineLayout(vkDevice_, &plLayoutInfo, nullptr, &pipelineLayout_)))
@@ -1250,23 +1839,47 @@ RESULT Render::Init()
 
     // Dynamic UBO
     {
+        constexpr uint MAX_UBO_SETS = 1024;
+
         VkDescriptorPoolSize dynUboSizes[1]{};
-        dynUboSizes[0].type              = VK_DESCRIPTOR_TYPE_SAMPLER;
-        dynUboSizes[0].descriptorCount   = DYNAMIC_UBO_COUNT + 1;
+        dynUboSizes[0].type              = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        dynUboSizes[0].descriptorCount   = MAX_UBO_SETS * DYNAMIC_UBO_COUNT;
 
         VkDescriptorPoolCreateInfo dynamicUbo{};
         dynamicUbo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        dynamicUbo.maxSets        = 1024;
+        dynamicUbo.maxSets        = MAX_UBO_SETS;
         dynamicUbo.poolSizeCount  = HS_ARR_LEN(dynUboSizes);
         dynamicUbo.pPoolSizes     = dynUboSizes;
 
-        for (int i = 0; i < BB_IMG_COUNT; ++i)
+        for (uint i = 0; i < config_.framesInFlight_; ++i)
         {
             if (VKR_FAILED(vkCreateDescriptorPool(vkDevice_, &dynamicUbo, nullptr, &dynamicUBODPool_[i])))
                 return R_FAIL;
         }
     }
 
+    return InitResources();
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::InitNull()
+{
+    nullBackend_ = true;
+
+    // Largest alignment the spec allows so cache layouts are never tighter than on a real device
+    vkPhysicalDeviceProperties_.limits.minUniformBufferOffsetAlignment = 256;
+    strncpy(vkPhysicalDeviceProperties_.deviceName, "Null", sizeof(vkPhysicalDeviceProperties_.deviceName) - 1);
+    multiDrawIndirect_ = true;
+    drawIndirectFirstInstance_ = true;
+    drawIndirectCount_ = true;
+
+    RESULT res = InitResources();
+    return res;
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::InitResources()
+{
     //-----------------------
     // Caches
     uboCache_ = MakeUnique<RenderBufferCache>(RenderBufferType::Uniform);
@@ -1281,17 +1894,28 @@ RESULT Render::Init()
     if (HS_FAILED(indexCache_->Init()))
         return R_FAIL;
 
-    if (HS_FAILED(CreateMainRenderPass()))
+    stagingCache_ = MakeUnique<RenderBufferCache>(RenderBufferType::Staging, STAGING_BLOCK_SIZE);
+    if (HS_FAILED(stagingCache_->Init()))
         return R_FAIL;
 
-    if (HS_FAILED(CreateMainFrameBuffer()))
+    indirectCache_ = MakeUnique<RenderBufferCache>(RenderBufferType::Indirect);
+    if (HS_FAILED(indirectCache_->Init()))
         return R_FAIL;
 
-    if (HS_FAILED(CreateOverlayRenderPass()))
-        return R_FAIL;
+    if (!nullBackend_)
+    {
+        if (HS_FAILED(CreateMainRenderPass()))
+            return R_FAIL;
 
-    if (HS_FAILED(CreateOverlayFrameBuffer()))
-        return R_FAIL;
+        if (HS_FAILED(CreateMainFrameBuffer()))
+            return R_FAIL;
+
+        if (HS_FAILED(CreateOverlayRenderPass()))
+            return R_FAIL;
+
+        if (HS_FAILED(CreateOverlayFrameBuffer()))
+            return R_FAIL;
+    }
 
     //-----------------------
     shaderManager_ = MakeUnique<ShaderManager>();
@@ -1321,7 +1945,34 @@ RESULT Render::Init()
     if (guiRenderer_ && HS_FAILED(guiRenderer_->Init()))
         return R_FAIL;
 
-    state_.Reset();
+    occlusionBuffer_ = MakeUnique<OcclusionBuffer>();
+    if (occlusionBuffer_ && HS_FAILED(occlusionBuffer_->Init()))
+        return R_FAIL;
+
+    if (config_.gpuCulling_)
+    {
+        gpuCuller_ = MakeUnique<GpuCuller>();
+        if (HS_FAILED(gpuCuller_->Init(config_.framesInFlight_)))
+        {
+            LOG_WARN("GPU culling is not available, objects are culled on the CPU");
+            gpuCuller_ = nullptr;
+        }
+        else
+        {
+            gpuCuller_->SetValidation(config_.gpuCullingValidation_);
+        }
+    }
+
+    static_assert(GpuProfiler::MAX_FRAMES == RenderConfig::MAX_FRAMES_IN_FLIGHT);
+    // Without Init all profiler calls are no-ops
+    gpuProfiler_ = MakeUnique<GpuProfiler>();
+    if (!nullBackend_ && HS_FAILED(gpuProfiler_->Init(vkDevice_, vkPhysicalDevice_, directQueueFamilyIdx_, config_.framesInFlight_)))
+        return R_FAIL;
+
+    if (!nullBackend_ && HS_FAILED(LoadPipelineCache()))
+        return R_FAIL;
+
+    mainRecorder_.state_.Reset();
 
     return R_OK;
 }
@@ -1345,6 +1996,12 @@ void Render::RenderObjects(Span<VisualObject*> objects)
     renderObjects_[RPT_MAIN].AddRange(objects);
 }
 
+//------------------------------------------------------------------------------
+void Render::AddOccluder(Span<const Vec3> vertices, Span<const uint> indices, const Mat44& transform)
+{
+    occluders_.Add(Occluder{ vertices, indices, transform });
+}
+
 //------------------------------------------------------------------------------
 static void ImguiVkCheckResult(VkResult res)
 {
@@ -1357,6 +2014,15 @@ static void ImguiVkCheckResult(VkResult res)
 //------------------------------------------------------------------------------
 RESULT Render::InitImgui()
 {
+    if (nullBackend_)
+    {
+        // NewFrame needs a built font atlas, the texture is never uploaded
+        uint8* pixels;
+        int width, height;
+        ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        return R_OK;
+    }
+
     // Create Descriptor Pool
     {
         VkDescriptorPoolSize poolSizes[] =
@@ -1393,11 +2059,12 @@ RESULT Render::InitImgui()
     initInfo.Device            = vkDevice_;
     initInfo.QueueFamily       = directQueueFamilyIdx_;
     initInfo.Queue             = vkDirectQueue_;
-    initInfo.PipelineCache     = nullptr; // TODO(pavel): Set
+    initInfo.PipelineCache     = vkPipelineCache_;
     initInfo.DescriptorPool    = imguiDescriptorPool_;
     initInfo.Allocator         = nullptr;
-    initInfo.MinImageCount     = BB_IMG_COUNT;
-    initInfo.ImageCount        = BB_IMG_COUNT;
+    initInfo.MinImageCount     = 2;
+    // Imgui reuses its per frame buffers after ImageCount frames
+    initInfo.ImageCount        = Max(swapchainImageCount_, config_.framesInFlight_);
     initInfo.CheckVkResultFn   = ImguiVkCheckResult;
     if (!ImGui_ImplVulkan_Init(&initInfo, overlayRenderPass_))
         return R_FAIL;
@@ -1405,7 +2072,7 @@ RESULT Render::InitImgui()
     // Upload Fonts
     {
         // Use any command queue
-        if (!ImGui_ImplVulkan_CreateFontsTexture(directCmdBuffers_[currentBBIdx_]))
+        if (!ImGui_ImplVulkan_CreateFontsTexture(directCmdBuffers_[frameIdx_]))
             return R_FAIL;
 
         // TODO(pavel): Do this sometime, we could either flush GPU and wait here or check it every time we preset... neither is very good
@@ -1418,18 +2085,53 @@ RESULT Render::InitImgui()
 //------------------------------------------------------------------------------
 void Render::Free()
 {
+    // Nothing was created on a device
+    if (nullBackend_)
+    {
+        if (gpuCuller_)
+            gpuCuller_->Free();
+        gpuCuller_ = nullptr;
+        shaderManager_ = nullptr;
+        gpuProfiler_ = nullptr;
+        return;
+    }
+
     FlushGpu<false, true>();
+    FreeCaptures();
+
+    if (gpuCuller_)
+        gpuCuller_->Free();
+    gpuCuller_ = nullptr;
 
     ImGui_ImplVulkan_Shutdown();
 
     // TODO(pavel): Destroy everything
-    for (int bbIdx = 0; bbIdx < BB_IMG_COUNT; ++bbIdx)
+    for (uint bbIdx = 0; bbIdx < swapchainImageCount_; ++bbIdx)
     {
         vkDestroyFramebuffer(vkDevice_, mainFrameBuffer_[bbIdx], nullptr);
     }
 
+    WaitForPipelineCompiles();
+    CollectCompiledPipelines();
+
+    SavePipelineCache();
+    vkDestroyPipelineCache(vkDevice_, vkPipelineCache_, nullptr);
+    for (int i = 0; i < vertexLayoutStorage_.Count(); ++i)
+        delete vertexLayoutStorage_[i];
+    vertexLayoutStorage_.Clear();
+
     shaderManager_ = nullptr;
 
+    if (gpuProfiler_)
+        gpuProfiler_->Free();
+    gpuProfiler_ = nullptr;
+
+    for (uint f = 0; f < config_.framesInFlight_; ++f)
+    {
+        for (uint i = 0; i < MAX_RECORD_CHUNKS; ++i)
+            vkDestroyCommandPool(vkDevice_, chunkCmdPools_[f][i], nullptr);
+    }
+
     vkDestroyRenderPass(vkDevice_, mainRenderPass_, nullptr);
     vkDestroyDevice(vkDevice_, nullptr);
 }
@@ -1438,22 +2140,66 @@ void Render::Free()
 template<bool present, bool wait>
 void Render::FlushGpu()
 {
-    vkEndCommandBuffer(directCmdBuffers_[currentBBIdx_]);
+    HS_PROFILE_SCOPE("FlushGpu");
+
+    vkEndCommandBuffer(directCmdBuffers_[frameIdx_]);
+
+    VkSemaphore signalSemaphores[2]{};
+    uint signalCount = 0;
+    #if defined(VKR_USE_TIMELINE_SEMAPHORES)
+        signalSemaphores[signalCount++] = directQueueSemaphore_;
+    #endif
+    if (present && !headless_)
+        signalSemaphores[signalCount++] = submitSemaphores_[currentBBIdx_];
+
+    // Only the first submit after the acquire waits, flushes in the middle of a frame can come before present
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submit{};
     submit.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit.commandBufferCount   = 1;
-    submit.pCommandBuffers      = &directCmdBuffers_[currentBBIdx_];
-    if (present)
+    submit.pCommandBuffers      = &directCmdBuffers_[frameIdx_];
+    if (acquirePending_)
     {
-        submit.signalSemaphoreCount = 1;
-        submit.pSignalSemaphores    = &submitSemaphores_[currentBBIdx_];
+        submit.waitSemaphoreCount   = 1;
+        submit.pWaitSemaphores      = &acquireSemaphores_[frameIdx_];
+        submit.pWaitDstStageMask    = &waitStage;
+        acquirePending_ = false;
     }
 
-    VKR_CHECK(vkQueueSubmit(vkDirectQueue_, 1, &submit, directQueueFences_[currentBBIdx_]));
+    #if defined(VKR_USE_TIMELINE_SEMAPHORES)
+        // Binary semaphores ignore their values
+        const uint64 signalValues[2]{ ++lastSemaphoreValue_, 0 };
+        const uint64 waitValue = 0;
+
+        VkTimelineSemaphoreSubmitInfo timelineSubmit{};
+        timelineSubmit.sType                        = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineSubmit.waitSemaphoreValueCount      = submit.waitSemaphoreCount;
+        timelineSubmit.pWaitSemaphoreValues         = &waitValue;
+        timelineSubmit.signalSemaphoreValueCount    = signalCount;
+        timelineSubmit.pSignalSemaphoreValues       = signalValues;
+        submit.pNext = &timelineSubmit;
+
+        semaphoreValues_[frameIdx_] = lastSemaphoreValue_;
+        const VkFence fence = VK_NULL_HANDLE;
+    #else
+        const VkFence fence = directQueueFences_[frameIdx_];
+    #endif
+
+    submit.signalSemaphoreCount = signalCount;
+    submit.pSignalSemaphores    = signalSemaphores;
 
-    bool needRecreateSwapchain = false;
+    {
+        HS_PROFILE_SCOPE("Submit");
+        VKR_CHECK(vkQueueSubmit(vkDirectQueue_, 1, &submit, fence));
+    }
+
+    // Only the present submit finishes the frame, flushes in the middle of it don't
     if (present)
+        submittedFrames_[frameIdx_] = frame_ + 1;
+
+    bool needRecreateSwapchain = false;
+    if (present && !headless_)
     {
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType               = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1463,46 +2209,193 @@ void Render::FlushGpu()
         presentInfo.waitSemaphoreCount  = 1;
         presentInfo.pWaitSemaphores     = &submitSemaphores_[currentBBIdx_];
 
+        HS_PROFILE_SCOPE("Present");
         VkResult presentResult = vkQueuePresentKHR(vkDirectQueue_, &presentInfo);
         if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
         {
             needRecreateSwapchain = true;
         }
-
-        if (!needRecreateSwapchain)
-            VKR_CHECK(vkAcquireNextImageKHR(vkDevice_, vkSwapchain_, (uint64)-1, nullptr, nextImageFence_, &currentBBIdx_));
     }
 
+    // The next frame records into the next slot while the GPU may still work on this one
+    if (present)
+        frameIdx_ = (frameIdx_ + 1) % config_.framesInFlight_;
+
     if (wait)
     {
-        if (!needRecreateSwapchain && present)
-        {
-            HS_CHECK(WaitForFence(nextImageFence_));
-        }
-        HS_CHECK(WaitForFence(directQueueFences_[currentBBIdx_]));
+        HS_PROFILE_SCOPE("WaitForFrame");
+        const auto waitStart = std::chrono::high_resolution_clock::now();
+        HS_CHECK(WaitForFrame(frameIdx_));
+        frameStats_.gpuWaitMs_ += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+        // The queue executes in order so everything submitted before this frame is done as well
+        completedFrame_ = Max(completedFrame_, submittedFrames_[frameIdx_]);
+
+        WriteCapture(frameIdx_);
 
-        vkResetDescriptorPool(vkDevice_, dynamicUBODPool_[currentBBIdx_], 0);
+        vkResetDescriptorPool(vkDevice_, dynamicUBODPool_[frameIdx_], 0);
+        ClearUboSetCaches(frameIdx_);
 
         // Reset kept alive objects
-        for (int i = 0; i < destroyPipelines_[currentBBIdx_].Count(); ++i)
-            vkDestroyPipeline(vkDevice_, destroyPipelines_[currentBBIdx_][i], nullptr);
-        destroyPipelines_[currentBBIdx_].Clear();
+        for (int i = 0; i < destroyPipelines_[frameIdx_].Count(); ++i)
+            vkDestroyPipeline(vkDevice_, destroyPipelines_[frameIdx_][i], nullptr);
+        destroyPipelines_[frameIdx_].Clear();
 
-        for (int i = 0; i < destroyBuffers_[currentBBIdx_].Count(); ++i)
-            vmaDestroyBuffer(allocator_, destroyBuffers_[currentBBIdx_][i].buffer_, destroyBuffers_[currentBBIdx_][i].allocation_);
-        destroyBuffers_[currentBBIdx_].Clear();
+        for (int i = 0; i < destroyBuffers_[frameIdx_].Count(); ++i)
+            vmaDestroyBuffer(allocator_, destroyBuffers_[frameIdx_][i].buffer_, destroyBuffers_[frameIdx_][i].allocation_);
+        destroyBuffers_[frameIdx_].Clear();
+    }
+
+    // The acquire semaphore of the slot is free once the slot's previous frame is done
+    if (present && !needRecreateSwapchain)
+    {
+        HS_ASSERT(wait);
+        needRecreateSwapchain = !AcquireNextImage();
     }
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[currentBBIdx_], &beginInfo));
+    VKR_CHECK(vkBeginCommandBuffer(directCmdBuffers_[frameIdx_], &beginInfo));
+    InvalidateBoundState();
 
     if (needRecreateSwapchain)
         HS_CHECK(OnWindowResized(width_, height_));
 }
 
+//------------------------------------------------------------------------------
+void Render::EndNullFrame()
+{
+    submittedFrames_[frameIdx_] = frame_ + 1;
+    frameIdx_ = (frameIdx_ + 1) % config_.framesInFlight_;
+
+    // Behaves like a GPU which is always frames in flight behind so caches keep the same footprint
+    completedFrame_ = Max(completedFrame_, submittedFrames_[frameIdx_]);
+
+    ClearUboSetCaches(frameIdx_);
+    destroyPipelines_[frameIdx_].Clear();
+    InvalidateBoundState();
+}
+
+//------------------------------------------------------------------------------
+void Render::AddRecorderStats(CommandRecorder& recorder)
+{
+    const RenderStats& stats = recorder.stats_;
+    frameStats_.drawCount_              += stats.drawCount_;
+    frameStats_.drawsSkipped_           += stats.drawsSkipped_;
+    frameStats_.fallbackDraws_          += stats.fallbackDraws_;
+    frameStats_.pipelineCreates_        += stats.pipelineCreates_;
+    frameStats_.pipelineBinds_          += stats.pipelineBinds_;
+    frameStats_.pipelineBindsSkipped_   += stats.pipelineBindsSkipped_;
+    frameStats_.descriptorBinds_        += stats.descriptorBinds_;
+    frameStats_.descriptorBindsSkipped_ += stats.descriptorBindsSkipped_;
+    frameStats_.bufferBinds_            += stats.bufferBinds_;
+    frameStats_.bufferBindsSkipped_     += stats.bufferBindsSkipped_;
+    frameStats_.indirectCommands_       += stats.indirectCommands_;
+
+    recorder.stats_ = {};
+}
+
+//------------------------------------------------------------------------------
+void Render::ClearUboSetCaches(uint frameIdx)
+{
+    mainRecorder_.uboSetCache_[frameIdx].clear();
+    for (uint i = 0; i < MAX_RECORD_CHUNKS; ++i)
+        chunkRecorders_[i].uboSetCache_[frameIdx].clear();
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::WaitForFrame(uint frameIdx)
+{
+    #if defined(VKR_USE_TIMELINE_SEMAPHORES)
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &directQueueSemaphore_;
+        waitInfo.pValues        = &semaphoreValues_[frameIdx];
+
+        if (VKR_FAILED(vkWaitSemaphores(vkDevice_, &waitInfo, 1000 * 1000 * 1000)))
+            return R_FAIL;
+
+        return R_OK;
+    #else
+        return WaitForFence(directQueueFences_[frameIdx]);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+bool Render::AcquireNextImage()
+{
+    HS_PROFILE_SCOPE("AcquireNextImage");
+    HS_ASSERT(!acquirePending_);
+
+    if (headless_)
+    {
+        currentBBIdx_ = frameIdx_;
+        return true;
+    }
+
+    const auto acquireStart = std::chrono::high_resolution_clock::now();
+    const VkResult result = vkAcquireNextImageKHR(vkDevice_, vkSwapchain_, (uint64)-1, acquireSemaphores_[frameIdx_], VK_NULL_HANDLE, &currentBBIdx_);
+    frameStats_.acquireMs_ += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
+
+    // Suboptimal still signals the semaphore, the swapchain is recreated after the present
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    {
+        if (result != VK_ERROR_OUT_OF_DATE_KHR)
+            VKR_CHECK(result);
+        return false;
+    }
+
+    acquirePending_ = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::AllocateCommandBuffers()
+{
+    VkCommandBufferAllocateInfo cmdBufferInfo{};
+    cmdBufferInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferInfo.commandPool           = directCmdPool_;
+    cmdBufferInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferInfo.commandBufferCount    = config_.framesInFlight_;
+
+    if (VKR_FAILED(vkAllocateCommandBuffers(vkDevice_, &cmdBufferInfo, directCmdBuffers_)))
+        return R_FAIL;
+
+    for (uint i = 0; i < config_.framesInFlight_; ++i)
+    {
+        if (VKR_FAILED(SetDiagName(vkDevice_, (uint64)directCmdBuffers_[i], VK_OBJECT_TYPE_COMMAND_BUFFER, "DirectCmdBuffer")))
+            return R_FAIL;
+    }
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+bool Render::UboSetKey::operator==(const UboSetKey& other) const
+{
+    for (uint i = 0; i < DYNAMIC_UBO_COUNT; ++i)
+    {
+        if (buffers_[i] != other.buffers_[i] || ranges_[i] != other.ranges_[i])
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+Hash_t Render::UboSetKeyHash::operator()(const UboSetKey& key) const
+{
+    Hash_t hash{};
+    for (uint i = 0; i < DYNAMIC_UBO_COUNT; ++i)
+    {
+        hash = FibonacciHash<uint64>()(hash ^ (uint64)key.buffers_[i]);
+        hash = FibonacciHash<uint64>()(hash ^ (uint64)key.ranges_[i]);
+    }
+    return hash;
+}
+
 //------------------------------------------------------------------------------
 Render::PipelineKey Render::StateToPipelineKey(const RenderPassContext& ctx, const RenderState& state)
 {
@@ -1517,67 +2410,85 @@ Render::PipelineKey Render::StateToPipelineKey(const RenderPassContext& ctx, con
     key |= (uint64)state.vertexLayouts_[0]  << 32;  // 10 bit
     key |= (uint64)state.primitiveTopology_ << 42;  // 4 bit
     key |= (uint64)ctx.passType_            << 46;  // 3 bit
+    key |= (uint64)state.depthState_        << 49;  // 2 bit
+    key |= (uint64)state.cullMode_          << 51;  // 2 bit
+    key |= (uint64)state.blendMode_         << 53;  // 2 bit
 
     return key;
 }
 
 //------------------------------------------------------------------------------
-RESULT Render::PrepareForDraw(const RenderPassContext& ctx)
+Render::PipelineDesc Render::MakePipelineDesc(const RenderPassContext& ctx, const RenderState& state) const
 {
-    #pragma region Pipeline
-    //-------------------
-    // Create Pipeline
-    VkPipelineShaderStageCreateInfo stages[2]{};
-    uint numStages = 0;
-    if (state_.shaders_[PS_VERT])
+    PipelineDesc desc;
+    for (int i = 0; i < PS_COUNT; ++i)
     {
-        ++numStages;
-        stages[0].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        stages[0].stage     = VK_SHADER_STAGE_VERTEX_BIT;
-        stages[0].module    = state_.shaders_[PS_VERT]->vkShader_;
-        stages[0].pName     = "main";
+        if (state.shaders_[i])
+            desc.shaders_[i] = state.shaders_[i]->vkShader_;
+    }
+
+    if (state.vertexLayouts_[0] != RenderState::INVALID_HANDLE)
+    {
+        desc.vertexLayout_ = vertexLayouts_[state.vertexLayouts_[0]];
     }
+    else
+    {
+        desc.vertexLayout_.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    }
+
+    desc.primitiveTopology_ = (VkPrimitiveTopology)state.primitiveTopology_;
+    desc.depthState_        = state.depthState_;
+    desc.cullMode_          = state.cullMode_;
+    desc.blendMode_         = state.blendMode_;
+    desc.renderPass_        = ctx.renderPass_;
 
-    if (state_.shaders_[PS_FRAG])
+    return desc;
+}
+
+//------------------------------------------------------------------------------
+VkPipeline Render::CreatePipeline(const PipelineDesc& desc) const
+{
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    uint numStages = 0;
+    if (desc.shaders_[PS_VERT])
     {
+        stages[numStages].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[numStages].stage     = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[numStages].module    = desc.shaders_[PS_VERT];
+        stages[numStages].pName     = "main";
         ++numStages;
-        stages[1].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        stages[1].stage     = VK_SHADER_STAGE_FRAGMENT_BIT;
-        stages[1].module    = state_.shaders_[PS_FRAG]->vkShader_;
-        stages[1].pName     = "main";
     }
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    if (desc.shaders_[PS_FRAG])
     {
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        stages[numStages].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[numStages].stage     = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[numStages].module    = desc.shaders_[PS_FRAG];
+        stages[numStages].pName     = "main";
+        ++numStages;
     }
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     {
         inputAssembly.sType                     = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology                  = (VkPrimitiveTopology)state_.primitiveTopology_;
+        inputAssembly.topology                  = desc.primitiveTopology_;
         inputAssembly.primitiveRestartEnable    = VK_FALSE;
     }
 
+    // Set by SetViewportAndScissor
     VkPipelineViewportStateCreateInfo viewportState{};
-    VkViewport viewport{};
-    VkRect2D scissor{};
     {
-        viewport.x          = 0.0f;
-        viewport.y          = (float)height_;
-        viewport.width      = (float)width_;
-        viewport.height     = -(float)height_;
-        viewport.minDepth   = 0.0f;
-        viewport.maxDepth   = 1.0f;
-
-        scissor.offset = { 0, 0 };
-        scissor.extent = VkExtent2D{ width_, height_ };
-
         viewportState.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports    = &viewport;
         viewportState.scissorCount  = 1;
-        viewportState.pScissors     = &scissor;
+    }
+
+    const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    {
+        dynamicState.sType              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount  = HS_ARR_LEN(dynamicStates);
+        dynamicState.pDynamicStates     = dynamicStates;
     }
 
     VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -1588,7 +2499,12 @@ RESULT Render::PrepareForDraw(const RenderPassContext& ctx)
         rasterizer.polygonMode              = VK_POLYGON_MODE_FILL; // Using any other mode requires enabling GPU feature
         //rasterizer.polygonMode              = VK_POLYGON_MODE_LINE;
         rasterizer.lineWidth                = 1.0f;
-        rasterizer.cullMode                 = VK_CULL_MODE_NONE;
+        switch (desc.cullMode_)
+        {
+            case VkrCullMode::Back:     rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; break;
+            case VkrCullMode::Front:    rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT; break;
+            case VkrCullMode::None:     rasterizer.cullMode = VK_CULL_MODE_NONE; break;
+        }
         rasterizer.frontFace                = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     }
 
@@ -1601,17 +2517,17 @@ RESULT Render::PrepareForDraw(const RenderPassContext& ctx)
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     {
         depthStencil.sType              = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        depthStencil.depthTestEnable    = (state_.depthState_ & DS_TEST) ? VK_TRUE : VK_FALSE;
-        depthStencil.depthWriteEnable   = (state_.depthState_ & DS_WRITE) ? VK_TRUE : VK_FALSE;
+        depthStencil.depthTestEnable    = (desc.depthState_ & DS_TEST) ? VK_TRUE : VK_FALSE;
+        depthStencil.depthWriteEnable   = (desc.depthState_ & DS_WRITE) ? VK_TRUE : VK_FALSE;
         depthStencil.depthCompareOp     = VK_COMPARE_OP_LESS;
     }
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     {
-        colorBlendAttachment.blendEnable            = VK_TRUE;
+        colorBlendAttachment.blendEnable            = desc.blendMode_ != BM_OPAQUE ? VK_TRUE : VK_FALSE;
         colorBlendAttachment.srcColorBlendFactor    = VK_BLEND_FACTOR_SRC_ALPHA;
-        colorBlendAttachment.dstColorBlendFactor    = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor    = desc.blendMode_ == BM_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
         colorBlendAttachment.colorBlendOp           = VK_BLEND_OP_ADD;
         colorBlendAttachment.srcAlphaBlendFactor    = VK_BLEND_FACTOR_ONE;
         colorBlendAttachment.dstAlphaBlendFactor    = VK_BLEND_FACTOR_ONE;
@@ -1627,162 +2543,655 @@ RESULT Render::PrepareForDraw(const RenderPassContext& ctx)
     plInfo.sType                = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     plInfo.stageCount           = numStages;
     plInfo.pStages              = stages;
-    if (state_.vertexLayouts_[0] != RenderState::INVALID_HANDLE)
-    {
-        plInfo.pVertexInputState    = &vertexLayouts_[state_.vertexLayouts_[0]];
-    }
-    else
-    {
-        plInfo.pVertexInputState    = &vertexInputInfo;
-    }
+    plInfo.pVertexInputState    = &desc.vertexLayout_;
     plInfo.pInputAssemblyState  = &inputAssembly;
     plInfo.pViewportState       = &viewportState;
     plInfo.pRasterizationState  = &rasterizer;
     plInfo.pMultisampleState    = &multisampling;
     plInfo.pDepthStencilState   = &depthStencil;
     plInfo.pColorBlendState     = &colorBlending;
+    plInfo.pDynamicState        = &dynamicState;
     plInfo.layout               = pipelineLayout_;
-    plInfo.renderPass           = ctx.renderPass_;
+    plInfo.renderPass           = desc.renderPass_;
 
     VkPipeline pipeline{};
+    VKR_CHECK(vkCreateGraphicsPipelines(vkDevice_, vkPipelineCache_, 1, &plInfo, nullptr, &pipeline));
 
-    PipelineKey plKey = StateToPipelineKey(ctx, state_);
-    auto cachedPl = pipelineCache_.find(plKey);
-    if (cachedPl != pipelineCache_.end())
-    {
-        pipeline = cachedPl->second;
-    }
-    else
+    return pipeline;
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::PrepareForDraw(const RenderPassContext& ctx)
+{
+    CommandRecorder& rec = GetRecorder();
+    ++rec.stats_.drawCount_;
+
+    //-------------------
+    // Pipeline
+    VkPipeline pipeline = FindOrCompilePipeline(ctx, rec.state_);
+    if (!pipeline)
     {
-        VKR_CHECK(vkCreateGraphicsPipelines(vkDevice_, VK_NULL_HANDLE, 1, &plInfo, nullptr, &pipeline));
-        pipelineCache_.emplace(plKey, pipeline);
+        const Shader* const* fallback = fallbackShaders_[ctx.passType_];
+        if (fallback[PS_VERT] || fallback[PS_FRAG])
+        {
+            RenderState fallbackState = rec.state_;
+            for (int i = 0; i < PS_COUNT; ++i)
+                fallbackState.shaders_[i] = fallbackShaders_[ctx.passType_][i];
+
+            pipeline = FindOrCompilePipeline(ctx, fallbackState);
+        }
+
+        if (!pipeline)
+        {
+            ++rec.stats_.drawsSkipped_;
+            return R_FAIL;
+        }
+        ++rec.stats_.fallbackDraws_;
     }
-    // End Create Pipeline
-    //-------------------
-    #pragma endregion
 
     //-------------------
     // Descriptors
-    VkDescriptorSetAllocateInfo dsAllocInfo{};
-    dsAllocInfo.sType               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    dsAllocInfo.descriptorPool      = dynamicUBODPool_[currentBBIdx_];
-    dsAllocInfo.descriptorSetCount  = 1;
-    dsAllocInfo.pSetLayouts         = &dynamicUBOLayout_;
 
-    if (VKR_FAILED(vkAllocateDescriptorSets(vkDevice_, &dsAllocInfo, &state_.uboDescSet_)))
-        return R_FAIL;
+    UboSetKey setKey;
+    uint dynOffsets[DYNAMIC_UBO_COUNT]{};
 
-    // Fill bindless UBO
+    for (int i = 0; i < DYNAMIC_UBO_COUNT; ++i)
     {
-        BindingUBO* ubo;
-        state_.bindlessUBO_ = uboCache_->BeginAlloc(sizeof(BindingUBO), sizeof(BindingUBO), (void**)&ubo);
-
-        for (uint i = 0; i < SRV_SLOT_COUNT; ++i)
+        if (rec.state_.dynamicUBOs_[i].buffer_)
         {
-            ubo->SRV[i] = state_.fsTextures_[i];
+            setKey.buffers_[i] = rec.state_.dynamicUBOs_[i].buffer_;
+            setKey.ranges_[i] = rec.state_.dynamicUBOs_[i].size_;
+            dynOffsets[i] = rec.state_.dynamicUBOs_[i].offset_;
         }
-        uboCache_->EndAlloc();
     }
 
-    // Copy descriptors
-    VkDescriptorBufferInfo buffInfo[DYNAMIC_UBO_COUNT + 1]{};
-    buffInfo[0].buffer = state_.bindlessUBO_.buffer_;
-    buffInfo[0].offset = 0;
-    buffInfo[0].range  = state_.bindlessUBO_.size_;
-
-    uint dynOffsets[DYNAMIC_UBO_COUNT + 1]{};
-    dynOffsets[0] = state_.bindlessUBO_.offset_;
-
-    VkWriteDescriptorSet UBOWrites[DYNAMIC_UBO_COUNT + 1]{};
-    UBOWrites[0].sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    UBOWrites[0].dstSet             = state_.uboDescSet_;
-    UBOWrites[0].dstBinding         = 0;
-    UBOWrites[0].dstArrayElement    = 0;
-    UBOWrites[0].descriptorCount    = 1;
-    UBOWrites[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    UBOWrites[0].pBufferInfo        = buffInfo;
-
-    uint writeCount = 1;
-
-    for (int i = 0; i < DYNAMIC_UBO_COUNT; ++i)
+    // Cache buffers are long lived so most draws only change the dynamic offsets
+    auto& setCache = rec.uboSetCache_[frameIdx_];
+    auto cachedSet = setCache.find(setKey);
+    if (cachedSet != setCache.end())
+    {
+        rec.state_.uboDescSet_ = cachedSet->second;
+    }
+    else if (nullBackend_)
+    {
+        std::lock_guard<std::mutex> lock(dynamicUBODPoolLock_);
+        rec.state_.uboDescSet_ = MakeNullHandle<VkDescriptorSet>();
+        setCache.emplace(setKey, rec.state_.uboDescSet_);
+    }
+    else
     {
-        if (state_.dynamicUBOs_[i].buffer_)
+        VkDescriptorSetAllocateInfo dsAllocInfo{};
+        dsAllocInfo.sType               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        dsAllocInfo.descriptorPool      = dynamicUBODPool_[frameIdx_];
+        dsAllocInfo.descriptorSetCount  = 1;
+        dsAllocInfo.pSetLayouts         = &dynamicUBOLayout_;
+
         {
-            buffInfo[i + 1].buffer = state_.dynamicUBOs_[i].buffer_;
-            buffInfo[i + 1].offset = 0;
-            buffInfo[i + 1].range  = state_.dynamicUBOs_[i].size_;
+            // The pool is shared by the recorders of all chunks
+            std::lock_guard<std::mutex> lock(dynamicUBODPoolLock_);
+            if (VKR_FAILED(vkAllocateDescriptorSets(vkDevice_, &dsAllocInfo, &rec.state_.uboDescSet_)))
+                return R_FAIL;
+        }
 
-            dynOffsets[i + 1] = state_.dynamicUBOs_[i].offset_;
+        VkDescriptorBufferInfo buffInfo[DYNAMIC_UBO_COUNT]{};
+        VkWriteDescriptorSet UBOWrites[DYNAMIC_UBO_COUNT]{};
+        uint writeCount = 0;
 
+        for (int i = 0; i < DYNAMIC_UBO_COUNT; ++i)
+        {
+            if (!setKey.buffers_[i])
+                continue;
+
+            buffInfo[writeCount].buffer = setKey.buffers_[i];
+            buffInfo[writeCount].offset = 0;
+            buffInfo[writeCount].range  = setKey.ranges_[i];
+
+            UBOWrites[writeCount].sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            UBOWrites[writeCount].dstSet             = rec.state_.uboDescSet_;
+            UBOWrites[writeCount].dstBinding         = i + 1;
+            UBOWrites[writeCount].dstArrayElement    = 0;
+            UBOWrites[writeCount].descriptorCount    = 1;
+            UBOWrites[writeCount].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            UBOWrites[writeCount].pBufferInfo        = &buffInfo[writeCount];
             ++writeCount;
-            UBOWrites[i + 1].sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            UBOWrites[i + 1].dstSet             = state_.uboDescSet_;
-            UBOWrites[i + 1].dstBinding         = i + 1;
-            UBOWrites[i + 1].dstArrayElement    = 0;
-            UBOWrites[i + 1].descriptorCount    = 1;
-            UBOWrites[i + 1].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-            UBOWrites[i + 1].pBufferInfo        = &buffInfo[i + 1];
         }
-    }
 
+        vkUpdateDescriptorSets(vkDevice_, writeCount, UBOWrites, 0, nullptr);
 
-    vkUpdateDescriptorSets(vkDevice_, writeCount, UBOWrites, 0, nullptr);
+        setCache.emplace(setKey, rec.state_.uboDescSet_);
+    }
 
-    VkDescriptorSet descSets[] = {
-        immutableSamplerSet_,
-        bindlessSet_,
-        state_.uboDescSet_,
-    };
+    //-------------------
+    // Binds
+    // All pipelines share pipelineLayout_ so descriptor sets stay bound across pipeline changes
+    if (!rec.bound_.staticSetsBound_)
+    {
+        VkDescriptorSet staticSets[] = {
+            immutableSamplerSet_,
+            bindlessSet_,
+        };
 
-    vkCmdBindDescriptorSets(CmdBuff(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, HS_ARR_LEN(descSets), descSets, HS_ARR_LEN(dynOffsets), dynOffsets);
+        if (!nullBackend_)
+            vkCmdBindDescriptorSets(CmdBuff(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, HS_ARR_LEN(staticSets), staticSets, 0, nullptr);
+        rec.bound_.staticSetsBound_ = true;
+        ++rec.stats_.descriptorBinds_;
+    }
 
-    // Vertex buffers
-    if (state_.vertexBuffers_[0])
+    if (rec.bound_.uboDescSet_ != rec.state_.uboDescSet_ || memcmp(rec.bound_.dynOffsets_, dynOffsets, sizeof(dynOffsets)) != 0)
     {
-        vkCmdBindVertexBuffers(CmdBuff(), 0, RenderState::MAX_VERT_BUFF, state_.vertexBuffers_, state_.vbOffsets_);
+        if (!nullBackend_)
+            vkCmdBindDescriptorSets(CmdBuff(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 2, 1, &rec.state_.uboDescSet_, HS_ARR_LEN(dynOffsets), dynOffsets);
+        rec.bound_.uboDescSet_ = rec.state_.uboDescSet_;
+        memcpy(rec.bound_.dynOffsets_, dynOffsets, sizeof(dynOffsets));
+        ++rec.stats_.descriptorBinds_;
     }
-
-    if (state_.indexBuffers_[0])
+    else
     {
-        vkCmdBindIndexBuffer(CmdBuff(), state_.indexBuffers_[0], state_.indexOffsets_[0], VK_INDEX_TYPE_UINT32);
+        ++rec.stats_.descriptorBindsSkipped_;
     }
 
-    vkCmdBindPipeline(CmdBuff(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-    return R_OK;
-}
+    // Bindless indices, pushed only when the textures change so most draws write nothing
+    if (!rec.bound_.texturesPushed_ || memcmp(rec.bound_.fsTextures_, rec.state_.fsTextures_, sizeof(rec.state_.fsTextures_)) != 0)
+    {
+        static_assert(sizeof(BindingConstants) == sizeof(rec.state_.fsTextures_));
+        if (!nullBackend_)
+            vkCmdPushConstants(CmdBuff(), pipelineLayout_, BINDING_CONSTANTS_STAGES, 0, sizeof(BindingConstants), rec.state_.fsTextures_);
+        rec.bound_.texturesPushed_ = true;
+        memcpy(rec.bound_.fsTextures_, rec.state_.fsTextures_, sizeof(rec.state_.fsTextures_));
+    }
+
+    // Vertex buffers
+    if (rec.state_.vertexBuffers_[0])
+    {
+        if (memcmp(rec.bound_.vertexBuffers_, rec.state_.vertexBuffers_, sizeof(rec.state_.vertexBuffers_)) != 0
+            || memcmp(rec.bound_.vbOffsets_, rec.state_.vbOffsets_, sizeof(rec.state_.vbOffsets_)) != 0)
+        {
+            // Only the leading bound slots, unused ones stay null
+            uint vbCount = 1;
+            while (vbCount < RenderState::MAX_VERT_BUFF && rec.state_.vertexBuffers_[vbCount])
+                ++vbCount;
+
+            if (!nullBackend_)
+                vkCmdBindVertexBuffers(CmdBuff(), 0, vbCount, rec.state_.vertexBuffers_, rec.state_.vbOffsets_);
+            memcpy(rec.bound_.vertexBuffers_, rec.state_.vertexBuffers_, sizeof(rec.state_.vertexBuffers_));
+            memcpy(rec.bound_.vbOffsets_, rec.state_.vbOffsets_, sizeof(rec.state_.vbOffsets_));
+            ++rec.stats_.bufferBinds_;
+        }
+        else
+        {
+            ++rec.stats_.bufferBindsSkipped_;
+        }
+    }
+
+    if (rec.state_.indexBuffers_[0])
+    {
+        if (rec.bound_.indexBuffer_ != rec.state_.indexBuffers_[0]
+            || rec.bound_.indexOffset_ != rec.state_.indexOffsets_[0]
+            || rec.bound_.indexType_ != rec.state_.indexTypes_[0])
+        {
+            const VkIndexType indexType = rec.state_.indexTypes_[0] == IndexType::U16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            if (!nullBackend_)
+                vkCmdBindIndexBuffer(CmdBuff(), rec.state_.indexBuffers_[0], rec.state_.indexOffsets_[0], indexType);
+            rec.bound_.indexBuffer_ = rec.state_.indexBuffers_[0];
+            rec.bound_.indexOffset_ = rec.state_.indexOffsets_[0];
+            rec.bound_.indexType_ = rec.state_.indexTypes_[0];
+            ++rec.stats_.bufferBinds_;
+        }
+        else
+        {
+            ++rec.stats_.bufferBindsSkipped_;
+        }
+    }
+
+    if (rec.bound_.pipeline_ != pipeline)
+    {
+        if (!nullBackend_)
+            vkCmdBindPipeline(CmdBuff(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        rec.bound_.pipeline_ = pipeline;
+        ++rec.stats_.pipelineBinds_;
+    }
+    else
+    {
+        ++rec.stats_.pipelineBindsSkipped_;
+    }
+
+    return R_OK;
+}
 
 //------------------------------------------------------------------------------
 void Render::AfterDraw()
 {
-    state_.Reset();
+    GetRecorder().state_.Reset();
+}
+
+//------------------------------------------------------------------------------
+void Render::InvalidateBoundState()
+{
+    GetRecorder().bound_ = {};
+}
+
+//------------------------------------------------------------------------------
+void Render::Draw(const RenderPassContext& ctx, uint vertexCount, uint firstVertex, uint instanceCount)
+{
+    if (PrepareForDraw(ctx) == R_OK && !nullBackend_)
+        vkCmdDraw(CmdBuff(), vertexCount, instanceCount, firstVertex, 0);
+
+    AfterDraw();
 }
 
 //------------------------------------------------------------------------------
-void Render::Draw(const RenderPassContext& ctx, uint vertexCount, uint firstVertex)
+void Render::DrawIndexed(const RenderPassContext& ctx, uint indexCount, uint firstIndex, uint vertexOffset, uint instanceCount)
 {
+    if (PrepareForDraw(ctx) == R_OK && !nullBackend_)
+        vkCmdDrawIndexed(CmdBuff(), indexCount, instanceCount, firstIndex, (int)vertexOffset, 0);
+
+    AfterDraw();
+}
+
+//------------------------------------------------------------------------------
+void Render::DrawIndexedIndirect(const RenderPassContext& ctx, const RenderBufferEntry& commands, uint drawCount)
+{
+    HS_ASSERT(commands.size_ >= (int)(drawCount * sizeof(VkDrawIndexedIndirectCommand)));
+
     if (PrepareForDraw(ctx) == R_OK)
-        vkCmdDraw(directCmdBuffers_[currentBBIdx_], vertexCount, 1, firstVertex, 0);
+    {
+        GetRecorder().stats_.indirectCommands_ += drawCount;
+
+        if (!nullBackend_)
+        {
+            // Without multiDrawIndirect an indirect draw reads at most one command
+            const uint commandsPerDraw = multiDrawIndirect_ ? drawCount : 1;
+            for (uint i = 0; i < drawCount; i += commandsPerDraw)
+            {
+                const VkDeviceSize offset = commands.offset_ + i * sizeof(VkDrawIndexedIndirectCommand);
+                vkCmdDrawIndexedIndirect(CmdBuff(), commands.buffer_, offset, commandsPerDraw, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
 
     AfterDraw();
 }
 
 //------------------------------------------------------------------------------
-void Render::DrawIndexed(const RenderPassContext& ctx, uint indexCount, uint firstIndex, uint vertexOffset)
+void Render::DrawIndexedIndirectCount(const RenderPassContext& ctx, const RenderBufferEntry& commands, const RenderBufferEntry& countBuffer, uint maxDraws)
 {
+    if (!countBuffer.buffer_)
+    {
+        DrawIndexedIndirect(ctx, commands, maxDraws);
+        return;
+    }
+
+    HS_ASSERT(drawIndirectCount_);
+    HS_ASSERT(commands.size_ >= (int)(maxDraws * sizeof(VkDrawIndexedIndirectCommand)));
+
     if (PrepareForDraw(ctx) == R_OK)
-        vkCmdDrawIndexed(directCmdBuffers_[currentBBIdx_], indexCount, 1, firstIndex, 0, 0);
+    {
+        GetRecorder().stats_.indirectCommands_ += maxDraws;
+
+        if (!nullBackend_)
+        {
+            vkCmdDrawIndexedIndirectCount(
+                CmdBuff(),
+                commands.buffer_, commands.offset_,
+                countBuffer.buffer_, countBuffer.offset_,
+                maxDraws, sizeof(VkDrawIndexedIndirectCommand)
+            );
+        }
+    }
 
     AfterDraw();
 }
 
+//------------------------------------------------------------------------------
+bool Render::HasIndirectFirstInstance() const
+{
+    return drawIndirectFirstInstance_;
+}
+
+//------------------------------------------------------------------------------
+bool Render::HasDrawIndirectCount() const
+{
+    return drawIndirectCount_;
+}
+
+//------------------------------------------------------------------------------
+uint64 Render::MakeDrawSortKey(RenderPassType pass, const VisualObject* object, const Vec3& cameraPos)
+{
+    constexpr uint PASS_BITS        = 3;
+    constexpr uint PIPELINE_BITS    = 12;
+    constexpr uint MATERIAL_BITS    = 16;
+    constexpr uint MESH_BITS        = 17;
+    constexpr uint DEPTH_BITS       = 16;
+    static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+    static_assert(RPT_COUNT <= (1 << PASS_BITS));
+
+    auto field = [](uint64 value, uint bits) { return value & ((1ull << bits) - 1); };
+
+    // Ids don't need to be unique, equal keys of different meshes only break a run
+    const Mesh& mesh = object->mesh_;
+    uint64 meshId;
+    if (mesh.pool_)
+    {
+        // Index type and pool first so meshes drawn as one batch are next to each other
+        constexpr uint POOL_BITS = 4;
+        constexpr uint OFFSET_BITS = MESH_BITS - POOL_BITS - 1;
+        const uint64 poolHash = FibonacciHash<uint64>()((uint64)mesh.pool_);
+        const uint64 meshHash = FibonacciHash<uint64>()(((uint64)mesh.firstVertex_ << 32) | mesh.firstIndex_);
+        meshId = ((uint64)mesh.indexType_ << (MESH_BITS - 1))
+            | ((poolHash >> (64 - POOL_BITS)) << OFFSET_BITS)
+            | (meshHash >> (64 - OFFSET_BITS));
+    }
+    else
+    {
+        const uint64 meshHash = FibonacciHash<uint64>()((uint64)object->vertexBuffer_.buffer_.buffer_ ^ ((uint64)object->vertexBuffer_.buffer_.offset_ << 48));
+        meshId = meshHash >> (64 - MESH_BITS);
+    }
+
+    // Positive floats compare the same as their bits, the top bits are enough for front to back order
+    const Vec4 objectPos = object->transform_.GetPosition();
+    const float distSqr = (Vec3{ objectPos.x, objectPos.y, objectPos.z } - cameraPos).LengthSqr();
+    uint distBits;
+    memcpy(&distBits, &distSqr, sizeof(distBits));
+    const uint64 depth = distBits >> (32 - DEPTH_BITS);
+
+    uint64 key = field(pass, PASS_BITS);
+    key = (key << PIPELINE_BITS)    | field(object->material_->GetPipelineSortId(), PIPELINE_BITS);
+    key = (key << MATERIAL_BITS)    | field(object->material_->GetSortId(), MATERIAL_BITS);
+    key = (key << MESH_BITS)        | meshId;
+    key = (key << DEPTH_BITS)       | depth;
+
+    return key;
+}
+
+//------------------------------------------------------------------------------
+static bool CanInstanceTogether(const VisualObject* a, const VisualObject* b)
+{
+    return a->material_ == b->material_
+        && a->vertexBuffer_.buffer_.buffer_ == b->vertexBuffer_.buffer_.buffer_
+        && a->vertexBuffer_.buffer_.offset_ == b->vertexBuffer_.buffer_.offset_
+        && a->indexBuffer_.buffer_.buffer_ == b->indexBuffer_.buffer_.buffer_
+        && a->indexBuffer_.buffer_.offset_ == b->indexBuffer_.buffer_.offset_
+        && a->indexBuffer_.buffer_.size_ == b->indexBuffer_.buffer_.size_
+        && a->mesh_ == b->mesh_;
+}
+
+//------------------------------------------------------------------------------
+static bool CanBatchTogether(const VisualObject* a, const VisualObject* b)
+{
+    return a->material_ == b->material_
+        && a->mesh_.pool_ == b->mesh_.pool_
+        && a->mesh_.indexType_ == b->mesh_.indexType_;
+}
+
+//------------------------------------------------------------------------------
+//! Whether b joins the draw of a run starting at a, pool meshes batch and other meshes instance
+static bool CanDrawTogether(const VisualObject* a, const VisualObject* b)
+{
+    return a->mesh_.pool_ ? CanBatchTogether(a, b) : CanInstanceTogether(a, b);
+}
+
+//------------------------------------------------------------------------------
+void Render::CullObjects(Span<VisualObject* const> objects)
+{
+    HS_PROFILE_SCOPE("CullObjects");
+    visibleObjects_.Clear();
+
+    while (cullBoxes_.Count() < (int)objects.Count())
+    {
+        cullBoxes_.Add({});
+        cullVisible_.Add(0);
+    }
+
+    Span<AABB> boxes = MakeSpan(cullBoxes_.Data(), objects.Count());
+    Span<uint8> visible = MakeSpan(cullVisible_.Data(), objects.Count());
+
+    auto computeBoxes = [&objects, &boxes](Span<AABB> chunk)
+    {
+        const uint64 begin = chunk.Data() - boxes.Data();
+        for (uint64 i = 0; i < chunk.Count(); ++i)
+        {
+            const VisualObject* object = objects[begin + i];
+            chunk[i] = object->bounds_.IsValid() ? TransformAABB(object->bounds_, object->transform_) : AABB(Vec3::ZERO(), Vec3::ZERO());
+        }
+    };
+
+    // Job system runs small arrays on this thread
+    if (g_JobSystem)
+        g_JobSystem->ParallelForChunked(boxes, 1024, computeBoxes);
+    else
+        computeBoxes(boxes);
+
+    const Mat44 viewProj = camera_.toCamera_ * camera_.toProjection_;
+    const Frustum frustum = MakeFrustum(viewProj);
+    CullBoxesParallel(g_JobSystem, frustum, boxes, visible);
+
+    const bool useOcclusion = occlusionBuffer_ && !occluders_.IsEmpty();
+    if (useOcclusion)
+    {
+        occlusionBuffer_->BeginFrame(viewProj);
+        for (int i = 0; i < occluders_.Count(); ++i)
+            occlusionBuffer_->AddOccluder(occluders_[i].vertices_, occluders_[i].indices_, occluders_[i].transform_);
+        occlusionBuffer_->EndOccluders();
+    }
+
+    uint occluded = 0;
+    for (uint64 i = 0; i < objects.Count(); ++i)
+    {
+        if (!objects[i]->bounds_.IsValid())
+        {
+            visibleObjects_.Add(objects[i]);
+            continue;
+        }
+
+        if (!visible[i])
+            continue;
+
+        if (useOcclusion && !occlusionBuffer_->IsVisible(boxes[i]))
+        {
+            ++occluded;
+            continue;
+        }
+
+        visibleObjects_.Add(objects[i]);
+    }
+
+    frameStats_.objectsVisible_ += (uint)visibleObjects_.Count();
+    frameStats_.objectsOccluded_ += occluded;
+    frameStats_.objectsCulled_ += (uint)(objects.Count() - visibleObjects_.Count()) - occluded;
+}
+
+//------------------------------------------------------------------------------
+Span<VisualObject* const> Render::CullObjectsOnGpu(Span<VisualObject* const> objects)
+{
+    gpuCulledObjects_.Clear();
+    cpuCulledObjects_.Clear();
+
+    for (uint64 i = 0; i < objects.Count(); ++i)
+    {
+        VisualObject* object = objects[i];
+        if (object->mesh_.pool_ && object->material_->SupportsGpuCulling())
+            gpuCulledObjects_.Add(object);
+        else
+            cpuCulledObjects_.Add(object);
+    }
+
+    const Mat44 viewProj = camera_.toCamera_ * camera_.toProjection_;
+    gpuCuller_->Cull(directCmdBuffers_[frameIdx_], frameIdx_, MakeSpan<VisualObject* const>(gpuCulledObjects_.Data(), gpuCulledObjects_.Count()), viewProj);
+    frameStats_.objectsGpuCulled_ += (uint)gpuCulledObjects_.Count();
+
+    // The pass pushed its own constants
+    InvalidateBoundState();
+
+    return MakeSpan<VisualObject* const>(cpuCulledObjects_.Data(), cpuCulledObjects_.Count());
+}
+
+//------------------------------------------------------------------------------
+void Render::SortDrawItems(const RenderPassContext& ctx, Span<VisualObject* const> objects)
+{
+    const Vec3 cameraPos = camera_.pos_;
+
+    drawItems_.Clear();
+    for (uint64 i = 0; i < objects.Count(); ++i)
+        drawItems_.Add(DrawItem{ MakeDrawSortKey(ctx.passType_, objects[i], cameraPos), objects[i] });
+
+    while (drawItemsScratch_.Count() < drawItems_.Count())
+        drawItemsScratch_.Add({});
+
+    RadixSort(
+        MakeSpan(drawItems_.Data(), drawItems_.Count()),
+        MakeSpan(drawItemsScratch_.Data(), drawItemsScratch_.Count()),
+        [](const DrawItem& item) { return item.key_; }
+    );
+}
+
+//------------------------------------------------------------------------------
+uint Render::SplitDrawChunks()
+{
+    const int itemCount = drawItems_.Count();
+    if (!g_JobSystem || g_JobSystem->GetThreadCount() <= 1 || itemCount < 2 * MIN_CHUNK_DRAWS)
+        return 0;
+
+    const uint chunkCount = Min(Min((uint)g_JobSystem->GetThreadCount(), (uint)(itemCount / MIN_CHUNK_DRAWS)), MAX_RECORD_CHUNKS);
+    const int chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+
+    // Chunks end on run boundaries so each instanced run or pool batch stays one draw
+    uint count = 0;
+    int begin = 0;
+    while (begin < itemCount && count < chunkCount)
+    {
+        int end = count + 1 == chunkCount ? itemCount : Min(begin + chunkSize, itemCount);
+        while (end < itemCount && CanDrawTogether(drawItems_[end - 1].object_, drawItems_[end].object_))
+            ++end;
+
+        recordChunks_[count].items_ = MakeSpan<const DrawItem>(drawItems_.Data() + begin, end - begin);
+        ++count;
+        begin = end;
+    }
+
+    return count;
+}
+
+//------------------------------------------------------------------------------
+void Render::RecordDrawChunks(const RenderPassContext& ctx, uint chunkCount)
+{
+    HS_PROFILE_SCOPE("RecordDrawChunks");
+
+    JobDecl jobs[MAX_RECORD_CHUNKS];
+    VkCommandBuffer cmdBuffs[MAX_RECORD_CHUNKS];
+    for (uint i = 0; i < chunkCount; ++i)
+    {
+        RecordChunk& chunk = recordChunks_[i];
+        chunk.render_ = this;
+        chunk.ctx_ = ctx;
+        chunk.frameBuffer_ = mainFrameBuffer_[currentBBIdx_];
+        chunk.recorder_ = &chunkRecorders_[i];
+        chunk.recorder_->cmdBuff_ = chunkCmdBuffers_[frameIdx_][i];
+        chunk.drawGpuCulled_ = gpuCuller_ && i + 1 == chunkCount;
+
+        jobs[i] = JobDecl{ &Render::RecordChunkJob, &chunk };
+        cmdBuffs[i] = chunk.recorder_->cmdBuff_;
+    }
+
+    g_JobSystem->Run(jobs, chunkCount, &chunkRecords_);
+    g_JobSystem->Wait(&chunkRecords_);
+
+    // Executed in chunk order so the sort order is kept
+    if (!nullBackend_)
+        vkCmdExecuteCommands(directCmdBuffers_[frameIdx_], chunkCount, cmdBuffs);
+
+    // Executing secondary buffers leaves the primary buffer's state undefined
+    InvalidateBoundState();
+}
+
+//------------------------------------------------------------------------------
+void Render::RecordChunkJob(void* data)
+{
+    HS_PROFILE_SCOPE("RecordChunk");
+
+    RecordChunk& chunk = *static_cast<RecordChunk*>(data);
+    Render* render = chunk.render_;
+
+    s_Recorder = chunk.recorder_;
+    s_Recorder->state_.Reset();
+    s_Recorder->bound_ = {};
+
+    if (!render->nullBackend_)
+    {
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass  = chunk.ctx_.renderPass_;
+        inheritance.subpass     = 0;
+        inheritance.framebuffer = chunk.frameBuffer_;
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType             = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags             = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo  = &inheritance;
+
+        VKR_CHECK(vkBeginCommandBuffer(s_Recorder->cmdBuff_, &beginInfo));
+    }
+
+    render->SetViewportAndScissor();
+    render->DrawItems(chunk.ctx_, chunk.items_, chunk.instances_);
+    if (chunk.drawGpuCulled_)
+        render->gpuCuller_->Draw(chunk.ctx_);
+
+    if (!render->nullBackend_)
+        VKR_CHECK(vkEndCommandBuffer(s_Recorder->cmdBuff_));
+
+    s_Recorder = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void Render::DrawItems(const RenderPassContext& ctx, Span<const DrawItem> items, Array<DrawData>& instances)
+{
+    // Runs of the same material and mesh go out as one instanced draw, runs of meshes
+    // sharing a mesh pool go to the material together so it can draw them all at once
+    uint64 runStart = 0;
+    while (runStart < items.Count())
+    {
+        const VisualObject* first = items[runStart].object_;
+        const bool batch = first->mesh_.pool_ != nullptr;
+
+        instances.Clear();
+        uint64 runEnd = runStart;
+        while (runEnd < items.Count() && CanDrawTogether(first, items[runEnd].object_))
+        {
+            VisualObject* object = items[runEnd].object_;
+            instances.Add(DrawData{ object->transform_, object });
+            ++runEnd;
+        }
+
+        const Span<const DrawData> runInstances = MakeSpan<const DrawData>(instances.Data(), instances.Count());
+        if (batch)
+            first->material_->DrawMeshBatch(ctx, runInstances);
+        else
+            first->material_->DrawInstanced(ctx, runInstances);
+
+        runStart = runEnd;
+    }
+}
+
 //------------------------------------------------------------------------------
 void Render::Update(float dTime)
 {
-    ImGui_ImplVulkan_NewFrame();
+    if (!nullBackend_)
+        ImGui_ImplVulkan_NewFrame();
 
     //-------------------
     // Frame start
+    VkCommandBuffer cmdBuff = directCmdBuffers_[frameIdx_];
+    gpuProfiler_->BeginFrame(cmdBuff, frameIdx_);
+    const uint frameScope = gpuProfiler_->BeginScope(cmdBuff, "Frame");
+
+    // Camera is fixed for the rest of the frame
+    UploadSceneData();
+
+    // Culling, objects culled on the GPU skip the draw list and are drawn after it
+    Span<VisualObject* const> mainObjects = MakeSpan<VisualObject* const>(renderObjects_[RPT_MAIN].Data(), renderObjects_[RPT_MAIN].Count());
+    if (gpuCuller_)
+        mainObjects = CullObjectsOnGpu(mainObjects);
+    CullObjects(mainObjects);
 
 
     // Main pass
@@ -1805,15 +3214,30 @@ void Render::Update(float dTime)
         ctx.passType_ = RPT_MAIN;
         ctx.renderPass_ = mainRenderPass_;
 
-        vkCmdBeginRenderPass(directCmdBuffers_[currentBBIdx_], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        HS_PROFILE_SCOPE("MainPass");
+        SortDrawItems(ctx, MakeSpan<VisualObject* const>(visibleObjects_.Data(), visibleObjects_.Count()));
+        const uint chunkCount = SplitDrawChunks();
+
+        // Chunked passes may only execute secondary buffers, the timestamps go outside of it
+        const uint passScope = gpuProfiler_->BeginScope(cmdBuff, "MainPass");
+        if (!nullBackend_)
+            vkCmdBeginRenderPass(directCmdBuffers_[frameIdx_], &renderPassBeginInfo, chunkCount ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-        for (int i = 0; i < renderObjects_[RPT_MAIN].Count(); ++i)
+        if (chunkCount)
+        {
+            RecordDrawChunks(ctx, chunkCount);
+        }
+        else
         {
-            VisualObject* rndrObj = renderObjects_[RPT_MAIN][i];
-            rndrObj->material_->Draw(ctx, DrawData{ rndrObj->transform_, rndrObj });
+            SetViewportAndScissor();
+            DrawItems(ctx, MakeSpan<const DrawItem>(drawItems_.Data(), drawItems_.Count()), drawInstances_);
+            if (gpuCuller_)
+                gpuCuller_->Draw(ctx);
         }
 
-        vkCmdEndRenderPass(directCmdBuffers_[currentBBIdx_]);
+        if (!nullBackend_)
+            vkCmdEndRenderPass(directCmdBuffers_[frameIdx_]);
+        gpuProfiler_->EndScope(cmdBuff, passScope);
     }
 
 
@@ -1829,42 +3253,225 @@ void Render::Update(float dTime)
         renderPassBeginInfo.framebuffer     = overlayFrameBuffer_[currentBBIdx_];
         renderPassBeginInfo.renderArea      = VkRect2D { VkOffset2D { 0, 0 }, VkExtent2D { width_, height_ } };
 
-        vkCmdBeginRenderPass(directCmdBuffers_[currentBBIdx_], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        HS_PROFILE_SCOPE("OverlayPass");
+        const uint passScope = gpuProfiler_->BeginScope(cmdBuff, "OverlayPass");
+        if (!nullBackend_)
+            vkCmdBeginRenderPass(directCmdBuffers_[frameIdx_], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        SetViewportAndScissor();
 
         if (drawCanvas_)
+        {
+            const uint scope = gpuProfiler_->BeginScope(cmdBuff, "DrawCanvas");
             drawCanvas_->Draw(ctx);
+            gpuProfiler_->EndScope(cmdBuff, scope);
+        }
 
         if (spriteRenderer_)
+        {
+            const uint scope = gpuProfiler_->BeginScope(cmdBuff, "SpriteRenderer");
             spriteRenderer_->Draw(ctx);
+            gpuProfiler_->EndScope(cmdBuff, scope);
+        }
 
         if (debugShapeRenderer_)
+        {
+            const uint scope = gpuProfiler_->BeginScope(cmdBuff, "DebugShapeRenderer");
             debugShapeRenderer_->Draw(ctx);
+            gpuProfiler_->EndScope(cmdBuff, scope);
+        }
 
         if (guiRenderer_)
+        {
+            const uint scope = gpuProfiler_->BeginScope(cmdBuff, "GuiRenderer");
             guiRenderer_->Draw(ctx);
+            gpuProfiler_->EndScope(cmdBuff, scope);
+        }
 
+        gpuProfiler_->DrawImGui();
+        if (g_Profiler)
+            g_Profiler->DrawImGui();
+
+        const uint imguiScope = gpuProfiler_->BeginScope(cmdBuff, "ImGui");
         ImGui::Render();
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), directCmdBuffers_[currentBBIdx_]);
+        if (!nullBackend_)
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), directCmdBuffers_[frameIdx_]);
+        InvalidateBoundState();
+        gpuProfiler_->EndScope(cmdBuff, imguiScope);
+
+        if (!nullBackend_)
+            vkCmdEndRenderPass(directCmdBuffers_[frameIdx_]);
+        gpuProfiler_->EndScope(cmdBuff, passScope);
+    }
 
-        vkCmdEndRenderPass(directCmdBuffers_[currentBBIdx_]);
+    if (captureRequest_[0])
+    {
+        HS_CHECK(RecordCapture());
+        captureRequest_[0] = 0;
     }
 
+    gpuProfiler_->EndScope(cmdBuff, frameScope);
+
 
     //-------------------
     // Submit and Present
 
-    FlushGpu<true, true>();
+    if (nullBackend_)
+        EndNullFrame();
+    else
+        FlushGpu<true, true>();
+
+    uboCache_->EndFrame();
+    vbCache_->EndFrame();
+    indexCache_->EndFrame();
+    stagingCache_->EndFrame();
+    indirectCache_->EndFrame();
+    frameStats_.bytesAllocated_ = uboCache_->GetStats().bytesAllocated_
+        + vbCache_->GetStats().bytesAllocated_
+        + indexCache_->GetStats().bytesAllocated_
+        + indirectCache_->GetStats().bytesAllocated_;
+
+    CollectCompiledPipelines();
+    frameStats_.pipelinesCompiling_ = (uint)pendingPipelines_.size();
+
+    AddRecorderStats(mainRecorder_);
+    for (uint i = 0; i < MAX_RECORD_CHUNKS; ++i)
+        AddRecorderStats(chunkRecorders_[i]);
+
+    stats_ = frameStats_;
+    frameStats_ = {};
 
     ++frame_;
 
+    // Frame arena blocks are reused once the frame they were filled in is safe
+    HS_ASSERT(!g_FrameArena || GetSafeFrame() - GetCurrentFrame() <= g_FrameArena->GetFrameCount());
+    if (g_FrameArena)
+        g_FrameArena->BeginFrame(GetCurrentFrame());
+
     for (int passI = 0; passI < RPT_COUNT; ++passI)
         renderObjects_[passI].Clear();
+    occluders_.Clear();
+}
+
+//------------------------------------------------------------------------------
+bool Render::IsHeadless() const
+{
+    return headless_;
+}
+
+//------------------------------------------------------------------------------
+bool Render::IsNull() const
+{
+    return nullBackend_;
+}
+
+//------------------------------------------------------------------------------
+void Render::CaptureFrame(const char* path)
+{
+    if (!headless_)
+    {
+        LOG_WARN("Frame capture is supported in headless mode only");
+        return;
+    }
+
+    strncpy(captureRequest_, path, sizeof(captureRequest_) - 1);
+}
+
+//------------------------------------------------------------------------------
+RESULT Render::RecordCapture()
+{
+    FrameCapture& capture = captures_[frameIdx_];
+    HS_ASSERT(!capture.pending_ && "Capture of the slot's previous frame was not written");
+
+    const VkDeviceSize size = (VkDeviceSize)width_ * height_ * 4;
+    if (capture.size_ != size)
+    {
+        if (capture.buffer_)
+            vmaDestroyBuffer(allocator_, capture.buffer_, capture.allocation_);
+        capture.buffer_ = VK_NULL_HANDLE;
+        capture.size_ = 0;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size         = size;
+        bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage         = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+        if (VKR_FAILED(vmaCreateBuffer(allocator_, &bufferInfo, &allocInfo, &capture.buffer_, &capture.allocation_, nullptr)))
+            return R_FAIL;
+        capture.size_ = size;
+    }
+
+    VkCommandBuffer cmdBuff = directCmdBuffers_[frameIdx_];
+
+    // The overlay pass leaves the image in transfer src layout and its external dependency orders the copy
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask  = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount  = 1;
+    region.imageExtent                  = VkExtent3D{ width_, height_, 1 };
+    vkCmdCopyImageToBuffer(cmdBuff, bbImages_[currentBBIdx_], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, capture.buffer_, 1, &region);
+
+    VkMemoryBarrier copyToHost{};
+    copyToHost.sType            = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    copyToHost.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+    copyToHost.dstAccessMask    = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &copyToHost, 0, nullptr, 0, nullptr);
+
+    capture.width_ = width_;
+    capture.height_ = height_;
+    capture.pending_ = true;
+    strncpy(capture.path_, captureRequest_, sizeof(capture.path_) - 1);
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void Render::WriteCapture(uint frameIdx)
+{
+    FrameCapture& capture = captures_[frameIdx];
+    if (!capture.pending_)
+        return;
+    capture.pending_ = false;
+
+    void* mapped{};
+    if (VKR_FAILED(vmaMapMemory(allocator_, capture.allocation_, &mapped)))
+        return;
+    vmaInvalidateAllocation(allocator_, capture.allocation_, 0, VK_WHOLE_SIZE);
+
+    // Blending leaves arbitrary alpha in the back buffer, it is not meant to be seen
+    uint8* pixels = static_cast<uint8*>(mapped);
+    for (VkDeviceSize i = 3; i < capture.size_; i += 4)
+        pixels[i] = 255;
+
+    if (!stbi_write_png(capture.path_, (int)capture.width_, (int)capture.height_, 4, pixels, (int)capture.width_ * 4))
+        LOG_WARN("Failed to write frame capture %s", capture.path_);
+
+    vmaUnmapMemory(allocator_, capture.allocation_);
+}
+
+//------------------------------------------------------------------------------
+void Render::FreeCaptures()
+{
+    // Captures of the other frame slots may still be executing
+    if (vkDevice_)
+        vkDeviceWaitIdle(vkDevice_);
+
+    for (uint i = 0; i < MAX_FRAMES; ++i)
+    {
+        WriteCapture(i);
+
+        if (captures_[i].buffer_)
+            vmaDestroyBuffer(allocator_, captures_[i].buffer_, captures_[i].allocation_);
+        captures_[i] = {};
+    }
 }
 
 //------------------------------------------------------------------------------
 void Render::DestroyLater(VkBuffer buffer, VmaAllocation allocation)
 {
-    destroyBuffers_[currentBBIdx_].Add({ buffer, allocation });
+    destroyBuffers_[frameIdx_].Add({ buffer, allocation });
 }
 
 //------------------------------------------------------------------------------
@@ -1888,7 +3495,16 @@ ShaderManager* Render::GetShaderManager() const
 //------------------------------------------------------------------------------
 VkCommandBuffer Render::CmdBuff() const
 {
-    return directCmdBuffers_[currentBBIdx_];
+    return s_Recorder ? s_Recorder->cmdBuff_ : directCmdBuffers_[frameIdx_];
+}
+
+//------------------------------------------------------------------------------
+thread_local Render::CommandRecorder* Render::s_Recorder{};
+
+//------------------------------------------------------------------------------
+Render::CommandRecorder& Render::GetRecorder()
+{
+    return s_Recorder ? *s_Recorder : mainRecorder_;
 }
 
 //------------------------------------------------------------------------------
@@ -1900,7 +3516,13 @@ uint64 Render::GetCurrentFrame() const
 //------------------------------------------------------------------------------
 uint64 Render::GetSafeFrame() const
 {
-    return frame_ + 2;
+    return frame_ + config_.framesInFlight_;
+}
+
+//------------------------------------------------------------------------------
+uint64 Render::GetCompletedFrame() const
+{
+    return completedFrame_;
 }
 
 //------------------------------------------------------------------------------
@@ -1927,6 +3549,18 @@ RenderBufferCache* Render::GetIndexCache() const
     return indexCache_.Get();
 }
 
+//------------------------------------------------------------------------------
+RenderBufferCache* Render::GetStagingCache() const
+{
+    return stagingCache_.Get();
+}
+
+//------------------------------------------------------------------------------
+RenderBufferCache* Render::GetIndirectCache() const
+{
+    return indirectCache_.Get();
+}
+
 //------------------------------------------------------------------------------
 uint Render::GetWidth() const
 {
@@ -1953,17 +3587,23 @@ Vec2 Render::GetDimensions() const
 //------------------------------------------------------------------------------
 void Render::ResetState()
 {
-    state_.Reset();
+    GetRecorder().state_.Reset();
+}
+
+//------------------------------------------------------------------------------
+const RenderStats& Render::GetStats() const
+{
+    return stats_;
 }
 
 //------------------------------------------------------------------------------
 void Render::SetTexture(uint slot, Texture* texture)
 {
     uint texIdx = texture ? texture->GetBindlessIndex() : 0;
-    if (state_.fsTextures_[slot] == texIdx)
+    if (GetRecorder().state_.fsTextures_[slot] == texIdx)
         return;
 
-    state_.fsTextures_[slot] = texIdx;
+    GetRecorder().state_.fsTextures_[slot] = texIdx;
 }
 
 //------------------------------------------------------------------------------
@@ -1971,48 +3611,87 @@ void Render::SetVertexBuffer(uint slot, const RenderBufferEntry& entry)
 {
     HS_ASSERT(slot < RenderState::MAX_VERT_BUFF);
 
-    state_.vertexBuffers_[slot] = entry.buffer_;
-    state_.vbOffsets_[slot] = entry.offset_;
+    GetRecorder().state_.vertexBuffers_[slot] = entry.buffer_;
+    GetRecorder().state_.vbOffsets_[slot] = entry.offset_;
 }
 
 //------------------------------------------------------------------------------
-void Render::SetIndexBuffer(uint slot, const RenderBufferEntry& entry)
+void Render::SetIndexBuffer(uint slot, const RenderBufferEntry& entry, IndexType indexType)
 {
     HS_ASSERT(slot < RenderState::MAX_INDEX_BUFF);
 
-    state_.indexBuffers_[slot] = entry.buffer_;
-    state_.indexOffsets_[slot] = entry.offset_;
+    GetRecorder().state_.indexBuffers_[slot] = entry.buffer_;
+    GetRecorder().state_.indexOffsets_[slot] = entry.offset_;
+    GetRecorder().state_.indexTypes_[slot] = indexType;
 }
 
 //------------------------------------------------------------------------------
 void Render::SetPrimitiveTopology(VkrPrimitiveTopology primitiveTopology)
 {
-    state_.primitiveTopology_ = primitiveTopology;
+    GetRecorder().state_.primitiveTopology_ = primitiveTopology;
 }
 
 //------------------------------------------------------------------------------
 void Render::SetVertexLayout(uint slot, uint layoutHandle)
 {
-    state_.vertexLayouts_[slot] = layoutHandle;
+    GetRecorder().state_.vertexLayouts_[slot] = layoutHandle;
 }
 
 //------------------------------------------------------------------------------
 void Render::SetDynamicUbo(uint slot, const RenderBufferEntry& entry)
 {
-    HS_ASSERT(slot < DYNAMIC_UBO_COUNT + 1);
+    HS_ASSERT(slot < DYNAMIC_UBO_COUNT);
 
-    state_.dynamicUBOs_[slot] = entry;
+    GetRecorder().state_.dynamicUBOs_[slot] = entry;
 }
 
 //------------------------------------------------------------------------------
 void Render::SetDepthState(uint state)
 {
-    state_.depthState_ = state;
+    GetRecorder().state_.depthState_ = state;
+}
+
+//------------------------------------------------------------------------------
+void Render::SetCullMode(VkrCullMode cullMode)
+{
+    GetRecorder().state_.cullMode_ = cullMode;
+}
+
+//------------------------------------------------------------------------------
+void Render::SetBlendMode(BlendMode blendMode)
+{
+    GetRecorder().state_.blendMode_ = blendMode;
+}
+
+//------------------------------------------------------------------------------
+void Render::SetViewportAndScissor()
+{
+    // Flipped so +y is up like in the projection matrices
+    VkViewport viewport{};
+    viewport.x          = 0.0f;
+    viewport.y          = (float)height_;
+    viewport.width      = (float)width_;
+    viewport.height     = -(float)height_;
+    viewport.minDepth   = 0.0f;
+    viewport.maxDepth   = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = VkExtent2D{ width_, height_ };
+
+    if (nullBackend_)
+        return;
+
+    vkCmdSetViewport(CmdBuff(), 0, 1, &viewport);
+    vkCmdSetScissor(CmdBuff(), 0, 1, &scissor);
 }
 
 //------------------------------------------------------------------------------
 uint Render::AddBindlessTexture(VkImageView view)
 {
+    if (nullBackend_)
+        return lastFreeBindlessIndex_++;
+
     VkDescriptorImageInfo imgInfo{};
     imgInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imgInfo.imageView   = view;
@@ -2054,21 +3733,31 @@ void RenderState::Reset()
     {
         indexBuffers_[i] = {};
         indexOffsets_[i] = {};
+        indexTypes_[i] = IndexType::U32;
     }
 
     primitiveTopology_ = VkrPrimitiveTopology::TRIANGLE_LIST;
 
-    cullMode_ = VkrCullMode::Back;
+    // Pipelines ignored the cull mode until it was part of the key, not all meshes have consistent winding
+    cullMode_ = VkrCullMode::None;
     depthState_ = DS_TEST | DS_WRITE;
+    blendMode_ = BM_ALPHA;
 }
 
 //------------------------------------------------------------------------------
 uint Render::GetOrCreateVertexLayout(VkPipelineVertexInputStateCreateInfo info)
 {
+    // Compare the descriptions, layouts from the pipeline manifest point to different storage
     for (int i = 0; i < vertexLayouts_.Count(); ++i)
     {
-        if (memcmp(&vertexLayouts_[i], &info, sizeof(VkPipelineVertexInputStateCreateInfo)) == 0)
+        const VkPipelineVertexInputStateCreateInfo& layout = vertexLayouts_[i];
+        if (layout.vertexBindingDescriptionCount == info.vertexBindingDescriptionCount
+            && layout.vertexAttributeDescriptionCount == info.vertexAttributeDescriptionCount
+            && memcmp(layout.pVertexBindingDescriptions, info.pVertexBindingDescriptions, info.vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription)) == 0
+            && memcmp(layout.pVertexAttributeDescriptions, info.pVertexAttributeDescriptions, info.vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription)) == 0)
+        {
             return i;
+        }
     }
 
     vertexLayouts_.Add(info);
@@ -2081,6 +3770,24 @@ const Camera* Render::GetCamera() const
     return &camera_;
 }
 
+//------------------------------------------------------------------------------
+const RenderBufferEntry& Render::GetSceneData() const
+{
+    return sceneData_;
+}
+
+//------------------------------------------------------------------------------
+void Render::UploadSceneData()
+{
+    sh::SceneData* scene{};
+    sceneData_ = uboCache_->BeginAlloc(sizeof(sh::SceneData), sizeof(sh::SceneData), (void**)&scene);
+
+    scene->VP       = camera_.toCamera_ * camera_.toProjection_;
+    scene->ViewPos  = camera_.pos_.ToVec4Pos();
+
+    uboCache_->EndAlloc();
+}
+
 //------------------------------------------------------------------------------
 Camera* Render::GetCamera()
 {
@@ -2105,4 +3812,16 @@ GuiRenderer* Render::GetGuiRenderer() const
     return guiRenderer_.Get();
 }
 
+//------------------------------------------------------------------------------
+GpuProfiler* Render::GetGpuProfiler() const
+{
+    return gpuProfiler_.Get();
+}
+
+//------------------------------------------------------------------------------
+GpuCuller* Render::GetGpuCuller() const
+{
+    return gpuCuller_.Get();
+}
+
 }
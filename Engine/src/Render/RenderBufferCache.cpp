@@ -3,15 +3,20 @@
 #include "Render/Buffer.h"
 #include "Render/Render.h"
 
+#include "Threading/Atomic.h"
+
 #include "Common/Logging.h"
 
 namespace hs
 {
 
 //------------------------------------------------------------------------------
-RenderBufferCache::RenderBufferCache(RenderBufferType cacheType)
+RenderBufferCache::RenderBufferCache(RenderBufferType cacheType, uint blockSize)
     : cacheType_(cacheType)
+    , blockSize_((int)blockSize)
 {
+    HS_ASSERT(blockSize > 0 && blockSize < (1u << 31));
+
     switch (cacheType_)
     {
         case RenderBufferType::Uniform:
@@ -19,7 +24,12 @@ RenderBufferCache::RenderBufferCache(RenderBufferType cacheType)
             minAlignment_ = (int)g_Render->GetPhysDevProps().limits.minUniformBufferOffsetAlignment;
             break;
         }
-        case RenderBufferType::Vertex:
+        case RenderBufferType::Staging:
+        {
+            minAlignment_ = (int)g_Render->GetPhysDevProps().limits.optimalBufferCopyOffsetAlignment;
+            break;
+        }
+        default:
         {
             break;
         }
@@ -29,90 +39,245 @@ RenderBufferCache::RenderBufferCache(RenderBufferType cacheType)
 //------------------------------------------------------------------------------
 RenderBufferCache::~RenderBufferCache()
 {
-    for (int i = 0; i < entries_.Count(); ++i)
+    for (int i = 0; i < ring_.Count(); ++i)
+        FreeEntry(ring_[i]);
+    for (int i = 0; i < oversize_.Count(); ++i)
+        FreeEntry(oversize_[i]);
+}
+
+//------------------------------------------------------------------------------
+RESULT RenderBufferCache::MakeEntry(int size, CacheEntry*& entry)
+{
+    entry = new CacheEntry;
+    entry->size_ = size;
+    entry->buffer_ = new RenderBuffer;
+    if (HS_FAILED(entry->buffer_->Init(cacheType_, RenderBufferMemory::HostToDevice, size)))
     {
-        entries_[i].buffer_->Free();
-        delete entries_[i].buffer_;
+        FreeEntry(entry);
+        entry = nullptr;
+        return R_FAIL;
     }
+
+    entry->mapped_ = static_cast<uint8*>(entry->buffer_->GetMappedData());
+    if (!entry->mapped_)
+    {
+        FreeEntry(entry);
+        entry = nullptr;
+        return R_FAIL;
+    }
+
+    return R_OK;
 }
 
 //------------------------------------------------------------------------------
-RESULT RenderBufferCache::MakeEntry(CacheEntry& entry)
+void RenderBufferCache::FreeEntry(CacheEntry* entry)
 {
-    entry.buffer_ = new RenderBuffer;
-    RESULT res = entry.buffer_->Init(cacheType_, RenderBufferMemory::HostToDevice, BUFFER_SIZE);
-    return res;
+    entry->buffer_->Free();
+    delete entry->buffer_;
+    delete entry;
+}
+
+//------------------------------------------------------------------------------
+bool RenderBufferCache::IsRetired(const CacheEntry* entry) const
+{
+    return entry->busyUntilFrame_ <= g_Render->GetCompletedFrame();
 }
 
 //------------------------------------------------------------------------------
 RESULT RenderBufferCache::Init()
 {
-    CacheEntry entry;
-    if (HS_FAILED(MakeEntry(entry)))
+    CacheEntry* entry;
+    if (HS_FAILED(MakeEntry(blockSize_, entry)))
         return R_FAIL;
 
-    entries_.Add(entry);
+    ring_.Add(entry);
+    head_ = 0;
+    current_ = entry;
 
     return R_OK;
 }
 
 //------------------------------------------------------------------------------
-RenderBufferEntry RenderBufferCache::BeginAlloc(int size, int align, void** data)
+void RenderBufferCache::SwitchEntry()
 {
-    align = Max(align, minAlignment_);
-    entries_.Front().begin_ = Align(entries_.Front().begin_, align);
+    // The block we leave may have been written this frame
+    current_->busyUntilFrame_ = g_Render->GetCurrentFrame() + 1;
 
-    if ((int)BUFFER_SIZE - (int)entries_.Front().begin_ < (int)size)
+    // The block after head is the least recently used one
+    const int next = (head_ + 1) % ring_.Count();
+    if (next != head_ && IsRetired(ring_[next]))
+    {
+        head_ = next;
+        AtomicIncrement(&frameWraps_);
+    }
+    else
     {
-        if (entries_.Back().safeToUseFrame_ <= g_Render->GetCurrentFrame())
+        CacheEntry* newEntry;
+        if (HS_FAILED(MakeEntry(blockSize_, newEntry)))
         {
-            auto last = entries_.Back();
-            entries_.Insert(0, last);
-            entries_.RemoveBack();
-            entries_.Front().begin_ = 0;
+            LOG_ERR("Failed to create new buffer entry");
+            HS_ASSERT(false);
+            return;
         }
-        else
+
+        ++head_;
+        ring_.Insert(head_, newEntry);
+        AtomicIncrement(&frameGrows_);
+    }
+
+    CacheEntry* entry = ring_[head_];
+    AtomicStore(&entry->begin_, 0);
+    AtomicStorePtr(&current_, entry);
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry RenderBufferCache::AllocOversize(int size, void** data)
+{
+    std::lock_guard<std::mutex> lock(switchLock_);
+
+    // Smallest retired buffer which fits
+    CacheEntry* entry{};
+    for (int i = 0; i < oversize_.Count(); ++i)
+    {
+        CacheEntry* candidate = oversize_[i];
+        if (candidate->size_ >= size && IsRetired(candidate) && (!entry || candidate->size_ < entry->size_))
+            entry = candidate;
+    }
+
+    if (!entry)
+    {
+        if (HS_FAILED(MakeEntry((int)Align(size, blockSize_), entry)))
         {
-            CacheEntry newEntry;
-            if (HS_FAILED(MakeEntry(newEntry)))
-            {
-                LOG_ERR("Failed to create new buffer entry");
-                HS_ASSERT(false);
-                return {};
-            }
-            entries_.Insert(0, newEntry);
+            LOG_ERR("Failed to create oversize buffer entry");
+            HS_ASSERT(false);
+            return {};
         }
+        oversize_.Add(entry);
     }
 
+    entry->busyUntilFrame_ = g_Render->GetCurrentFrame() + 1;
+    entry->begin_ = size;
+
+    AtomicAdd(&frameBytes_, size);
+    AtomicIncrement(&frameAllocs_);
+    AtomicIncrement(&frameOversize_);
+
+    *data = entry->mapped_;
+
     RenderBufferEntry result;
-    result.buffer_ = entries_.Front().buffer_->GetBuffer();
-    result.offset_ = entries_.Front().begin_;
+    result.buffer_ = entry->buffer_->GetBuffer();
+    result.offset_ = 0;
     result.size_ = size;
+    return result;
+}
+
+//------------------------------------------------------------------------------
+RenderBufferEntry RenderBufferCache::BeginAlloc(int size, int align, void** data)
+{
+    HS_ASSERT(size >= 0);
 
-    *data = (uint8*)entries_.Front().buffer_->Map() + entries_.Front().begin_;
+    align = Max(align, minAlignment_);
 
-    entries_.Front().safeToUseFrame_ = g_Render->GetSafeFrame();
-    entries_.Front().begin_ += size;
+    if (size > blockSize_)
+        return AllocOversize(size, data);
 
-    return result;
+    for (;;)
+    {
+        CacheEntry* entry = AtomicLoadPtr(&current_);
+
+        int begin = AtomicLoad(&entry->begin_);
+        for (;;)
+        {
+            const int alignedBegin = (int)Align(begin, align);
+            const int end = alignedBegin + size;
+            if (end > blockSize_)
+                break;
+
+            const int oldBegin = AtomicCompareExchange(&entry->begin_, end, begin);
+            if (oldBegin == begin)
+            {
+                AtomicAdd(&frameBytes_, size);
+                AtomicIncrement(&frameAllocs_);
+
+                *data = entry->mapped_ + alignedBegin;
+
+                RenderBufferEntry result;
+                result.buffer_ = entry->buffer_->GetBuffer();
+                result.offset_ = alignedBegin;
+                result.size_ = size;
+                return result;
+            }
+
+            begin = oldBegin;
+        }
+
+        // Block is full, whoever gets the lock first switches it, the rest just retries
+        std::lock_guard<std::mutex> lock(switchLock_);
+        if (AtomicLoadPtr(&current_) == entry)
+            SwitchEntry();
+    }
 }
 
 //------------------------------------------------------------------------------
 void RenderBufferCache::EndAlloc()
 {
-    entries_.Front().buffer_->Unmap();
+}
+
+//------------------------------------------------------------------------------
+void RenderBufferCache::EndFrame()
+{
+    std::lock_guard<std::mutex> lock(switchLock_);
+
+    current_->busyUntilFrame_ = g_Render->GetCurrentFrame() + 1;
+
+    // Release oversize buffers nobody asked for in a while so spikes don't stick
+    const uint64 completedFrame = g_Render->GetCompletedFrame();
+    for (int i = oversize_.Count() - 1; i >= 0; --i)
+    {
+        if (oversize_[i]->busyUntilFrame_ + OVERSIZE_KEEP_FRAMES <= completedFrame)
+        {
+            FreeEntry(oversize_[i]);
+            oversize_.Remove(i);
+        }
+    }
+
+    stats_.bytesAllocated_ = (uint64)AtomicExchange(&frameBytes_, 0);
+    stats_.allocCount_ = (uint)AtomicExchange(&frameAllocs_, 0);
+    stats_.wrapCount_ = (uint)AtomicExchange(&frameWraps_, 0);
+    stats_.growCount_ = (uint)AtomicExchange(&frameGrows_, 0);
+    stats_.oversizeCount_ = (uint)AtomicExchange(&frameOversize_, 0);
+    stats_.bufferCount_ = (uint)ring_.Count();
+
+    stats_.buffersInFlight_ = 0;
+    for (int i = 0; i < ring_.Count(); ++i)
+    {
+        if (!IsRetired(ring_[i]))
+            ++stats_.buffersInFlight_;
+    }
+    for (int i = 0; i < oversize_.Count(); ++i)
+    {
+        if (!IsRetired(oversize_[i]))
+            ++stats_.buffersInFlight_;
+    }
 }
 
 //------------------------------------------------------------------------------
 uint RenderBufferCache::GetMaxSize() const
 {
-    return BUFFER_SIZE;
+    return (uint)blockSize_;
 }
 
 //------------------------------------------------------------------------------
 int RenderBufferCache::GetRemainingBufferSize(uint align) const
 {
-    return (int)BUFFER_SIZE - (int)Align(entries_.Front().begin_, align);
+    const CacheEntry* entry = AtomicLoadPtr(&current_);
+    return blockSize_ - (int)Align(AtomicLoad(&entry->begin_), Max(align, (uint)minAlignment_));
+}
+
+//------------------------------------------------------------------------------
+const RenderBufferCacheStats& RenderBufferCache::GetStats() const
+{
+    return stats_;
 }
 
 }
@@ -14,6 +14,7 @@ namespace hs
 //------------------------------------------------------------------------------
 static constexpr const char* FRAG_EXT = "fs";
 static constexpr const char* VERT_EXT = "vs";
+static constexpr const char* COMP_EXT = "cs";
 //static constexpr const char* PATH_PREFIX = "../Engine/Shaders/%s";
 static constexpr const char* SHADER_BIN_DIR = "Shaders";
 
@@ -68,6 +69,10 @@ RESULT ShaderManager::Init()
 //------------------------------------------------------------------------------
 ShaderManager::~ShaderManager()
 {
+    // The null backend creates no modules
+    if (g_Render->IsNull())
+        return;
+
     for (const auto& it : cache_)
         vkDestroyShaderModule(g_Render->GetDevice(), it.second->vkShader_, nullptr);
     cache_.clear();
@@ -94,6 +99,10 @@ Result<PipelineStage> GetTypeFromName(const char* name)
     {
         stage = PS_VERT;
     }
+    else if (strncmp(ext, COMP_EXT, 2) == 0)
+    {
+        stage = PS_COMP;
+    }
     else
     {
         Log(LogLevel::Error, "Invalid shader stage extension %s", ext);
@@ -124,7 +133,9 @@ Shader* ShaderManager::GetOrCreateShader(const char* name)
         return nullptr;
     }
 
-    cache_.emplace(name, shader);
+    // Key must outlive the caller's string
+    shader->name_ = String(name);
+    cache_.emplace(shader->name_.Data(), shader);
 
     return shader;
 }
@@ -205,6 +216,14 @@ RESULT ShaderManager::ReloadShaders()
 //------------------------------------------------------------------------------
 RESULT ShaderManager::LoadShader(const char* name, PipelineStage type, Shader* shader)
 {
+    // Shaders only need their identity for pipeline keys, the bytecode is not read
+    if (g_Render->IsNull())
+    {
+        shader->id_ = ++shaderId_[type];
+        shader->type_ = type;
+        return R_OK;
+    }
+
     char filePath[256];
     sprintf(filePath, "%s/%s.spv", SHADER_BIN_DIR, name);
 
@@ -3,10 +3,13 @@
 #include "Render/Render.h"
 #include "Render/Allocator.h"
 #include "Render/Buffer.h"
+#include "Render/RenderBufferCache.h"
 #include "Common/Logging.h"
 
 #include "Render/Image.h"
 
+#include <cstring>
+
 namespace hs
 {
 
@@ -100,6 +103,13 @@ static int FormatBytesPerPixel(VkFormat format)
 //------------------------------------------------------------------------------
 RESULT Texture::Allocate(const void** data, const char* diagName) // TODO(pavel): This is a terrible API with the void**, callers need to cast.
 {
+    // Only the bindless index is visible to the rest of the render
+    if (g_Render->IsNull())
+    {
+        bindlessIdx_ = g_Render->AddBindlessTexture(VK_NULL_HANDLE);
+        return R_OK;
+    }
+
     VkImageLayout initLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VkImageCreateInfo imgInfo{};
@@ -165,12 +175,16 @@ RESULT Texture::Allocate(const void** data, const char* diagName) // TODO(pavel)
         for (uint i = 0; i < imgInfo.arrayLayers; ++i)
         {
             uint buffSize = size_.width * size_.height * bpp;
-            TempStagingBuffer staging(buffSize);
-            if (HS_FAILED(staging.Allocate(data[i])))
+            void* mapped{};
+            const RenderBufferEntry staging = g_Render->GetStagingCache()->BeginAlloc((int)buffSize, 16, &mapped);
+            if (!staging.buffer_)
                 return R_FAIL;
 
+            memcpy(mapped, data[i], buffSize);
+            g_Render->GetStagingCache()->EndAlloc();
+
             VkBufferImageCopy region{};
-            region.bufferOffset = 0;
+            region.bufferOffset = staging.offset_;
             region.bufferRowLength = 0;
             region.bufferImageHeight = 0;
 
@@ -182,7 +196,7 @@ RESULT Texture::Allocate(const void** data, const char* diagName) // TODO(pavel)
             region.imageOffset = { 0, 0, 0 };
             region.imageExtent = size_;
 
-            vkCmdCopyBufferToImage(g_Render->CmdBuff(), staging.GetBuffer(), image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            vkCmdCopyBufferToImage(g_Render->CmdBuff(), staging.buffer_, image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
         }
 
         g_Render->TransitionBarrier(
@@ -209,6 +223,9 @@ RESULT Texture::Allocate(const void** data, const char* diagName) // TODO(pavel)
 //------------------------------------------------------------------------------
 void Texture::Free()
 {
+    if (g_Render->IsNull())
+        return;
+
     vkDestroyImageView(g_Render->GetDevice(), srv_, nullptr);
     vmaDestroyImage(g_Render->GetAllocator(), image_, allocation_);
 }
@@ -0,0 +1,236 @@
+#include "System/FrameArena.h"
+
+#include "System/Memory.h"
+#include "Threading/Atomic.h"
+#include "Common/Logging.h"
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+FrameArena* g_FrameArena{};
+
+//------------------------------------------------------------------------------
+RESULT CreateFrameArena()
+{
+    g_FrameArena = new FrameArena();
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void DestroyFrameArena()
+{
+    if (!g_FrameArena)
+        return;
+
+    g_FrameArena->Free();
+    delete g_FrameArena;
+    g_FrameArena = nullptr;
+}
+
+//------------------------------------------------------------------------------
+static constexpr uint64 BLOCK_ALIGNMENT = 64;
+
+//------------------------------------------------------------------------------
+static uint64 AlignUp(uint64 x, uint64 alignment)
+{
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+//------------------------------------------------------------------------------
+RESULT FrameArena::Init(uint64 capacity, uint frameCount)
+{
+    HS_ASSERT(capacity > 0 && capacity < (1ull << 31));
+
+    if (frameCount == 0 || frameCount > MAX_FRAME_COUNT)
+    {
+        LOG_ERR("Frame arena supports 1 to %u frames, got %u", MAX_FRAME_COUNT, frameCount);
+        return R_FAIL;
+    }
+    frameCount_ = frameCount;
+
+    capacity = AlignUp(capacity, BLOCK_ALIGNMENT);
+    for (uint i = 0; i < frameCount_; ++i)
+    {
+        blocks_[i].memory_ = static_cast<uint8*>(AllocAligned(capacity, BLOCK_ALIGNMENT));
+        if (!blocks_[i].memory_)
+            return R_FAIL;
+
+        blocks_[i].capacity_ = static_cast<int>(capacity);
+        blocks_[i].top_ = 0;
+        blocks_[i].allocCount_ = 0;
+        blocks_[i].frame_ = i;
+    }
+
+    currentBlock_ = 0;
+    frame_ = 0;
+    stats_ = {};
+    stats_.capacity_ = capacity;
+    frameStartHeapAllocs_ = GetHeapAllocCount();
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void FrameArena::Free()
+{
+    for (uint i = 0; i < frameCount_; ++i)
+    {
+        Block& block = blocks_[i];
+        for (void* overflow : block.overflow_)
+            FreeAligned(overflow);
+        block.overflow_.Clear();
+
+        FreeAligned(block.memory_);
+        block.memory_ = nullptr;
+        block.capacity_ = 0;
+        block.top_ = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+void FrameArena::BeginFrame(uint64 frame)
+{
+    HS_ASSERT(frame > frame_ || (frame == 0 && frame_ == 0));
+
+    const Block& finished = blocks_[currentBlock_];
+    stats_.bytesAllocated_ = static_cast<uint64>(AtomicLoad(&finished.top_)) + finished.overflowBytes_;
+    stats_.allocCount_ = static_cast<uint>(AtomicLoad(&finished.allocCount_));
+    stats_.overflowCount_ = static_cast<uint>(finished.overflow_.Count());
+
+    const int heapAllocs = GetHeapAllocCount();
+    stats_.heapAllocCount_ = static_cast<uint>(heapAllocs - frameStartHeapAllocs_);
+
+    frame_ = frame;
+    currentBlock_ = static_cast<uint>(frame % frameCount_);
+
+    Block& block = blocks_[currentBlock_];
+    HS_ASSERT(frame >= block.frame_ + frameCount_ || frame == block.frame_);
+
+    for (void* overflow : block.overflow_)
+        FreeAligned(overflow);
+    block.overflow_.Clear();
+
+    // Grow so the load that overflowed fits next time
+    if (block.overflowBytes_)
+    {
+        const uint64 newCapacity = AlignUp(Max<uint64>(block.capacity_ * 2ull, block.top_ + block.overflowBytes_), BLOCK_ALIGNMENT);
+        HS_ASSERT(newCapacity < (1ull << 31));
+
+        LOG_DBG("Frame arena growing from %d to %llu bytes", block.capacity_, (unsigned long long)newCapacity);
+
+        uint8* newMemory = static_cast<uint8*>(AllocAligned(newCapacity, BLOCK_ALIGNMENT));
+        if (newMemory)
+        {
+            FreeAligned(block.memory_);
+            block.memory_ = newMemory;
+            block.capacity_ = static_cast<int>(newCapacity);
+            stats_.capacity_ = Max(stats_.capacity_, newCapacity);
+        }
+        else
+        {
+            // Keep the old block, the frames that do not fit keep spilling to the heap
+            HS_ASSERT(!"Failed to grow the frame arena");
+            LOG_ERR("Failed to grow the frame arena from %d to %llu bytes", block.capacity_, (unsigned long long)newCapacity);
+        }
+    }
+
+    #if HS_DEBUG
+        // Make use of stale frame memory obvious
+        memset(block.memory_, 0xcd, block.top_);
+    #endif
+
+    block.top_ = 0;
+    block.allocCount_ = 0;
+    block.overflowBytes_ = 0;
+    block.frame_ = frame;
+
+    // Measured after our own reset allocations so the steady state reads zero
+    frameStartHeapAllocs_ = GetHeapAllocCount();
+}
+
+//------------------------------------------------------------------------------
+void* FrameArena::Alloc(uint64 size, uint64 alignment)
+{
+    HS_ASSERT(IsPow2(alignment) && alignment <= BLOCK_ALIGNMENT);
+
+    Block& block = blocks_[currentBlock_];
+    AtomicIncrement(&block.allocCount_);
+
+    // Bump with CAS so top_ is always the exact end of the last allocation which TryGrow relies on
+    int top = AtomicLoad(&block.top_);
+    for (;;)
+    {
+        const uint64 begin = AlignUp(static_cast<uint64>(top), alignment);
+        const uint64 end = begin + size;
+        if (end > static_cast<uint64>(block.capacity_))
+            break;
+
+        const int oldTop = AtomicCompareExchange(&block.top_, static_cast<int>(end), top);
+        if (oldTop == top)
+            return block.memory_ + begin;
+
+        top = oldTop;
+    }
+
+    return AllocOverflow(block, size, alignment);
+}
+
+//------------------------------------------------------------------------------
+void* FrameArena::AllocOverflow(Block& block, uint64 size, uint64 alignment)
+{
+    std::lock_guard<std::mutex> lock(overflowLock_);
+
+    void* memory = AllocAligned(size, alignment);
+    block.overflow_.Add(memory);
+    block.overflowBytes_ += size;
+
+    return memory;
+}
+
+//------------------------------------------------------------------------------
+bool FrameArena::TryGrow(void* memory, uint64 oldSize, uint64 newSize)
+{
+    HS_ASSERT(newSize >= oldSize);
+
+    Block& block = blocks_[currentBlock_];
+    if (!Owns(memory))
+        return false;
+
+    const uint64 begin = static_cast<uint8*>(memory) - block.memory_;
+    const uint64 newEnd = begin + newSize;
+    if (newEnd > static_cast<uint64>(block.capacity_))
+        return false;
+
+    // Only the allocation at the top can grow, fails if anyone allocated since
+    const int oldEnd = static_cast<int>(begin + oldSize);
+    return AtomicCompareExchange(&block.top_, static_cast<int>(newEnd), oldEnd) == oldEnd;
+}
+
+//------------------------------------------------------------------------------
+bool FrameArena::Owns(const void* memory) const
+{
+    const Block& block = blocks_[currentBlock_];
+    return memory >= block.memory_ && memory < block.memory_ + block.capacity_;
+}
+
+//------------------------------------------------------------------------------
+uint64 FrameArena::GetCurrentFrame() const
+{
+    return frame_;
+}
+
+//------------------------------------------------------------------------------
+uint FrameArena::GetFrameCount() const
+{
+    return frameCount_;
+}
+
+//------------------------------------------------------------------------------
+const FrameArenaStats& FrameArena::GetStats() const
+{
+    return stats_;
+}
+
+}
@@ -1,6 +1,7 @@
 #include "System/Memory.h"
 
 #include "Math/Math.h"
+#include "Threading/Atomic.h"
 
 #include <cstdlib>
 #include <cstring>
@@ -8,9 +9,19 @@
 namespace hs
 {
 
+//------------------------------------------------------------------------------
+static int g_HeapAllocCount{};
+
+//------------------------------------------------------------------------------
+int GetHeapAllocCount()
+{
+    return AtomicLoad(&g_HeapAllocCount);
+}
+
 //------------------------------------------------------------------------------
 void* Alloc(uint64 size)
 {
+    AtomicIncrement(&g_HeapAllocCount);
     return std::malloc(size);
 }
 
@@ -18,6 +29,7 @@ void* Alloc(uint64 size)
 void* AllocAligned(uint64 size, uint64 alignment)
 {
     HS_ASSERT(IsPow2(alignment));
+    AtomicIncrement(&g_HeapAllocCount);
 
     size = Align(size, alignment);
 
@@ -31,6 +43,7 @@ void* AllocAligned(uint64 size, uint64 alignment)
 //------------------------------------------------------------------------------
 void* Realloc(void* memory, uint64 newSize)
 {
+    AtomicIncrement(&g_HeapAllocCount);
     return realloc(memory, newSize);
 }
 
@@ -38,16 +51,22 @@ void* Realloc(void* memory, uint64 newSize)
 void* ReallocAligned(void* memory, uint64 oldSize, uint64 newSize, uint64 alignment)
 {
     HS_ASSERT(IsPow2(alignment));
+    AtomicIncrement(&g_HeapAllocCount);
 
     newSize = Align(newSize, alignment);
 
     #if HS_WINDOWS
         return _aligned_realloc(memory, newSize, alignment);
     #else
-        realloc(memory, newSize);
-        //void* newMemory = std::aligned_alloc(alignment, newSize);
-        //memcpy(newMemory, memory, oldSize);
-        //std::free(memory);
+        // Like realloc the old memory stays valid when the allocation fails
+        void* newMemory = std::aligned_alloc(alignment, newSize);
+        if (!newMemory)
+            return nullptr;
+
+        if (memory)
+            memcpy(newMemory, memory, Min(oldSize, newSize));
+        std::free(memory);
+        return newMemory;
     #endif
 }
 
@@ -0,0 +1,346 @@
+#include "System/Profiler.h"
+
+#include "Threading/Atomic.h"
+#include "Common/Logging.h"
+
+#include "imgui/imgui.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+Profiler* g_Profiler{};
+
+//------------------------------------------------------------------------------
+RESULT CreateProfiler()
+{
+    g_Profiler = new Profiler();
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void DestroyProfiler()
+{
+    if (!g_Profiler)
+        return;
+
+    g_Profiler->Free();
+    delete g_Profiler;
+    g_Profiler = nullptr;
+}
+
+//------------------------------------------------------------------------------
+uint Profiler::s_Generation{};
+
+//------------------------------------------------------------------------------
+static thread_local Profiler::ThreadBuffer* t_Buffer{};
+static thread_local uint t_Generation{};
+
+//------------------------------------------------------------------------------
+static constexpr uint64 EVENT_MASK = Profiler::THREAD_EVENT_COUNT - 1;
+static_assert((Profiler::THREAD_EVENT_COUNT & EVENT_MASK) == 0, "Event count must be a power of two");
+
+//------------------------------------------------------------------------------
+RESULT Profiler::Init()
+{
+    generation_ = ++s_Generation;
+    startNs_ = GetTimeNs();
+    frameCount_ = 0;
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void Profiler::Free()
+{
+    // No thread may be inside a scope anymore, the buffers they cached are freed here
+    for (int i = 0; i < threadCount_; ++i)
+    {
+        delete threads_[i];
+        threads_[i] = nullptr;
+    }
+    threadCount_ = 0;
+    flameThreads_.Clear();
+}
+
+//------------------------------------------------------------------------------
+void Profiler::BeginFrame()
+{
+    frameStarts_[frameCount_ % FRAME_HISTORY] = GetTimeNs();
+    ++frameCount_;
+}
+
+//------------------------------------------------------------------------------
+Profiler::ThreadBuffer* Profiler::RegisterThread()
+{
+    std::lock_guard<std::mutex> lock(registerLock_);
+
+    t_Generation = generation_;
+    t_Buffer = nullptr;
+
+    if (threadCount_ >= (int)MAX_THREADS)
+    {
+        LOG_WARN("Profiler supports at most %u threads, events of the others are dropped", MAX_THREADS);
+        return nullptr;
+    }
+
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->threadIdx_ = threadCount_;
+    snprintf(buffer->name_, sizeof(buffer->name_), "Thread %d", threadCount_);
+
+    threads_[threadCount_] = buffer;
+    AtomicStore(&threadCount_, threadCount_ + 1);
+
+    t_Buffer = buffer;
+    return buffer;
+}
+
+//------------------------------------------------------------------------------
+void Profiler::SetThreadName(const char* name)
+{
+    ThreadBuffer* buffer = t_Generation == generation_ ? t_Buffer : RegisterThread();
+    if (!buffer)
+        return;
+
+    strncpy(buffer->name_, name, sizeof(buffer->name_) - 1);
+}
+
+//------------------------------------------------------------------------------
+Profiler::ThreadBuffer* Profiler::BeginEvent()
+{
+    ThreadBuffer* buffer = t_Generation == generation_ ? t_Buffer : RegisterThread();
+    if (buffer)
+        ++buffer->depth_;
+
+    return buffer;
+}
+
+//------------------------------------------------------------------------------
+void Profiler::EndEvent(ThreadBuffer* buffer, const char* name, uint64 startNs)
+{
+    const uint64 endNs = GetTimeNs();
+
+    HS_ASSERT(buffer->depth_ > 0);
+    --buffer->depth_;
+
+    // Only this thread writes the buffer, readers see the event once the count is published
+    const uint64 writeIdx = buffer->writeCount_;
+    buffer->events_[writeIdx & EVENT_MASK] = ProfileEvent{ name, startNs, endNs, buffer->depth_ };
+    AtomicStore(&buffer->writeCount_, writeIdx + 1);
+}
+
+//------------------------------------------------------------------------------
+void Profiler::CollectEvents(uint64 fromNs, uint64 toNs, Array<ProfileThreadEvents>& threads) const
+{
+    threads.Clear();
+
+    Array<ProfileEvent> newestFirst;
+    const int threadCount = AtomicLoad(&threadCount_);
+    for (int t = 0; t < threadCount; ++t)
+    {
+        const ThreadBuffer* buffer = threads_[t];
+
+        const uint64 writeCount = AtomicLoad(&buffer->writeCount_);
+        const uint64 first = writeCount > THREAD_EVENT_COUNT ? writeCount - THREAD_EVENT_COUNT : 0;
+
+        // Events are stored in the order they ended, walk back until they end before the range
+        newestFirst.Clear();
+        uint64 idx = writeCount;
+        while (idx > first)
+        {
+            const ProfileEvent& event = buffer->events_[(idx - 1) & EVENT_MASK];
+            if (event.endNs_ < fromNs)
+                break;
+
+            newestFirst.Add(event);
+            --idx;
+        }
+
+        // The writer may have overwritten the oldest events while we copied them
+        const uint64 writeCountAfter = AtomicLoad(&buffer->writeCount_);
+        const uint64 validFirst = writeCountAfter >= THREAD_EVENT_COUNT ? writeCountAfter - THREAD_EVENT_COUNT + 1 : 0;
+        int validCount = newestFirst.Count();
+        if (idx < validFirst)
+            validCount -= (int)Min<uint64>(validFirst - idx, (uint64)validCount);
+
+        threads.Add(ProfileThreadEvents{});
+        ProfileThreadEvents& thread = threads.Back();
+        thread.threadName_ = buffer->name_;
+        thread.threadIdx_ = buffer->threadIdx_;
+        for (int i = validCount - 1; i >= 0; --i)
+        {
+            if (newestFirst[i].startNs_ < toNs)
+                thread.events_.Add(newestFirst[i]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool Profiler::GetFrameRange(uint frameAgo, uint64& startNs, uint64& endNs) const
+{
+    // The last started frame is not finished yet
+    if (frameAgo + 1 >= FRAME_HISTORY || frameAgo + 2 > frameCount_)
+        return false;
+
+    const uint64 frame = frameCount_ - 2 - frameAgo;
+    startNs = frameStarts_[frame % FRAME_HISTORY];
+    endNs = frameStarts_[(frame + 1) % FRAME_HISTORY];
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void WriteJsonString(FILE* f, const char* str)
+{
+    fputc('"', f);
+    for (const char* c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', f);
+        if ((unsigned char)*c >= 0x20)
+            fputc(*c, f);
+    }
+    fputc('"', f);
+}
+
+//------------------------------------------------------------------------------
+RESULT Profiler::ExportChromeTrace(const char* path) const
+{
+    Array<ProfileThreadEvents> threads;
+    CollectEvents(0, ~0ull, threads);
+
+    FILE* f = fopen(path, "w");
+    if (!f)
+    {
+        LOG_WARN("Failed to open %s for writing", path);
+        return R_FAIL;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    for (int t = 0; t < threads.Count(); ++t)
+    {
+        const ProfileThreadEvents& thread = threads[t];
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread.threadIdx_);
+        WriteJsonString(f, thread.threadName_);
+        fprintf(f, "}}");
+        first = false;
+
+        // Timestamps are in microseconds
+        for (int i = 0; i < thread.events_.Count(); ++i)
+        {
+            const ProfileEvent& event = thread.events_[i];
+            const uint64 startNs = event.startNs_ > startNs_ ? event.startNs_ - startNs_ : 0;
+
+            fprintf(f, ",\n{\"name\":");
+            WriteJsonString(f, event.name_);
+            fprintf(f, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                thread.threadIdx_, startNs / 1000.0, (event.endNs_ - event.startNs_) / 1000.0);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+bool Profiler::IsVisible() const
+{
+    return visible_;
+}
+
+//------------------------------------------------------------------------------
+void Profiler::SetVisible(bool visible)
+{
+    visible_ = visible;
+}
+
+//------------------------------------------------------------------------------
+static ImU32 ScopeColor(const char* name)
+{
+    // FNV-1a so the same scope keeps its color between frames
+    uint hash = 2166136261u;
+    for (const char* c = name; *c; ++c)
+        hash = (hash ^ (uint8)*c) * 16777619u;
+
+    return IM_COL32(80 + (hash & 0x7f), 80 + ((hash >> 8) & 0x7f), 80 + ((hash >> 16) & 0x7f), 255);
+}
+
+//------------------------------------------------------------------------------
+void Profiler::DrawImGui()
+{
+    if (!visible_)
+        return;
+
+    if (!ImGui::Begin("CPU Profiler", &visible_))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Pause", &paused_);
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace"))
+    {
+        if (HS_SUCCEEDED(ExportChromeTrace(TRACE_FILE)))
+            LOG_DBG("CPU trace exported to %s", TRACE_FILE);
+    }
+
+    if (!paused_ && GetFrameRange(0, flameStartNs_, flameEndNs_))
+        CollectEvents(flameStartNs_, flameEndNs_, flameThreads_);
+
+    const double frameNs = (double)(flameEndNs_ - flameStartNs_);
+    ImGui::Text("Frame %.3f ms", frameNs * 1e-6);
+
+    if (frameNs > 0)
+    {
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+
+        for (int t = 0; t < flameThreads_.Count(); ++t)
+        {
+            const ProfileThreadEvents& thread = flameThreads_[t];
+            if (thread.events_.IsEmpty())
+                continue;
+
+            ImGui::TextUnformatted(thread.threadName_);
+
+            const ImVec2 origin = ImGui::GetCursorScreenPos();
+            const float width = Max(ImGui::GetContentRegionAvail().x, 1.0f);
+
+            uint maxDepth = 0;
+            for (int i = 0; i < thread.events_.Count(); ++i)
+            {
+                const ProfileEvent& event = thread.events_[i];
+                maxDepth = Max(maxDepth, event.depth_);
+
+                const double start = (double)(Max(event.startNs_, flameStartNs_) - flameStartNs_);
+                const double end = (double)(Min(event.endNs_, flameEndNs_) - flameStartNs_);
+
+                const ImVec2 min(origin.x + (float)(start / frameNs) * width, origin.y + event.depth_ * rowHeight);
+                const ImVec2 max(Max(origin.x + (float)(end / frameNs) * width, min.x + 1), min.y + rowHeight - 1);
+
+                drawList->AddRectFilled(min, max, ScopeColor(event.name_));
+                if (max.x - min.x > ImGui::CalcTextSize(event.name_).x)
+                    drawList->AddText(ImVec2(min.x + 2, min.y), IM_COL32_BLACK, event.name_);
+
+                if (ImGui::IsMouseHoveringRect(min, max))
+                    ImGui::SetTooltip("%s %.3f ms", event.name_, (event.endNs_ - event.startNs_) * 1e-6);
+            }
+
+            ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+        }
+    }
+
+    ImGui::End();
+}
+
+}
@@ -0,0 +1,424 @@
+#include "Threading/JobSystem.h"
+
+#include "System/Profiler.h"
+#include "Common/Logging.h"
+
+#include <cstdio>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+JobSystem* g_JobSystem{};
+
+//------------------------------------------------------------------------------
+struct Job
+{
+    JobFunc     func_{};
+    void*       data_{};
+    JobCounter* counter_{};
+    Job*        next_{};
+    //! Set once the job finished, the owner thread may then reuse the slot
+    int         free_{ 1 };
+    //! Allocated when all pool slots of the thread were alive, deleted once finished
+    bool        heap_{};
+};
+
+//------------------------------------------------------------------------------
+static thread_local JobSystem* t_JobSystem{};
+static thread_local int t_ThreadIdx{ -1 };
+
+//------------------------------------------------------------------------------
+RESULT CreateJobSystem()
+{
+    g_JobSystem = new JobSystem();
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void DestroyJobSystem()
+{
+    if (!g_JobSystem)
+        return;
+
+    g_JobSystem->Free();
+    delete g_JobSystem;
+    g_JobSystem = nullptr;
+}
+
+//------------------------------------------------------------------------------
+static void SpinLock(int* lock)
+{
+    while (AtomicCompareExchange(lock, 1, 0) != 0)
+        std::this_thread::yield();
+}
+
+//------------------------------------------------------------------------------
+static void SpinUnlock(int* lock)
+{
+    AtomicExchange(lock, 0);
+}
+
+//------------------------------------------------------------------------------
+bool JobDeque::Push(Job* job)
+{
+    const int b = AtomicLoad(&bottom_);
+    if (b - AtomicLoad(&top_) >= CAPACITY)
+        return false;
+
+    jobs_[b & MASK] = job;
+    AtomicStore(&bottom_, b + 1);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+Job* JobDeque::Pop()
+{
+    // Exchange acts as a full barrier so the read of top can't move above the bottom write
+    const int b = AtomicLoad(&bottom_) - 1;
+    AtomicExchange(&bottom_, b);
+    const int t = AtomicLoad(&top_);
+
+    if (t > b)
+    {
+        // Empty
+        AtomicStore(&bottom_, t);
+        return nullptr;
+    }
+
+    Job* job = jobs_[b & MASK];
+    if (t != b)
+        return job;
+
+    // Last item, race against stealers for it
+    if (AtomicCompareExchange(&top_, t + 1, t) != t)
+        job = nullptr;
+
+    AtomicStore(&bottom_, t + 1);
+    return job;
+}
+
+//------------------------------------------------------------------------------
+Job* JobDeque::Steal()
+{
+    const int t = AtomicLoad(&top_);
+    const int b = AtomicLoad(&bottom_);
+    if (t >= b)
+        return nullptr;
+
+    Job* job = jobs_[t & MASK];
+    if (AtomicCompareExchange(&top_, t + 1, t) != t)
+        return nullptr;
+
+    return job;
+}
+
+//------------------------------------------------------------------------------
+int JobDeque::Count() const
+{
+    const int b = AtomicLoad(&bottom_);
+    const int t = AtomicLoad(&top_);
+    return b > t ? b - t : 0;
+}
+
+//------------------------------------------------------------------------------
+RESULT JobSystem::Init(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+
+    threadCount_ = Clamp(threadCount, 1, MAX_THREADS);
+    quit_ = 0;
+    queuedJobs_ = 0;
+    sleepingThreads_ = 0;
+
+    threads_ = new ThreadData[threadCount_];
+    for (int i = 0; i < threadCount_; ++i)
+        threads_[i].jobPool_ = new Job[MAX_THREAD_JOBS];
+
+    t_JobSystem = this;
+    t_ThreadIdx = 0;
+
+    for (int i = 1; i < threadCount_; ++i)
+        threads_[i].thread_ = std::thread(&JobSystem::WorkerMain, this, i);
+
+    LOG_DBG("Job system started with %d threads", threadCount_);
+
+    return R_OK;
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Free()
+{
+    if (!threads_)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        AtomicStore(&quit_, 1);
+    }
+    sleepCv_.notify_all();
+
+    for (int i = 1; i < threadCount_; ++i)
+        threads_[i].thread_.join();
+
+    for (int i = 0; i < threadCount_; ++i)
+        delete[] threads_[i].jobPool_;
+
+    delete[] threads_;
+    threads_ = nullptr;
+    threadCount_ = 0;
+
+    if (t_JobSystem == this)
+    {
+        t_JobSystem = nullptr;
+        t_ThreadIdx = -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+int JobSystem::GetThreadCount() const
+{
+    return threadCount_;
+}
+
+//------------------------------------------------------------------------------
+int JobSystem::GetThreadIdx() const
+{
+    return t_JobSystem == this ? t_ThreadIdx : -1;
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::WorkerMain(JobSystem* system, int threadIdx)
+{
+    t_JobSystem = system;
+    t_ThreadIdx = threadIdx;
+
+    #if HS_PROFILE
+        char threadName[32];
+        snprintf(threadName, sizeof(threadName), "Worker %d", threadIdx);
+        HS_PROFILE_THREAD(threadName);
+    #endif
+
+    constexpr int SPIN_COUNT = 64;
+    int idleSpins = 0;
+
+    while (!AtomicLoad(&system->quit_))
+    {
+        if (Job* job = system->GetJob(threadIdx))
+        {
+            system->Execute(threadIdx, job);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing to do for a while, sleep until new jobs are queued
+        std::unique_lock<std::mutex> lock(system->sleepMutex_);
+        AtomicIncrement(&system->sleepingThreads_);
+        system->sleepCv_.wait(lock, [system]()
+        {
+            return AtomicLoad(&system->queuedJobs_) > 0 || AtomicLoad(&system->quit_);
+        });
+        AtomicDecrement(&system->sleepingThreads_);
+        idleSpins = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+Job* JobSystem::AllocJob(int threadIdx)
+{
+    // Ring buffer, skip slots of jobs still parked on a dependency or running for long
+    ThreadData& data = threads_[threadIdx];
+    for (int i = 0; i < MAX_THREAD_JOBS; ++i)
+    {
+        Job* job = &data.jobPool_[data.jobPoolIdx_ & (MAX_THREAD_JOBS - 1)];
+        ++data.jobPoolIdx_;
+        if (AtomicLoad(&job->free_))
+        {
+            AtomicStore(&job->free_, 0);
+            return job;
+        }
+    }
+
+    // All slots are alive, never overwrite them
+    Job* job = new Job();
+    job->free_ = 0;
+    job->heap_ = true;
+    return job;
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::FreeJob(Job* job)
+{
+    if (job->heap_)
+        delete job;
+    else
+        AtomicStore(&job->free_, 1);
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Enqueue(int threadIdx, Job* job)
+{
+    AtomicIncrement(&queuedJobs_);
+    if (threads_[threadIdx].deque_.Push(job))
+        return;
+
+    // Deque is full, run the job right away instead of dropping it
+    AtomicDecrement(&queuedJobs_);
+    Execute(threadIdx, job);
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::WakeWorkers()
+{
+    // Sleeping counter is incremented under the mutex before the predicate is checked
+    // so either the sleeper sees the queued jobs or we see the sleeper here
+    if (AtomicLoad(&sleepingThreads_) == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    sleepCv_.notify_all();
+}
+
+//------------------------------------------------------------------------------
+Job* JobSystem::GetJob(int threadIdx)
+{
+    Job* job = threads_[threadIdx].deque_.Pop();
+    if (!job)
+    {
+        for (int i = 1; i < threadCount_; ++i)
+        {
+            const int victim = (threadIdx + i) % threadCount_;
+            job = threads_[victim].deque_.Steal();
+            if (job)
+                break;
+        }
+    }
+
+    if (job)
+        AtomicDecrement(&queuedJobs_);
+
+    return job;
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Execute(int threadIdx, Job* job)
+{
+    {
+        HS_PROFILE_SCOPE("Job");
+        job->func_(job->data_);
+    }
+
+    JobCounter* counter = job->counter_;
+    FreeJob(job);
+    if (!counter)
+        return;
+
+    // Decrement under the lock so a waiter can't let the counter go out of scope while we still touch it
+    SpinLock(&counter->lock_);
+    Job* waiting{};
+    if (AtomicDecrement(&counter->value_) == 0)
+    {
+        waiting = counter->waitList_;
+        counter->waitList_ = nullptr;
+    }
+    SpinUnlock(&counter->lock_);
+
+    if (waiting)
+        EnqueueList(threadIdx, waiting);
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::EnqueueList(int threadIdx, Job* job)
+{
+    while (job)
+    {
+        Job* next = job->next_;
+        Enqueue(threadIdx, job);
+        job = next;
+    }
+
+    WakeWorkers();
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Run(const JobDecl* jobs, int count, JobCounter* counter, JobCounter* dependency)
+{
+    const int threadIdx = GetThreadIdx();
+    HS_ASSERT(threadIdx >= 0 && "Jobs can only be dispatched from threads owned by the job system");
+
+    if (count <= 0)
+        return;
+
+    if (counter)
+        AtomicAdd(&counter->value_, count);
+
+    Job* first{};
+    Job* last{};
+    for (int i = 0; i < count; ++i)
+    {
+        Job* job = AllocJob(threadIdx);
+        job->func_ = jobs[i].func_;
+        job->data_ = jobs[i].data_;
+        job->counter_ = counter;
+        job->next_ = nullptr;
+
+        if (last)
+            last->next_ = job;
+        else
+            first = job;
+        last = job;
+    }
+
+    if (dependency)
+    {
+        SpinLock(&dependency->lock_);
+        if (!dependency->IsDone())
+        {
+            // Park the jobs on the dependency, whoever finishes it queues them
+            last->next_ = dependency->waitList_;
+            dependency->waitList_ = first;
+            SpinUnlock(&dependency->lock_);
+            return;
+        }
+        SpinUnlock(&dependency->lock_);
+    }
+
+    EnqueueList(threadIdx, first);
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Run(const JobDecl& job, JobCounter* counter, JobCounter* dependency)
+{
+    Run(&job, 1, counter, dependency);
+}
+
+//------------------------------------------------------------------------------
+void JobSystem::Wait(JobCounter* counter)
+{
+    const int threadIdx = GetThreadIdx();
+    HS_ASSERT(threadIdx >= 0 && "Only threads owned by the job system can wait for jobs");
+
+    while (!counter->IsDone())
+    {
+        if (Job* job = GetJob(threadIdx))
+            Execute(threadIdx, job);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last finishing thread may still hold the lock, don't let the counter go out of scope before it's released
+    SpinLock(&counter->lock_);
+    SpinUnlock(&counter->lock_);
+}
+
+}
@@ -0,0 +1,76 @@
+#include "ShaderStructs/Common.h"
+
+// VkDrawIndexedIndirectCommand
+struct DrawIndexedCommand
+{
+    uint    IndexCount;
+    uint    InstanceCount;
+    uint    FirstIndex;
+    int     VertexOffset;
+    uint    FirstInstance;
+};
+
+[[vk::push_constant]] ConstantBuffer<CullConstants> Cull;
+
+[[vk::binding(0, 0)]] StructuredBuffer<CullObject>              Objects;
+[[vk::binding(1, 0)]] StructuredBuffer<InstanceData>            Instances;
+[[vk::binding(2, 0)]] RWStructuredBuffer<DrawIndexedCommand>    Commands;
+[[vk::binding(3, 0)]] RWStructuredBuffer<uint>                  DrawCounts;
+
+// Same test as the CPU culling, TransformAABB and IsIntersecting(Frustum, AABB)
+bool IsVisible(CullObject object, float4x4 world)
+{
+    if (any(object.BoundsMin.xyz > object.BoundsMax.xyz))
+        return true;
+
+    // C++ rows are HLSL columns so the world matrix transforms column vectors
+    const float3 center = (object.BoundsMin.xyz + object.BoundsMax.xyz) * 0.5;
+    const float3 extents = (object.BoundsMax.xyz - object.BoundsMin.xyz) * 0.5;
+    const float3 worldCenter = mul(world, float4(center, 1)).xyz;
+    const float3 worldExtents = mul(abs((float3x3)world), extents);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const float4 plane = Cull.FrustumPlanes[i];
+        const float dist = dot(plane.xyz, worldCenter) + plane.w;
+        const float radius = dot(abs(plane.xyz), worldExtents);
+        if (dist < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    const uint idx = threadId.x;
+    if (idx >= Cull.ObjectCount)
+        return;
+
+    const CullObject object = Objects[idx];
+    const bool visible = IsVisible(object, Instances[idx].World);
+
+    DrawIndexedCommand command;
+    command.IndexCount      = object.IndexCount;
+    command.InstanceCount   = 1;
+    command.FirstIndex      = object.FirstIndex;
+    command.VertexOffset    = object.VertexOffset;
+    // Instances are in object order, the vertex shader reads the object's world matrix
+    command.FirstInstance   = idx;
+
+    if (Cull.Compact)
+    {
+        if (!visible)
+            return;
+
+        uint slot;
+        InterlockedAdd(DrawCounts[object.Batch], 1, slot);
+        Commands[object.CommandBase + slot] = command;
+    }
+    else
+    {
+        command.InstanceCount = visible ? 1 : 0;
+        Commands[idx] = command;
+    }
+}
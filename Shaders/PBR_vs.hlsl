@@ -5,6 +5,11 @@ struct vs_in
     float3 Pos      : POSITION;
     float3 Normal   : NORMAL;
     float2 UV       : TEXCOORD0;
+    // Per instance world matrix rows
+    float4 World0   : TEXCOORD1;
+    float4 World1   : TEXCOORD2;
+    float4 World2   : TEXCOORD3;
+    float4 World3   : TEXCOORD4;
 };
 
 struct vs_out
@@ -17,14 +22,16 @@ struct vs_out
 };
 
 ConstantBuffer<SceneData>       Scene       : register(b1, space2);
-ConstantBuffer<InstanceData>    Instance    : register(b2, space2);
 
 vs_out main(vs_in vertex)
 {
     vs_out o = (vs_out)0;
 
-    o.Pos = mul(mul(Scene.VP, Instance.World), float4(vertex.Pos, 1));
-    o.WorldPos = mul(Instance.World, float4(vertex.Pos, 1)).xyz;
+    // Same layout the constant buffer used to give us, C++ rows are HLSL columns
+    float4x4 world = transpose(float4x4(vertex.World0, vertex.World1, vertex.World2, vertex.World3));
+
+    o.Pos = mul(mul(Scene.VP, world), float4(vertex.Pos, 1));
+    o.WorldPos = mul(world, float4(vertex.Pos, 1)).xyz;
 
     o.Normal = normalize(vertex.Normal);
 
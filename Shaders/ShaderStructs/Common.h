@@ -17,17 +17,21 @@ namespace hs
     #define Vec3 float3
     #define Vec4 float4
 
-    struct BindingUBO
-    {
-        uint4 SRV[2]; // TODO use constant
-    };
+    // Compute shaders use the push constants for their own data
+    #ifndef CS
+        //! Bindless indices of the SRV slots, pushed by the render when the textures change
+        struct BindingConstants
+        {
+            uint4 SRV[2]; // TODO use constant
+        };
 
-    #define BindingIdx(x) Bindings.SRV[x >> 2][x & 3]
+        #define BindingIdx(x) Bindings.SRV[x >> 2][x & 3]
 
-    Texture2D BindlessTex2D[] : register(t0, space1);
-    ConstantBuffer<BindingUBO> Bindings : register(b0, space2);
+        Texture2D BindlessTex2D[] : register(t0, space1);
+        [[vk::push_constant]] ConstantBuffer<BindingConstants> Bindings;
 
-    #define GetTex2D(x) BindlessTex2D[BindingIdx(x)]
+        #define GetTex2D(x) BindlessTex2D[BindingIdx(x)]
+    #endif
 #endif
 
 #ifdef __cplusplus
@@ -42,12 +46,6 @@ struct SceneData
     Vec4    ViewPos;
 };
 
-//------------------------------------------------------------------------------
-struct SpriteData
-{
-    Mat44 World;
-};
-
 //------------------------------------------------------------------------------
 struct PBRData
 {
@@ -63,6 +61,32 @@ struct InstanceData
     Mat44   World;
 };
 
+//------------------------------------------------------------------------------
+//! Object of the GPU culling pass, its world matrix is the InstanceData at the same index
+struct CullObject
+{
+    //! Object space bounds, min above max for objects which are never culled
+    Vec4    BoundsMin;
+    Vec4    BoundsMax;
+    uint    FirstIndex;
+    uint    IndexCount;
+    int     VertexOffset;
+    //! Commands of the object's batch start here, the number written is in DrawCounts[Batch]
+    uint    CommandBase;
+    uint    Batch;
+    uint    Pad[3];
+};
+
+//------------------------------------------------------------------------------
+struct CullConstants
+{
+    //! Planes as (normal, d) with normals pointing inside
+    Vec4    FrustumPlanes[6];
+    uint    ObjectCount;
+    //! Culled objects keep their command with zero instances when 0, for devices without draw count buffers
+    uint    Compact;
+};
+
 //------------------------------------------------------------------------------
 struct GuiData
 {
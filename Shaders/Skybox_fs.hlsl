@@ -1,4 +1,4 @@
-struct BindingUBO
+struct BindingConstants
 {
     uint4 SRV[2]; // TODO use constant
 };
@@ -6,7 +6,7 @@ struct BindingUBO
 #define BindingIdx(x) Bindings.SRV[x >> 2][x & 3]
 
 TextureCube AllTextures[] : register(t0, space1);
-ConstantBuffer<BindingUBO> Bindings : register(b0, space2);
+[[vk::push_constant]] ConstantBuffer<BindingConstants> Bindings;
 
 SamplerState SamplerSkybox : register(s32, space0);
 
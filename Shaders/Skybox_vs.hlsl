@@ -68,7 +68,8 @@ vs_out main(uint vertID : SV_VERTEXID)
     float4 pos = float4(CubeVerts[CubeIndices[vertID]], 1);
     o.SkyboxCoord = pos;
 
-    o.Pos = mul(View.VP, pos);
+    // Centered on the camera so the view translation cancels out
+    o.Pos = mul(View.VP, float4(pos.xyz + View.ViewPos.xyz, 1));
 
     return o;
 }
@@ -9,4 +9,5 @@ struct ps_in
     #endif
     float2 UV : TEXCOORD0;
     float4 Color : COLOR;
+    nointerpolation uint TexIdx : TEXCOORD1;
 };
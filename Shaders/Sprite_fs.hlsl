@@ -5,7 +5,8 @@ SamplerState PointSampler : register(s0, space0);
 
 float4 main(ps_in input) : SV_Target
 {
-    float4 col = GetTex2D(0).Sample(PointSampler, input.UV.xy);
+    // Sprites of a batch may use different textures
+    float4 col = BindlessTex2D[NonUniformResourceIndex(input.TexIdx)].Sample(PointSampler, input.UV.xy);
     col *= input.Color;
     return col;
 }
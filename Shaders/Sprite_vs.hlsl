@@ -1,23 +1,41 @@
 #include "SpriteCommon.h"
 #include "ShaderStructs/Common.h"
 
-struct vertex
+struct instance
 {
-    float4 Pos : SV_POSITION;
-    float2 UV : TEXCOORD0;
-    float4 Color : COLOR;
+    // World matrix rows
+    float4 World0   : TEXCOORD0;
+    float4 World1   : TEXCOORD1;
+    float4 World2   : TEXCOORD2;
+    float4 World3   : TEXCOORD3;
+    float4 UVBox    : TEXCOORD4;
+    float2 Size     : TEXCOORD5;
+    uint TexIdx     : TEXCOORD6;
+    float4 Color    : COLOR;
 };
 
 ConstantBuffer<SceneData>   Scene   : register(b1, space2);
-ConstantBuffer<SpriteData>  Sprite  : register(b2, space2);
 
-vs_out main(vertex vert)
+// Two triangles, corners of a unit quad
+static const float2 Corners[6] =
+{
+    float2(0, 0), float2(1, 0), float2(1, 1),
+    float2(0, 0), float2(1, 1), float2(0, 1),
+};
+
+vs_out main(instance inst, uint vertexId : SV_VertexID)
 {
     vs_out o;
 
-    o.Pos = mul(mul(Scene.VP, Sprite.World), vert.Pos);
-    o.UV = vert.UV;
-    o.Color = vert.Color;
+    const float2 corner = Corners[vertexId];
+
+    // C++ rows are HLSL columns
+    float4x4 world = transpose(float4x4(inst.World0, inst.World1, inst.World2, inst.World3));
+
+    o.Pos = mul(mul(Scene.VP, world), float4(corner * inst.Size, 0, 1));
+    o.UV = float2(inst.UVBox.x + corner.x * inst.UVBox.z, inst.UVBox.y + (1 - corner.y) * inst.UVBox.w);
+    o.Color = inst.Color;
+    o.TexIdx = inst.TexIdx;
 
     return o;
 }
@@ -1,4 +1,4 @@
-struct BindingUBO
+struct BindingConstants
 {
     uint4 SRV[2]; // TODO use constant
 };
@@ -7,7 +7,7 @@ struct BindingUBO
 
 SamplerState PointSampler : register(s0, space0);
 Texture2D AllTextures[] : register(t0, space1);
-ConstantBuffer<BindingUBO> Bindings : register(b0, space2);
+[[vk::push_constant]] ConstantBuffer<BindingConstants> Bindings;
 
 struct ps_in
 {
@@ -416,6 +416,27 @@ TEST_DEF(Array_Grow_ResizesToPow2)
     tester.TestGrowAfterReserve(test_result);
 }
 
+//------------------------------------------------------------------------------
+TEST_DEF(Array_AddCount_AppendsItemsToWrite)
+{
+    Array<int> a;
+    a.Add(-1);
+
+    int* added = a.AddCount(100);
+    TEST_TRUE(a.Count() == 101);
+    TEST_TRUE(added == a.Data() + 1);
+    for (int i = 0; i < 100; ++i)
+        added[i] = i;
+
+    TEST_TRUE(a[0] == -1);
+    for (int i = 0; i < 100; ++i)
+        TEST_TRUE(a[i + 1] == i);
+
+    // Grows like Add when adding few at a time
+    a.AddCount(a.Capacity() - a.Count() + 1);
+    TEST_TRUE(IsPow2(a.Capacity()));
+}
+
 //------------------------------------------------------------------------------
 TEST_DEF(Array_RangeFor_Works)
 {
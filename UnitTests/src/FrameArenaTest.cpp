@@ -0,0 +1,140 @@
+#include "UnitTests.h"
+
+#include "System/FrameArena.h"
+#include "System/Memory.h"
+
+using namespace hsTest;
+using namespace hs;
+
+TEST_DEF(FrameArena_Alloc_RespectsAlignment)
+{
+    FrameArena arena;
+    TEST_TRUE(HS_SUCCEEDED(arena.Init(4096)));
+
+    void* a = arena.Alloc(3, 1);
+    void* b = arena.Alloc(16, 16);
+    void* c = arena.Alloc(1, 64);
+
+    TEST_TRUE(a && b && c);
+    TEST_TRUE(((uintptr)b & 15) == 0);
+    TEST_TRUE(((uintptr)c & 63) == 0);
+    TEST_TRUE((uint8*)b >= (uint8*)a + 3);
+
+    arena.Free();
+}
+
+TEST_DEF(FrameArena_BeginFrame_ReusesBlockAfterFrameCount)
+{
+    FrameArena arena;
+    TEST_TRUE(HS_SUCCEEDED(arena.Init(4096)));
+
+    void* frame0 = arena.Alloc(64, 16);
+    arena.BeginFrame(1);
+    void* frame1 = arena.Alloc(64, 16);
+    arena.BeginFrame(2);
+    void* frame2 = arena.Alloc(64, 16);
+
+    TEST_TRUE(frame0 != frame1);
+    // Frame 2 reuses the block of frame 0
+    TEST_TRUE(frame0 == frame2);
+
+    arena.Free();
+}
+
+TEST_DEF(FrameArena_BeginFrame_ReusesBlockAfterCustomFrameCount)
+{
+    FrameArena arena;
+    TEST_TRUE(HS_FAILED(arena.Init(4096, FrameArena::MAX_FRAME_COUNT + 1)));
+    TEST_TRUE(HS_SUCCEEDED(arena.Init(4096, 3)));
+    TEST_TRUE(arena.GetFrameCount() == 3);
+
+    void* frame0 = arena.Alloc(64, 16);
+    arena.BeginFrame(1);
+    void* frame1 = arena.Alloc(64, 16);
+    arena.BeginFrame(2);
+    void* frame2 = arena.Alloc(64, 16);
+    arena.BeginFrame(3);
+    void* frame3 = arena.Alloc(64, 16);
+
+    TEST_TRUE(frame0 != frame1 && frame0 != frame2 && frame1 != frame2);
+    // Frame 3 reuses the block of frame 0
+    TEST_TRUE(frame0 == frame3);
+
+    arena.Free();
+}
+
+TEST_DEF(FrameArena_Overflow_GrowsAndStopsAllocating)
+{
+    FrameArena arena;
+    TEST_TRUE(HS_SUCCEEDED(arena.Init(256)));
+
+    uint64 frame = 0;
+    auto simulateFrame = [&]()
+    {
+        for (int i = 0; i < 16; ++i)
+            arena.Alloc(64, 16);
+        arena.BeginFrame(++frame);
+    };
+
+    // First two frames overflow, the blocks grow on reset
+    simulateFrame();
+    TEST_TRUE(arena.GetStats().overflowCount_ > 0);
+    TEST_TRUE(arena.GetStats().heapAllocCount_ > 0);
+    simulateFrame();
+
+    // Steady state
+    for (int i = 0; i < 4; ++i)
+    {
+        simulateFrame();
+        TEST_TRUE(arena.GetStats().overflowCount_ == 0);
+        TEST_TRUE(arena.GetStats().heapAllocCount_ == 0);
+        TEST_TRUE(arena.GetStats().allocCount_ == 16);
+        TEST_TRUE(arena.GetStats().bytesAllocated_ == 16 * 64);
+    }
+
+    arena.Free();
+}
+
+TEST_DEF(FrameArena_TryGrow_OnlyGrowsLastAllocation)
+{
+    FrameArena arena;
+    TEST_TRUE(HS_SUCCEEDED(arena.Init(4096)));
+
+    void* a = arena.Alloc(32, 16);
+    TEST_TRUE(arena.TryGrow(a, 32, 64));
+
+    void* b = arena.Alloc(32, 16);
+    TEST_TRUE((uint8*)b >= (uint8*)a + 64);
+    TEST_FALSE(arena.TryGrow(a, 64, 128));
+    TEST_FALSE(arena.TryGrow(b, 32, 8192));
+
+    arena.Free();
+}
+
+TEST_DEF(FrameArena_FrameArray_NoHeapAllocations)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateFrameArena()));
+    TEST_TRUE(HS_SUCCEEDED(g_FrameArena->Init(64 * 1024)));
+
+    const int heapAllocsBefore = GetHeapAllocCount();
+    {
+        FrameArray<int> ints;
+        for (int i = 0; i < 1000; ++i)
+            ints.Add(i);
+
+        FrameArray<int> copy = ints;
+        ints.Insert(0, -1);
+
+        TEST_TRUE(ints.Count() == 1001);
+        TEST_TRUE(ints[0] == -1);
+        TEST_TRUE(ints[1000] == 999);
+        TEST_TRUE(copy.Count() == 1000);
+        for (int i = 0; i < copy.Count(); ++i)
+            TEST_TRUE(copy[i] == i);
+        TEST_TRUE(g_FrameArena->Owns(ints.Data()));
+    }
+
+    TEST_TRUE(GetHeapAllocCount() == heapAllocsBefore);
+
+    DestroyFrameArena();
+}
@@ -0,0 +1,242 @@
+#include "UnitTests.h"
+
+#include "Threading/JobSystem.h"
+#include "Containers/Array.h"
+
+using namespace hsTest;
+using namespace hs;
+
+//------------------------------------------------------------------------------
+static void IncrementJob(void* data)
+{
+    AtomicIncrement(static_cast<int*>(data));
+}
+
+//------------------------------------------------------------------------------
+struct DependencyData
+{
+    int     firstDone_{};
+    int     secondRun_{};
+    int     orderViolations_{};
+};
+
+//------------------------------------------------------------------------------
+static void FirstStageJob(void* data)
+{
+    AtomicIncrement(&static_cast<DependencyData*>(data)->firstDone_);
+}
+
+//------------------------------------------------------------------------------
+static void SecondStageJob(void* data)
+{
+    auto depData = static_cast<DependencyData*>(data);
+    if (AtomicLoad(&depData->firstDone_) != 64)
+        AtomicIncrement(&depData->orderViolations_);
+    AtomicIncrement(&depData->secondRun_);
+}
+
+TEST_DEF(JobSystem_Run_ExecutesAllJobs)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(4)));
+
+    int value = 0;
+    JobDecl decls[100];
+    for (int i = 0; i < (int)HS_ARR_LEN(decls); ++i)
+        decls[i] = JobDecl{ &IncrementJob, &value };
+
+    JobCounter counter;
+    jobSystem.Run(decls, (int)HS_ARR_LEN(decls), &counter);
+    jobSystem.Wait(&counter);
+
+    TEST_TRUE(counter.IsDone());
+    TEST_TRUE(AtomicLoad(&value) == 100);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_SingleThread_ExecutesOnWait)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(1)));
+
+    int value = 0;
+    JobCounter counter;
+    jobSystem.Run(JobDecl{ &IncrementJob, &value }, &counter);
+
+    TEST_FALSE(counter.IsDone());
+
+    jobSystem.Wait(&counter);
+
+    TEST_TRUE(value == 1);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_Dependency_RunsAfterCounterIsDone)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(4)));
+
+    DependencyData data;
+
+    JobDecl first[64];
+    for (int i = 0; i < (int)HS_ARR_LEN(first); ++i)
+        first[i] = JobDecl{ &FirstStageJob, &data };
+
+    JobDecl second[16];
+    for (int i = 0; i < (int)HS_ARR_LEN(second); ++i)
+        second[i] = JobDecl{ &SecondStageJob, &data };
+
+    JobCounter firstCounter;
+    JobCounter secondCounter;
+    jobSystem.Run(first, (int)HS_ARR_LEN(first), &firstCounter);
+    jobSystem.Run(second, (int)HS_ARR_LEN(second), &secondCounter, &firstCounter);
+    jobSystem.Wait(&secondCounter);
+
+    TEST_TRUE(firstCounter.IsDone());
+    TEST_TRUE(data.firstDone_ == 64);
+    TEST_TRUE(data.secondRun_ == 16);
+    TEST_TRUE(data.orderViolations_ == 0);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_Dependency_AlreadyDoneRunsImmediately)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(2)));
+
+    int value = 0;
+    JobCounter doneCounter;
+    JobCounter counter;
+    jobSystem.Run(JobDecl{ &IncrementJob, &value }, &counter, &doneCounter);
+    jobSystem.Wait(&counter);
+
+    TEST_TRUE(value == 1);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_ParallelFor_VisitsEachItemOnce)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(4)));
+
+    Array<int> items;
+    for (int i = 0; i < 10000; ++i)
+        items.Add(i);
+
+    jobSystem.ParallelFor(MakeSpan(items.Data(), items.Count()), [](int& item)
+    {
+        item = item * 2 + 1;
+    });
+
+    for (int i = 0; i < items.Count(); ++i)
+        TEST_TRUE(items[i] == i * 2 + 1);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_ParallelForChunked_CoversRangeWithBatchSize)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(3)));
+
+    Array<int> items;
+    for (int i = 0; i < 1001; ++i)
+        items.Add(0);
+
+    int chunkCount = 0;
+    int oversizedChunks = 0;
+    jobSystem.ParallelForChunked(MakeSpan(items.Data(), items.Count()), 64, [&](Span<int> chunk)
+    {
+        AtomicIncrement(&chunkCount);
+        if (chunk.Count() > 64)
+            AtomicIncrement(&oversizedChunks);
+
+        for (uint64 i = 0; i < chunk.Count(); ++i)
+            ++chunk[i];
+    });
+
+    TEST_TRUE(chunkCount == 16);
+    TEST_TRUE(oversizedChunks == 0);
+    for (int i = 0; i < items.Count(); ++i)
+        TEST_TRUE(items[i] == 1);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_ParallelFor_EmptySpanDoesNothing)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(2)));
+
+    int calls = 0;
+    jobSystem.ParallelFor(Span<int>(), [&calls](int&)
+    {
+        ++calls;
+    });
+
+    TEST_TRUE(calls == 0);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_NestedParallelFor_Works)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(4)));
+
+    int outer[8]{};
+    int total = 0;
+    jobSystem.ParallelFor(MakeSpan(outer), 1, [&](int&)
+    {
+        int inner[256]{};
+        jobSystem.ParallelFor(MakeSpan(inner), 16, [](int& x)
+        {
+            x = 1;
+        });
+
+        int sum = 0;
+        for (int x : inner)
+            sum += x;
+        AtomicAdd(&total, sum);
+    });
+
+    TEST_TRUE(total == 8 * 256);
+
+    jobSystem.Free();
+}
+
+TEST_DEF(JobSystem_MoreParkedJobsThanPoolSlots_AllRun)
+{
+    JobSystem jobSystem;
+    TEST_TRUE(HS_SUCCEEDED(jobSystem.Init(1)));
+
+    // Single thread, nothing runs before Wait so all jobs stay parked on the dependency
+    int first = 0;
+    JobCounter dependency;
+    jobSystem.Run(JobDecl{ &IncrementJob, &first }, &dependency);
+
+    constexpr int jobCount = JobSystem::MAX_THREAD_JOBS + 100;
+    int value = 0;
+    Array<JobDecl> decls;
+    for (int i = 0; i < jobCount; ++i)
+        decls.Add(JobDecl{ &IncrementJob, &value });
+
+    JobCounter counter;
+    jobSystem.Run(decls.Data(), decls.Count(), &counter, &dependency);
+    jobSystem.Wait(&counter);
+
+    TEST_TRUE(first == 1);
+    TEST_TRUE(value == jobCount);
+
+    // Finished slots are reused
+    jobSystem.Run(decls.Data(), 16, &counter);
+    jobSystem.Wait(&counter);
+
+    TEST_TRUE(value == jobCount + 16);
+
+    jobSystem.Free();
+}
@@ -0,0 +1,197 @@
+#include "UnitTests.h"
+
+#include "Math/Math.h"
+#include "Math/MathBatch.h"
+
+using namespace hsTest;
+using namespace hs;
+
+namespace
+{
+
+constexpr float EPS = 1e-4f;
+
+//------------------------------------------------------------------------------
+bool IsNear(const Mat44& a, const Mat44& b, float eps = EPS)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            if (fabsf(a(i, j) - b(i, j)) > eps * Max(1.0f, fabsf(b(i, j))))
+                return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool IsNear(const Vec4& a, const Vec4& b, float eps = EPS)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        if (fabsf(a.v[i] - b.v[i]) > eps * Max(1.0f, fabsf(b.v[i])))
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+Mat44 MakeGeneral()
+{
+    return Mat44(
+        2, 1, 0, 1,
+        0, 3, 1, 0,
+        1, 0, 4, 2,
+        1, 2, 0, 5
+    );
+}
+
+//------------------------------------------------------------------------------
+Mat44 MakeAffine()
+{
+    const Mat44 rotation = Mat44::RotationRoll(0.7f);
+    const Mat44 scale = Mat44::Scale(2.5f);
+    const Mat44 translation = Mat44::Translation(Vec3(3, -4, 10));
+    return scale * rotation * translation;
+}
+
+}
+
+TEST_DEF(Math_MulMatchesScalar)
+{
+    const Mat44 a = MakeGeneral();
+    const Mat44 b = MakeAffine();
+
+    TEST_TRUE(IsNear(a * b, scalar::Mul(a, b)));
+    TEST_TRUE(IsNear(b * a, scalar::Mul(b, a)));
+    TEST_TRUE(IsNear(a * Mat44::Identity(), a));
+}
+
+TEST_DEF(Math_TransformMatchesScalar)
+{
+    const Mat44 m = MakeGeneral();
+    const Vec4 v(1.5f, -2, 3, 1);
+
+    TEST_TRUE(IsNear(v * m, scalar::Mul(v, m)));
+    TEST_TRUE(IsNear(MakeAffine().TransformPos(Vec3(0, 0, 0)).ToVec4Pos(), Vec4(3, -4, 10, 1)));
+}
+
+TEST_DEF(Math_Transpose)
+{
+    const Mat44 m = MakeGeneral();
+    const Mat44 t = Transpose(m);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+            TEST_TRUE(t(i, j) == m(j, i));
+    }
+    TEST_TRUE(IsNear(t, scalar::Transpose(m)));
+}
+
+TEST_DEF(Math_Inverse)
+{
+    const Mat44 m = MakeGeneral();
+    const Mat44 inverse = Inverse(m);
+
+    TEST_TRUE(IsNear(inverse, scalar::Inverse(m)));
+    TEST_TRUE(IsNear(inverse * m, Mat44::Identity()));
+    TEST_TRUE(IsNear(m * inverse, Mat44::Identity()));
+}
+
+TEST_DEF(Math_InverseAffine)
+{
+    const Mat44 m = MakeAffine();
+    const Mat44 inverse = InverseAffine(m);
+
+    TEST_TRUE(IsNear(inverse, scalar::InverseAffine(m)));
+    TEST_TRUE(IsNear(inverse, Inverse(m)));
+    TEST_TRUE(IsNear(inverse * m, Mat44::Identity()));
+}
+
+TEST_DEF(Math_BatchTransformMatchesPerElement)
+{
+    // Not a multiple of four so the tail is covered as well
+    constexpr int COUNT = 11;
+
+    const Mat44 m = MakeGeneral();
+    Vec3 points[COUNT];
+    Vec4 vectors[COUNT];
+    for (int i = 0; i < COUNT; ++i)
+    {
+        points[i] = Vec3((float)i, -2.0f * i, 0.5f * i + 1);
+        vectors[i] = Vec4(points[i], (float)(i % 3));
+    }
+
+    Vec4 pointsOut[COUNT];
+    Vec3 points3Out[COUNT + 1];
+    points3Out[COUNT] = Vec3(42, 42, 42);
+    Vec4 vectorsOut[COUNT];
+
+    TransformPoints(MakeSpan(points), m, MakeSpan(pointsOut));
+    TransformPoints(MakeSpan(points), m, MakeSpan(points3Out, COUNT));
+    TransformVectors(MakeSpan(vectors), m, MakeSpan(vectorsOut));
+
+    for (int i = 0; i < COUNT; ++i)
+    {
+        const Vec4 expected = scalar::Mul(points[i].ToVec4Pos(), m);
+        TEST_TRUE(IsNear(pointsOut[i], expected));
+        TEST_TRUE(IsNear(points3Out[i].ToVec4Pos(), Vec4(expected.x, expected.y, expected.z, 1)));
+        TEST_TRUE(IsNear(vectorsOut[i], scalar::Mul(vectors[i], m)));
+    }
+
+    // Stores must not spill past the output
+    TEST_TRUE(points3Out[COUNT].x == 42);
+}
+
+TEST_DEF(Math_BatchMultiplyMatrices)
+{
+    const Mat44 a[] = { MakeGeneral(), MakeAffine(), Mat44::Identity() };
+    const Mat44 b[] = { MakeAffine(), MakeGeneral(), MakeGeneral() };
+    Mat44 out[HS_ARR_LEN(a)];
+
+    MultiplyMatrices(MakeSpan(a), MakeSpan(b), MakeSpan(out));
+    for (int i = 0; i < (int)HS_ARR_LEN(a); ++i)
+        TEST_TRUE(IsNear(out[i], scalar::Mul(a[i], b[i])));
+
+    MultiplyMatrices(MakeSpan(a), MakeSpan(b, 1), MakeSpan(out));
+    for (int i = 0; i < (int)HS_ARR_LEN(a); ++i)
+        TEST_TRUE(IsNear(out[i], scalar::Mul(a[i], b[0])));
+}
+
+TEST_DEF(Math_FrustumCulling)
+{
+    const Mat44 view = MakeLookAt(Vec3(0, 0, 0), Vec3(0, 0, 1));
+    const Mat44 projection = MakePerspectiveProjection(HS_PI_HALF, 1, 0.1f, 100);
+    const Frustum frustum = MakeFrustum(view * projection);
+
+    TEST_TRUE(IsIntersecting(frustum, Sphere(Vec3(0, 0, 10), 1)));
+    TEST_TRUE(!IsIntersecting(frustum, Sphere(Vec3(0, 0, -10), 1)));
+    TEST_TRUE(!IsIntersecting(frustum, Sphere(Vec3(0, 0, 200), 1)));
+    TEST_TRUE(IsIntersecting(frustum, Sphere(Vec3(0, 0, 101), 2)));
+
+    const AABB unitBox(Vec3(-1, -1, -1), Vec3(1, 1, 1));
+    TEST_TRUE(IsIntersecting(frustum, TransformAABB(unitBox, Mat44::Translation(Vec3(0, 0, 10)))));
+    TEST_TRUE(!IsIntersecting(frustum, TransformAABB(unitBox, Mat44::Translation(Vec3(30, 0, 10)))));
+    TEST_TRUE(!IsIntersecting(frustum, TransformAABB(unitBox, Mat44::Translation(Vec3(0, -30, 10)))));
+    // Straddling the left plane
+    TEST_TRUE(IsIntersecting(frustum, TransformAABB(unitBox, Mat44::Translation(Vec3(-10.5f, 0, 10)))));
+
+    // Batch culler agrees with the per box test, count is not a multiple of four
+    constexpr int COUNT = 103;
+    AABB boxes[COUNT];
+    uint8 visible[COUNT];
+    uint expectedVisible = 0;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        const Vec3 pos((float)(i % 11) * 7 - 35, (float)(i % 5) * 9 - 18, (float)(i % 13) * 11 - 30);
+        boxes[i] = TransformAABB(unitBox, Mat44::Translation(pos));
+        expectedVisible += IsIntersecting(frustum, boxes[i]) ? 1 : 0;
+    }
+
+    TEST_TRUE(CullBoxes(frustum, MakeSpan(boxes), MakeSpan(visible)) == expectedVisible);
+    for (int i = 0; i < COUNT; ++i)
+        TEST_TRUE((visible[i] != 0) == IsIntersecting(frustum, boxes[i]));
+    TEST_TRUE(expectedVisible > 0 && expectedVisible < COUNT);
+}
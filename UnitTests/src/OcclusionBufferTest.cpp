@@ -0,0 +1,117 @@
+#include "UnitTests.h"
+
+#include "Render/OcclusionBuffer.h"
+
+using namespace hsTest;
+using namespace hs;
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+Mat44 MakeViewProj()
+{
+    const Mat44 view = MakeLookAt(Vec3(0, 0, 0), Vec3(0, 0, 1));
+    const Mat44 projection = MakePerspectiveProjection(HS_PI_HALF, 2, 0.1f, 100);
+    return view * projection;
+}
+
+//------------------------------------------------------------------------------
+//! Square wall facing the camera at distance z
+void AddWall(OcclusionBuffer& buffer, float halfSize, float z)
+{
+    const Vec3 vertices[] = {
+        Vec3(-halfSize, -halfSize, 0),
+        Vec3(halfSize, -halfSize, 0),
+        Vec3(halfSize, halfSize, 0),
+        Vec3(-halfSize, halfSize, 0),
+    };
+    const uint indices[] = { 0, 1, 2, 0, 2, 3 };
+
+    buffer.AddOccluder(MakeSpan(vertices), MakeSpan(indices), Mat44::Translation(Vec3(0, 0, z)));
+}
+
+//------------------------------------------------------------------------------
+AABB MakeBox(const Vec3& center, float halfSize)
+{
+    const Vec3 extents(halfSize, halfSize, halfSize);
+    return AABB(center - extents, center + extents);
+}
+
+}
+
+TEST_DEF(OcclusionBuffer_InitRequiresWholeTiles)
+{
+    OcclusionBuffer buffer;
+    TEST_TRUE(HS_FAILED(buffer.Init(100, 64)));
+    TEST_TRUE(HS_FAILED(buffer.Init(64, 30)));
+    TEST_TRUE(HS_SUCCEEDED(buffer.Init(64, 32)));
+}
+
+TEST_DEF(OcclusionBuffer_NoOccludersAllVisible)
+{
+    OcclusionBuffer buffer;
+    TEST_TRUE(HS_SUCCEEDED(buffer.Init()));
+    buffer.BeginFrame(MakeViewProj());
+    buffer.EndOccluders();
+
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(0, 0, 10), 1)));
+    TEST_TRUE(buffer.GetDepth(buffer.GetWidth() / 2, buffer.GetHeight() / 2) == 1.0f);
+}
+
+TEST_DEF(OcclusionBuffer_WallOccludesBoxesBehind)
+{
+    OcclusionBuffer buffer;
+    TEST_TRUE(HS_SUCCEEDED(buffer.Init()));
+    buffer.BeginFrame(MakeViewProj());
+    AddWall(buffer, 10, 10);
+    buffer.EndOccluders();
+
+    // Wall covers the center of the screen
+    TEST_TRUE(buffer.GetDepth(buffer.GetWidth() / 2, buffer.GetHeight() / 2) < 1.0f);
+
+    TEST_TRUE(!buffer.IsVisible(MakeBox(Vec3(0, 0, 20), 1)));
+    TEST_TRUE(!buffer.IsVisible(MakeBox(Vec3(3, -2, 50), 2)));
+    // In front of the wall
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(0, 0, 5), 1)));
+    // Intersecting the wall
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(0, 0, 10), 1)));
+    // Sticking out past the wall edge
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(19, 0, 20), 2)));
+    // Crossing the near plane
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(0, 0, 0), 1)));
+}
+
+TEST_DEF(OcclusionBuffer_TestBoxesCountsOccluded)
+{
+    OcclusionBuffer buffer;
+    TEST_TRUE(HS_SUCCEEDED(buffer.Init()));
+    buffer.BeginFrame(MakeViewProj());
+    AddWall(buffer, 10, 10);
+    buffer.EndOccluders();
+
+    const AABB boxes[] = {
+        MakeBox(Vec3(0, 0, 20), 1),
+        MakeBox(Vec3(0, 0, 5), 1),
+        MakeBox(Vec3(-2, 2, 30), 1),
+    };
+    uint8 visible[HS_ARR_LEN(boxes)];
+
+    TEST_TRUE(buffer.TestBoxes(MakeSpan(boxes), MakeSpan(visible)) == 1);
+    TEST_TRUE(!visible[0] && visible[1] && !visible[2]);
+    TEST_TRUE(buffer.GetStats().occludedBoxes_ == 2);
+    TEST_TRUE(buffer.GetStats().occluderTriangles_ == 2);
+}
+
+TEST_DEF(OcclusionBuffer_NearPlaneTrianglesAreDropped)
+{
+    OcclusionBuffer buffer;
+    TEST_TRUE(HS_SUCCEEDED(buffer.Init()));
+    buffer.BeginFrame(MakeViewProj());
+    // Wall behind the camera must not occlude anything
+    AddWall(buffer, 10, -5);
+    buffer.EndOccluders();
+
+    TEST_TRUE(buffer.GetStats().clippedTriangles_ == 2);
+    TEST_TRUE(buffer.IsVisible(MakeBox(Vec3(0, 0, 20), 1)));
+}
@@ -0,0 +1,119 @@
+#include "UnitTests.h"
+
+#include "System/Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+using namespace hsTest;
+using namespace hs;
+
+TEST_DEF(Profiler_Scope_RecordsNesting)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateProfiler()));
+    TEST_TRUE(HS_SUCCEEDED(g_Profiler->Init()));
+
+    {
+        ProfileScope outer("Outer");
+        {
+            ProfileScope inner("Inner");
+        }
+    }
+
+    Array<ProfileThreadEvents> threads;
+    g_Profiler->CollectEvents(0, ~0ull, threads);
+
+    TEST_TRUE(threads.Count() == 1);
+    TEST_TRUE(threads[0].events_.Count() == 2);
+
+    // Events are ordered by their end
+    const ProfileEvent& inner = threads[0].events_[0];
+    const ProfileEvent& outer = threads[0].events_[1];
+    TEST_TRUE(strcmp(inner.name_, "Inner") == 0 && inner.depth_ == 1);
+    TEST_TRUE(strcmp(outer.name_, "Outer") == 0 && outer.depth_ == 0);
+    TEST_TRUE(outer.startNs_ <= inner.startNs_ && inner.endNs_ <= outer.endNs_);
+
+    DestroyProfiler();
+}
+
+TEST_DEF(Profiler_Ring_KeepsLatestEvents)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateProfiler()));
+    TEST_TRUE(HS_SUCCEEDED(g_Profiler->Init()));
+
+    uint64 lastStart = 0;
+    for (uint i = 0; i < Profiler::THREAD_EVENT_COUNT + 100; ++i)
+    {
+        lastStart = Profiler::GetTimeNs();
+        ProfileScope scope("Loop");
+    }
+
+    Array<ProfileThreadEvents> threads;
+    g_Profiler->CollectEvents(0, ~0ull, threads);
+
+    TEST_TRUE(threads.Count() == 1);
+    TEST_TRUE(threads[0].events_.Count() <= (int)Profiler::THREAD_EVENT_COUNT);
+    TEST_TRUE(threads[0].events_.Count() >= (int)Profiler::THREAD_EVENT_COUNT - 1);
+    TEST_TRUE(threads[0].events_.Back().startNs_ >= lastStart);
+
+    // Only events overlapping the range
+    threads.Clear();
+    g_Profiler->CollectEvents(lastStart, ~0ull, threads);
+    TEST_TRUE(threads[0].events_.Count() == 1);
+
+    DestroyProfiler();
+}
+
+TEST_DEF(Profiler_Threads_HaveSeparateBuffers)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateProfiler()));
+    TEST_TRUE(HS_SUCCEEDED(g_Profiler->Init()));
+
+    {
+        ProfileScope scope("Main");
+    }
+
+    std::thread worker([]()
+    {
+        g_Profiler->SetThreadName("Worker");
+        ProfileScope scope("Work");
+    });
+    worker.join();
+
+    Array<ProfileThreadEvents> threads;
+    g_Profiler->CollectEvents(0, ~0ull, threads);
+
+    TEST_TRUE(threads.Count() == 2);
+    TEST_TRUE(strcmp(threads[1].threadName_, "Worker") == 0);
+    TEST_TRUE(threads[1].events_.Count() == 1);
+    TEST_TRUE(strcmp(threads[1].events_[0].name_, "Work") == 0);
+
+    DestroyProfiler();
+}
+
+TEST_DEF(Profiler_ExportChromeTrace_WritesEvents)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateProfiler()));
+    TEST_TRUE(HS_SUCCEEDED(g_Profiler->Init()));
+
+    {
+        ProfileScope scope("Exported \"scope\"");
+    }
+
+    const char* path = "ProfilerTestTrace.json";
+    TEST_TRUE(HS_SUCCEEDED(g_Profiler->ExportChromeTrace(path)));
+    DestroyProfiler();
+
+    FILE* f = fopen(path, "r");
+    TEST_TRUE(f);
+
+    char text[1024]{};
+    fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    remove(path);
+
+    TEST_TRUE(strstr(text, "\"traceEvents\""));
+    TEST_TRUE(strstr(text, "\"name\":\"Exported \\\"scope\\\"\",\"ph\":\"X\""));
+    TEST_TRUE(strstr(text, "\"thread_name\""));
+}
@@ -0,0 +1,77 @@
+#include "UnitTests.h"
+
+#include "Containers/RadixSort.h"
+#include "Containers/Array.h"
+
+using namespace hsTest;
+using namespace hs;
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+struct KeyedItem
+{
+    uint64 key_;
+    int order_;
+};
+
+//------------------------------------------------------------------------------
+uint64 GetKey(const KeyedItem& item)
+{
+    return item.key_;
+}
+
+}
+
+TEST_DEF(RadixSort_SortsFullWidthKeys)
+{
+    Array<KeyedItem> items;
+    Array<KeyedItem> scratch;
+
+    uint64 x = 88172645463325252ull;
+    for (int i = 0; i < 1000; ++i)
+    {
+        // xorshift so keys differ in every byte
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        items.Add(KeyedItem{ x, i });
+        scratch.Add({});
+    }
+
+    RadixSort(MakeSpan(items.Data(), items.Count()), MakeSpan(scratch.Data(), scratch.Count()), GetKey);
+
+    for (int i = 1; i < items.Count(); ++i)
+        TEST_TRUE(items[i - 1].key_ <= items[i].key_);
+}
+
+TEST_DEF(RadixSort_IsStable)
+{
+    KeyedItem items[] = {
+        { 3, 0 }, { 1, 1 }, { 3, 2 }, { 0x100, 3 }, { 1, 4 }, { 0, 5 },
+    };
+    KeyedItem scratch[HS_ARR_LEN(items)];
+
+    RadixSort(MakeSpan(items), MakeSpan(scratch), GetKey);
+
+    TEST_TRUE(items[0].order_ == 5);
+    TEST_TRUE(items[1].order_ == 1);
+    TEST_TRUE(items[2].order_ == 4);
+    TEST_TRUE(items[3].order_ == 0);
+    TEST_TRUE(items[4].order_ == 2);
+    TEST_TRUE(items[5].order_ == 3);
+}
+
+TEST_DEF(RadixSort_SameKeysKeepOrder)
+{
+    KeyedItem items[] = {
+        { 7, 0 }, { 7, 1 }, { 7, 2 },
+    };
+    KeyedItem scratch[HS_ARR_LEN(items)];
+
+    RadixSort(MakeSpan(items), MakeSpan(scratch), GetKey);
+
+    for (int i = 0; i < (int)HS_ARR_LEN(items); ++i)
+        TEST_TRUE(items[i].order_ == i);
+}
@@ -0,0 +1,628 @@
+#include "UnitTests.h"
+
+#include "Render/Render.h"
+#include "Render/RenderBufferCache.h"
+#include "Render/GpuCuller.h"
+#include "Render/Material.h"
+#include "Render/ShaderManager.h"
+#include "Game/DebugShapeRenderer.h"
+#include "System/FrameArena.h"
+#include "Threading/JobSystem.h"
+
+#include "imgui/imgui.h"
+
+#include <cstring>
+
+using namespace hsTest;
+using namespace hs;
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+//! Null render with ImGui set up for Update, both destroyed with the scope
+class NullRender
+{
+public:
+    explicit NullRender(const RenderConfig& config = {})
+    {
+        if (HS_FAILED(CreateRender(64, 64, config)) || HS_FAILED(g_Render->InitNull()))
+            return;
+
+        ImGui::CreateContext();
+        ImGui::GetIO().DisplaySize = ImVec2(64, 64);
+        ImGui::GetIO().DeltaTime = 1.0f / 60;
+
+        ok_ = HS_SUCCEEDED(g_Render->InitImgui());
+    }
+
+    ~NullRender()
+    {
+        if (ImGui::GetCurrentContext())
+            ImGui::DestroyContext();
+        if (g_Render)
+            DestroyRender();
+    }
+
+    NullRender(const NullRender&) = delete;
+    NullRender& operator=(const NullRender&) = delete;
+
+    bool IsOk() const
+    {
+        return ok_;
+    }
+
+private:
+    bool ok_{};
+};
+
+//------------------------------------------------------------------------------
+//! Null buffers are host memory at the handle's address
+VkDrawIndexedIndirectCommand* GetBatchCommands(const GpuCullBatch& batch)
+{
+    return (VkDrawIndexedIndirectCommand*)((uintptr)batch.commands_.buffer_ + batch.commands_.offset_);
+}
+
+//------------------------------------------------------------------------------
+uint* GetBatchDrawCount(const GpuCullBatch& batch)
+{
+    return (uint*)((uintptr)batch.drawCount_.buffer_ + batch.drawCount_.offset_);
+}
+
+//------------------------------------------------------------------------------
+//! Objects in and out of the camera's view, drawn with two meshes of different index types from one pool
+struct GpuCullScene
+{
+    PBRMaterial     material_;
+    MeshPool        pool_;
+    Mesh            meshes_[2];
+    VisualObject    objects_[6]{};
+
+    RESULT Init()
+    {
+        if (HS_FAILED(material_.Init()) || HS_FAILED(pool_.Init(sizeof(ObjectVertex), 64, 256)))
+            return R_FAIL;
+
+        const ObjectVertex vertices[4]{};
+        const uint16 indices16[] = { 0, 1, 2, 2, 1, 3 };
+        const uint indices32[] = { 0, 1, 2 };
+
+        if (HS_FAILED(pool_.Add(vertices, 4, indices16, 6, IndexType::U16, meshes_[0]))
+            || HS_FAILED(pool_.Add(vertices, 3, indices32, 3, IndexType::U32, meshes_[1])))
+        {
+            return R_FAIL;
+        }
+
+        // Behind the camera and far to the side are culled, objects without bounds never are
+        const int meshOfObject[] = { 0, 1, 0, 1, 0, 0 };
+        const Vec3 positions[] = { Vec3(0, 0, 0), Vec3(0, 0, -50), Vec3(1, 0, 0), Vec3(0, 0, 2), Vec3(500, 0, 0), Vec3(0, 0, -50) };
+        for (int i = 0; i < (int)HS_ARR_LEN(objects_); ++i)
+        {
+            objects_[i].transform_ = Mat44::Translation(positions[i]);
+            objects_[i].material_ = &material_;
+            objects_[i].mesh_ = meshes_[meshOfObject[i]];
+            objects_[i].bounds_ = AABB(Vec3(-0.5f, -0.5f, -0.5f), Vec3(0.5f, 0.5f, 0.5f));
+        }
+        objects_[5].bounds_ = AABB::Invalid();
+
+        CameraInitAsPerspective(g_Render->GetCamera(), Vec3(0, 0, -5), Vec3(0, 0, 0));
+
+        return R_OK;
+    }
+
+    void Free()
+    {
+        pool_.Free();
+    }
+
+    void RenderFrame()
+    {
+        for (int i = 0; i < (int)HS_ARR_LEN(objects_); ++i)
+            g_Render->RenderObject(&objects_[i]);
+
+        ImGui::NewFrame();
+        g_Render->Update(1.0f / 60);
+    }
+};
+
+}
+
+TEST_DEF(RenderNull_Update_CountsDrawsBindsAndBytes)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateFrameArena()));
+    TEST_TRUE(HS_SUCCEEDED(g_FrameArena->Init()));
+
+    {
+        NullRender render;
+        TEST_TRUE(render.IsOk());
+        TEST_TRUE(g_Render->IsNull());
+
+        const Vec3 line[] = { Vec3{ 0, 0, 0 }, Vec3{ 1, 1, 0 } };
+
+        ImGui::NewFrame();
+        for (int i = 0; i < 3; ++i)
+            g_Render->GetDebugShapeRenderer()->AddShape(MakeSpan(line), Color(1, 0, 0, 1));
+        g_Render->Update(1.0f / 60);
+
+        // Same pipeline and scene data for all the shapes, each has its own vertices
+        const RenderStats& stats = g_Render->GetStats();
+        TEST_TRUE(stats.drawCount_ == 3);
+        TEST_TRUE(stats.pipelineBinds_ == 1);
+        TEST_TRUE(stats.pipelineBindsSkipped_ == 2);
+        TEST_TRUE(stats.descriptorBindsSkipped_ == 2);
+        TEST_TRUE(stats.bufferBinds_ == 3);
+        TEST_TRUE(stats.bytesAllocated_ >= 3 * sizeof(line));
+
+        // Scene data is the only UBO of the frame, texture indices are push constants
+        TEST_TRUE(g_Render->GetUBOCache()->GetStats().allocCount_ == 1);
+    }
+
+    DestroyFrameArena();
+}
+
+TEST_DEF(RenderNull_DebugShapes_RetainedUntilClearedImmediateForOneFrame)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateFrameArena()));
+    TEST_TRUE(HS_SUCCEEDED(g_FrameArena->Init()));
+
+    {
+        NullRender render;
+        TEST_TRUE(render.IsOk());
+
+        DebugShapeRenderer* shapes = g_Render->GetDebugShapeRenderer();
+        const Vec3 line[] = { Vec3{ 0, 0, 0 }, Vec3{ 1, 1, 0 } };
+        shapes->AddShape(MakeSpan(line), Color(1, 0, 0, 1));
+        shapes->AddShape(MakeSpan(line), Color(0, 1, 0, 1));
+        shapes->AddImmediateShape(MakeSpan(line), Color(0, 0, 1, 1));
+
+        ImGui::NewFrame();
+        g_Render->Update(1.0f / 60);
+        TEST_TRUE(g_Render->GetStats().drawCount_ == 3);
+
+        ImGui::NewFrame();
+        g_Render->Update(1.0f / 60);
+        TEST_TRUE(g_Render->GetStats().drawCount_ == 2);
+
+        shapes->ClearShapes();
+        ImGui::NewFrame();
+        g_Render->Update(1.0f / 60);
+        TEST_TRUE(g_Render->GetStats().drawCount_ == 0);
+    }
+
+    DestroyFrameArena();
+}
+
+TEST_DEF(RenderNull_DebugShapes_TransformedFromLocalSpace)
+{
+    NullRender render;
+    TEST_TRUE(render.IsOk());
+
+    // More points than a batch of four so both the batched and the remaining points are covered
+    Vec3 local[7];
+    for (int i = 0; i < (int)HS_ARR_LEN(local); ++i)
+        local[i] = Vec3((float)i, (float)-i, 0.5f);
+
+    DebugShapeRenderer* shapes = g_Render->GetDebugShapeRenderer();
+    shapes->AddShape(MakeSpan(local), Color(1, 0, 0, 1), Mat44::Scale(2) * Mat44::Translation(Vec3(1, 2, 3)));
+
+    const Span<const DebugShape> added = shapes->GetShapes();
+    TEST_TRUE(added.Count() == 1);
+    TEST_TRUE(added[0].vertices_.Count() == (int)HS_ARR_LEN(local));
+    for (int i = 0; i < added[0].vertices_.Count(); ++i)
+    {
+        const Vec3& v = added[0].vertices_[i];
+        TEST_TRUE(v.x == 2.0f * i + 1 && v.y == 2 - 2.0f * i && v.z == 4);
+    }
+
+    shapes->ClearShapes();
+}
+
+TEST_DEF(RenderNull_BufferCache_ReusesBlocksOfCompletedFrames)
+{
+    RenderConfig config;
+    config.framesInFlight_ = 2;
+    NullRender render(config);
+    TEST_TRUE(render.IsOk());
+
+    // Each frame fills most of a block so every frame in flight needs its own
+    RenderBufferCache* cache = g_Render->GetVertexCache();
+    const int allocSize = (int)cache->GetMaxSize() * 3 / 4;
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        ImGui::NewFrame();
+
+        uint8* data{};
+        const RenderBufferEntry entry = cache->BeginAlloc(allocSize, 16, (void**)&data);
+        TEST_TRUE(entry.buffer_ && data);
+        data[0] = (uint8)frame;
+        data[allocSize - 1] = (uint8)frame;
+        cache->EndAlloc();
+
+        g_Render->Update(1.0f / 60);
+    }
+
+    const RenderBufferCacheStats& stats = cache->GetStats();
+    TEST_TRUE(stats.bytesAllocated_ == (uint64)allocSize);
+    TEST_TRUE(stats.bufferCount_ <= config.framesInFlight_ + 1);
+    TEST_TRUE(stats.growCount_ == 0);
+}
+
+TEST_DEF(RenderNull_PipelineManifest_SkipsStaleEntries)
+{
+    NullRender render;
+    TEST_TRUE(render.IsOk());
+
+    // Materials prewarm their pipelines in Init, one of them has a vertex layout
+    const Span<const Render::PipelineManifestEntry> manifest = g_Render->GetPipelineManifest();
+    const uint64 manifestCount = manifest.Count();
+
+    Array<Render::PipelineManifestEntry> entries;
+    for (uint64 i = 0; i < manifest.Count() && entries.IsEmpty(); ++i)
+    {
+        if (manifest[i].attributeCount_ && manifest[i].shaders_[PS_VERT][0] && manifest[i].shaders_[PS_FRAG][0])
+            entries.Add(manifest[i]);
+    }
+    TEST_TRUE(entries.Count() == 1);
+
+    // Fragment shader in the vertex stage
+    Render::PipelineManifestEntry stale = entries[0];
+    strcpy(stale.shaders_[PS_VERT], stale.shaders_[PS_FRAG]);
+    entries.Add(stale);
+
+    // Attribute reading a binding the entry does not have
+    stale = entries[0];
+    stale.attributes_[0].binding = RenderState::MAX_VERT_BUFF;
+    entries.Add(stale);
+
+    // Render pass which does not exist
+    stale = entries[0];
+    stale.passType_ = RPT_COUNT;
+    entries.Add(stale);
+
+    TEST_TRUE(g_Render->PrecreatePipelines(MakeSpan<const Render::PipelineManifestEntry>(entries.Data(), entries.Count())) == 1);
+    TEST_TRUE(g_Render->GetPipelineManifest().Count() == manifestCount);
+}
+
+//------------------------------------------------------------------------------
+//! One draw per object with the object's vertex buffer
+class NullTestMaterial : public Material
+{
+public:
+    RESULT Init() override
+    {
+        vs_ = g_Render->GetShaderManager()->GetOrCreateShader("Shape_vs");
+        fs_ = g_Render->GetShaderManager()->GetOrCreateShader("Shape_fs");
+        return vs_ && fs_ ? R_OK : R_FAIL;
+    }
+
+    void Draw(const RenderPassContext& ctx, const DrawData& drawData) override
+    {
+        g_Render->SetVertexBuffer(0, drawData.object_->vertexBuffer_.buffer_);
+        g_Render->SetShader<PS_VERT>(vs_);
+        g_Render->SetShader<PS_FRAG>(fs_);
+        g_Render->Draw(ctx, 3, 0);
+    }
+
+private:
+    Shader* vs_{};
+    Shader* fs_{};
+};
+
+TEST_DEF(RenderNull_MainPass_RecordsChunksInParallel)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateJobSystem()));
+    TEST_TRUE(HS_SUCCEEDED(g_JobSystem->Init(4)));
+
+    // The render uses the job system until it is destroyed
+    {
+        NullRender render;
+        TEST_TRUE(render.IsOk());
+
+        NullTestMaterial material;
+        TEST_TRUE(HS_SUCCEEDED(material.Init()));
+
+        // Different vertex offsets so no objects are instanced together
+        constexpr int OBJECT_COUNT = 4096;
+        Array<VisualObject> objects;
+        for (int i = 0; i < OBJECT_COUNT; ++i)
+        {
+            VisualObject object{};
+            object.transform_ = Mat44::Identity();
+            object.material_ = &material;
+            object.vertexBuffer_.buffer_ = RenderBufferEntry{ (VkBuffer)(uintptr)1, i * 64, 64 };
+            objects.Add(object);
+        }
+
+        ImGui::NewFrame();
+        g_Render->RenderObjects(MakeSpan(objects.Data(), objects.Count()));
+        g_Render->Update(1.0f / 60);
+
+        // Each chunk has its own recorder so it binds the pipeline once for itself
+        const RenderStats& stats = g_Render->GetStats();
+        TEST_TRUE(stats.drawCount_ == OBJECT_COUNT);
+        TEST_TRUE(stats.bufferBinds_ == OBJECT_COUNT);
+        TEST_TRUE(stats.pipelineBinds_ > 1 && stats.pipelineBinds_ <= (uint)g_JobSystem->GetThreadCount());
+        TEST_TRUE(stats.pipelineBinds_ + stats.pipelineBindsSkipped_ == OBJECT_COUNT);
+    }
+
+    DestroyJobSystem();
+}
+
+TEST_DEF(RenderNull_MeshPool_SuballocatesAndReusesRanges)
+{
+    NullRender render;
+    TEST_TRUE(render.IsOk());
+
+    MeshPool pool;
+    TEST_TRUE(HS_SUCCEEDED(pool.Init(sizeof(ObjectVertex), 8, 64)));
+
+    ObjectVertex vertices[4]{};
+    for (int i = 0; i < 4; ++i)
+        vertices[i].position_ = Vec3{ (float)i, 0, 0 };
+    const uint16 indices16[] = { 0, 1, 2, 2, 1, 3 };
+    const uint indices32[] = { 3, 2, 1 };
+
+    Mesh a, b;
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, a)));
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices32, 3, IndexType::U32, b)));
+
+    // Both index types share the buffer, offsets are in elements of each mesh's type
+    TEST_TRUE(a.firstVertex_ == 0 && a.firstIndex_ == 0);
+    TEST_TRUE(b.firstVertex_ == 4 && b.firstIndex_ == 3);
+
+    // Null buffers are host memory at the handle's address
+    const ObjectVertex* poolVertices = (const ObjectVertex*)(uintptr)pool.GetVertexBuffer().buffer_;
+    const uint* poolIndices = (const uint*)(uintptr)pool.GetIndexBuffer().buffer_;
+    TEST_TRUE(poolVertices[b.firstVertex_ + 3].position_.x == 3);
+    TEST_TRUE(poolIndices[b.firstIndex_] == 3);
+
+    // All vertices are taken
+    Mesh c;
+    TEST_TRUE(HS_FAILED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, c)));
+
+    // Ranges of a removed mesh are reused once the frames which may draw it finish
+    pool.Remove(a);
+    TEST_TRUE(HS_FAILED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, a)));
+    for (uint frame = 0; frame < RenderConfig::MAX_FRAMES_IN_FLIGHT + 1; ++frame)
+    {
+        ImGui::NewFrame();
+        g_Render->Update(1.0f / 60);
+    }
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, a)));
+    TEST_TRUE(a.firstVertex_ == 0);
+    TEST_TRUE(pool.GetStats().meshCount_ == 2 && pool.GetStats().pendingFrees_ == 0);
+
+    pool.Free();
+}
+
+TEST_DEF(RenderNull_MeshPool_BatchesMeshesIntoIndirectDraws)
+{
+    NullRender render;
+    TEST_TRUE(render.IsOk());
+
+    PBRMaterial material;
+    TEST_TRUE(HS_SUCCEEDED(material.Init()));
+
+    MeshPool pool;
+    TEST_TRUE(HS_SUCCEEDED(pool.Init(sizeof(ObjectVertex), 64, 256)));
+
+    const ObjectVertex vertices[4]{};
+    const uint16 indices16[] = { 0, 1, 2, 2, 1, 3 };
+    const uint indices32[] = { 0, 1, 2 };
+
+    Mesh meshes[3];
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, meshes[0])));
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices16, 6, IndexType::U16, meshes[1])));
+    TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 3, indices32, 3, IndexType::U32, meshes[2])));
+
+    // 3 objects of the first mesh, 2 of the second and 1 of the 32-bit one
+    const int meshOfObject[] = { 0, 1, 0, 2, 1, 0 };
+    VisualObject objects[HS_ARR_LEN(meshOfObject)]{};
+    for (int i = 0; i < (int)HS_ARR_LEN(meshOfObject); ++i)
+    {
+        objects[i].transform_ = Mat44::Identity();
+        objects[i].material_ = &material;
+        objects[i].mesh_ = meshes[meshOfObject[i]];
+        g_Render->RenderObject(&objects[i]);
+    }
+
+    ImGui::NewFrame();
+    g_Render->Update(1.0f / 60);
+
+    // One indirect draw per index type, one command per mesh
+    const RenderStats& stats = g_Render->GetStats();
+    TEST_TRUE(stats.drawCount_ == 2);
+    TEST_TRUE(stats.indirectCommands_ == 3);
+
+    // Both draws share the material's constants with the scene data
+    TEST_TRUE(g_Render->GetUBOCache()->GetStats().allocCount_ == 2);
+
+    pool.Free();
+}
+
+TEST_DEF(RenderNull_MainPass_ChunksKeepMeshBatchesWhole)
+{
+    TEST_TRUE(HS_SUCCEEDED(CreateJobSystem()));
+    TEST_TRUE(HS_SUCCEEDED(g_JobSystem->Init(4)));
+
+    // The render uses the job system until it is destroyed
+    {
+        NullRender render;
+        TEST_TRUE(render.IsOk());
+
+        PBRMaterial material;
+        TEST_TRUE(HS_SUCCEEDED(material.Init()));
+
+        MeshPool pool;
+        TEST_TRUE(HS_SUCCEEDED(pool.Init(sizeof(ObjectVertex), 64, 256)));
+
+        const ObjectVertex vertices[4]{};
+        const uint16 indices[] = { 0, 1, 2, 2, 1, 3 };
+        Mesh mesh;
+        TEST_TRUE(HS_SUCCEEDED(pool.Add(vertices, 4, indices, 6, IndexType::U16, mesh)));
+
+        // Enough objects to be split into chunks, all of them are one batch
+        constexpr int OBJECT_COUNT = 4096;
+        Array<VisualObject> objects;
+        for (int i = 0; i < OBJECT_COUNT; ++i)
+        {
+            VisualObject object{};
+            object.transform_ = Mat44::Identity();
+            object.material_ = &material;
+            object.mesh_ = mesh;
+            objects.Add(object);
+        }
+
+        ImGui::NewFrame();
+        g_Render->RenderObjects(MakeSpan(objects.Data(), objects.Count()));
+        g_Render->Update(1.0f / 60);
+
+        const RenderStats& stats = g_Render->GetStats();
+        TEST_TRUE(stats.drawCount_ == 1);
+        TEST_TRUE(stats.indirectCommands_ == 1);
+
+        pool.Free();
+    }
+
+    DestroyJobSystem();
+}
+
+TEST_DEF(RenderNull_GpuCuller_DrawsVisibleObjectsWithDrawCounts)
+{
+    RenderConfig config;
+    config.gpuCulling_ = true;
+    NullRender render(config);
+    TEST_TRUE(render.IsOk());
+
+    GpuCuller* culler = g_Render->GetGpuCuller();
+    TEST_TRUE(culler);
+
+    GpuCullScene scene;
+    TEST_TRUE(HS_SUCCEEDED(scene.Init()));
+    scene.RenderFrame();
+
+    const GpuCullStats& cullStats = culler->GetStats();
+    TEST_TRUE(cullStats.objects_ == 6 && cullStats.batches_ == 2 && cullStats.visible_ == 4);
+
+    // Objects are grouped by batch in the order they came
+    const Span<const GpuCullBatch> batches = culler->GetBatches();
+    TEST_TRUE(batches.Count() == 2);
+    TEST_TRUE(batches[0].indexType_ == IndexType::U16 && batches[0].maxDraws_ == 4);
+    TEST_TRUE(batches[1].indexType_ == IndexType::U32 && batches[1].maxDraws_ == 2);
+    TEST_TRUE(*GetBatchDrawCount(batches[0]) == 3);
+    TEST_TRUE(*GetBatchDrawCount(batches[1]) == 1);
+
+    const VkDrawIndexedIndirectCommand* commands = GetBatchCommands(batches[1]);
+    TEST_TRUE(commands[0].indexCount == 3 && commands[0].firstIndex == scene.meshes_[1].firstIndex_ && commands[0].firstInstance == 5);
+
+    // One indirect draw per batch, nothing went through the draw list
+    const RenderStats& stats = g_Render->GetStats();
+    TEST_TRUE(stats.drawCount_ == 2);
+    TEST_TRUE(stats.indirectCommands_ == 6);
+    TEST_TRUE(stats.objectsGpuCulled_ == 6 && stats.objectsVisible_ == 0);
+
+    scene.Free();
+}
+
+TEST_DEF(RenderNull_GpuCuller_ValidationCatchesWrongOutput)
+{
+    RenderConfig config;
+    config.framesInFlight_ = 2;
+    config.gpuCulling_ = true;
+    config.gpuCullingValidation_ = true;
+    NullRender render(config);
+    TEST_TRUE(render.IsOk());
+
+    GpuCuller* culler = g_Render->GetGpuCuller();
+    TEST_TRUE(culler);
+
+    GpuCullScene scene;
+    TEST_TRUE(HS_SUCCEEDED(scene.Init()));
+
+    // Output of a frame is validated when its slot is reused two frames later, null
+    // buffers are the output itself so they are changed the way a faulty pass would
+    const GpuCullStats& cullStats = culler->GetStats();
+
+    // Compact commands come in any order, only the visible ones are compared
+    scene.RenderFrame();
+    VkDrawIndexedIndirectCommand* commands = GetBatchCommands(culler->GetBatches()[0]);
+    TEST_TRUE(*GetBatchDrawCount(culler->GetBatches()[0]) == 3);
+    const VkDrawIndexedIndirectCommand first = commands[0];
+    commands[0] = commands[2];
+    commands[2] = first;
+    commands[3].indexCount = 1234;
+
+    // Wrong draw count
+    scene.RenderFrame();
+    ++*GetBatchDrawCount(culler->GetBatches()[1]);
+
+    scene.RenderFrame();
+    TEST_TRUE(cullStats.framesValidated_ == 1 && cullStats.validationFailures_ == 0);
+
+    // Wrong visible command
+    GetBatchCommands(culler->GetBatches()[0])[1].firstIndex += 1;
+
+    scene.RenderFrame();
+    TEST_TRUE(cullStats.framesValidated_ == 2 && cullStats.validationFailures_ == 1);
+
+    scene.RenderFrame();
+    TEST_TRUE(cullStats.framesValidated_ == 3 && cullStats.validationFailures_ == 2);
+
+    // Correct output of the last frames
+    scene.RenderFrame();
+    scene.RenderFrame();
+    TEST_TRUE(cullStats.framesValidated_ == 5 && cullStats.validationFailures_ == 2);
+
+    scene.Free();
+}
+
+TEST_DEF(RenderNull_GpuCuller_ValidationAcceptsBoxesOnAPlane)
+{
+    RenderConfig config;
+    config.framesInFlight_ = 2;
+    config.gpuCulling_ = true;
+    config.gpuCullingValidation_ = true;
+    NullRender render(config);
+    TEST_TRUE(render.IsOk());
+
+    GpuCuller* culler = g_Render->GetGpuCuller();
+    TEST_TRUE(culler);
+
+    GpuCullScene scene;
+    TEST_TRUE(HS_SUCCEEDED(scene.Init()));
+
+    // Box of the second batch's first object touches the left plane from outside, exactly at its corner
+    const Camera* camera = g_Render->GetCamera();
+    const Frustum frustum = MakeFrustum(camera->toCamera_ * camera->toProjection_);
+    const Vec4& plane = frustum.planes_[FP_LEFT];
+    const Vec3 normal(plane.x, plane.y, plane.z);
+    const float radius = 0.5f * (fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z));
+    scene.objects_[1].transform_ = Mat44::Translation(normal * -(plane.w + radius));
+
+    // The GPU rounding the other way gives the opposite of the reference, which is not a failure
+    scene.RenderFrame();
+    const GpuCullBatch& batch = culler->GetBatches()[1];
+    VkDrawIndexedIndirectCommand* commands = GetBatchCommands(batch);
+    uint* drawCount = GetBatchDrawCount(batch);
+    if (*drawCount == 2)
+    {
+        if (commands[0].firstInstance == 4)
+            commands[0] = commands[1];
+        --*drawCount;
+    }
+    else
+    {
+        TEST_TRUE(*drawCount == 1 && commands[0].firstInstance == 5);
+        commands[1] = commands[0];
+        commands[1].firstInstance = 4;
+        ++*drawCount;
+    }
+
+    scene.RenderFrame();
+    scene.RenderFrame();
+
+    const GpuCullStats& cullStats = culler->GetStats();
+    TEST_TRUE(cullStats.framesValidated_ == 1 && cullStats.validationFailures_ == 0);
+
+    scene.Free();
+}